@@ -1,22 +1,13 @@
 #
-# Includes flags and libraries to compile&link with "prometheus-cpp" library
+# Includes flags to compile the built-in Prometheus exposition support
 # https://github.com/f18m/cmonitor
 # Francesco Montorsi (c) 2019
 #
 
-ifeq ($(PROMETHEUS_SUPPORT),1)
+# Prometheus support has no external dependency: it is enabled unless PROMETHEUS_SUPPORT=0 is given
+ifneq ($(PROMETHEUS_SUPPORT),0)
 
 $(info INFO: Prometheus support is ENABLED)
-
-ifeq ($(wildcard $(ROOT_DIR)/conandeps.mk),)
-$(error Please run 'conan install . --build=missing' first)
-endif
-
-# include prometheus-cpp depedency through the GNU make variables provided by Conan at install time
-# NOTE: for some reason "dl pthread" libraries must be explicitly listed
-include $(ROOT_DIR)/conandeps.mk
-LIBS += $(foreach libdir,$(CONAN_LIB_DIRS),-L$(libdir)) $(foreach lib,$(CONAN_LIBS),-l$(lib)) -ldl -lpthread
-CXXFLAGS += $(CONAN_CXXFLAGS) -I$(CONAN_INCLUDE_DIRS_PROMETHEUS_CPP)
 DEFS += -DPROMETHEUS_SUPPORT=1
 else
 
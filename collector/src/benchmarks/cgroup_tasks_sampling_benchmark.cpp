@@ -0,0 +1,91 @@
+//------------------------------------------------------------------------------
+// Benchmark tests for the sampling of the tasks of a cgroup
+/*
+	Measures the time to sample the tasks of a cgroup containing thousands of threads, as done with
+	--collect=cgroup_threads --deep-collect, using from 1 to 16 sampling threads (see --sampling-threads);
+	the number after '/' is the number of sampling threads.
+	The benchmark monitors its own cgroup (which is where the idle threads it spawns live), so it requires
+	cgroups to be available; the "tasks" counter reports the number of tasks sampled each time.
+*/
+//------------------------------------------------------------------------------
+
+#include "../cgroups.h"
+#include "../output_frontend.h"
+#include <benchmark/benchmark.h> // "google-benchmark-devel" RPM (or similar package) is required
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define NUM_IDLE_THREADS (5000)
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+// a crowd of threads doing nothing, just to populate the cgroup
+class IdleThreads {
+public:
+    IdleThreads(unsigned int n)
+    {
+        for (unsigned int i = 0; i < n; i++)
+            m_threads.push_back(std::thread([this]() {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [this]() -> bool { return m_stop; });
+            }));
+    }
+    ~IdleThreads()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        for (auto& t : m_threads)
+            t.join();
+    }
+
+private:
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stop = false;
+};
+
+//------------------------------------------------------------------------------
+// BM_sample_cgroup_threads
+//------------------------------------------------------------------------------
+
+static void BM_sample_cgroup_threads(benchmark::State& state)
+{
+    IdleThreads idle(NUM_IDLE_THREADS);
+
+    CMonitorCollectorAppConfig cfg;
+    cfg.m_strCGroupName = "self";
+    cfg.m_nCollectFlags = PK_CGROUP_THREADS;
+    cfg.m_nSamplingThreads = state.range(0);
+
+    CMonitorOutputFrontend output;
+    CMonitorCgroups cgroups(&cfg, &output);
+    cgroups.init(true /* include_threads */);
+    if (cgroups.get_detected_cgroup_version() == CG_NONE || (cfg.m_nCollectFlags & PK_CGROUP_THREADS) == 0) {
+        state.SkipWithError("cgroups not available");
+        return;
+    }
+
+    // bootstrap sample:
+    cgroups.sample_process_list();
+    cgroups.sample_processes(1.0, PF_ALL);
+
+    for (auto _ : state) {
+        output.psample_start();
+        cgroups.sample_process_list();
+        cgroups.sample_processes(1.0, PF_ALL);
+
+        state.PauseTiming();
+        output.push_current_sample(); // discards the sample: no output has been configured
+        state.ResumeTiming();
+    }
+
+    state.counters["tasks"] = cgroups.get_num_tasks();
+}
+BENCHMARK(BM_sample_cgroup_threads)->RangeMultiplier(2)->Range(1, 16)->Unit(benchmark::kMillisecond)->UseRealTime();
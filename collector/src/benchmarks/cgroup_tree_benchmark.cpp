@@ -0,0 +1,113 @@
+//------------------------------------------------------------------------------
+// Benchmark tests for the discovery of the cgroups of a whole host
+/*
+	Measures the cost of --cgroup-discovery on a synthetic hierarchy shaped like the one of a Kubernetes node:
+	50 pods with 100 containers each, i.e. about 5k cgroups. The hierarchy is made of plain directories in /tmp:
+	inotify reports mkdir/rmdir the same way it does for cgroupfs.
+	 - BM_cgroup_tree_init: initial walk of the hierarchy, adding one inotify watch per cgroup
+	 - BM_cgroup_tree_update: applying the creation and the removal of 10 cgroups, i.e. the incremental update
+	   done at each sampling interval in place of a new walk
+	 - BM_cgroup_tree_update_idle: the cost paid at each sampling interval when no cgroup changed
+*/
+//------------------------------------------------------------------------------
+
+#include "../cgroup_tree.h"
+#include <benchmark/benchmark.h> // "google-benchmark-devel" RPM (or similar package) is required
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define NUM_PODS (50)
+#define NUM_CONTAINERS_PER_POD (100)
+#define NUM_CHANGES_PER_UPDATE (10)
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+class SyntheticHierarchy {
+public:
+    SyntheticHierarchy()
+    {
+        m_root = "/tmp/cmonitor_cgroup_tree_benchmark_" + std::to_string(getpid());
+        mkdir(m_root.c_str(), 0755);
+        mkdir((m_root + "/kubepods").c_str(), 0755);
+        for (unsigned int p = 0; p < NUM_PODS; p++) {
+            mkdir(get_pod_path(p).c_str(), 0755);
+            for (unsigned int c = 0; c < NUM_CONTAINERS_PER_POD; c++)
+                mkdir((get_pod_path(p) + "/container" + std::to_string(c)).c_str(), 0755);
+        }
+    }
+    ~SyntheticHierarchy()
+    {
+        std::string cmd = "rm -rf " + m_root;
+        if (system(cmd.c_str()) != 0)
+            fprintf(stderr, "Failed to remove %s\n", m_root.c_str());
+    }
+
+    const std::string& get_root() const { return m_root; }
+    std::string get_pod_path(unsigned int pod) const { return m_root + "/kubepods/pod" + std::to_string(pod); }
+
+private:
+    std::string m_root;
+};
+
+//------------------------------------------------------------------------------
+// Benchmarks
+//------------------------------------------------------------------------------
+
+static void BM_cgroup_tree_init(benchmark::State& state)
+{
+    SyntheticHierarchy hierarchy;
+    CMonitorCgroupTree tree;
+    for (auto _ : state)
+        tree.init(hierarchy.get_root());
+
+    state.counters["cgroups"] = tree.get_num_cgroups();
+    if (!tree.is_watching_all())
+        state.SkipWithError("cannot watch all the cgroups: increase fs.inotify.max_user_watches");
+}
+BENCHMARK(BM_cgroup_tree_init)->Unit(benchmark::kMillisecond);
+
+static void BM_cgroup_tree_update(benchmark::State& state)
+{
+    SyntheticHierarchy hierarchy;
+    CMonitorCgroupTree tree;
+    tree.init(hierarchy.get_root());
+
+    std::vector<std::string> added, removed;
+    unsigned int n = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        // containers come and go in the pods:
+        for (unsigned int i = 0; i < NUM_CHANGES_PER_UPDATE; i++, n++) {
+            std::string path = hierarchy.get_pod_path(n % NUM_PODS) + "/new-container" + std::to_string(n);
+            mkdir(path.c_str(), 0755);
+            if (n >= NUM_CHANGES_PER_UPDATE) {
+                unsigned int old = n - NUM_CHANGES_PER_UPDATE;
+                path = hierarchy.get_pod_path(old % NUM_PODS) + "/new-container" + std::to_string(old);
+                rmdir(path.c_str());
+            }
+        }
+        state.ResumeTiming();
+
+        tree.update(added, removed);
+    }
+
+    state.counters["cgroups"] = tree.get_num_cgroups();
+    state.counters["full_scans"] = tree.get_stats().full_scans;
+}
+BENCHMARK(BM_cgroup_tree_update)->Unit(benchmark::kMicrosecond);
+
+static void BM_cgroup_tree_update_idle(benchmark::State& state)
+{
+    SyntheticHierarchy hierarchy;
+    CMonitorCgroupTree tree;
+    tree.init(hierarchy.get_root());
+
+    std::vector<std::string> added, removed;
+    for (auto _ : state)
+        tree.update(added, removed);
+}
+BENCHMARK(BM_cgroup_tree_update_idle)->Unit(benchmark::kMicrosecond);
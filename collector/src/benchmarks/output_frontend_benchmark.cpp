@@ -0,0 +1,112 @@
+//------------------------------------------------------------------------------
+// Benchmark tests for output frontend encoders
+/*
+	Compares JSON vs CBOR encoding of a synthetic sample shaped like the "cgroup_tasks"
+	section produced with --collect=cgroup_threads --deep-collect; the number after '/'
+	is the number of tasks in the sample.
+	The "bytes_per_sample" counter reports the size of the encoded sample.
+*/
+//------------------------------------------------------------------------------
+
+#include "../output_frontend.h"
+#include <benchmark/benchmark.h> // "google-benchmark-devel" RPM (or similar package) is required
+#include <sys/stat.h> // stat()
+#include <unistd.h> // unlink()
+
+#define BENCHMARK_OUTPUT_PREFIX "/tmp/cmonitor_output_frontend_benchmark"
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+static void fill_synthetic_sample(CMonitorOutputFrontend& output, int ntasks)
+{
+    output.psample_start();
+    output.psection_start("timestamp");
+    output.pstring("UTC", "2021-12-14T01:13:18.000");
+    output.plong("sample_index", 1);
+    output.psection_end();
+
+    output.psection_start("cgroup_tasks");
+    for (int i = 0; i < ntasks; i++) {
+        std::string pid = std::to_string(1000 + i);
+        std::map<std::string, std::string> labels = { { "pid", pid }, { "cmd", "redis-server" } };
+
+        output.psubsection_start(fmt::format("pid_{}", pid).c_str(), labels);
+
+        output.psubsubsection_start("proc_info");
+        output.pstring("cmd", "redis-server");
+        output.pstring("cmd_line", "/usr/local/bin/redis-server *:6379");
+        output.plong("pid", 1000 + i);
+        output.plong("ppid", 1);
+        output.plong("tgid", 1000);
+        output.pstring("state", "Sleeping-interruptible");
+        output.psubsubsection_end();
+
+        output.psubsubsection_start("cpu", labels);
+        output.pdouble("user", 1.234 * i);
+        output.pdouble("sys", 0.567 * i);
+        output.plong("user_time_secs", 12345 + i);
+        output.plong("system_time_secs", 678 + i);
+        output.plong("last_cpu", i % 64);
+        output.psubsubsection_end();
+
+        output.psubsubsection_start("memory", labels);
+        output.plong("minor_fault", 1234567 + i);
+        output.plong("major_fault", 12);
+        output.plong("virtual_size_bytes", 123456789012LL + i);
+        output.plong("resident_set_size_bytes", 123456789LL + i);
+        output.psubsubsection_end();
+
+        output.psubsubsection_start("io", labels);
+        output.plong("rchar", 987654321LL + i);
+        output.plong("wchar", 123456789LL + i);
+        output.plong("read_bytes", 4096 * i);
+        output.plong("write_bytes", 8192 * i);
+        output.psubsubsection_end();
+
+        output.psubsection_end();
+    }
+    output.psection_end();
+}
+
+static void run_encoder_benchmark(benchmark::State& state, bool cbor)
+{
+    std::string outFile = std::string(BENCHMARK_OUTPUT_PREFIX) + (cbor ? ".cbor" : ".json");
+
+    {
+        CMonitorOutputFrontend output;
+        if (cbor)
+            output.init_cbor_output_file(BENCHMARK_OUTPUT_PREFIX);
+        else
+            output.init_json_output_file(BENCHMARK_OUTPUT_PREFIX);
+
+        for (auto _ : state) {
+            state.PauseTiming();
+            fill_synthetic_sample(output, state.range(0));
+            state.ResumeTiming();
+
+            output.push_current_sample();
+        }
+        output.close();
+    }
+
+    struct stat st;
+    if (stat(outFile.c_str(), &st) == 0 && state.iterations() > 0)
+        state.counters["bytes_per_sample"] = (double)st.st_size / state.iterations();
+    unlink(outFile.c_str());
+}
+
+//------------------------------------------------------------------------------
+// BM_encode_json
+//------------------------------------------------------------------------------
+
+static void BM_encode_json(benchmark::State& state) { run_encoder_benchmark(state, false); }
+BENCHMARK(BM_encode_json)->RangeMultiplier(10)->Range(1, 1000);
+
+//------------------------------------------------------------------------------
+// BM_encode_cbor
+//------------------------------------------------------------------------------
+
+static void BM_encode_cbor(benchmark::State& state) { run_encoder_benchmark(state, true); }
+BENCHMARK(BM_encode_cbor)->RangeMultiplier(10)->Range(1, 1000);
@@ -0,0 +1,288 @@
+/*
+ * cgroup_tree.cpp -- incremental discovery of the cgroups of a hierarchy
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cgroup_tree.h"
+#include "logger.h"
+#include "utils_files.h"
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ----------------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------------
+
+// cgroups are directories: files appearing or disappearing inside them are not interesting
+#define CGROUP_TREE_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroupTree
+// ----------------------------------------------------------------------------------
+
+bool CMonitorCgroupTree::init(const std::string& root_path)
+{
+    close();
+    m_root = root_path;
+    while (m_root.size() > 1 && m_root.back() == '/')
+        m_root.pop_back();
+    m_stats = cgroup_tree_stats_t();
+    m_rescan_needed = false;
+
+    if (!file_or_dir_exists(m_root.c_str())) {
+        CMonitorLogger::instance()->LogError("Cannot find the cgroup hierarchy %s\n", m_root.c_str());
+        return false;
+    }
+    m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify_fd == -1) {
+        CMonitorLogger::instance()->LogErrorWithErrno("Failed to create the inotify instance to watch cgroups");
+        return false;
+    }
+
+    add_subtree("", nullptr);
+    m_stats.full_scans++;
+    CMonitorLogger::instance()->LogDebug("Found %zu cgroups below %s, watching %zu of them\n", m_cgroups.size(),
+        m_root.c_str(), m_watched_paths.size());
+    return true;
+}
+
+void CMonitorCgroupTree::close()
+{
+    if (m_inotify_fd != -1) {
+        ::close(m_inotify_fd); // removes all the watches
+        m_inotify_fd = -1;
+    }
+    m_cgroups.clear();
+    m_watched_paths.clear();
+}
+
+bool CMonitorCgroupTree::update(std::vector<std::string>& addedOUT, std::vector<std::string>& removedOUT)
+{
+    addedOUT.clear();
+    removedOUT.clear();
+    if (m_inotify_fd == -1)
+        return false;
+
+    char buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(m_inotify_fd, buf, sizeof(buf))) > 0) {
+        for (char* ptr = buf; ptr < buf + len;) {
+            const struct inotify_event* event = (const struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+            m_stats.events++;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                CMonitorLogger::instance()->LogDebug("The inotify queue overflowed: rescanning all cgroups\n");
+                m_rescan_needed = true;
+                continue;
+            }
+            auto it = m_watched_paths.find(event->wd);
+            if (it == m_watched_paths.end())
+                continue; // e.g. events of a cgroup removed by a previous event
+            if (event->mask & IN_IGNORED) {
+                // the watched directory is gone
+                m_watched_paths.erase(it);
+                continue;
+            }
+            if ((event->mask & IN_ISDIR) == 0 || event->len == 0)
+                continue;
+
+            std::string path = it->second.empty() ? event->name : it->second + "/" + event->name;
+            if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                add_subtree(path, &addedOUT);
+            else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                remove_subtree(path, &removedOUT);
+        }
+    }
+
+    if (m_rescan_needed)
+        rescan(addedOUT, removedOUT);
+
+    m_stats.added += addedOUT.size();
+    m_stats.removed += removedOUT.size();
+    return !addedOUT.empty() || !removedOUT.empty();
+}
+
+std::vector<std::string> CMonitorCgroupTree::get_cgroups() const
+{
+    std::vector<std::string> ret;
+    ret.reserve(m_cgroups.size());
+    for (const auto& it : m_cgroups)
+        ret.push_back(it.first);
+    return ret;
+}
+
+bool CMonitorCgroupTree::has_children(const std::string& path) const
+{
+    std::string prefix = path + "/";
+    auto it = m_cgroups.lower_bound(prefix);
+    return it != m_cgroups.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool CMonitorCgroupTree::select_cgroups_to_monitor(std::vector<std::string> candidates,
+    const std::vector<std::string>& patterns, const std::set<std::string>& monitored, size_t max_monitored,
+    std::vector<std::string>& selectedOUT) const
+{
+    // a stable order: the same cgroups are picked whatever the order of the events that reported them
+    std::sort(candidates.begin(), candidates.end());
+
+    selectedOUT.clear();
+    size_t num_monitored = monitored.size();
+    for (const auto& path : candidates) {
+        bool matching = false;
+        if (patterns.empty())
+            // without patterns only the leaves are monitored: e.g. the containers and not the slices holding them
+            matching = !has_children(path);
+        for (const auto& pattern : patterns)
+            if (fnmatch(pattern.c_str(), path.c_str(), FNM_PATHNAME) == 0)
+                matching = true;
+        if (!matching || monitored.count(path))
+            continue;
+        if (num_monitored >= max_monitored)
+            return false;
+        selectedOUT.push_back(path);
+        num_monitored++;
+    }
+    return true;
+}
+
+void CMonitorCgroupTree::add_subtree(const std::string& path, std::vector<std::string>* addedOUT)
+{
+    if (!path.empty()) {
+        auto it = m_cgroups.insert(std::make_pair(path, -1));
+        if (!it.second)
+            return; // e.g. found while listing its parent and then reported by inotify as well
+        if (addedOUT)
+            addedOUT->push_back(path);
+        it.first->second = add_watch(path);
+    } else
+        add_watch(path);
+
+    // the watch is added before listing the subdirectories: those created in the meantime are not lost
+    std::vector<std::string> children;
+    list_subdirs(path, children);
+    for (const auto& child : children)
+        add_subtree(child, addedOUT);
+}
+
+void CMonitorCgroupTree::remove_subtree(const std::string& path, std::vector<std::string>* removedOUT)
+{
+    auto remove = [&](std::map<std::string, int>::iterator it) {
+        if (it->second != -1) {
+            inotify_rm_watch(m_inotify_fd, it->second); // fails if the kernel already removed it: no problem
+            m_watched_paths.erase(it->second);
+        }
+        if (removedOUT)
+            removedOUT->push_back(it->first);
+        return m_cgroups.erase(it);
+    };
+
+    auto it = m_cgroups.find(path);
+    if (it == m_cgroups.end())
+        return; // e.g. already removed together with its parent
+    remove(it);
+
+    // the descendants of a path are contiguous in the map, starting from "path/"; they do not necessarily
+    // follow the path itself since siblings like "path-x" or "path.slice" sort in between
+    std::string prefix = path + "/";
+    it = m_cgroups.lower_bound(prefix);
+    while (it != m_cgroups.end() && it->first.compare(0, prefix.size(), prefix) == 0)
+        it = remove(it);
+}
+
+int CMonitorCgroupTree::add_watch(const std::string& path)
+{
+    int wd = inotify_add_watch(m_inotify_fd, get_abs_path(path).c_str(), CGROUP_TREE_WATCH_MASK);
+    if (wd == -1) {
+        if (errno == ENOENT || errno == ENOTDIR)
+            return -1; // removed in the meantime: its parent is going to report it
+
+        if (!m_rescan_needed)
+            CMonitorLogger::instance()->LogErrorWithErrno(
+                "Failed to watch the cgroup %s; falling back to rescanning all cgroups at each update",
+                get_abs_path(path).c_str());
+        m_rescan_needed = true;
+        return -1;
+    }
+    m_watched_paths[wd] = path;
+    return wd;
+}
+
+void CMonitorCgroupTree::rescan(std::vector<std::string>& addedOUT, std::vector<std::string>& removedOUT)
+{
+    m_stats.full_scans++;
+    m_rescan_needed = false; // unless watching fails again
+
+    // list all the cgroups, parents before their children:
+    std::vector<std::string> current, stack(1, "");
+    while (!stack.empty()) {
+        std::string path = stack.back();
+        stack.pop_back();
+        std::vector<std::string> children;
+        list_subdirs(path, children);
+        for (auto it = children.rbegin(); it != children.rend(); ++it)
+            stack.push_back(*it);
+        if (!path.empty())
+            current.push_back(path);
+    }
+    std::sort(current.begin(), current.end());
+
+    // the cgroups in the tree but not on disk anymore:
+    std::vector<std::string> stale;
+    for (const auto& it : m_cgroups)
+        if (!std::binary_search(current.begin(), current.end(), it.first))
+            stale.push_back(it.first);
+    for (const auto& path : stale)
+        remove_subtree(path, &removedOUT); // no-op for those already removed with their parent
+
+    for (const auto& path : current) {
+        auto it = m_cgroups.insert(std::make_pair(path, -1));
+        if (it.second)
+            addedOUT.push_back(path);
+        if (it.first->second == -1)
+            it.first->second = add_watch(path);
+    }
+}
+
+void CMonitorCgroupTree::list_subdirs(const std::string& path, std::vector<std::string>& pathsOUT) const
+{
+    std::string abs_path = get_abs_path(path);
+    DIR* dir = opendir(abs_path.c_str());
+    if (dir == nullptr)
+        return; // e.g. removed in the meantime
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat st;
+            std::string entry_path = abs_path + "/" + entry->d_name;
+            if (lstat(entry_path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+                continue;
+        } else if (entry->d_type != DT_DIR)
+            continue;
+        pathsOUT.push_back(path.empty() ? entry->d_name : path + "/" + entry->d_name);
+    }
+    closedir(dir);
+}
@@ -0,0 +1,98 @@
+/*
+ * cgroup_tree.h -- incremental discovery of the cgroups of a hierarchy
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+typedef struct {
+    uint64_t full_scans = 0; // walks of the whole hierarchy: the initial one plus those needed to recover lost events
+    uint64_t events = 0; // inotify events processed
+    uint64_t added = 0; // cgroups found after the initial walk
+    uint64_t removed = 0;
+} cgroup_tree_stats_t;
+
+//------------------------------------------------------------------------------
+// CMonitorCgroupTree
+//
+// Keeps the list of all the cgroups of a hierarchy, e.g. /sys/fs/cgroup/memory with cgroups v1 or
+// /sys/fs/cgroup with cgroups v2. The hierarchy is walked once by init(); then every directory is watched with
+// inotify and update() applies the creations/removals reported by the kernel, so that its cost depends on the
+// number of cgroups that changed and not on the size of the hierarchy.
+// If a directory cannot be watched (e.g. the fs.inotify.max_user_watches limit is reached) or the inotify queue
+// overflows, update() falls back to walking the whole hierarchy and comparing it with the known cgroups.
+//------------------------------------------------------------------------------
+
+class CMonitorCgroupTree {
+public:
+    CMonitorCgroupTree() { }
+    ~CMonitorCgroupTree() { close(); }
+
+    bool init(const std::string& root_path);
+    void close();
+
+    // applies the pending changes; the cgroups are reported as paths relative to the root of the hierarchy,
+    // parents before their children; returns false if nothing changed
+    bool update(std::vector<std::string>& addedOUT, std::vector<std::string>& removedOUT);
+
+    // all the cgroups below the root, sorted by path
+    std::vector<std::string> get_cgroups() const;
+    size_t get_num_cgroups() const { return m_cgroups.size(); }
+    bool has_children(const std::string& path) const;
+
+    // the candidates to start monitoring: those matching one of the fnmatch() patterns, or the leaves when there
+    // are no patterns, that are not monitored yet, in the order of their paths and as many as fit in max_monitored
+    // together with the monitored ones; returns false if some matching cgroups were left out because of the limit
+    bool select_cgroups_to_monitor(std::vector<std::string> candidates, const std::vector<std::string>& patterns,
+        const std::set<std::string>& monitored, size_t max_monitored, std::vector<std::string>& selectedOUT) const;
+    bool is_watching_all() const { return !m_rescan_needed; }
+    const cgroup_tree_stats_t& get_stats() const { return m_stats; }
+
+private:
+    void add_subtree(const std::string& path, std::vector<std::string>* addedOUT);
+    void remove_subtree(const std::string& path, std::vector<std::string>* removedOUT);
+    int add_watch(const std::string& path);
+    void rescan(std::vector<std::string>& addedOUT, std::vector<std::string>& removedOUT);
+    void list_subdirs(const std::string& path, std::vector<std::string>& pathsOUT) const;
+    std::string get_abs_path(const std::string& path) const { return path.empty() ? m_root : m_root + "/" + path; }
+
+    std::string m_root;
+    int m_inotify_fd = -1;
+    bool m_rescan_needed = false; // set when some creations/removals may go unnoticed by inotify
+
+    // the in-memory tree: the ordering of the paths keeps the descendants of each cgroup, i.e. the paths
+    // starting with "<cgroup>/", contiguous; siblings like "<cgroup>-x" may sort between a cgroup and them
+    std::map<std::string /* relative path */, int /* inotify watch descriptor or -1 */> m_cgroups;
+    std::unordered_map<int, std::string> m_watched_paths; // including the root, whose path is empty
+
+    cgroup_tree_stats_t m_stats;
+};
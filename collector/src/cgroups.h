@@ -26,16 +26,16 @@
 #include "cmonitor.h"
 #include "fast_file_reader.h"
 #include "system.h"
+#include "worker_pool.h"
 #include <map>
 #include <set>
 #include <string.h>
 #include <string>
 #include <unistd.h>
+#include <unordered_map>
 #include <vector>
 
-#ifdef PROMETHEUS_SUPPORT
 #include "prometheus_kpi.h"
-#endif
 
 // ----------------------------------------------------------------------------------
 // Constants
@@ -57,73 +57,69 @@ std::string CGroupDetected2string(CGroupDetected k);
 // Types
 //------------------------------------------------------------------------------
 
-#ifdef PROMETHEUS_SUPPORT
 /* structure for prometheus output : CPU utilization as reported by cpuacct cgroup */
 static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_cpu[] = {
     // cgroup : cpu
-    { "cgroup_cpuacct_stats_user", prometheus::MetricType::Gauge, "CPU time consumed by tasks in user mode" },
-    { "cgroup_cpuacct_stats_sys", prometheus::MetricType::Gauge, "CPU time consumed by tasks in system (kernel) mode" },
-    { "cgroup_cpuacct_stats_nr_periods", prometheus::MetricType::Gauge,
+    { "cgroup_cpuacct_stats_user", PrometheusKpiType::Gauge, "CPU time consumed by tasks in user mode" },
+    { "cgroup_cpuacct_stats_sys", PrometheusKpiType::Gauge, "CPU time consumed by tasks in system (kernel) mode" },
+    { "cgroup_cpuacct_stats_nr_periods", PrometheusKpiType::Gauge,
         "Number of periods that any thread in the cgroup was runnable" },
-    { "cgroup_cpuacct_stats_nr_throttled", prometheus::MetricType::Gauge,
+    { "cgroup_cpuacct_stats_nr_throttled", PrometheusKpiType::Gauge,
         "Number of runnable periods in which the application used its entire quota and was throttled" },
-    { "cgroup_cpuacct_stats_throttled_time", prometheus::MetricType::Gauge,
+    { "cgroup_cpuacct_stats_throttled_time", PrometheusKpiType::Gauge,
         "Sum total amount of time individual threads within the cgroup were throttled" },
 };
 
 /* structure for prometheus output : Memory utilization as reported by cpuacct cgroup */
 static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_memory[] = {
     // cgroup : memory
-    { "cgroup_memory_stats_stat_active_anon", prometheus::MetricType::Counter,
+    { "cgroup_memory_stats_stat_active_anon", PrometheusKpiType::Gauge,
         "Number of bytes of anonymous and swap cache memory on active LRU list" },
-    { "cgroup_memory_stats_stat_inactive_anon", prometheus::MetricType::Counter,
+    { "cgroup_memory_stats_stat_inactive_anon", PrometheusKpiType::Gauge,
         "Number of bytes of anonymous and swap cache memory on inactive LRU list" },
-    { "cgroup_memory_stats_stat_active_file", prometheus::MetricType::Counter,
+    { "cgroup_memory_stats_stat_active_file", PrometheusKpiType::Gauge,
         "Number of bytes of file-backed memory on active LRU list" },
-    { "cgroup_memory_stats_stat_inactive_file", prometheus::MetricType::Counter,
+    { "cgroup_memory_stats_stat_inactive_file", PrometheusKpiType::Gauge,
         "Number of bytes of file-backed memory on inactive LRU list" },
-    { "cgroup_memory_stats_stat_cache", prometheus::MetricType::Counter, "Number of bytes of page cache memory" },
-    { "cgroup_memory_stats_stat_mapped_file", prometheus::MetricType::Counter,
+    { "cgroup_memory_stats_stat_cache", PrometheusKpiType::Gauge, "Number of bytes of page cache memory" },
+    { "cgroup_memory_stats_stat_mapped_file", PrometheusKpiType::Gauge,
         "Number of bytes of mapped file (includes tmpfs/shmem)" },
-    { "cgroup_memory_stats_stat_pgfault", prometheus::MetricType::Counter, "Total number of page faults incurred" },
-    { "cgroup_memory_stats_stat_pgmajfault", prometheus::MetricType::Counter, "Number of major page faults incurred" },
-    { "cgroup_memory_stats_stat_pgpgin", prometheus::MetricType::Counter,
-        "Number of charging events to the memory cgroup" },
-    { "cgroup_memory_stats_stat_pgpgout", prometheus::MetricType::Counter,
+    { "cgroup_memory_stats_stat_pgfault", PrometheusKpiType::Counter, "Total number of page faults incurred" },
+    { "cgroup_memory_stats_stat_pgmajfault", PrometheusKpiType::Counter, "Number of major page faults incurred" },
+    { "cgroup_memory_stats_stat_pgpgin", PrometheusKpiType::Counter, "Number of charging events to the memory cgroup" },
+    { "cgroup_memory_stats_stat_pgpgout", PrometheusKpiType::Counter,
         "Number of uncharging events to the memory cgroup" },
-    { "cgroup_memory_stats_stat_rss", prometheus::MetricType::Counter,
+    { "cgroup_memory_stats_stat_rss", PrometheusKpiType::Gauge,
         "Number of bytes of anonymous and swap cache memory (includes transparent hugepages)" },
-    { "cgroup_memory_stats_stat_rss_huge", prometheus::MetricType::Counter,
+    { "cgroup_memory_stats_stat_rss_huge", PrometheusKpiType::Gauge,
         "Number of bytes of anonymous transparent hugepages" },
-    { "cgroup_memory_stats_stat_swap", prometheus::MetricType::Counter, "Number of bytes of swap usage" },
-    { "cgroup_memory_stats_stat_unevictable", prometheus::MetricType::Counter,
+    { "cgroup_memory_stats_stat_swap", PrometheusKpiType::Gauge, "Number of bytes of swap usage" },
+    { "cgroup_memory_stats_stat_unevictable", PrometheusKpiType::Gauge,
         "Number of bytes of memory that cannot be reclaimed (mlocked etc)" },
-    { "cgroup_memory_stats_events_failcnt", prometheus::MetricType::Counter,
+    { "cgroup_memory_stats_events_failcnt", PrometheusKpiType::Gauge,
         "Number of times that a usage counter hit its limit" },
 };
 
 /* structure for prometheus output : Network utilization as reported by BY-NETWORK-INTERFACE */
 static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_network[] = {
     // cgroup : network
-    { "cgroup_network_ibytes", prometheus::MetricType::Gauge,
-        "Total number of bytes of data received by the interface" },
-    { "cgroup_network_ipackets", prometheus::MetricType::Gauge,
+    { "cgroup_network_ibytes", PrometheusKpiType::Gauge, "Total number of bytes of data received by the interface" },
+    { "cgroup_network_ipackets", PrometheusKpiType::Gauge,
         "Total number of packets of data received by the interface" },
-    { "cgroup_network_ierrs", prometheus::MetricType::Gauge,
+    { "cgroup_network_ierrs", PrometheusKpiType::Gauge,
         "Total number of receive errors detected by the device driver" },
-    { "cgroup_network_idrop", prometheus::MetricType::Gauge, "Total number of packets dropped by the device driver" },
-    { "cgroup_network_ififo", prometheus::MetricType::Gauge, "Total number of FIFO buffer errors" },
-    { "cgroup_network_iframe", prometheus::MetricType::Gauge, "Total number of packet framing errors" },
-    { "cgroup_network_obytes", prometheus::MetricType::Gauge,
-        "Total number of bytes of data transmitted by the interface" },
-    { "cgroup_network_opackets", prometheus::MetricType::Gauge,
+    { "cgroup_network_idrop", PrometheusKpiType::Gauge, "Total number of packets dropped by the device driver" },
+    { "cgroup_network_ififo", PrometheusKpiType::Gauge, "Total number of FIFO buffer errors" },
+    { "cgroup_network_iframe", PrometheusKpiType::Gauge, "Total number of packet framing errors" },
+    { "cgroup_network_obytes", PrometheusKpiType::Gauge, "Total number of bytes of data transmitted by the interface" },
+    { "cgroup_network_opackets", PrometheusKpiType::Gauge,
         "Total number of packets of data transmitted by the interface" },
-    { "cgroup_network_oerrs", prometheus::MetricType::Gauge,
+    { "cgroup_network_oerrs", PrometheusKpiType::Gauge,
         "Total number of transmitted errors detected by the device driver" },
-    { "cgroup_network_odrop", prometheus::MetricType::Gauge, "Total number of packets dropped by the interface" },
-    { "cgroup_network_ofifo", prometheus::MetricType::Gauge, "Total number of FIFO buffer errors" },
-    { "cgroup_network_ocolls", prometheus::MetricType::Gauge, "Total number of collisions detected on the interface" },
-    { "cgroup_network_ocarrier", prometheus::MetricType::Gauge,
+    { "cgroup_network_odrop", PrometheusKpiType::Gauge, "Total number of packets dropped by the interface" },
+    { "cgroup_network_ofifo", PrometheusKpiType::Gauge, "Total number of FIFO buffer errors" },
+    { "cgroup_network_ocolls", PrometheusKpiType::Gauge, "Total number of collisions detected on the interface" },
+    { "cgroup_network_ocarrier", PrometheusKpiType::Gauge,
         "Total number of carrier losses detected by the device driver" },
 
 };
@@ -131,45 +127,44 @@ static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_network[] = {
 /* structure for prometheus output : PROCESS/THREAD statistics */
 static const prometheus_kpi_descriptor g_prometheus_kpi_cgroup_processes[] = {
     // cgroup : task/threads
-    { "cgroup_tasks_last", prometheus::MetricType::Gauge, "CPU number last executed on" },
-    { "cgroup_tasks_usr", prometheus::MetricType::Gauge,
+    { "cgroup_tasks_last", PrometheusKpiType::Gauge, "CPU number last executed on" },
+    { "cgroup_tasks_usr", PrometheusKpiType::Gauge,
         "Amount of time that this process has been scheduled in user mode, measured in clock ticks" },
-    { "cgroup_tasks_sys", prometheus::MetricType::Gauge,
+    { "cgroup_tasks_sys", PrometheusKpiType::Gauge,
         "Amount of time that this process has been scheduled in kernel mode, measured in clock ticks" },
-    { "cgroup_tasks_usr_total_secs", prometheus::MetricType::Counter,
+    { "cgroup_tasks_usr_total_secs", PrometheusKpiType::Counter,
         "Total amount of time that this process has been scheduled in kernel mode, measured in clock ticks" },
-    { "cgroup_tasks_sys_total_secs", prometheus::MetricType::Counter,
+    { "cgroup_tasks_sys_total_secs", PrometheusKpiType::Counter,
         "Total amount of time that this process has been scheduled in kernel mode, measured in clock ticks" },
-    { "cgroup_tasks_size_kb", prometheus::MetricType::Counter, "Total program size" },
-    { "cgroup_tasks_resident_kb", prometheus::MetricType::Counter, "Resident set size" },
-    { "cgroup_tasks_restext_kb", prometheus::MetricType::Counter, "Resident text" },
-    { "cgroup_tasks_resdata_kb", prometheus::MetricType::Counter, "Resident data" },
-    { "cgroup_tasks_share_kb", prometheus::MetricType::Counter, "Shared pages" },
-    { "cgroup_tasks_rss_limit_bytes", prometheus::MetricType::Counter,
+    { "cgroup_tasks_size_kb", PrometheusKpiType::Gauge, "Total program size" },
+    { "cgroup_tasks_resident_kb", PrometheusKpiType::Gauge, "Resident set size" },
+    { "cgroup_tasks_restext_kb", PrometheusKpiType::Gauge, "Resident text" },
+    { "cgroup_tasks_resdata_kb", PrometheusKpiType::Gauge, "Resident data" },
+    { "cgroup_tasks_share_kb", PrometheusKpiType::Gauge, "Shared pages" },
+    { "cgroup_tasks_rss_limit_bytes", PrometheusKpiType::Gauge,
         "Current soft limit in bytes on the rss of the process" },
-    { "cgroup_tasks_minor_fault", prometheus::MetricType::Gauge,
+    { "cgroup_tasks_minor_fault", PrometheusKpiType::Gauge,
         "The number of minor faults the process has made which have not required loading a memory page from disk" },
-    { "cgroup_tasks_major_fault", prometheus::MetricType::Gauge,
+    { "cgroup_tasks_major_fault", PrometheusKpiType::Gauge,
         "The number of major faults the process has made which have required loading a memory page from disk" },
-    { "cgroup_tasks_virtual_bytes", prometheus::MetricType::Counter, "Virtual memory size in bytes" },
-    { "cgroup_tasks_rss_bytes", prometheus::MetricType::Counter,
+    { "cgroup_tasks_virtual_bytes", PrometheusKpiType::Gauge, "Virtual memory size in bytes" },
+    { "cgroup_tasks_rss_bytes", PrometheusKpiType::Gauge,
         "Resident Set Size: number of pages the process has in real memory" },
-    { "cgroup_tasks_swap_pages", prometheus::MetricType::Counter, "Number of pages swapped " },
-    { "cgroup_tasks_child_swap_pages", prometheus::MetricType::Counter, "Cumulative nswap for child processes" },
-    { "cgroup_tasks_realtime_priority", prometheus::MetricType::Counter, "Real-time scheduling priority" },
-    { "cgroup_tasks_sched_policy", prometheus::MetricType::Counter, "Scheduling policy" },
-    { "cgroup_tasks_delayacct_blkio_secs", prometheus::MetricType::Counter,
+    { "cgroup_tasks_swap_pages", PrometheusKpiType::Counter, "Number of pages swapped " },
+    { "cgroup_tasks_child_swap_pages", PrometheusKpiType::Counter, "Cumulative nswap for child processes" },
+    { "cgroup_tasks_realtime_priority", PrometheusKpiType::Gauge, "Real-time scheduling priority" },
+    { "cgroup_tasks_sched_policy", PrometheusKpiType::Gauge, "Scheduling policy" },
+    { "cgroup_tasks_delayacct_blkio_secs", PrometheusKpiType::Counter,
         "Aggregated block I/O delays, measured in clock ticks" },
-    { "cgroup_tasks_rchar", prometheus::MetricType::Gauge,
+    { "cgroup_tasks_rchar", PrometheusKpiType::Gauge,
         "The number of bytes which this task has caused to be read from storage" },
-    { "cgroup_tasks_wchar", prometheus::MetricType::Gauge,
+    { "cgroup_tasks_wchar", PrometheusKpiType::Gauge,
         "The number of bytes which this task has caused, or shall cause to be written to disk" },
-    { "cgroup_tasks_read_bytes", prometheus::MetricType::Gauge, "Bytes read" },
-    { "cgroup_tasks_write_bytes", prometheus::MetricType::Gauge, "Bytes written" },
-    { "cgroup_tasks_total_read", prometheus::MetricType::Counter, "Total bytes read" },
-    { "cgroup_tasks_total_write", prometheus::MetricType::Counter, "Total bytes written" },
+    { "cgroup_tasks_read_bytes", PrometheusKpiType::Gauge, "Bytes read" },
+    { "cgroup_tasks_write_bytes", PrometheusKpiType::Gauge, "Bytes written" },
+    { "cgroup_tasks_total_read", PrometheusKpiType::Counter, "Total bytes read" },
+    { "cgroup_tasks_total_write", PrometheusKpiType::Counter, "Total bytes written" },
 };
-#endif
 
 /* structure to save CPU utilization as reported by cpuacct cgroup */
 typedef struct {
@@ -190,6 +185,45 @@ typedef struct {
     key_value_map_t v2_events;
 } memory_events_t;
 
+/* the monotonically-increasing per-task KPIs */
+typedef struct {
+    double usr_total_secs = 0, sys_total_secs = 0;
+    double delayacct_blkio_secs = 0;
+    uint64_t total_read = 0, total_write = 0;
+} task_counters_t;
+
+/* sum of the per-task KPIs of a group of tasks, used by the cardinality caps of the per-task series */
+typedef struct {
+    std::string name; // name of the subsection, e.g. "cmd_java" or "other"
+    std::map<std::string, std::string> labels;
+    uint64_t score = 0;
+    unsigned int tasks = 0;
+    double usr = 0, sys = 0;
+    double minor_fault = 0, major_fault = 0;
+    uint64_t virtual_bytes = 0, rss_bytes = 0;
+    std::set<pid_t> tgids; // the memory of a process is shared by its threads: it is summed once per TGID
+    double rchar = 0, wchar = 0, read_bytes = 0, write_bytes = 0;
+    task_counters_t totals; // counters of the series: they never decrease while the series exists
+    task_counters_t increments; // non-negative increments of the counters of its tasks since the previous sample
+} task_aggregate_t;
+
+/* the per-task series as seen by all the sinks sharing the same cardinality cap */
+typedef struct {
+    task_series_limit_t limit;
+    sink_mask_t sinks = 0;
+    std::unordered_map<std::string, uint64_t> group_scores; // unused when capping by PID
+    std::unordered_map<std::string, task_aggregate_t> groups; // top groups by score; unused when capping by PID
+    task_aggregate_t other; // all the tasks beyond the cap
+    std::unordered_map<std::string, task_counters_t> totals; // counters of the aggregated series of the last sample
+} task_series_view_t;
+
+/* the tasks sampled by one of the workers of --sampling-threads; reused across samples */
+typedef struct {
+    std::vector<std::pair<pid_t, procsinfo_t>> tasks;
+    size_t nfailed_sampling = 0;
+    size_t nthreads_discarded = 0;
+} task_sampling_arena_t;
+
 //------------------------------------------------------------------------------
 // The CMonitorCgroups object
 //------------------------------------------------------------------------------
@@ -199,8 +233,12 @@ class CMonitorLoggerUtils;
 
 class CMonitorCgroups : public CMonitorAppHelper {
 public:
-    CMonitorCgroups(CMonitorCollectorAppConfig* pCfg, CMonitorOutputFrontend* pOutput)
+    // the cgroups are sampled one after the other, so they can all share the same pool of threads sampling
+    // their tasks; without a pool, each instance starts its own one
+    CMonitorCgroups(CMonitorCollectorAppConfig* pCfg, CMonitorOutputFrontend* pOutput,
+        CMonitorWorkerPool* pTaskSamplingPool = nullptr)
         : CMonitorAppHelper(pCfg, pOutput)
+        , m_task_sampling_pool(pTaskSamplingPool)
     {
         memset(&m_cpuacct_prev_values[0], 0, MAX_LOGICAL_CPU * sizeof(cpuacct_utilisation_t));
         memset(&m_cpuacct_prev_values_for_total_cpu, 0, sizeof(cpuacct_utilisation_t));
@@ -210,6 +248,23 @@ public:
 
     ~CMonitorCgroups() { }
 
+    // selects one of the cgroups given by --cgroup-name as the one to monitor; call before init()
+    void set_cgroup_name(const std::string& name) { m_cgroup_name = name; }
+
+    // expands the comma-separated list of cgroup names and glob patterns given by --cgroup-name into the
+    // names of the existing cgroups; names without wildcards are returned as they are
+    // NOTE: arguments _for_test are used only during unit testing
+    bool expand_cgroup_names(const std::string& names, std::vector<std::string>& namesOUT,
+        const std::string& cgroup_prefix_for_test = "", // force newline
+        const std::string& proc_prefix_for_test = "", // force newline
+        uint64_t my_own_pid_for_test = UINT64_MAX);
+
+    // returns the absolute path of the hierarchy containing the cgroups given by --cgroup-name, e.g.
+    // /sys/fs/cgroup/memory with cgroups v1
+    // NOTE: arguments _for_test are used only during unit testing
+    bool detect_hierarchy_path(std::string& pathOUT, const std::string& cgroup_prefix_for_test = "",
+        const std::string& proc_prefix_for_test = "", uint64_t my_own_pid_for_test = UINT64_MAX);
+
     // main setup
     // NOTE: arguments _for_test are used only during unit testing
     void init(bool include_threads, // force newline
@@ -230,10 +285,23 @@ public:
     void sample_network_interfaces(double elapsed_sec, OutputFields output_opts);
     void sample_processes(double elapsed_sec, OutputFields output_opts);
 
+    // same as CMonitorSystem::save_delta_baselines() and CMonitorSystem::restore_delta_baselines()
+    void save_delta_baselines();
+    void restore_delta_baselines();
+
     // misc helpers
     bool cgroup_still_exists();
+
+    // false once the cgroup has been removed or, with cgroups v2, once all its processes (and those of its
+    // descendants) exited, even if the cgroup itself has not been removed yet
+    bool cgroup_is_alive();
+
+    // with cgroups v2 returns the "cgroup.events" file, which is modified whenever the cgroup becomes populated
+    // or empty; returns an empty string with cgroups v1
+    std::string get_events_file() const;
     std::set<uint64_t> get_cgroup_cpus() const { return m_cgroup_cpus; }
     CGroupDetected get_detected_cgroup_version() const { return m_nCGroupsFound; }
+    size_t get_num_tasks() const { return m_cgroup_all_pids.size(); } // as found by sample_process_list()
 
 private:
     // cgroups config
@@ -258,6 +326,10 @@ private:
         pid_t pid, bool include_threads, procsinfo_t* pout, OutputFields output_opts, bool output_tgid);
     bool collect_pids(const std::string& file, std::vector<pid_t>& pids); // utility of cgroup_proc_tasks()
     bool collect_pids(FastFileReader& reader, std::vector<pid_t>& pids); // utility of cgroup_proc_tasks()
+    const std::vector<pid_t>& select_tasks_to_sample();
+    void init_task_series_views();
+    void cap_task_series(std::multimap<uint64_t, proc_topper_t>::iterator first_over_threshold, double elapsed_sec);
+    void output_task_aggregate(const task_aggregate_t& aggregate, sink_mask_t sinks, OutputFields output_opts);
 
     // cpuacct controller
     bool read_cpuacct_line(FastFileReader& reader, std::vector<uint64_t>& valuesINT /* OUT */);
@@ -282,6 +354,7 @@ private:
     //------------------------------------------------------------------------------
     // paths of cgroups controllers to monitor (either our own cgroup or another one):
     //------------------------------------------------------------------------------
+    std::string m_cgroup_name; // the cgroup to monitor; defaults to --cgroup-name
     std::string m_cgroup_systemd_name; // contains the "name" of the cgroup
     std::string m_cgroup_memory_kernel_path; // contains the abs path to the folder with memory controller files
     std::string m_cgroup_cpuacct_kernel_path; // contains the abs path to the folder with cpuacct controller files
@@ -350,10 +423,41 @@ private:
     // cgroup processes tracking
     //------------------------------------------------------------------------------
     bool m_cgroup_processes_include_threads = false;
+    bool m_read_task_statm = true; // false when no sink wants the KPIs from /proc/PID/statm
+    bool m_read_task_io = true; // false when no sink wants the KPIs from /proc/PID/io
     std::map<pid_t, procsinfo_t> m_pid_databases[2];
     unsigned int m_pid_database_current_index = 0; // will be alternatively 0 and 1
 
+    // the tasks are sampled by m_task_sampling_pool, each worker into its own arena, then merged into the DB
+    CMonitorWorkerPool* m_task_sampling_pool = nullptr; // owned by the caller or by m_own_task_sampling_pool
+    std::unique_ptr<CMonitorWorkerPool> m_own_task_sampling_pool;
+    std::vector<task_sampling_arena_t> m_task_sampling_arenas; // one for each worker
+
     // it's possible, even if unlikely, for 2 PIDs to have identical process score...
     // that's why we use std::multimap instead of a std::map
     std::multimap<uint64_t /* process score */, proc_topper_t> m_topper_procs;
+
+    // when the number of tasks to sample is capped (see --cpu-budget), the tasks with the highest scores are kept:
+    std::vector<pid_t> m_top_tasks; // by decreasing score, as found by the last sample
+    std::vector<pid_t> m_capped_pids; // the subset of m_cgroup_all_pids being sampled
+    size_t m_capped_rotation_cursor = 0; // where, in m_cgroup_all_pids, the rotation over the other tasks restarts
+
+    // cardinality caps of the per-task series, see --sink-task-limit
+    std::vector<task_series_view_t> m_task_series_views; // one for each distinct cap in use
+    bool m_task_series_views_initialized = false;
+    sink_mask_t m_task_series_uncapped_sinks = SINK_MASK_ALL; // sinks getting all tasks as individual series
+
+    //------------------------------------------------------------------------------
+    // previous values saved by save_delta_baselines()
+    //------------------------------------------------------------------------------
+    typedef struct {
+        std::vector<cpuacct_utilisation_t> cpuacct_prev_values;
+        cpuacct_utilisation_t cpuacct_prev_values_for_total_cpu;
+        cpuacct_throttling_t cpuacct_prev_values_for_throttling;
+        memory_events_t memory_prev_values;
+        netinfo_map_t previous_netinfo;
+        std::map<pid_t, procsinfo_t> pid_database; // the tasks of the last sample
+        std::vector<std::unordered_map<std::string, task_counters_t>> task_series_totals; // one for each view
+    } delta_baselines_t;
+    std::unique_ptr<delta_baselines_t> m_saved_delta_baselines; // nullptr when nothing is saved
 };
@@ -22,10 +22,13 @@
 #include "output_frontend.h"
 #include "utils_files.h"
 #include "utils_string.h"
+#include <algorithm>
 #include <assert.h>
 #include <fstream>
+#include <glob.h>
 #include <pwd.h>
 #include <sstream>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -274,7 +277,9 @@ void CMonitorCgroups::init( // force newline
     */
     if (!detect_cgroup_ver_and_paths_from_myself(cgroup_prefix_for_test, my_own_pid_for_test))
         return; // the function has already logged errors
-    if (m_pCfg->m_strCGroupName.empty() || m_pCfg->m_strCGroupName == "self") {
+    if (m_cgroup_name.empty())
+        m_cgroup_name = m_pCfg->m_strCGroupName;
+    if (m_cgroup_name.empty() || m_cgroup_name == "self") {
         if (!detect_my_own_cgroup())
             return; // the function has already logged errors
     } else {
@@ -306,6 +311,59 @@ void CMonitorCgroups::init( // force newline
     init_processes(cgroup_prefix_for_test);
 }
 
+bool CMonitorCgroups::expand_cgroup_names(const std::string& names, std::vector<std::string>& namesOUT,
+    const std::string& cgroup_prefix_for_test, const std::string& proc_prefix_for_test, uint64_t my_own_pid_for_test)
+{
+    namesOUT.clear();
+    std::string hierarchy_path;
+    for (const std::string& token : split_string_in_array(names, ',')) {
+        std::string name = trim_string(token);
+        if (name.empty())
+            continue;
+        if (name.find_first_of("*?[") == std::string::npos) {
+            namesOUT.push_back(name);
+            continue;
+        }
+
+        if (hierarchy_path.empty()
+            && !detect_hierarchy_path(
+                hierarchy_path, cgroup_prefix_for_test, proc_prefix_for_test, my_own_pid_for_test))
+            return false; // the function has already logged errors
+        std::string pattern = hierarchy_path + "/" + name;
+        glob_t matches;
+        size_t nmatches = 0;
+        if (glob(pattern.c_str(), GLOB_ONLYDIR, NULL, &matches) == 0) {
+            nmatches = matches.gl_pathc;
+            for (size_t i = 0; i < matches.gl_pathc; i++) {
+                std::string path = matches.gl_pathv[i];
+                if (path.back() == '/')
+                    path.pop_back();
+                namesOUT.push_back(path.substr(hierarchy_path.size() + 1));
+            }
+        }
+        globfree(&matches);
+        CMonitorLogger::instance()->LogDebug("Cgroup pattern [%s] matched %zu cgroups\n", name.c_str(), nmatches);
+    }
+
+    // a cgroup matched by several patterns is monitored once:
+    std::sort(namesOUT.begin(), namesOUT.end());
+    namesOUT.erase(std::unique(namesOUT.begin(), namesOUT.end()), namesOUT.end());
+    return true;
+}
+
+bool CMonitorCgroups::detect_hierarchy_path(std::string& pathOUT, const std::string& cgroup_prefix_for_test,
+    const std::string& proc_prefix_for_test, uint64_t my_own_pid_for_test)
+{
+    // this is the hierarchy searched for the cgroup names, see detect_user_provided_cgroup(); with cgroups v1
+    // that is the one of the "memory" controller
+    m_proc_prefix = proc_prefix_for_test;
+    bool found = detect_cgroup_ver_and_paths_from_myself(cgroup_prefix_for_test, my_own_pid_for_test);
+    if (found)
+        pathOUT = m_cgroup_memory_kernel_path;
+    m_nCGroupsFound = CG_NONE; // init() is still needed
+    return found;
+}
+
 bool CMonitorCgroups::detect_cgroup_ver_and_paths_from_myself(
     const std::string& cgroup_prefix_for_test, uint64_t my_own_pid_for_test)
 {
@@ -540,14 +598,14 @@ bool CMonitorCgroups::detect_user_provided_cgroup()
     // NOW DETECT ACTUAL CGROUP PATHS TO MONITOR
     CMonitorLogger::instance()->LogDebug(
         "Cgroup name [%s] provided. Trying to detect the paths for the actual cgroups to monitor.",
-        m_pCfg->m_strCGroupName.c_str());
+        m_cgroup_name.c_str());
 
     // assume that the provided cgroup is using the same absolute CGROUP prefix of this process...
     // this should be pretty safe since in practice it means assuming that there is a single kernel folder like
     // /sys/fs/cgroup/...
-    m_cgroup_memory_kernel_path += "/" + m_pCfg->m_strCGroupName;
-    m_cgroup_cpuacct_kernel_path += "/" + m_pCfg->m_strCGroupName;
-    m_cgroup_cpuset_kernel_path += "/" + m_pCfg->m_strCGroupName;
+    m_cgroup_memory_kernel_path += "/" + m_cgroup_name;
+    m_cgroup_cpuacct_kernel_path += "/" + m_cgroup_name;
+    m_cgroup_cpuset_kernel_path += "/" + m_cgroup_name;
 
     // verify the provided cgroup name is actually existing on disk:
     if (!file_or_dir_exists(m_cgroup_memory_kernel_path.c_str())) {
@@ -559,7 +617,7 @@ bool CMonitorCgroups::detect_user_provided_cgroup()
         return false;
     }
 
-    m_cgroup_systemd_name = m_pCfg->m_strCGroupName;
+    m_cgroup_systemd_name = m_cgroup_name;
 
     // set m_cgroup_processes_path
     search_processes_cgroup_path();
@@ -817,6 +875,71 @@ bool CMonitorCgroups::cgroup_still_exists()
         file_or_dir_exists(m_cgroup_cpuset_kernel_path.c_str());
 }
 
+bool CMonitorCgroups::cgroup_is_alive()
+{
+    if (!cgroup_still_exists())
+        return false;
+    if (m_nCGroupsFound != CG_VERSION2)
+        return true;
+
+    // e.g. a container whose processes exited, but which has not been removed yet by its container runtime:
+    FILE* events = fopen(get_events_file().c_str(), "r");
+    if (events == nullptr)
+        return true; // cannot tell
+    char key[64];
+    uint64_t value;
+    bool populated = true;
+    while (fscanf(events, "%63s %lu", key, &value) == 2) {
+        if (strcmp(key, "populated") == 0) {
+            populated = value != 0;
+            break;
+        }
+    }
+    fclose(events);
+    return populated;
+}
+
+void CMonitorCgroups::save_delta_baselines()
+{
+    m_saved_delta_baselines.reset(new delta_baselines_t());
+    m_saved_delta_baselines->cpuacct_prev_values.assign(
+        &m_cpuacct_prev_values[0], &m_cpuacct_prev_values[MAX_LOGICAL_CPU]);
+    m_saved_delta_baselines->cpuacct_prev_values_for_total_cpu = m_cpuacct_prev_values_for_total_cpu;
+    m_saved_delta_baselines->cpuacct_prev_values_for_throttling = m_cpuacct_prev_values_for_throttling;
+    m_saved_delta_baselines->memory_prev_values = m_memory_prev_values;
+    m_saved_delta_baselines->previous_netinfo = m_previous_netinfo;
+    m_saved_delta_baselines->pid_database = m_pid_databases[m_pid_database_current_index];
+    for (const auto& view : m_task_series_views)
+        m_saved_delta_baselines->task_series_totals.push_back(view.totals);
+}
+
+void CMonitorCgroups::restore_delta_baselines()
+{
+    if (!m_saved_delta_baselines)
+        return;
+    std::copy(m_saved_delta_baselines->cpuacct_prev_values.begin(),
+        m_saved_delta_baselines->cpuacct_prev_values.end(), &m_cpuacct_prev_values[0]);
+    m_cpuacct_prev_values_for_total_cpu = m_saved_delta_baselines->cpuacct_prev_values_for_total_cpu;
+    m_cpuacct_prev_values_for_throttling = m_saved_delta_baselines->cpuacct_prev_values_for_throttling;
+    m_memory_prev_values.v1_failcnt = m_saved_delta_baselines->memory_prev_values.v1_failcnt;
+    m_memory_prev_values.v2_events.swap(m_saved_delta_baselines->memory_prev_values.v2_events);
+    m_previous_netinfo.swap(m_saved_delta_baselines->previous_netinfo);
+
+    // the next sample_processes() compares the tasks it finds with those of the current DB:
+    m_pid_databases[m_pid_database_current_index].swap(m_saved_delta_baselines->pid_database);
+    if (m_saved_delta_baselines->task_series_totals.size() == m_task_series_views.size())
+        for (size_t i = 0; i < m_task_series_views.size(); i++)
+            m_task_series_views[i].totals.swap(m_saved_delta_baselines->task_series_totals[i]);
+    m_saved_delta_baselines.reset();
+}
+
+std::string CMonitorCgroups::get_events_file() const
+{
+    if (m_nCGroupsFound != CG_VERSION2)
+        return "";
+    return m_cgroup_memory_kernel_path + "/cgroup.events";
+}
+
 void CMonitorCgroups::get_list_monitored_files(std::set<std::string>& list)
 {
     //------------------------------------------------------------------------------
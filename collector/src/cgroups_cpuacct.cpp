@@ -151,7 +151,8 @@ bool CMonitorCgroups::sample_cpuacct_v1_counters_by_cpu(
                         / (elapsed_sec * 1E9);
 
                     // output JSON counter
-                    m_pOutput->psubsection_start(fmt::format("cpu{}", i).c_str());
+                    m_pOutput->psubsection_start(
+                        fmt::format("cpu{}", i).c_str(), "cpu", fmt::format("{}", i).c_str());
                     m_pOutput->pdouble("user", cpuUserPercent);
                     m_pOutput->pdouble("sys", cpuSysPercent);
                     m_pOutput->psubsection_end();
@@ -197,7 +198,8 @@ bool CMonitorCgroups::sample_cpuacct_v1_counters_by_cpu(
                         / (elapsed_sec * 1E9);
 
                     // output JSON counter
-                    m_pOutput->psubsection_start(fmt::format("cpu{}", i).c_str());
+                    m_pOutput->psubsection_start(
+                        fmt::format("cpu{}", i).c_str(), "cpu", fmt::format("{}", i).c_str());
                     m_pOutput->pdouble("user", cpuUserPercent);
                     m_pOutput->psubsection_end();
                 }
@@ -392,12 +394,10 @@ void CMonitorCgroups::init_cpuacct(const std::string& cgroup_prefix_for_test)
         return;
     }
 
-#ifdef PROMETHEUS_SUPPORT
-    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_CGROUP_CPU_ACCT)) == 0) {
+    if (m_pOutput->wants_kpi_descriptors() && (!(m_pCfg->m_nCollectFlags & PK_CGROUP_CPU_ACCT)) == 0) {
         size_t size = sizeof(g_prometheus_kpi_cgroup_cpu) / sizeof(g_prometheus_kpi_cgroup_cpu[0]);
         m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cgroup_cpu, size);
     }
-#endif
     CMonitorLogger::instance()->LogDebug("Successfully initialized cpuacct cgroup monitoring.\n");
 }
 
@@ -132,12 +132,10 @@ void CMonitorCgroups::init_memory(const std::string& cgroup_prefix_for_test)
         return;
     }
 
-#ifdef PROMETHEUS_SUPPORT
-    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_CGROUP_MEMORY) == 0)) {
+    if (m_pOutput->wants_kpi_descriptors() && (!(m_pCfg->m_nCollectFlags & PK_CGROUP_MEMORY) == 0)) {
         size_t size = sizeof(g_prometheus_kpi_cgroup_memory) / sizeof(g_prometheus_kpi_cgroup_memory[0]);
         m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cgroup_memory, size);
     }
-#endif
 
     CMonitorLogger::instance()->LogDebug("Successfully initialized memory cgroup monitoring.\n");
 }
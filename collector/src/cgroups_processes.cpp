@@ -110,7 +110,7 @@ bool CMonitorCgroups::get_process_infos(
     auto pid_dir = fmt::format("{}/proc/{}", m_proc_prefix, pid);
     struct stat statbuf;
     if (stat(pid_dir.c_str(), &statbuf) != 0) {
-        // IMPORTANT: cmonitor_collector first reads all PIDs and then invokes, sequentially, this function;
+        // IMPORTANT: cmonitor_collector first reads all PIDs and then invokes this function on each of them;
         //            this means that by the time we get here, a PID may has ceased to exist. So do not generate
         //            any error line for this condition and consider it to be just something that can happen.
         // CMonitorLogger::instance()->LogErrorWithErrno("ERROR: failed to stat file %s", pid_dir.c_str());
@@ -119,8 +119,10 @@ bool CMonitorCgroups::get_process_infos(
 
     // by looking at the owner of the directory we know which user is running it:
     pout->uid = statbuf.st_uid;
-    struct passwd* pw = getpwuid(statbuf.st_uid);
-    if (pw) {
+    // NOTE: this function may run on several threads at once, see --sampling-threads
+    struct passwd pwd, *pw = NULL;
+    char pwbuf[1024];
+    if (getpwuid_r(statbuf.st_uid, &pwd, pwbuf, sizeof(pwbuf), &pw) == 0 && pw) {
         strncpy(pout->username, pw->pw_name, 63);
         pout->username[63] = 0;
     }
@@ -270,7 +272,7 @@ bool CMonitorCgroups::get_process_infos(
         }
     }
 
-    if (output_opts == PF_ALL) { /* process the statm file for the process/thread */
+    if (output_opts == PF_ALL && m_read_task_statm) { /* process the statm file for the process/thread */
 
         std::string filename = stat_file_prefix + "/statm";
         if ((fp = fopen(filename.c_str(), "r")) == NULL) {
@@ -314,7 +316,7 @@ bool CMonitorCgroups::get_process_infos(
         fclose(fp);
     }
 
-    { /* process the I/O file for the process/thread */
+    if (m_read_task_io) { /* process the I/O file for the process/thread */
         pout->io_read_bytes = 0;
         pout->io_write_bytes = 0;
 
@@ -453,14 +455,36 @@ void CMonitorCgroups::init_processes(const std::string& cgroup_prefix_for_test)
         return;
     }
 
-#ifdef PROMETHEUS_SUPPORT
-    if (m_pOutput->is_prometheus_enabled()
+    if (m_pOutput->wants_kpi_descriptors()
         && ((!(m_pCfg->m_nCollectFlags & PK_CGROUP_PROCESSES) == 0)
             || (!(m_pCfg->m_nCollectFlags & PK_CGROUP_THREADS) == 0))) {
         size_t size = sizeof(g_prometheus_kpi_cgroup_processes) / sizeof(g_prometheus_kpi_cgroup_processes[0]);
         m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cgroup_processes, size);
     }
-#endif
+
+    // the per-task files can be read by several threads, see --sampling-threads:
+    if (!m_task_sampling_pool) {
+        m_own_task_sampling_pool.reset(new CMonitorWorkerPool());
+        m_task_sampling_pool = m_own_task_sampling_pool.get();
+        if ((m_pCfg->m_nCollectFlags & (PK_CGROUP_PROCESSES | PK_CGROUP_THREADS))
+            && !m_task_sampling_pool->init(m_pCfg->m_nSamplingThreads)) {
+            CMonitorLogger::instance()->LogError(
+                "Could not start %u threads to sample the tasks inside the cgroup. Using a single thread.\n",
+                m_pCfg->m_nSamplingThreads);
+            m_task_sampling_pool->init(1);
+        }
+    }
+    m_task_sampling_arenas.resize(m_task_sampling_pool->get_num_workers());
+
+    // the per-task files whose KPIs are all filtered out by --sink-filter are not read at all:
+    auto is_any_wanted = [this](const std::vector<const char*>& measurements) {
+        for (const char* measurement : measurements)
+            if (m_pOutput->is_measurement_wanted("cgroup_tasks", measurement))
+                return true;
+        return false;
+    };
+    m_read_task_statm = is_any_wanted({ "size_kb", "resident_kb", "restext_kb", "resdata_kb", "share_kb" });
+    m_read_task_io = is_any_wanted({ "rchar", "wchar", "read_bytes", "write_bytes", "total_read", "total_write" });
 
     CMonitorLogger::instance()->LogDebug("Successfully initialized cgroup processes monitoring.\n");
 }
@@ -486,6 +510,49 @@ void CMonitorCgroups::sample_process_list()
     collect_pids(m_cgroup_processes_reader_pids, m_cgroup_all_pids);
 }
 
+const std::vector<pid_t>& CMonitorCgroups::select_tasks_to_sample()
+{
+    size_t max_tasks = m_pCfg->m_nMaxTasks;
+    if (max_tasks == 0 || m_cgroup_all_pids.size() <= max_tasks)
+        return m_cgroup_all_pids;
+
+    // the tasks with the highest scores in the last sample go first, but some slots are left to a window
+    // rotating over all the other tasks, otherwise a task outside the top ones would never get a score.
+    // The window moves by half its size at each sample: each task stays in it for 2 consecutive samples,
+    // as needed to compute its score (the cap is never below CPU_BUDGET_MIN_TASKS, so the window has 2+ slots).
+    size_t rotation_size = std::min(max_tasks / 2, std::max((size_t)2, max_tasks / 4));
+    std::set<pid_t> candidates(m_cgroup_all_pids.begin(), m_cgroup_all_pids.end());
+    m_capped_pids.clear();
+    for (pid_t pid : m_top_tasks)
+        if (m_capped_pids.size() < max_tasks - rotation_size && candidates.erase(pid))
+            m_capped_pids.push_back(pid);
+
+    size_t num_pids = m_cgroup_all_pids.size();
+    size_t next_cursor = m_capped_rotation_cursor + 1;
+    for (size_t n = 0, num_rotated = 0; n < num_pids && num_rotated < rotation_size; n++) {
+        size_t idx = (m_capped_rotation_cursor + n) % num_pids;
+        if (!candidates.erase(m_cgroup_all_pids[idx]))
+            continue;
+        m_capped_pids.push_back(m_cgroup_all_pids[idx]);
+        if (++num_rotated == rotation_size / 2 + 1 && rotation_size > 1)
+            next_cursor = idx; // the second half of this window is the first half of the next one
+    }
+    m_capped_rotation_cursor = next_cursor % num_pids;
+
+    // then, if there are less top tasks than slots, the other ones in the order of the cgroup file, so that the
+    // same tasks keep being sampled and get a score from the next sample on:
+    for (pid_t pid : m_cgroup_all_pids) {
+        if (m_capped_pids.size() >= max_tasks)
+            break;
+        if (candidates.erase(pid))
+            m_capped_pids.push_back(pid);
+    }
+
+    CMonitorLogger::instance()->LogDebug(
+        "Sampling %zu/%zu tasks because of the cap on the tasks", m_capped_pids.size(), m_cgroup_all_pids.size());
+    return m_capped_pids;
+}
+
 void CMonitorCgroups::sample_processes(double elapsed_sec, OutputFields output_opts)
 {
     if (m_nCGroupsFound == CG_NONE)
@@ -506,32 +573,44 @@ void CMonitorCgroups::sample_processes(double elapsed_sec, OutputFields output_o
     std::map<pid_t, procsinfo_t>& prevDB = m_pid_databases[!m_pid_database_current_index];
 
     // get new fresh processes data and update current database:
-    currDB.clear();
     bool needsToFilterOutThreads = (m_nCGroupsFound == CG_VERSION1) && !m_cgroup_processes_include_threads;
-    size_t nfailed_sampling = 0, nthreads_discarded = 0;
-    for (size_t i = 0; i < m_cgroup_all_pids.size(); i++) {
+    const std::vector<pid_t>& pids = select_tasks_to_sample();
+    m_task_sampling_pool->run(pids.size(), [&](unsigned int worker, size_t first, size_t last) {
+        // NOTE: this may run in parallel on several threads: only the arena of this worker can be modified
+        task_sampling_arena_t& arena = m_task_sampling_arenas[worker];
+        for (size_t i = first; i < last; i++) {
+
+            // acquire all possible informations on this PID (or TID)
+            // NOTE: getting the Tgid is expensive (requires opening a dedicated file) but we want to provide Tgid in
+            //       output since it's the only way to provide to the data consumer a realiable criteria to
+            //       distinguish between secondary threads and main threads
+            arena.tasks.emplace_back();
+            procsinfo_t& procData = arena.tasks.back().second;
+            if (get_process_infos(pids[i], m_cgroup_processes_include_threads, &procData, output_opts,
+                    true /* output_tgid */)) {
 
-        // acquire all possible informations on this PID (or TID)
-        // NOTE: getting the Tgid is expensive (requires opening a dedicated file) but we want to provide Tgid in output
-        //       since it's the only way to provide to the data consumer a realiable criteria to distinguish between
-        //       secondary threads and main threads
-        procsinfo_t procData;
-        if (get_process_infos(m_cgroup_all_pids[i], m_cgroup_processes_include_threads, &procData, output_opts,
-                true /* output_tgid */)) {
-
-            if (needsToFilterOutThreads) {
                 // only the main thread has its PID == TGID...
-                if (procData.pi_pid == procData.pi_tgid)
-                    // this is the main thread of current PID... insert it into the database
-                    currDB.insert(std::make_pair(m_cgroup_all_pids[i], procData));
-                else
-                    nthreads_discarded++;
+                if (needsToFilterOutThreads && procData.pi_pid != procData.pi_tgid) {
+                    arena.tasks.pop_back();
+                    arena.nthreads_discarded++;
+                } else
+                    // this is a thread we want to track or the main thread of current PID
+                    arena.tasks.back().first = pids[i];
             } else {
-                // we can simply take into account all PIDs/TIDs collected
-                currDB.insert(std::make_pair(m_cgroup_all_pids[i], procData));
+                arena.tasks.pop_back();
+                arena.nfailed_sampling++;
             }
-        } else
-            nfailed_sampling++;
+        }
+    });
+
+    currDB.clear();
+    size_t nfailed_sampling = 0, nthreads_discarded = 0;
+    for (auto& arena : m_task_sampling_arenas) {
+        currDB.insert(arena.tasks.begin(), arena.tasks.end());
+        nfailed_sampling += arena.nfailed_sampling;
+        nthreads_discarded += arena.nthreads_discarded;
+        arena.tasks.clear(); // keeps the memory for the next sample
+        arena.nfailed_sampling = arena.nthreads_discarded = 0;
     }
 
     if (output_opts == PF_NONE) {
@@ -564,7 +643,7 @@ void CMonitorCgroups::sample_processes(double elapsed_sec, OutputFields output_o
 
         // compute the score
         uint64_t score = compute_proc_score(pcurrent_status, pprev_status, elapsed_sec);
-        proc_topper_t newEntry = { .current = pcurrent_status, .prev = pprev_status };
+        proc_topper_t newEntry = { .current = pcurrent_status, .prev = pprev_status, .sinks = 0 };
         m_topper_procs.insert(std::make_pair(score, newEntry));
 
         // of the 40 fields of procsinfo_t we're mostly interested in user and system time:
@@ -576,6 +655,13 @@ void CMonitorCgroups::sample_processes(double elapsed_sec, OutputFields output_o
         // CMonitorLogger::instance()->LogDebug("PID=%lu -> score=%lu", current_entry.first, score);
     }
 
+    if (m_pCfg->m_nMaxTasks) {
+        m_top_tasks.clear();
+        for (auto it = m_topper_procs.rbegin(); it != m_topper_procs.rend() && m_top_tasks.size() < m_pCfg->m_nMaxTasks;
+             it++)
+            m_top_tasks.push_back(it->second.current->pi_pid);
+    }
+
     if (m_topper_procs.empty()) {
         // just produce an empty section to have all samples structured in the same way, then return
         m_pOutput->psection_start("cgroup_tasks");
@@ -589,14 +675,26 @@ void CMonitorCgroups::sample_processes(double elapsed_sec, OutputFields output_o
         currDB.size(), m_cgroup_all_pids.size(), m_cgroup_processes_include_threads, m_topper_procs.begin()->first,
         m_topper_procs.rbegin()->first);
 
+    // Decide which tasks get an individual series in each sink, before formatting anything:
+    auto first_over_threshold = m_topper_procs.lower_bound(m_pCfg->m_nProcessScoreThreshold);
+    init_task_series_views();
+    if (!m_task_series_views.empty())
+        cap_task_series(first_over_threshold, elapsed_sec);
+
     // Now output all data for each process, starting from the minimal score PROCESS_SCORE_IGNORE_THRESHOLD
     static double ticks = (double)sysconf(_SC_CLK_TCK); // clock ticks per second
-    size_t nProcsOverThreshold = 0;
+    size_t nProcsOverThreshold = 0, nProcsBeyondCaps = 0;
     m_pOutput->psection_start("cgroup_tasks");
-    for (auto entry = m_topper_procs.lower_bound(m_pCfg->m_nProcessScoreThreshold); entry != m_topper_procs.end();
-         entry++) {
+    for (auto entry = first_over_threshold; entry != m_topper_procs.end(); entry++) {
         uint64_t score = (*entry).first;
 
+        sink_mask_t sinks = m_task_series_uncapped_sinks | (*entry).second.sinks;
+        if (!m_task_series_views.empty() && (sinks & m_pOutput->get_enabled_sinks()) == 0) {
+            // this task is accounted only inside the "other" series of the capped sinks
+            nProcsBeyondCaps++;
+            continue;
+        }
+
         // note that the m_topper_procs map contains pointers to "currDB" and "prevDB"
         const procsinfo_t* p = (*entry).second.current;
         const procsinfo_t* q = (*entry).second.prev;
@@ -606,10 +704,11 @@ void CMonitorCgroups::sample_processes(double elapsed_sec, OutputFields output_o
 #define DELTA(member) (CURRENT(member) - PREVIOUS(member))
 #define COUNTDELTA(member) ((PREVIOUS(member) > CURRENT(member)) ? 0 : (CURRENT(member) - PREVIOUS(member)))
 
-        m_pOutput->psubsection_start(fmt::format("pid_{}", (unsigned long)CURRENT(pi_pid)).c_str());
+        std::map<std::string, std::string> labels;
+        if (m_pOutput->wants_labels())
+            labels = { { "pid", fmt::format("{}", (unsigned long)CURRENT(pi_pid)) }, { "cmd", CURRENT(pi_comm) } };
 
-        std::map<std::string, std::string> labels
-            = { { "pid", fmt::format("{}", (unsigned long)CURRENT(pi_pid)).c_str() }, { "cmd", CURRENT(pi_comm) } };
+        m_pOutput->psubsection_start(fmt::format("pid_{}", (unsigned long)CURRENT(pi_pid)).c_str(), labels, sinks);
 
         m_pOutput->psubsubsection_start("proc_info");
         m_pOutput->plong("cmon_score", score);
@@ -734,8 +833,220 @@ void CMonitorCgroups::sample_processes(double elapsed_sec, OutputFields output_o
         m_pOutput->psubsection_end();
         nProcsOverThreshold++;
     }
+
+    for (const auto& view : m_task_series_views) {
+        for (const auto& group : view.groups)
+            output_task_aggregate(group.second, view.sinks, output_opts);
+        if (view.other.tasks > 0)
+            output_task_aggregate(view.other, view.sinks, output_opts);
+    }
     m_pOutput->psection_end();
 
-    CMonitorLogger::instance()->LogDebug("%zu processes found over score threshold", nProcsOverThreshold);
+    CMonitorLogger::instance()->LogDebug("%zu processes found over score threshold (%zu only in aggregated series)",
+        nProcsOverThreshold + nProcsBeyondCaps, nProcsBeyondCaps);
     m_topper_procs.clear();
 }
+
+// ----------------------------------------------------------------------------------
+// CMonitorCgroups - cardinality caps of the per-task series
+// ----------------------------------------------------------------------------------
+
+// the counters of a PID go backwards only if the PID has been recycled by a new task:
+static inline uint64_t counter_increment(uint64_t current, uint64_t prev)
+{
+    return current > prev ? current - prev : 0;
+}
+
+static void accumulate_task(task_aggregate_t& aggregate, uint64_t score, const procsinfo_t* p, const procsinfo_t* q,
+    double elapsed_sec, double ticks)
+{
+    // same KPIs of the individual series, summed:
+    aggregate.score += score;
+    aggregate.tasks++;
+    aggregate.usr += std::min(100.0, (double)(p->pi_utime - q->pi_utime) / elapsed_sec);
+    aggregate.sys += std::min(100.0, (double)(p->pi_stime - q->pi_stime) / elapsed_sec);
+    aggregate.totals.usr_total_secs += (double)p->pi_utime / ticks;
+    aggregate.totals.sys_total_secs += (double)p->pi_stime / ticks;
+    aggregate.increments.usr_total_secs += counter_increment(p->pi_utime, q->pi_utime) / ticks;
+    aggregate.increments.sys_total_secs += counter_increment(p->pi_stime, q->pi_stime) / ticks;
+
+    aggregate.minor_fault += (q->pi_minflt > p->pi_minflt ? 0 : p->pi_minflt - q->pi_minflt) / elapsed_sec;
+    aggregate.major_fault += (q->pi_majflt > p->pi_majflt ? 0 : p->pi_majflt - q->pi_majflt) / elapsed_sec;
+    if (aggregate.tgids.insert(p->pi_tgid).second) {
+        aggregate.virtual_bytes += p->pi_vsize;
+        aggregate.rss_bytes += p->pi_rss * PAGESIZE_BYTES;
+    }
+
+    aggregate.totals.delayacct_blkio_secs += (double)p->pi_delayacct_blkio_ticks / ticks;
+    aggregate.increments.delayacct_blkio_secs
+        += counter_increment(p->pi_delayacct_blkio_ticks, q->pi_delayacct_blkio_ticks) / ticks;
+    aggregate.rchar += (p->io_rchar - q->io_rchar) / elapsed_sec;
+    aggregate.wchar += (p->io_wchar - q->io_wchar) / elapsed_sec;
+    aggregate.read_bytes += (p->io_read_bytes - q->io_read_bytes) / elapsed_sec;
+    aggregate.write_bytes += (p->io_write_bytes - q->io_write_bytes) / elapsed_sec;
+    aggregate.totals.total_read += p->io_rchar;
+    aggregate.totals.total_write += p->io_wchar;
+    aggregate.increments.total_read += counter_increment(p->io_rchar, q->io_rchar);
+    aggregate.increments.total_write += counter_increment(p->io_wchar, q->io_wchar);
+}
+
+static void update_aggregate_totals(task_series_view_t& view)
+{
+    // tasks join and leave the aggregated series from one sample to the next, so the sum of their counters could
+    // decrease: the counters of a series already present in the last sample grow by the increments of its tasks.
+    // A series appearing (again) starts from the sum of the counters of its tasks.
+    std::unordered_map<std::string, task_counters_t> prev_totals;
+    prev_totals.swap(view.totals);
+    auto update = [&view, &prev_totals](task_aggregate_t& aggregate) {
+        auto prev = prev_totals.find(aggregate.name);
+        if (prev != prev_totals.end()) {
+            aggregate.totals = prev->second;
+            aggregate.totals.usr_total_secs += aggregate.increments.usr_total_secs;
+            aggregate.totals.sys_total_secs += aggregate.increments.sys_total_secs;
+            aggregate.totals.delayacct_blkio_secs += aggregate.increments.delayacct_blkio_secs;
+            aggregate.totals.total_read += aggregate.increments.total_read;
+            aggregate.totals.total_write += aggregate.increments.total_write;
+        }
+        view.totals[aggregate.name] = aggregate.totals;
+    };
+    for (auto& group : view.groups)
+        update(group.second);
+    if (view.other.tasks > 0)
+        update(view.other);
+}
+
+void CMonitorCgroups::init_task_series_views()
+{
+    if (m_task_series_views_initialized) {
+        // the views are kept across samples, together with the counters of their aggregated series:
+        for (auto& view : m_task_series_views) {
+            view.group_scores.clear();
+            view.groups.clear();
+            view.other = task_aggregate_t();
+        }
+        return;
+    }
+    m_task_series_views_initialized = true;
+
+    // sinks configured with the same cap share the same aggregated series:
+    m_task_series_views.clear();
+    m_task_series_uncapped_sinks = SINK_MASK_ALL;
+    for (unsigned int sink = 0; sink < SINK_MAX; sink++) {
+        const task_series_limit_t& limit = m_pOutput->get_task_series_limit((OutputSink)sink);
+        if (limit.max_series == 0 || (m_pOutput->get_enabled_sinks() & SINK_MASK(sink)) == 0)
+            continue;
+        m_task_series_uncapped_sinks &= ~SINK_MASK(sink);
+
+        auto view = std::find_if(m_task_series_views.begin(), m_task_series_views.end(),
+            [&limit](const task_series_view_t& v) -> bool {
+                return v.limit.max_series == limit.max_series && v.limit.key == limit.key;
+            });
+        if (view == m_task_series_views.end()) {
+            m_task_series_views.push_back(task_series_view_t());
+            view = m_task_series_views.end() - 1;
+            view->limit = limit;
+        }
+        view->sinks |= SINK_MASK(sink);
+    }
+}
+
+void CMonitorCgroups::cap_task_series(
+    std::multimap<uint64_t, proc_topper_t>::iterator first_over_threshold, double elapsed_sec)
+{
+    static double ticks = (double)sysconf(_SC_CLK_TCK); // clock ticks per second
+    std::multimap<uint64_t, proc_topper_t>::reverse_iterator last_over_threshold(first_over_threshold);
+
+    for (auto& view : m_task_series_views) {
+        const char* key_label = view.limit.key == TASK_SERIES_BY_TGID ? "tgid" : "cmd";
+        view.other.name = "other";
+        // a dedicated label: any value of the "cmd" label could be the name of a real command, e.g. cmd="other"
+        view.other.labels = { { "other", "true" } };
+
+        if (view.limit.key == TASK_SERIES_BY_PID) {
+            // the tasks with the highest scores keep their individual series:
+            unsigned int rank = 0;
+            for (auto it = m_topper_procs.rbegin(); it != last_over_threshold; it++, rank++) {
+                if (rank < view.limit.max_series)
+                    it->second.sinks |= view.sinks;
+                else
+                    accumulate_task(view.other, it->first, it->second.current, it->second.prev, elapsed_sec, ticks);
+            }
+            update_aggregate_totals(view);
+            continue;
+        }
+
+        // first pass: find the groups with the highest scores
+        std::string key;
+        for (auto it = m_topper_procs.rbegin(); it != last_over_threshold; it++) {
+            const procsinfo_t* p = it->second.current;
+            key = view.limit.key == TASK_SERIES_BY_TGID ? std::to_string(p->pi_tgid) : p->pi_comm;
+            view.group_scores[key] += it->first;
+        }
+        std::vector<std::pair<uint64_t, std::string>> ranking;
+        ranking.reserve(view.group_scores.size());
+        for (const auto& group : view.group_scores)
+            ranking.push_back(std::make_pair(group.second, group.first));
+        size_t num_groups = std::min((size_t)view.limit.max_series, ranking.size());
+        std::partial_sort(ranking.begin(), ranking.begin() + num_groups, ranking.end(),
+            [](const std::pair<uint64_t, std::string>& a, const std::pair<uint64_t, std::string>& b) -> bool {
+                return a.first > b.first || (a.first == b.first && a.second < b.second);
+            });
+        for (size_t n = 0; n < num_groups; n++) {
+            task_aggregate_t& group = view.groups[ranking[n].second];
+            group.name = std::string(key_label) + "_" + ranking[n].second;
+            group.labels[key_label] = ranking[n].second;
+        }
+
+        // second pass: sum the KPIs of all tasks of each group
+        for (auto it = m_topper_procs.rbegin(); it != last_over_threshold; it++) {
+            const procsinfo_t* p = it->second.current;
+            key = view.limit.key == TASK_SERIES_BY_TGID ? std::to_string(p->pi_tgid) : p->pi_comm;
+            auto group = view.groups.find(key);
+            task_aggregate_t& aggregate = group != view.groups.end() ? group->second : view.other;
+            if (view.limit.key == TASK_SERIES_BY_TGID && &aggregate != &view.other
+                && (aggregate.tasks == 0 || p->pi_pid == p->pi_tgid))
+                aggregate.labels["cmd"] = p->pi_comm; // command of the main thread or of the busiest one
+            accumulate_task(aggregate, it->first, p, it->second.prev, elapsed_sec, ticks);
+        }
+        update_aggregate_totals(view);
+    }
+}
+
+void CMonitorCgroups::output_task_aggregate(
+    const task_aggregate_t& aggregate, sink_mask_t sinks, OutputFields output_opts)
+{
+    m_pOutput->psubsection_start(aggregate.name.c_str(), aggregate.labels, sinks);
+
+    m_pOutput->psubsubsection_start("proc_info");
+    m_pOutput->plong("cmon_score", aggregate.score);
+    m_pOutput->plong("tasks", aggregate.tasks);
+    m_pOutput->psubsubsection_end();
+
+    m_pOutput->psubsubsection_start("cpu", aggregate.labels);
+    m_pOutput->pdouble("usr", aggregate.usr);
+    m_pOutput->pdouble("sys", aggregate.sys);
+    m_pOutput->pdouble("usr_total_secs", aggregate.totals.usr_total_secs);
+    m_pOutput->pdouble("sys_total_secs", aggregate.totals.sys_total_secs);
+    m_pOutput->psubsubsection_end();
+
+    m_pOutput->psubsubsection_start("memory", aggregate.labels);
+    m_pOutput->pdouble("minor_fault", aggregate.minor_fault);
+    m_pOutput->pdouble("major_fault", aggregate.major_fault);
+    m_pOutput->plong("virtual_bytes", aggregate.virtual_bytes);
+    m_pOutput->plong("rss_bytes", aggregate.rss_bytes);
+    m_pOutput->psubsubsection_end();
+
+    m_pOutput->psubsubsection_start("io", aggregate.labels);
+    m_pOutput->pdouble("delayacct_blkio_secs", aggregate.totals.delayacct_blkio_secs);
+    m_pOutput->plong("rchar", aggregate.rchar);
+    m_pOutput->plong("wchar", aggregate.wchar);
+    if (output_opts == PF_ALL) {
+        m_pOutput->plong("read_bytes", aggregate.read_bytes);
+        m_pOutput->plong("write_bytes", aggregate.write_bytes);
+    }
+    m_pOutput->plong("total_read", aggregate.totals.total_read);
+    m_pOutput->plong("total_write", aggregate.totals.total_write);
+    m_pOutput->psubsubsection_end();
+
+    m_pOutput->psubsection_end();
+}
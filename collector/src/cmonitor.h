@@ -23,6 +23,12 @@
 // Includes
 //------------------------------------------------------------------------------
 
+#include "output_filters.h"
+#include "remote_sender.h"
+#include "sampling_scheduler.h"
+#include "shm_ring.h"
+#include "stream_server.h"
+#include "udp_sender.h"
 #include <fmt/format.h>
 #include <map>
 #include <set>
@@ -43,6 +49,10 @@
 
 #define SPECIAL_NUMSAMPLES_UNTIL_CGROUP_ALIVE (UINT64_MAX)
 
+// each monitored cgroup keeps about 10 files open: the default keeps well below the usual RLIMIT_NOFILE of 1024
+#define CGROUP_DISCOVERY_DEFAULT_MAX (64)
+#define CGROUP_DISCOVERY_DEFAULT_MAX_STR "64"
+
 enum PerformanceKpiFamily {
     PK_INVALID = 0,
 
@@ -81,16 +91,45 @@ enum OutputFields {
     PF_USED_BY_CHART_SCRIPT_ONLY // force newline
 };
 
+enum OutputFormat {
+    OF_INVALID = 0,
+    OF_JSON = 1, // force newline
+    OF_CBOR = 2, // force newline
+};
+
+OutputFormat string2OutputFormat(const std::string&);
+
 enum RemoteType {
     REMOTE_INVALID,
     REMOTE_NONE,
     REMOTE_INFLUXDB,
+    REMOTE_INFLUXDB_UDP,
     REMOTE_PROMETHEUS,
+    REMOTE_PROMETHEUS_REMOTE_WRITE,
+    REMOTE_OTLP,
 };
 
 RemoteType string2RemoteType(const std::string&);
 std::string RemoteType2string(RemoteType k);
 
+typedef struct {
+    // REMOTE_INFLUXDB, REMOTE_INFLUXDB_UDP, REMOTE_PROMETHEUS_REMOTE_WRITE or REMOTE_OTLP
+    RemoteType type = REMOTE_INVALID;
+    std::string address;
+    uint64_t port = 0;
+    std::string dbname; // empty means the value of --remote-dbname
+    std::string path; // remote-write and OTLP only: empty means the default path
+
+    // options given as ?queue=BATCHES&spool=DIRECTORY[,MAX_MB] or spool=none; when missing, the ones of
+    // --remote-queue-size and --remote-spool-dir apply
+    unsigned int queue_max_batches = 0; // 0 means the value of --remote-queue-size
+    bool has_spool = false; // spool= was given: an empty spool_dir means dropping what does not fit the queue
+    std::string spool_dir;
+    uint64_t spool_max_bytes = 0; // 0 means the value of --remote-spool-dir
+} remote_endpoint_t;
+
+bool string2RemoteEndpoint(const std::string&, remote_endpoint_t&);
+
 //------------------------------------------------------------------------------
 // Types
 //------------------------------------------------------------------------------
@@ -168,6 +207,7 @@ typedef struct procsinfo_s {
 typedef struct proc_topper_s {
     const procsinfo_t* current;
     const procsinfo_t* prev;
+    sink_mask_t sinks; // sinks that get an individual series for this task
 } proc_topper_t;
 
 //------------------------------------------------------------------------------
@@ -187,22 +227,43 @@ public:
     // local data saving opts
     std::string m_strOutputDir; // --output-directory
     std::string m_strOutputFilenamePrefix; // --output-filename
+    unsigned int m_nOutputFormats = OF_JSON; // --output-format; this is a bitmask of OutputFormat values
+    bool m_bOutputPretty = false; // --output-pretty
+    std::vector<std::string> m_vecOutputFilters; // --sink-filter
+    std::string m_strShmRingName; // --shm-ring; empty means disabled
+    uint64_t m_nShmRingSlots = SHM_RING_DEFAULT_SLOTS; // --shm-ring
+    uint64_t m_nShmRingSlotKB = SHM_RING_DEFAULT_SLOT_KB; // --shm-ring
+    std::string m_strStreamSocket; // --stream-socket; empty means disabled
+    StreamFormat m_nStreamFormat = STREAM_FORMAT_NDJSON; // --stream-socket
+    uint64_t m_nStreamQueueLen = STREAM_SERVER_DEFAULT_QUEUE_LEN; // --stream-socket
+    StreamSlowSubscriberPolicy m_nStreamPolicy = STREAM_POLICY_SKIP; // --stream-socket
 
     // remote streaming opts
     std::string m_strRemoteAddress; // --remote-ip
     std::string m_strRemoteSecret; // --remote-secret
     std::string m_strRemoteDatabaseName = "cmonitor"; // remote-dbname
     uint64_t m_nRemotePort = 0; // --remote-port
+    remote_sender_config_t m_remoteSenderCfg; // --remote-batch, --remote-queue-size, --remote-spool-dir
+    uint64_t m_nRemoteUdpPayloadSize = UDP_SENDER_DEFAULT_PAYLOAD_SIZE; // --remote-udp-payload
+    std::vector<remote_endpoint_t> m_remoteEndpoints; // --remote=influxdb://..., plus --remote-ip/port if InfluxDB
 
     // data collecting options
     uint64_t m_nSamples = 0; // --num-samples
     uint64_t m_nSamplingIntervalMsec = 60000; // --sampling-interval
+    MissedDeadlinePolicy m_nMissedDeadlinePolicy = MISSED_DEADLINE_SKIP; // --missed-deadlines
     unsigned int m_nCollectFlags = PK_ALL; // --collect; this is a bitmask of PerformanceKpiFamily values
+    std::map<unsigned int, uint64_t> m_mapFamilyIntervalMsec; // --collect=FAMILY@INTERVAL; keyed by a single family
     OutputFields m_nOutputFields = PF_USED_BY_CHART_SCRIPT_ONLY; // --deep-collect
-    std::string m_strCGroupName; // --cgroup-name
+    std::string m_strCGroupName; // --cgroup-name; can be a comma-separated list of names and glob patterns
+    bool m_bCgroupDiscovery = false; // --cgroup-discovery
+    uint64_t m_nCgroupDiscoveryMax = CGROUP_DISCOVERY_DEFAULT_MAX; // --cgroup-discovery-max
     uint64_t m_nProcessScoreThreshold = 1; // --score-threshold
+    unsigned int m_nSamplingThreads = 1; // --sampling-threads
     std::map<std::string, std::string> m_mapCustomMetadata; // --custom-metadata
-    RemoteType m_nRemote = REMOTE_NONE; // --remote=none|influxdb|prometheus
+    uint64_t m_nTriggerRingSamples = 0; // --trigger-ring
+    double m_dCpuBudgetPerc = 0; // --cpu-budget; 0 means no budget
+    uint64_t m_nMaxTasks = 0; // cap on the cgroup tasks sampled, set by the --cpu-budget degradation; 0 means no cap
+    RemoteType m_nRemote = REMOTE_NONE; // --remote=none|influxdb|influxdb-udp|prometheus|prometheus-remote-write|otlp
 };
 
 //------------------------------------------------------------------------------
@@ -0,0 +1,117 @@
+/*
+ * cpu_budget.cpp -- limits the CPU time used by the collector itself
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cpu_budget.h"
+#include <algorithm>
+#include <time.h>
+
+// ----------------------------------------------------------------------------------
+// Helpers
+// ----------------------------------------------------------------------------------
+
+static uint64_t get_clock_nsec(clockid_t clock)
+{
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0)
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorCpuBudget
+// ----------------------------------------------------------------------------------
+
+uint64_t CMonitorCpuBudget::get_thread_cpu_nsec() { return get_clock_nsec(CLOCK_THREAD_CPUTIME_ID); }
+
+uint64_t CMonitorCpuBudget::get_process_cpu_nsec() { return get_clock_nsec(CLOCK_PROCESS_CPUTIME_ID); }
+
+const char* CMonitorCpuBudget::action2string(CpuBudgetAction action)
+{
+    switch (action) {
+    case CPU_BUDGET_LENGTHEN_TASK_INTERVAL:
+        return "lengthen_task_interval";
+    case CPU_BUDGET_CAP_TASKS:
+        return "cap_tasks";
+    case CPU_BUDGET_DISABLE_DEEP_FIELDS:
+        return "disable_deep_fields";
+    case CPU_BUDGET_EXHAUSTED:
+        return "exhausted";
+    case CPU_BUDGET_NONE:
+        break;
+    }
+    return "none";
+}
+
+void CMonitorCpuBudget::init(double budget_perc, uint64_t sampling_interval_msec)
+{
+    m_budget_perc = budget_perc;
+    m_window_msec
+        = std::max((uint64_t)CPU_BUDGET_MIN_WINDOW_MSEC, CPU_BUDGET_MIN_WINDOW_SAMPLES * sampling_interval_msec);
+    m_window_start_msec = 0;
+}
+
+bool CMonitorCpuBudget::check(uint64_t now_msec, uint64_t process_cpu_nsec)
+{
+    if (m_window_start_msec == 0) {
+        // the first window starts after the first sample, excluding the initialization of the collector
+        m_window_start_msec = now_msec;
+        m_window_start_cpu_nsec = process_cpu_nsec;
+        m_window_samples = 0;
+        return false;
+    }
+
+    m_window_samples++;
+    uint64_t elapsed_msec = now_msec - m_window_start_msec;
+    if (elapsed_msec < m_window_msec || m_window_samples < CPU_BUDGET_MIN_WINDOW_SAMPLES)
+        return false;
+
+    m_last_usage_perc = (double)(process_cpu_nsec - m_window_start_cpu_nsec) / (elapsed_msec * 10000.0);
+    m_window_start_msec = now_msec;
+    m_window_start_cpu_nsec = process_cpu_nsec;
+    m_window_samples = 0;
+    return m_last_usage_perc > m_budget_perc;
+}
+
+CpuBudgetAction CMonitorCpuBudget::degrade(bool can_lengthen_task_interval, size_t num_tasks, bool deep_fields)
+{
+    if (m_exhausted)
+        return CPU_BUDGET_NONE; // already reported
+
+    if (can_lengthen_task_interval && m_task_interval_factor < CPU_BUDGET_MAX_TASK_INTERVAL_FACTOR) {
+        m_task_interval_factor *= 2;
+        m_level++;
+        return CPU_BUDGET_LENGTHEN_TASK_INTERVAL;
+    }
+
+    size_t tasks = m_max_tasks ? std::min(m_max_tasks, num_tasks) : num_tasks;
+    if (tasks > CPU_BUDGET_MIN_TASKS) {
+        m_max_tasks = std::max((size_t)CPU_BUDGET_MIN_TASKS, tasks / 2);
+        m_level++;
+        return CPU_BUDGET_CAP_TASKS;
+    }
+
+    if (deep_fields && !m_deep_fields_disabled) {
+        m_deep_fields_disabled = true;
+        m_level++;
+        return CPU_BUDGET_DISABLE_DEEP_FIELDS;
+    }
+
+    m_exhausted = true;
+    return CPU_BUDGET_EXHAUSTED;
+}
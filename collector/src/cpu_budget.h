@@ -0,0 +1,109 @@
+/*
+ * cpu_budget.h -- limits the CPU time used by the collector itself
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define CPU_BUDGET_MIN_WINDOW_MSEC (10000) // the CPU usage is measured over at least this time...
+#define CPU_BUDGET_MIN_WINDOW_SAMPLES (3) // ...and over at least this number of samples
+#define CPU_BUDGET_MAX_TASK_INTERVAL_FACTOR (8) // the cgroup tasks are sampled at most 8 times less often
+#define CPU_BUDGET_MIN_TASKS (16) // the cap on the number of cgroup tasks never goes below this value
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+// the degradation steps, in the order they are taken
+enum CpuBudgetAction {
+    CPU_BUDGET_NONE,
+    CPU_BUDGET_LENGTHEN_TASK_INTERVAL, // double the sampling interval of the cgroup_processes/threads families
+    CPU_BUDGET_CAP_TASKS, // halve the number of cgroup tasks being sampled
+    CPU_BUDGET_DISABLE_DEEP_FIELDS, // go back from --deep-collect to the default fields
+    CPU_BUDGET_EXHAUSTED, // nothing else can be degraded
+};
+
+//------------------------------------------------------------------------------
+// CMonitorCpuBudget
+//
+// Measures the CPU time consumed by the collector process (all its threads) over windows of at least
+// CPU_BUDGET_MIN_WINDOW_MSEC and, when it exceeds the budget, picks the next degradation step. Only one step is
+// taken per window, so that its effect is measured before taking the next one. Steps are never undone.
+// The CPU time spent sampling each KPI family is also measured, on the sampling thread, to explain where the
+// time goes.
+//------------------------------------------------------------------------------
+
+class CMonitorCpuBudget {
+public:
+    CMonitorCpuBudget() { }
+
+    // budget_perc is a percentage of a single core, e.g. 1 means at most 10msecs of CPU time every second
+    void init(double budget_perc, uint64_t sampling_interval_msec);
+    bool is_enabled() const { return m_budget_perc > 0; }
+    double get_budget_perc() const { return m_budget_perc; }
+
+    // CPU time spent by the calling thread / by the whole process
+    static uint64_t get_thread_cpu_nsec();
+    static uint64_t get_process_cpu_nsec();
+    static const char* action2string(CpuBudgetAction action);
+
+    // per-family costs of the sample in progress
+    void start_sample() { m_family_cost_nsec.clear(); }
+    void add_family_cost(unsigned int family, uint64_t cost_nsec) { m_family_cost_nsec[family] += cost_nsec; }
+    const std::map<unsigned int, uint64_t>& get_family_costs() const { return m_family_cost_nsec; }
+
+    // to call after each sample: returns true when a window just ended above the budget
+    bool check(uint64_t now_msec, uint64_t process_cpu_nsec);
+    double get_last_usage_perc() const { return m_last_usage_perc; }
+
+    // picks the next degradation step among those applicable; num_tasks is zero when no cgroup task is sampled
+    CpuBudgetAction degrade(bool can_lengthen_task_interval, size_t num_tasks, bool deep_fields);
+    unsigned int get_level() const { return m_level; } // number of steps taken so far
+    unsigned int get_task_interval_factor() const { return m_task_interval_factor; }
+    size_t get_max_tasks() const { return m_max_tasks; } // 0 means no cap
+
+private:
+    double m_budget_perc = 0;
+    uint64_t m_window_msec = 0;
+
+    // current window
+    uint64_t m_window_start_msec = 0;
+    uint64_t m_window_start_cpu_nsec = 0;
+    unsigned int m_window_samples = 0;
+    double m_last_usage_perc = 0;
+
+    std::map<unsigned int, uint64_t> m_family_cost_nsec; // keyed by PerformanceKpiFamily
+
+    // degradation state
+    unsigned int m_level = 0;
+    unsigned int m_task_interval_factor = 1;
+    size_t m_max_tasks = 0;
+    bool m_deep_fields_disabled = false;
+    bool m_exhausted = false;
+};
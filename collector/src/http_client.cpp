@@ -0,0 +1,364 @@
+/*
+ * http_client.cpp -- persistent HTTP/1.1 client used by remote sinks
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "http_client.h"
+#include "logger.h"
+#include "utils_misc.h"
+#include "utils_string.h"
+#include <algorithm>
+#include <errno.h>
+#include <fmt/format.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/uio.h>
+
+// max number of bytes of the response body kept for diagnostic purposes
+#define HTTP_CLIENT_MAX_SAVED_BODY (512)
+
+// ----------------------------------------------------------------------------------
+// CMonitorHttpClient - connection management
+// ----------------------------------------------------------------------------------
+
+bool CMonitorHttpClient::init(const std::string& hostname, unsigned int port)
+{
+    m_hostname = hostname;
+    m_port = port;
+    m_request_head.reserve(256);
+    m_rx_buffer.reserve(1024);
+    return resolve(get_monotonic_msec());
+}
+
+bool CMonitorHttpClient::resolve(uint64_t now_msec)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    // even if lookup fails, do not retry before the refresh interval: the last good address is kept
+    m_last_resolve_msec = now_msec;
+
+    struct addrinfo* res = nullptr;
+    int ret = getaddrinfo(m_hostname.c_str(), std::to_string(m_port).c_str(), &hints, &res);
+    if (ret != 0 || res == nullptr) {
+        CMonitorLogger::instance()->LogError(
+            "Lookup of IP address for hostname %s failed: %s\n", m_hostname.c_str(), gai_strerror(ret));
+        return false;
+    }
+
+    // just use the first address returned:
+    memcpy(&m_addr, res->ai_addr, res->ai_addrlen);
+    m_addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return true;
+}
+
+void CMonitorHttpClient::disconnect()
+{
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+    m_rx_buffer.clear();
+    m_rx_pos = 0;
+}
+
+void CMonitorHttpClient::on_failure(uint64_t now_msec)
+{
+    disconnect();
+    m_num_failures++;
+
+    m_backoff_msec = m_backoff_msec ? std::min<uint64_t>(m_backoff_msec * 2, HTTP_CLIENT_MAX_BACKOFF_MSEC)
+                                    : HTTP_CLIENT_MIN_BACKOFF_MSEC;
+    m_next_attempt_msec = now_msec + m_backoff_msec;
+}
+
+bool CMonitorHttpClient::wait_fd(short events, uint64_t deadline_msec)
+{
+    for (;;) {
+        uint64_t now_msec = get_monotonic_msec();
+        if (now_msec >= deadline_msec)
+            return false;
+
+        struct pollfd pfd = { m_fd, events, 0 };
+        int ret = poll(&pfd, 1, (int)(deadline_msec - now_msec));
+        if (ret > 0)
+            return true; // also POLLERR/POLLHUP: the following syscall will report the actual error
+        if (ret == 0 || errno != EINTR)
+            return false;
+    }
+}
+
+int CMonitorHttpClient::connect_with_timeout(uint64_t now_msec)
+{
+    if (m_addr_len == 0)
+        return HTTP_CLIENT_ERR_RESOLVE;
+
+    m_fd = socket(m_addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_fd == -1)
+        return HTTP_CLIENT_ERR_CONNECT;
+
+    // requests are small and we always wait for the response: no point in delaying them
+    int one = 1;
+    setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(m_fd, (struct sockaddr*)&m_addr, m_addr_len) != 0) {
+        if (errno != EINPROGRESS || !wait_fd(POLLOUT, now_msec + m_connect_timeout_msec))
+            return HTTP_CLIENT_ERR_CONNECT;
+
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0)
+            return HTTP_CLIENT_ERR_CONNECT;
+    }
+
+    m_num_connects++;
+    m_server_closes = false;
+    CMonitorLogger::instance()->LogDebug("Connected to HTTP server %s:%u", m_hostname.c_str(), m_port);
+    return 0;
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorHttpClient - request/response
+// ----------------------------------------------------------------------------------
+
+int CMonitorHttpClient::post(
+    const std::string& path, const std::string& extra_headers, const char* body, size_t body_len)
+{
+    uint64_t now_msec = get_monotonic_msec();
+    if (m_fd == -1 && now_msec < m_next_attempt_msec)
+        return HTTP_CLIENT_ERR_BACKOFF;
+
+    if (now_msec - m_last_resolve_msec >= m_dns_refresh_msec) {
+        struct sockaddr_storage old_addr = m_addr;
+        socklen_t old_addr_len = m_addr_len;
+        if (resolve(now_msec) && (old_addr_len != m_addr_len || memcmp(&old_addr, &m_addr, m_addr_len) != 0)) {
+            CMonitorLogger::instance()->LogDebug(
+                "Address of HTTP server %s changed: reconnecting to the new one", m_hostname.c_str());
+            disconnect();
+        }
+    }
+
+    m_request_head.clear();
+    m_request_head += "POST " + path + " HTTP/1.1\r\nHost: " + m_hostname + "\r\nContent-Length: ";
+    m_request_head += std::to_string(body_len);
+    m_request_head += "\r\n";
+    m_request_head += extra_headers;
+    m_request_head += "\r\n";
+    m_num_requests++;
+
+    int ret = 0;
+    for (unsigned int attempt = 0; attempt < 2; attempt++) {
+        bool reused = (m_fd != -1);
+        if (!reused) {
+            ret = connect_with_timeout(now_msec);
+            if (ret < 0) {
+                m_last_resolve_msec = 0; // maybe the server moved: resolve again at next attempt
+                break;
+            }
+        }
+
+        ret = send_request(m_request_head, body, body_len, get_monotonic_msec() + m_io_timeout_msec);
+        if (ret == 0)
+            ret = read_response(get_monotonic_msec() + m_io_timeout_msec);
+        if (ret >= 0) {
+            m_backoff_msec = 0;
+            if (m_server_closes)
+                disconnect();
+            return ret;
+        }
+
+        // an idle keep-alive connection might have been closed by the server in the meantime:
+        // in such case retry once on a brand new connection
+        disconnect();
+        if (!reused || (ret != HTTP_CLIENT_ERR_SEND && ret != HTTP_CLIENT_ERR_RECV))
+            break;
+    }
+
+    on_failure(now_msec);
+    return ret;
+}
+
+int CMonitorHttpClient::send_request(const std::string& head, const char* body, size_t body_len, uint64_t deadline_msec)
+{
+    struct iovec iov[2];
+    iov[0].iov_base = (void*)head.data();
+    iov[0].iov_len = head.size();
+    iov[1].iov_base = (void*)body;
+    iov[1].iov_len = body_len;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    while (msg.msg_iovlen > 0) {
+        ssize_t sent = sendmsg(m_fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_fd(POLLOUT, deadline_msec))
+                continue;
+            return HTTP_CLIENT_ERR_SEND;
+        }
+
+        // advance the iovec array past the bytes already sent:
+        while (msg.msg_iovlen > 0 && (size_t)sent >= msg.msg_iov[0].iov_len) {
+            sent -= msg.msg_iov[0].iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov[0].iov_base = (char*)msg.msg_iov[0].iov_base + sent;
+            msg.msg_iov[0].iov_len -= sent;
+        }
+    }
+    return 0;
+}
+
+int CMonitorHttpClient::recv_some(uint64_t deadline_msec)
+{
+    char buf[4096];
+    for (;;) {
+        ssize_t ret = recv(m_fd, buf, sizeof(buf), 0);
+        if (ret > 0) {
+            m_rx_buffer.append(buf, ret);
+            return ret;
+        }
+        if (ret == 0)
+            return 0; // connection closed by peer
+        if (errno == EINTR)
+            continue;
+        if ((errno == EAGAIN || errno == EWOULDBLOCK) && wait_fd(POLLIN, deadline_msec))
+            continue;
+        return HTTP_CLIENT_ERR_RECV;
+    }
+}
+
+int CMonitorHttpClient::read_line(std::string& line, uint64_t deadline_msec)
+{
+    for (;;) {
+        size_t eol = m_rx_buffer.find('\n', m_rx_pos);
+        if (eol != std::string::npos) {
+            size_t end = (eol > m_rx_pos && m_rx_buffer[eol - 1] == '\r') ? eol - 1 : eol;
+            line.assign(m_rx_buffer, m_rx_pos, end - m_rx_pos);
+            m_rx_pos = eol + 1;
+            return 0;
+        }
+        if (m_rx_buffer.size() - m_rx_pos > 8192)
+            return HTTP_CLIENT_ERR_PROTOCOL; // unreasonably long header line
+        if (recv_some(deadline_msec) <= 0)
+            return HTTP_CLIENT_ERR_RECV;
+    }
+}
+
+int CMonitorHttpClient::read_exactly(size_t len, uint64_t deadline_msec, bool keep_as_body)
+{
+    while (len > 0) {
+        if (m_rx_pos == m_rx_buffer.size()) {
+            m_rx_buffer.clear();
+            m_rx_pos = 0;
+            if (recv_some(deadline_msec) <= 0)
+                return HTTP_CLIENT_ERR_RECV;
+        }
+
+        size_t n = std::min(len, m_rx_buffer.size() - m_rx_pos);
+        if (keep_as_body && m_last_response_body.size() < HTTP_CLIENT_MAX_SAVED_BODY)
+            m_last_response_body.append(m_rx_buffer, m_rx_pos,
+                std::min(n, HTTP_CLIENT_MAX_SAVED_BODY - m_last_response_body.size()));
+        m_rx_pos += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int CMonitorHttpClient::read_response(uint64_t deadline_msec)
+{
+    // any leftover from a previous response is garbage:
+    m_rx_buffer.clear();
+    m_rx_pos = 0;
+    m_last_response_body.clear();
+
+    // status line, e.g. "HTTP/1.1 204 No Content"
+    std::string line;
+    int ret = read_line(line, deadline_msec);
+    if (ret < 0)
+        return ret;
+    if (line.compare(0, 5, "HTTP/") != 0 || line.size() < 12)
+        return HTTP_CLIENT_ERR_PROTOCOL;
+    int status = atoi(line.c_str() + 9);
+    if (status < 100)
+        return HTTP_CLIENT_ERR_PROTOCOL;
+    m_server_closes = (line.compare(0, 8, "HTTP/1.0") == 0); // HTTP/1.0 default is to close
+
+    // headers
+    bool chunked = false;
+    long long content_length = -1;
+    for (;;) {
+        ret = read_line(line, deadline_msec);
+        if (ret < 0)
+            return ret;
+        if (line.empty())
+            break;
+
+        std::string key, value;
+        if (!split_string_on_first_separator(line, ':', key, value))
+            continue;
+        key = to_lower(key);
+        value = to_lower(trim_string(value));
+        if (key == "content-length")
+            content_length = atoll(value.c_str());
+        else if (key == "transfer-encoding")
+            chunked = (value.find("chunked") != std::string::npos);
+        else if (key == "connection")
+            m_server_closes = (value == "close");
+    }
+
+    // body (it is discarded, apart from a short prefix useful for diagnostics)
+    if (status / 100 == 1 || status == 204 || status == 304)
+        return status;
+    if (chunked) {
+        for (;;) {
+            if ((ret = read_line(line, deadline_msec)) < 0)
+                return ret;
+            size_t chunk_len = strtoul(line.c_str(), nullptr, 16);
+            if (chunk_len == 0)
+                break;
+            if ((ret = read_exactly(chunk_len, deadline_msec, true)) < 0 || (ret = read_line(line, deadline_msec)) < 0)
+                return ret;
+        }
+        // skip the trailer
+        do {
+            if ((ret = read_line(line, deadline_msec)) < 0)
+                return ret;
+        } while (!line.empty());
+    } else if (content_length >= 0) {
+        if ((ret = read_exactly(content_length, deadline_msec, true)) < 0)
+            return ret;
+    } else {
+        // no framing: the body is delimited by the connection close
+        m_server_closes = true;
+        while (read_exactly(1, deadline_msec, true) == 0)
+            ;
+    }
+    return status;
+}
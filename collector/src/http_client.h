@@ -0,0 +1,138 @@
+/*
+ * http_client.h -- persistent HTTP/1.1 client used by remote sinks
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define HTTP_CLIENT_DEFAULT_CONNECT_TIMEOUT_MSEC (1000)
+#define HTTP_CLIENT_DEFAULT_IO_TIMEOUT_MSEC (2000)
+#define HTTP_CLIENT_MIN_BACKOFF_MSEC (250)
+#define HTTP_CLIENT_MAX_BACKOFF_MSEC (30000)
+#define HTTP_CLIENT_DEFAULT_DNS_REFRESH_SEC (300)
+
+// negative values returned by CMonitorHttpClient::post() in place of the HTTP status code:
+enum HttpClientError {
+    HTTP_CLIENT_ERR_RESOLVE = -1, // hostname lookup failed
+    HTTP_CLIENT_ERR_BACKOFF = -2, // not attempted: still waiting the backoff after a previous failure
+    HTTP_CLIENT_ERR_CONNECT = -3, // connection refused or connect timeout
+    HTTP_CLIENT_ERR_SEND = -4, // send error or timeout
+    HTTP_CLIENT_ERR_RECV = -5, // recv error, timeout or connection closed by peer
+    HTTP_CLIENT_ERR_PROTOCOL = -6, // malformed HTTP response
+};
+
+//------------------------------------------------------------------------------
+// CMonitorHttpClient
+//
+// A minimal HTTP/1.1 client keeping a single keep-alive connection open towards the server.
+// All socket operations are non-blocking and bounded by timeouts. Each phase has its own deadline:
+// the connection is bounded by the connect timeout, while sending the request and receiving the
+// response are bounded by one I/O timeout each. When a reused keep-alive connection turns out to be
+// closed by the server, the request is retried once on a new connection, so that a single post()
+// can take up to
+//     connect timeout + 4 * I/O timeout
+// plus the time of the hostname resolution, which is blocking, when it is due.
+// After a failure the connection is dropped and no new attempt is done before an exponential
+// backoff expires; in the meantime post() fails immediately with HTTP_CLIENT_ERR_BACKOFF.
+// The server hostname is resolved again periodically and after every failed connection attempt.
+//------------------------------------------------------------------------------
+
+class CMonitorHttpClient {
+public:
+    CMonitorHttpClient() { }
+    ~CMonitorHttpClient() { disconnect(); }
+
+    // performs the first hostname resolution; returns false if it fails
+    bool init(const std::string& hostname, unsigned int port);
+    void set_timeouts(unsigned int connect_timeout_msec, unsigned int io_timeout_msec)
+    {
+        m_connect_timeout_msec = connect_timeout_msec;
+        m_io_timeout_msec = io_timeout_msec;
+    }
+    void set_dns_refresh_interval(unsigned int refresh_sec) { m_dns_refresh_msec = (uint64_t)refresh_sec * 1000; }
+
+    // Sends a POST request with the given body; additional headers must be provided already terminated by \r\n.
+    // Returns the HTTP status code of the response or a negative HttpClientError.
+    int post(const std::string& path, const std::string& extra_headers, const char* body, size_t body_len);
+    int post(const std::string& path, const std::string& body) { return post(path, "", body.data(), body.size()); }
+
+    void disconnect();
+
+    bool is_connected() const { return m_fd != -1; }
+    const std::string& get_hostname() const { return m_hostname; }
+    unsigned int get_port() const { return m_port; }
+    const std::string& get_last_response_body() const { return m_last_response_body; }
+
+    // stats
+    uint64_t get_num_connects() const { return m_num_connects; }
+    uint64_t get_num_requests() const { return m_num_requests; }
+    uint64_t get_num_failures() const { return m_num_failures; }
+
+private:
+    bool resolve(uint64_t now_msec);
+    int connect_with_timeout(uint64_t now_msec);
+    int send_request(const std::string& head, const char* body, size_t body_len, uint64_t deadline_msec);
+    int read_response(uint64_t deadline_msec);
+    int recv_some(uint64_t deadline_msec);
+    int read_line(std::string& line, uint64_t deadline_msec);
+    int read_exactly(size_t len, uint64_t deadline_msec, bool keep_as_body);
+    bool wait_fd(short events, uint64_t deadline_msec);
+    void on_failure(uint64_t now_msec);
+
+private:
+    // config
+    std::string m_hostname;
+    unsigned int m_port = 0;
+    unsigned int m_connect_timeout_msec = HTTP_CLIENT_DEFAULT_CONNECT_TIMEOUT_MSEC;
+    unsigned int m_io_timeout_msec = HTTP_CLIENT_DEFAULT_IO_TIMEOUT_MSEC;
+    uint64_t m_dns_refresh_msec = HTTP_CLIENT_DEFAULT_DNS_REFRESH_SEC * 1000;
+
+    // resolved address
+    struct sockaddr_storage m_addr;
+    socklen_t m_addr_len = 0;
+    uint64_t m_last_resolve_msec = 0;
+
+    // connection status
+    int m_fd = -1;
+    bool m_server_closes = false; // server asked to close the connection after the current response
+    uint64_t m_backoff_msec = 0;
+    uint64_t m_next_attempt_msec = 0;
+
+    // buffers reused across requests
+    std::string m_request_head;
+    std::string m_rx_buffer;
+    size_t m_rx_pos = 0;
+    std::string m_last_response_body;
+
+    // stats
+    uint64_t m_num_connects = 0;
+    uint64_t m_num_requests = 0;
+    uint64_t m_num_failures = 0;
+};
@@ -83,16 +83,11 @@ void CMonitorLogger::LogDebug(const char* line, ...)
         printf("\n");
 }
 
-void CMonitorLogger::LogError(const char* line, ...)
+void CMonitorLogger::write_error_line(const char* line)
 {
-    m_nErrors++;
-
-    char currLogLine[MAX_LOG_LINE_LEN];
-    va_list args;
-    va_start(args, line);
-    vsnprintf(currLogLine, MAX_LOG_LINE_LEN - 1, line, args);
-    va_end(args);
-
+    // each line is written with a single call while holding the lock, so that the errors logged at the same
+    // time by different threads never get interleaved:
+    std::lock_guard<std::mutex> guard(m_outputErrMutex);
     if (!m_outputErr && !m_strErrorFileName.empty()) {
         // apparently this is the first error happening: time to open the logfile for errors:
         if ((m_outputErr = fopen(m_strErrorFileName.c_str(), "w")) == 0) {
@@ -100,25 +95,20 @@ void CMonitorLogger::LogError(const char* line, ...)
         }
     }
 
+    size_t len = strlen(line);
+    const char* newline = (len > 0 && line[len - 1] == '\n') ? "" : "\n";
     if (m_outputErr) {
         // errors always go in their dedicated file
-        fprintf(m_outputErr, "ERROR: %s", currLogLine);
-
-        size_t lastCh = strlen(currLogLine) - 1;
-        if (currLogLine[lastCh] != '\n')
-            fprintf(m_outputErr, "\n");
+        fprintf(m_outputErr, "ERROR: %s%s", line, newline);
     }
 
     if (m_bDebugEnabled) {
         // in debug mode stdout is still open, so we can printf:
-        printf("ERROR: %s", currLogLine);
-        size_t lastCh = strlen(currLogLine) - 1;
-        if (currLogLine[lastCh] != '\n')
-            printf("\n");
+        printf("ERROR: %s%s", line, newline);
     }
 }
 
-void CMonitorLogger::LogErrorWithErrno(const char* line, ...)
+void CMonitorLogger::LogError(const char* line, ...)
 {
     m_nErrors++;
 
@@ -128,23 +118,25 @@ void CMonitorLogger::LogErrorWithErrno(const char* line, ...)
     vsnprintf(currLogLine, MAX_LOG_LINE_LEN - 1, line, args);
     va_end(args);
 
-    if (!m_outputErr && !m_strErrorFileName.empty()) {
-        // apparently this is the first error happening: time to open the logfile for errors:
-        if ((m_outputErr = fopen(m_strErrorFileName.c_str(), "w")) == 0) {
-            exit(14);
-        }
-    }
+    write_error_line(currLogLine);
+}
 
-    if (m_outputErr) {
-        // errors always go in their dedicated file
-        fprintf(m_outputErr, "ERROR: %s (errno=%d, %s)\n", currLogLine, errno, strerror(errno));
-    }
+void CMonitorLogger::LogErrorWithErrno(const char* line, ...)
+{
+    int saved_errno = errno; // before any library call can change it
+    m_nErrors++;
 
-    if (m_bDebugEnabled) {
-        // in debug mode stdout is still open, so we can printf:
-        printf("ERROR: %s (errno=%d, %s)\n", currLogLine, errno, strerror(errno));
-        size_t lastCh = strlen(currLogLine) - 1;
-        if (currLogLine[lastCh] != '\n')
-            printf("\n");
-    }
+    char currLogLine[MAX_LOG_LINE_LEN];
+    va_list args;
+    va_start(args, line);
+    vsnprintf(currLogLine, MAX_LOG_LINE_LEN - 1, line, args);
+    va_end(args);
+
+    // the errno description goes on the same line of the message:
+    size_t len = strlen(currLogLine);
+    if (len > 0 && currLogLine[len - 1] == '\n')
+        currLogLine[--len] = '\0';
+    snprintf(currLogLine + len, MAX_LOG_LINE_LEN - len, " (errno=%d, %s)", saved_errno, strerror(saved_errno));
+
+    write_error_line(currLogLine);
 }
@@ -23,8 +23,10 @@
 // Includes
 //------------------------------------------------------------------------------
 
+#include <atomic>
 #include <cstdint>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string.h>
 #include <string>
@@ -61,12 +63,16 @@ public:
     void LogError(const char* line, ...) __attribute__((format(printf, 2, 3)));
     void LogErrorWithErrno(const char* line, ...) __attribute__((format(printf, 2, 3)));
 
+private:
+    void write_error_line(const char* line);
+
 private:
     static CMonitorLogger* ms_pInstance;
     std::string m_strErrorFileName;
     bool m_bDebugEnabled = false;
-    uint64_t m_nErrors = 0;
+    std::atomic<uint64_t> m_nErrors { 0 }; // errors may be logged also by the remote sender threads
 
     // output:
     FILE* m_outputErr = nullptr;
+    std::mutex m_outputErrMutex; // protects m_outputErr: errors come also from the remote and sampling threads
 };
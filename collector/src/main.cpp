@@ -17,12 +17,15 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "cgroup_tree.h"
 #include "cgroups.h"
 #include "cmonitor.h"
+#include "cpu_budget.h"
 #include "header_info.h"
 #include "logger.h"
 #include "output_frontend.h"
 #include "system.h"
+#include "triggers.h"
 #include "utils_files.h"
 #include "utils_misc.h"
 #include "utils_string.h"
@@ -31,9 +34,12 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <iostream>
+#include <memory>
+#include <set>
 #include <signal.h>
 #include <sstream>
 #include <sys/file.h>
+#include <sys/inotify.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -64,11 +70,13 @@
   The duration of sampling is linearly proportional with the number of PIDs to be monitored
   by CMonitorCgroups::sample_processes() and that explains the difference between the 2 numbers
   above (during baremetal1 example the collector tracked around 500 PIDs/TIDs in my test).
+  With --sampling-threads=N that time is spread over N threads (see CMonitorWorkerPool).
   Anyhow a reasonable min value for sampling time is currently set to 10msecs.
   Below such threshold the time for sampling all stats (even when there's a single PID like for a Docker)
   becomes too large compared to the sleeping time and the CPU usage of cmonitor_collector might be too high.
 */
 #define MIN_SAMPLING_TIME_SEC (0.01)
+#define MIN_SAMPLING_TICK_MSEC ((uint64_t)(MIN_SAMPLING_TIME_SEC * 1000))
 
 #define CMONITOR_DEFAULT_PROMETHEUS_PORT 8080
 #define CMONITOR_DEFAULT_PROMETHEUS_PORT_STR "8080"
@@ -93,7 +101,6 @@ class CMonitorCollectorApp {
 public:
     CMonitorCollectorApp()
         : m_header_info_generator(&m_cfg, &m_output)
-        , m_cgroups_collector(&m_cfg, &m_output)
         , m_system_collector(&m_cfg, &m_output)
     {
     }
@@ -105,9 +112,21 @@ public:
 private:
     void print_help();
     void check_pid_file();
-    void output_sample_date_time(long loop, const std::string& utcTime);
-    void do_sampling_sleep();
+    void select_cgroups();
+    void init_cgroups_collectors();
+    bool add_monitored_cgroup(const std::string& name);
+    void update_discovered_cgroups();
+    void select_discovered_cgroups(const std::vector<std::string>& candidates, const std::set<std::string>& monitored,
+        bool whole_tree, std::vector<std::string>& selectedOUT);
+    void output_sample_date_time(CMonitorOutputFrontend& output, long loop, const std::string& utcTime);
+    void output_scheduler_stats();
+    CpuBudgetAction check_cpu_budget(uint64_t now_msec, bool ring_mode, uint64_t& tick);
+    void output_cpu_budget(CMonitorOutputFrontend& output, CpuBudgetAction action);
+    uint64_t do_sampling_sleep(); // returns the number of elapsed ticks, including the skipped ones
+    void init_cgroup_events_watch();
+    bool is_any_cgroup_alive();
     void fill_with_defaults();
+    void disable_unwanted_kpi_families();
 
 private:
     //------------------------------------------------------------------------------
@@ -124,8 +143,48 @@ private:
     // Stats collectors
     //------------------------------------------------------------------------------
     CMonitorHeaderInfo m_header_info_generator;
-    CMonitorCgroups m_cgroups_collector;
     CMonitorSystem m_system_collector;
+
+    // the threads sampling the tasks, see --sampling-threads, are shared by all the cgroups:
+    CMonitorWorkerPool m_task_sampling_pool;
+
+    // one for each cgroup selected by --cgroup-name; when there are several, each one is saved into its
+    // own output files while the baremetal stats, which are sampled only once, go into m_output:
+    typedef struct {
+        std::string name;
+        std::unique_ptr<CMonitorCollectorAppConfig> cfg; // nullptr when using m_cfg
+        std::unique_ptr<CMonitorOutputFrontend> output; // nullptr when saving into m_output
+        std::unique_ptr<CMonitorCgroups> collector;
+        double baseline_time = 0; // when the first reading of the cgroup, not emitted, was done
+        std::map<unsigned int, double> last_sample_time; // see get_cgroup_elapsed() in run_main_loop()
+        std::map<unsigned int, double> saved_last_sample_time; // see save_delta_baselines() in run_main_loop()
+        bool has_saved_delta_baselines = false;
+    } monitored_cgroup_t;
+    std::vector<std::string> m_cgroup_names;
+    std::vector<monitored_cgroup_t> m_cgroups;
+    bool m_bPerCgroupOutput = false;
+
+    // with --cgroup-discovery the cgroups matching --cgroup-name are added and removed while running:
+    CMonitorCgroupTree m_cgroup_tree;
+    std::vector<std::string> m_cgroup_patterns; // empty to match all the leaf cgroups
+    bool m_bCgroupDiscoveryMaxReached = false; // some cgroups wait for a slot below --cgroup-discovery-max
+    std::map<std::string, unsigned int> m_cgroup_output_instances; // cgroups monitored so far for each output prefix
+    int m_argc = 0; // for the header of the cgroups discovered while running
+    char** m_argv = nullptr;
+
+    // with --num-samples=until-cgroup-alive and cgroups v2, the sampling sleep is interrupted as soon as the
+    // cgroups become empty:
+    int m_cgroup_events_fd = -1; // inotify instance watching the "cgroup.events" files
+    bool m_bCgroupsGone = false;
+
+    //------------------------------------------------------------------------------
+    // Sampling loop
+    //------------------------------------------------------------------------------
+    CMonitorSamplingPlan m_sampling_plan;
+    CMonitorSamplingScheduler m_scheduler;
+    CMonitorTriggers m_triggers; // --trigger, --trigger-burst
+    CMonitorCpuBudget m_cpu_budget; // --cpu-budget
+    double m_baseline_time = 0; // when the first reading of all the KPI families, not emitted, was done
 };
 
 //------------------------------------------------------------------------------
@@ -135,19 +194,30 @@ private:
 struct option g_long_opts[] = {
     // Data sampling options
     { "sampling-interval", required_argument, 0, 's' }, // force newline
+    { "missed-deadlines", required_argument, 0, 'j' }, // force newline
     { "num-samples", required_argument, 0, 'c' }, // force newline
     { "allow-multiple-instances", no_argument, 0, 'k' }, // force newline
     { "foreground", no_argument, 0, 'F' }, // force newline
     { "collect", required_argument, 0, 'C' }, // force newline
     { "deep-collect", no_argument, 0, 'e' }, // force newline
     { "cgroup-name", required_argument, 0, 'g' }, // force newline
+    { "cgroup-discovery", no_argument, 0, 'G' }, // force newline
+    { "cgroup-discovery-max", required_argument, 0, 'K' }, // force newline
     { "score-threshold", required_argument, 0, 't' }, // force newline
+    { "sampling-threads", required_argument, 0, 'N' }, // force newline
     { "custom-metadata", required_argument, 0, 'M' }, // force newline
+    { "trigger", required_argument, 0, 'y' }, // force newline
+    { "trigger-burst", required_argument, 0, 'b' }, // force newline
+    { "trigger-ring", required_argument, 0, 'w' }, // force newline
+    { "cpu-budget", required_argument, 0, 'x' }, // force newline
 
     // Options to save data locally
     { "output-directory", required_argument, 0, 'm' }, // force newline
     { "output-filename", required_argument, 0, 'f' }, // force newline
     { "output-pretty", no_argument, 0, 'P' }, // force newline
+    { "output-format", required_argument, 0, 'O' }, // force newline
+    { "shm-ring", required_argument, 0, 'R' }, // force newline
+    { "stream-socket", required_argument, 0, 'u' }, // force newline
 
     // Options to stream data remotely
     { "remote", required_argument, 0, 'r' }, // force newline
@@ -155,6 +225,14 @@ struct option g_long_opts[] = {
     { "remote-port", required_argument, 0, 'p' }, // force newline
     { "remote-secret", required_argument, 0, 'X' }, // force newline
     { "remote-dbname", required_argument, 0, 'D' }, // force newline
+    { "remote-batch", required_argument, 0, 'B' }, // force newline
+    { "remote-queue-size", required_argument, 0, 'Q' }, // force newline
+    { "remote-spool-dir", required_argument, 0, 'W' }, // force newline
+    { "remote-udp-payload", required_argument, 0, 'U' }, // force newline
+    { "remote-gzip", no_argument, 0, 'z' }, // force newline
+    { "remote-precision", required_argument, 0, 'T' }, // force newline
+    { "sink-filter", required_argument, 0, 'S' }, // force newline
+    { "sink-task-limit", required_argument, 0, 'L' }, // force newline
 
     // Other options
     { "version", no_argument, 0, 'v' }, // force newline
@@ -170,16 +248,25 @@ struct option_extended {
 } const g_opts_extended[] = {
     // Data sampling options
     { "Data sampling options", &g_long_opts[0],
-        "Seconds between samples of data (default is 60 seconds). Minimum value is 0.01sec, i.e. 10msecs." },
+        "Seconds between samples of data (default is 60 seconds). Minimum value is 0.01sec, i.e. 10msecs.\n"
+        "Samples are scheduled at fixed deadlines, so the time spent sampling does not make them drift." },
     { "Data sampling options", &g_long_opts[1],
+        "What to do when sampling took longer than the sampling interval and the next sample is already late:\n"
+        "  'skip': skip the missed deadlines and sample again at the next one (this is the default)\n"
+        "  'catch-up': take the missed samples immediately, one after the other, until back on schedule\n"
+        "Missed and skipped deadlines and the wakeup jitter are reported in the 'cmonitor_scheduler' section." },
+    { "Data sampling options", &g_long_opts[2],
         "Number of samples to collect; special values are:\n" // force newline
         "   '0': means forever (default value)\n" // force newline
-        "   'until-cgroup-alive': until the cgroup selected by --cgroup-name is alive" },
-    { "Data sampling options", &g_long_opts[2],
+        "   'until-cgroup-alive': until the cgroup selected by --cgroup-name is alive (or, if more than one\n"
+        "                         cgroup is selected, until any of them is alive). With cgroups v2 a cgroup\n"
+        "                         whose processes all exited is not alive anymore: this is noticed immediately\n"
+        "                         and a last sample is taken, without waiting for the end of the interval" },
+    { "Data sampling options", &g_long_opts[3],
         "Allow multiple simultaneously-running instances of cmonitor_collector on this system.\n"
         "Default is to block attempts to start more than one background instance." },
-    { "Data sampling options", &g_long_opts[3], "Stay in foreground." },
-    { "Data sampling options", &g_long_opts[4],
+    { "Data sampling options", &g_long_opts[4], "Stay in foreground." },
+    { "Data sampling options", &g_long_opts[5],
         "Collect specified list of performance stats. Available performance stats are:\n" // force newline
         "  'cpu': collect per-core CPU stats from /proc/stat\n" // force newline
         "  'memory': collect memory stats from /proc/meminfo, /proc/vmstat\n" // force newline
@@ -196,57 +283,191 @@ struct option_extended {
         "  'all_baremetal': the combination of 'cpu', 'memory', 'disk', 'network'\n" // force newline
         "  'all_cgroup': the combination of 'cgroup_cpu', 'cgroup_memory', 'cgroup_processes'\n" // force newline
         "  'all': the combination of all previous stats (this is the default)\n" // force newline
-        "Note that a comma-separated list of above stats can be provided." },
-    { "Data sampling options", &g_long_opts[5],
+        "Note that a comma-separated list of above stats can be provided.\n"
+        "Each of them can be sampled at its own interval, instead of the --sampling-interval one, using the\n"
+        "FAMILY@INTERVAL syntax where INTERVAL is in seconds or has a 'ms', 's' or 'm' suffix.\n"
+        "E.g. --collect=cpu@100ms,cgroup_cpu@100ms,memory@1s,disk@10s,cgroup_processes@5s\n"
+        "Each sample then contains only the families which were due for sampling at that time." },
+    { "Data sampling options", &g_long_opts[6],
         "Collect all available details for the performance statistics enabled by --collect.\n"
         "By default, for each category, only the stats that are used by the 'cmonitor_chart' companion utility\n"
         "are collected. With this option a more detailed but larger JSON / InfluxDB data stream is produced." },
-    { "Data sampling options", &g_long_opts[6],
+    { "Data sampling options", &g_long_opts[7],
         "If cgroup sampling is active (--collect=cgroups*), this option allows to provide explicitly the name of\n"
         "the cgroup to monitor. If 'self' value is passed (the default), the statistics of the cgroups where\n"
         "cmonitor_collector runs will be collected. Note that this option is mostly useful when running\n"
         "cmonitor_collector directly on the baremetal since a process running inside a container cannot monitor\n"
-        "the performances of other containers." },
-    { "Data sampling options", &g_long_opts[7],
+        "the performances of other containers.\n"
+        "A comma-separated list of cgroup names and glob patterns can be provided to monitor several cgroups with\n"
+        "a single instance, e.g. --cgroup-name='docker/*,system.slice/docker-*.scope'. The statistics of each cgroup\n"
+        "are then saved into their own output files, named after the --output-filename prefix and the cgroup name,\n"
+        "while the baremetal statistics are collected once and saved into the main output files.\n"
+        "Several cgroups can be monitored only when saving data into local files." },
+    { "Data sampling options", &g_long_opts[8],
+        "Monitor all the cgroups of the host matching --cgroup-name, including those created after the start:\n"
+        "the cgroup hierarchy is walked once and then kept up to date by watching its directories with inotify,\n"
+        "so that cgroups appearing or disappearing start or stop being sampled within one sampling interval.\n"
+        "If --cgroup-name is not provided, all the leaf cgroups of the host (those without child cgroups, e.g. the\n"
+        "containers) are monitored. Each cgroup is saved into its own output files, like when --cgroup-name\n"
+        "selects several cgroups; a cgroup created again after its removal gets new files, with a '.2', '.3', ...\n"
+        "suffix, so that the samples of its previous instance are kept." },
+    { "Data sampling options", &g_long_opts[9],
+        "Maximum number of cgroups monitored at the same time by --cgroup-discovery (defaults to "
+        CGROUP_DISCOVERY_DEFAULT_MAX_STR ").\n"
+        "Each cgroup keeps about 10 files open: higher values might require raising the limit on open files." },
+    { "Data sampling options", &g_long_opts[10],
         "If cgroup process/thread sampling is active (--collect=cgroup_processes/cgroup_threads) use the provided\n"
         "score threshold to filter out non-interesting processes/threads. The 'score' is a number that is linearly\n"
         "increasing with the CPU usage. Defaults to '1' to filter out all processes/threads having zero CPU usage.\n"
         "Use '0' to turn off filtering by score." },
-    { "Data sampling options", &g_long_opts[8],
+    { "Data sampling options", &g_long_opts[11],
+        "If cgroup process/thread sampling is active (--collect=cgroup_processes/cgroup_threads) read the\n"
+        "statistics of the processes/threads using the provided number of threads (defaults to 1, max "
+        WORKER_POOL_MAX_THREADS_STR ").\n"
+        "Useful when monitoring cgroups with thousands of tasks, whose sampling takes a long time on a single CPU." },
+    { "Data sampling options", &g_long_opts[12],
         "Allows to specify custom metadata key:value pairs that will be saved into the JSON output (if saving data\n"
         "locally) under the 'header.custom_metadata' path. Can be used multiple times. See usage examples below.\n" },
+    { "Data sampling options", &g_long_opts[13],
+        "Switch to burst sampling (see --trigger-burst) when a rule is satisfied by a sample. Rules have the\n"
+        "syntax KPI OP THRESHOLD where KPI is SECTION[/SUBSECTION]/MEASUREMENT as found in the JSON samples, OP is\n"
+        "one of >, >=, <, <= and THRESHOLD is a number or a percentage of another KPI, e.g. 90%KPI. The KPIs of\n"
+        "the percentage are looked up in the sample and then in the header, where e.g. cgroup limits are found.\n"
+        "Can be used multiple times: the burst starts as soon as any rule fires. E.g.\n"
+        "  --trigger='cgroup_cpuacct_stats/throttling/nr_throttled>0'\n"
+        "  --trigger='cgroup_memory_stats/stat.current>90%cgroup_config/memory_limit_bytes'\n"
+        "Counters are reported, and thus compared, as deltas since the previous sample." },
+    { "Data sampling options", &g_long_opts[14],
+        "Sampling interval and duration of the burst started by --trigger, using the syntax INTERVAL:DURATION\n"
+        "where both are in seconds or have a 'ms', 's' or 'm' suffix (defaults to 100ms:10s). During the burst\n"
+        "all the KPI families are sampled at each interval; a rule firing again extends the burst." },
+    { "Data sampling options", &g_long_opts[15],
+        "Keep in memory the last N samples taken at the burst interval even when no --trigger rule fired, and\n"
+        "write them out when a rule fires, so that the lead-up to the event is captured too (defaults to 0).\n"
+        "With a non-zero N the collector always samples at the burst interval and writes only the samples on\n"
+        "the --sampling-interval schedule unless a burst is in progress: KPIs reported as deltas in those samples\n"
+        "cover the whole time since the previous written sample, and samples older than it are dropped from memory.\n"
+        "Cannot be used with per-family sampling intervals." },
+    { "Data sampling options", &g_long_opts[16],
+        "Limit the CPU time used by the collector to the given percentage of a single core, e.g. 1 for 10msecs\n"
+        "of CPU every second. The usage is measured over windows of at least 10 secs and, each time a window\n"
+        "exceeds the budget, the sampling is degraded by one step, in this order: the interval of the\n"
+        "cgroup_processes/cgroup_threads families is doubled (up to 8 times), the number of cgroup tasks sampled\n"
+        "is halved (down to 16, keeping the top-scoring ones), the fields added by --deep-collect are dropped.\n"
+        "Each step is recorded in the 'cmonitor_cpu_budget' section of the samples, together with the CPU time\n"
+        "spent sampling each KPI family. Defaults to 0, i.e. no budget." },
 
     // Options to save data locally
-    { "Options to save data locally", &g_long_opts[9],
+    { "Options to save data locally", &g_long_opts[17],
         "Write output JSON and .err files to provided directory (defaults to current working directory)." },
-    { "Options to save data locally", &g_long_opts[10],
+    { "Options to save data locally", &g_long_opts[18],
         "Name the output files using provided prefix instead of defaulting to the filenames:\n"
         "\thostname_<year><month><day>_<hour><minutes>.json  (for JSON data)\n"
         "\thostname_<year><month><day>_<hour><minutes>.err   (for error log)\n"
         "Special argument 'stdout' means JSON output should be printed on stdout and errors/warnings on stderr.\n"
         "Special argument 'none' means that JSON output must be disabled." },
-    { "Options to save data locally", &g_long_opts[11],
-        "Generate a pretty-printed JSON file instead of a machine-friendly JSON (the default).\n" },
+    { "Options to save data locally", &g_long_opts[19],
+        "Generate a pretty-printed JSON file instead of a machine-friendly JSON (the default)." },
+    { "Options to save data locally", &g_long_opts[20],
+        "Comma-separated list of encodings for the locally-saved data. Available encodings are:\n" // force newline
+        "  'json': JSON document (this is the default)\n" // force newline
+        "  'cbor': CBOR (RFC 8949) binary document having exactly the same structure of the JSON one\n" // force newline
+        "The CBOR file is saved using the same prefix of --output-filename and the .cbor extension.\n" },
+    { "Options to save data locally", &g_long_opts[21],
+        "Publish each sample into a POSIX shared-memory ring, for local consumers needing the latest samples at high\n"
+        "rate, using the syntax NAME[,SLOTS[,SLOT_KB]]: the ring keeps the last SLOTS samples (default is "
+        SHM_RING_DEFAULT_SLOTS_STR "),\n"
+        "each one CBOR-encoded like in the CBOR file, into slots of SLOT_KB kilobytes (default is "
+        SHM_RING_DEFAULT_SLOT_KB_STR ").\n"
+        "Readers are lock-free and never block the collector; see shm_ring.h for the reader library.\n"
+        "The 'json' sink filter applies. E.g. --shm-ring=cmonitor,128,512\n" },
+    { "Options to save data locally", &g_long_opts[22],
+        "Stream the samples to the local subscribers connecting to a Unix domain socket, using the syntax\n"
+        "PATH[,FORMAT[,QUEUE_LEN[,POLICY]]]. FORMAT is 'json' (the default: one JSON object per line, the first\n"
+        "one being the header) or 'cbor' (a sequence of CBOR items).\n"
+        "Each subscriber has a queue of QUEUE_LEN samples (default is " STREAM_SERVER_DEFAULT_QUEUE_LEN_STR
+        "): when a slow subscriber fills it,\n"
+        "POLICY decides whether to 'skip' its oldest queued samples (the default) or to 'disconnect' it.\n"
+        "Subscribers never slow down the sampling.\n"
+        "The 'json' sink filter applies. E.g. --stream-socket=/run/cmonitor.sock,cbor,16,disconnect\n" },
 
     // Options to stream data remotely
-    { "Options to stream data remotely", &g_long_opts[12],
-        "Set the type of remote target: 'none' (default), 'influxdb' or 'prometheus'." },
-    { "Options to stream data remotely", &g_long_opts[13],
-        "When remote is InfluxDB: IP address or hostname of the InfluxDB instance to send measurements to;\n"
+    { "Options to stream data remotely", &g_long_opts[23],
+        "Set the type of remote target: 'none' (default), 'influxdb', 'influxdb-udp', 'prometheus',\n"
+        "'prometheus-remote-write' or 'otlp'.\n"
+        "With 'influxdb-udp' the line protocol is sent as fire-and-forget UDP datagrams to the UDP listener of InfluxDB.\n"
+        "With 'prometheus-remote-write' data is pushed to an endpoint implementing the Prometheus remote-write API\n"
+        "(e.g. Prometheus itself, Mimir, Thanos, VictoriaMetrics), which suits short-lived containers that might\n"
+        "never be scraped; batches are retried, queued and spooled like for InfluxDB.\n"
+        "With 'otlp' data is pushed to an OpenTelemetry collector using OTLP/HTTP with protobuf encoding:\n"
+        "each section becomes an instrumentation scope, counters become cumulative Sums and all other KPIs Gauges.\n"
+        "Additional endpoints can be given as influxdb://HOST:PORT[/DBNAME], influxdb-udp://HOST:PORT,\n"
+        "prometheus-remote-write://HOST:PORT[/PATH] (the default path is " PROMETHEUS_REMOTE_WRITE_DEFAULT_PATH ") or\n"
+        "otlp://HOST:PORT[/PATH] (the default path is " OTLP_DEFAULT_PATH ");\n"
+        "this option can be repeated to write to several endpoints at once, each one with its own connection, queue\n"
+        "and spool (a subfolder of --remote-spool-dir), so that a slow endpoint does not delay the others.\n"
+        "Except for influxdb-udp, an endpoint can override --remote-queue-size and --remote-spool-dir by appending\n"
+        "?queue=BATCHES&spool=DIRECTORY[,MAX_MB], where spool=none drops the batches that do not fit its queue,\n"
+        "e.g. otlp://collector:4318?queue=16&spool=none" },
+    { "Options to stream data remotely", &g_long_opts[24],
+        "When remote is InfluxDB, Prometheus remote-write or OTLP: IP address or hostname of the server to send\n"
+        "data to;\n"
         "When remote is Prometheus: listen address, defaults to 0.0.0.0 (to accept connections from all)." },
-    { "Options to stream data remotely", &g_long_opts[14],
-        "When remote is InfluxDB: port of server;\n"
+    { "Options to stream data remotely", &g_long_opts[25],
+        "When remote is InfluxDB or Prometheus remote-write: port of server;\n"
+        "When remote is OTLP: port of server, defaults to " OTLP_DEFAULT_PORT_STR ";\n"
         "When remote is Prometheus: listen port, defaults to " CMONITOR_DEFAULT_PROMETHEUS_PORT_STR "." },
-    { "Options to stream data remotely", &g_long_opts[15],
+    { "Options to stream data remotely", &g_long_opts[26],
         "InfluxDB only: set the collector secret (by default use environment variable CMONITOR_SECRET)." },
-    { "Options to stream data remotely", &g_long_opts[16],
-        "InfluxDB only: set the InfluxDB database name (default is 'cmonitor').\n" },
+    { "Options to stream data remotely", &g_long_opts[27],
+        "InfluxDB only: set the InfluxDB database name (default is 'cmonitor')." },
+    { "Options to stream data remotely", &g_long_opts[28],
+        "InfluxDB, Prometheus remote-write and OTLP only: batch the points sent to the server using the syntax\n"
+        "POINTS[,MSEC]: a batch is sent as soon as it contains POINTS points or it is older than MSEC milliseconds\n"
+        "(defaults are " REMOTE_SENDER_DEFAULT_BATCH_POINTS_STR "," REMOTE_SENDER_DEFAULT_BATCH_MSEC_STR ")." },
+    { "Options to stream data remotely", &g_long_opts[29],
+        "InfluxDB, Prometheus remote-write and OTLP only: max number of batches kept in memory while the server is\n"
+        "unreachable (default is " REMOTE_SENDER_DEFAULT_QUEUE_BATCHES_STR ").\n"
+        "When the queue is full, the oldest batches are moved to the spool directory or dropped if no spool is set." },
+    { "Options to stream data remotely", &g_long_opts[30],
+        "InfluxDB, Prometheus remote-write and OTLP only: directory where batches that do not fit the in-memory queue\n"
+        "are saved, using the syntax DIRECTORY[,MAX_MB]. Spooled batches are sent in order once the server is\n"
+        "reachable again, also across restarts. Its size is limited to MAX_MB megabytes (default is "
+        REMOTE_SENDER_DEFAULT_SPOOL_MAX_MB_STR "); when full the oldest data is dropped." },
+    { "Options to stream data remotely", &g_long_opts[31],
+        "InfluxDB UDP only: max payload size of each datagram in bytes (default is " UDP_SENDER_DEFAULT_PAYLOAD_SIZE_STR
+        ", i.e. Ethernet MTU minus\n"
+        "headers). Records are never split across datagrams." },
+    { "Options to stream data remotely", &g_long_opts[32],
+        "Compress data with gzip: for InfluxDB and OTLP, the batches sent to the server (Content-Encoding: gzip);\n"
+        "for Prometheus, the /metrics payload, compressed once per sample and served to the scrapers\n"
+        "sending 'Accept-Encoding: gzip'." },
+    { "Options to stream data remotely", &g_long_opts[33],
+        "InfluxDB only: precision of the timestamps, one of 's', 'ms', 'us' or 'ns' (the default).\n"
+        "Coarser timestamps make the line protocol shorter. With 'influxdb-udp' the same precision must be\n"
+        "set in the configuration of the UDP listener of InfluxDB." },
+    { "Options to stream data remotely", &g_long_opts[34],
+        "Select which KPIs are sent to a given output sink, using the syntax SINK:RULE[,RULE...]\n"
+        "where SINK is 'json' (local files), 'influxdb', 'prometheus' (also for remote-write) or 'otlp' and each\n"
+        "RULE is '+' (include) or '-' (exclude) followed by SECTION_GLOB[/MEASUREMENT_GLOB]. The last matching rule\n"
+        "wins.\n"
+        "This option can be repeated once per sink. KPI families that no sink wants are not sampled at all, nor\n"
+        "are the per-task /proc files and /proc/vmstat whose KPIs are all filtered out.\n"
+        "E.g. --sink-filter=prometheus:+cgroup_*,-cgroup_tasks --sink-filter=json:-cgroup_tasks/cmd_line\n" },
+    { "Options to stream data remotely", &g_long_opts[35],
+        "Cap the number of per-task series (the 'cgroup_tasks' section) sent to a given output sink, using the\n"
+        "syntax SINK:MAX_SERIES[:pid|tgid|cmd] where SINK is 'influxdb', 'prometheus' (also for remote-write) or\n"
+        "'otlp'.\n"
+        "Only the MAX_SERIES tasks with the highest score get their own series; all the other ones are summed\n"
+        "into a single series labelled other=true. With 'tgid' or 'cmd' the tasks are first summed by process or\n"
+        "by command name, e.g. to get one series per Java process instead of one per thread.\n"
+        "Local files always contain all tasks. E.g. --sink-task-limit=prometheus:20:tgid\n" },
 
     // help
-    { "Other options", &g_long_opts[17], "Show version and exit" }, // force newline
-    { "Other options", &g_long_opts[18],
+    { "Other options", &g_long_opts[36], "Show version and exit" }, // force newline
+    { "Other options", &g_long_opts[37],
         "Enable debug mode; automatically activates --foreground mode" }, // force newline
-    { "Other options", &g_long_opts[19], "Show this help" },
+    { "Other options", &g_long_opts[38], "Show this help" },
 
     { NULL, NULL, NULL }
 };
@@ -352,10 +573,104 @@ RemoteType string2RemoteType(const std::string& str)
 #endif
     if (to_lower(str) == "influxdb")
         return REMOTE_INFLUXDB;
+    if (to_lower(str) == "influxdb-udp")
+        return REMOTE_INFLUXDB_UDP;
+    if (to_lower(str) == "prometheus-remote-write")
+        return REMOTE_PROMETHEUS_REMOTE_WRITE;
+    if (to_lower(str) == "otlp")
+        return REMOTE_OTLP;
 
     return REMOTE_INVALID;
 }
 
+bool string2RemoteEndpoint(const std::string& str, remote_endpoint_t& endpoint)
+{
+    // syntax: influxdb://HOST:PORT[/DBNAME], influxdb-udp://HOST:PORT, prometheus-remote-write://HOST:PORT[/PATH]
+    // or otlp://HOST:PORT[/PATH], where HOST can be an IPv6 address in brackets; all but influxdb-udp accept the
+    // options ?queue=BATCHES&spool=DIRECTORY[,MAX_MB]|none
+    std::string scheme, rest;
+    size_t sep = str.find("://");
+    if (sep == std::string::npos)
+        return false;
+    scheme = to_lower(str.substr(0, sep));
+    rest = str.substr(sep + 3);
+    if (scheme == "influxdb")
+        endpoint.type = REMOTE_INFLUXDB;
+    else if (scheme == "influxdb-udp")
+        endpoint.type = REMOTE_INFLUXDB_UDP;
+    else if (scheme == "prometheus-remote-write")
+        endpoint.type = REMOTE_PROMETHEUS_REMOTE_WRITE;
+    else if (scheme == "otlp")
+        endpoint.type = REMOTE_OTLP;
+    else
+        return false;
+
+    endpoint.dbname.clear();
+    endpoint.path.clear();
+    endpoint.queue_max_batches = 0;
+    endpoint.has_spool = false;
+    endpoint.spool_dir.clear();
+    endpoint.spool_max_bytes = 0;
+    size_t question = rest.find('?');
+    if (question != std::string::npos) {
+        if (endpoint.type == REMOTE_INFLUXDB_UDP)
+            return false; // datagrams are never queued
+        for (const auto& option : split_string_in_array(rest.substr(question + 1), '&')) {
+            std::string key, value, max_mb;
+            uint64_t n;
+            if (!split_string_on_first_separator(option, '=', key, value) || value.empty())
+                return false;
+            if (key == "queue") {
+                if (!string2int(value.c_str(), n) || n == 0)
+                    return false;
+                endpoint.queue_max_batches = n;
+            } else if (key == "spool") {
+                endpoint.has_spool = true;
+                if (value == "none")
+                    endpoint.spool_dir.clear();
+                else if (split_string_on_first_separator(value, ',', endpoint.spool_dir, max_mb)) {
+                    if (endpoint.spool_dir.empty() || !string2int(max_mb.c_str(), n) || n == 0)
+                        return false;
+                    endpoint.spool_max_bytes = n * 1024 * 1024;
+                } else
+                    endpoint.spool_dir = value;
+            } else
+                return false;
+        }
+        rest = rest.substr(0, question);
+    }
+
+    size_t slash = rest.find('/');
+    if (slash != std::string::npos) {
+        if (endpoint.type == REMOTE_INFLUXDB)
+            endpoint.dbname = rest.substr(slash + 1);
+        else if (endpoint.type == REMOTE_PROMETHEUS_REMOTE_WRITE || endpoint.type == REMOTE_OTLP)
+            endpoint.path = rest.substr(slash);
+        else
+            return false;
+        rest = rest.substr(0, slash);
+    }
+
+    size_t colon = rest.rfind(':');
+    if (colon == std::string::npos || colon == 0)
+        return false;
+    endpoint.address = rest.substr(0, colon);
+    if (endpoint.address.front() == '[' && endpoint.address.back() == ']')
+        endpoint.address = endpoint.address.substr(1, endpoint.address.size() - 2);
+    return !endpoint.address.empty() && string2int(rest.substr(colon + 1).c_str(), endpoint.port) && endpoint.port > 0
+        && endpoint.port < 65536;
+}
+
+OutputFormat string2OutputFormat(const std::string& str)
+{
+    if (to_lower(str) == "json")
+        return OF_JSON;
+    if (to_lower(str) == "cbor")
+        return OF_CBOR;
+
+    return OF_INVALID;
+}
+
 std::string RemoteType2string(RemoteType k)
 {
     switch (k) {
@@ -363,8 +678,14 @@ std::string RemoteType2string(RemoteType k)
         return "NONE";
     case REMOTE_INFLUXDB:
         return "InfluxDB";
+    case REMOTE_INFLUXDB_UDP:
+        return "InfluxDB-UDP";
     case REMOTE_PROMETHEUS:
         return "Prometheus";
+    case REMOTE_PROMETHEUS_REMOTE_WRITE:
+        return "Prometheus-remote-write";
+    case REMOTE_OTLP:
+        return "OTLP";
 
     default:
         return "";
@@ -508,6 +829,16 @@ void CMonitorCollectorApp::parse_args(int argc, char** argv)
 
                 m_cfg.m_nSamplingIntervalMsec = interval_sec * 1000;
             } break;
+            case 'j':
+                if (strcmp(optarg, "skip") == 0)
+                    m_cfg.m_nMissedDeadlinePolicy = MISSED_DEADLINE_SKIP;
+                else if (strcmp(optarg, "catch-up") == 0)
+                    m_cfg.m_nMissedDeadlinePolicy = MISSED_DEADLINE_CATCH_UP;
+                else {
+                    printf("Unrecognized missed deadline policy: %s\n", optarg);
+                    exit(51);
+                }
+                break;
             case 'c':
                 if (strcmp(optarg, "until-cgroup-alive") == 0)
                     m_cfg.m_nSamples = SPECIAL_NUMSAMPLES_UNTIL_CGROUP_ALIVE;
@@ -524,13 +855,29 @@ void CMonitorCollectorApp::parse_args(int argc, char** argv)
             case 'C': {
                 std::vector<std::string> tokens = split_string_in_array(optarg, ',');
                 m_cfg.m_nCollectFlags = 0;
+                m_cfg.m_mapFamilyIntervalMsec.clear();
                 for (auto token : tokens) {
-                    PerformanceKpiFamily k = string2PerformanceKpiFamily(token);
+                    std::string family = token, interval;
+                    bool has_interval = split_string_on_first_separator(token, '@', family, interval);
+                    PerformanceKpiFamily k = string2PerformanceKpiFamily(family);
                     if (k == PK_INVALID) {
-                        printf("Unrecognized performance statistics family provided: %s\n", token.c_str());
+                        printf("Unrecognized performance statistics family provided: %s\n", family.c_str());
                         exit(51);
                     }
                     m_cfg.m_nCollectFlags |= k;
+
+                    uint64_t interval_msec;
+                    if (!has_interval)
+                        continue;
+                    if (!string2duration_msec(interval, interval_msec)
+                        || interval_msec < MIN_SAMPLING_TIME_SEC * 1000) {
+                        printf("Invalid sampling interval for %s: %s. Minimum value is %fsec\n", family.c_str(),
+                            interval.c_str(), MIN_SAMPLING_TIME_SEC);
+                        exit(51);
+                    }
+                    for (unsigned int bit = 1; bit < PK_MAX; bit <<= 1)
+                        if (k & bit)
+                            m_cfg.m_mapFamilyIntervalMsec[bit] = interval_msec;
                 }
             } break;
             case 'e':
@@ -542,12 +889,30 @@ void CMonitorCollectorApp::parse_args(int argc, char** argv)
             case 'g':
                 m_cfg.m_strCGroupName = optarg;
                 break;
+            case 'G':
+                m_cfg.m_bCgroupDiscovery = true;
+                break;
+            case 'K':
+                if (!string2int(optarg, m_cfg.m_nCgroupDiscoveryMax) || m_cfg.m_nCgroupDiscoveryMax == 0) {
+                    printf("Invalid maximum number of cgroups to discover: %s\n", optarg);
+                    exit(51);
+                }
+                break;
             case 't':
                 if (!string2int(optarg, m_cfg.m_nProcessScoreThreshold)) {
                     printf("Unrecognized score threshold: %s\n", optarg);
                     exit(51);
                 }
                 break;
+            case 'N': {
+                uint64_t nthreads = 0;
+                if (!string2int(optarg, nthreads) || nthreads == 0 || nthreads > WORKER_POOL_MAX_THREADS) {
+                    printf("Invalid number of sampling threads: %s. Expected a number between 1 and %d.\n", optarg,
+                        WORKER_POOL_MAX_THREADS);
+                    exit(51);
+                }
+                m_cfg.m_nSamplingThreads = (unsigned int)nthreads;
+            } break;
             case 'M': {
                 std::string key_value = optarg;
 
@@ -561,6 +926,39 @@ void CMonitorCollectorApp::parse_args(int argc, char** argv)
 
                 m_cfg.m_mapCustomMetadata.insert(std::make_pair(key_value_tokens[0], key_value_tokens[1]));
             } break;
+            case 'y': {
+                std::string errmsg;
+                if (!m_triggers.add_rule(optarg, errmsg)) {
+                    printf("Invalid trigger rule '%s': %s\n", optarg, errmsg.c_str());
+                    exit(51);
+                }
+            } break;
+            case 'b': {
+                std::string interval, duration;
+                uint64_t interval_msec, duration_msec;
+                if (!split_string_on_first_separator(optarg, ':', interval, duration)
+                    || !string2duration_msec(interval, interval_msec) || !string2duration_msec(duration, duration_msec)
+                    || interval_msec < MIN_SAMPLING_TIME_SEC * 1000 || duration_msec == 0) {
+                    printf("Invalid trigger burst: %s. Expected INTERVAL:DURATION with a minimum interval of %fsec\n",
+                        optarg, MIN_SAMPLING_TIME_SEC);
+                    exit(51);
+                }
+                m_triggers.set_burst(interval_msec, duration_msec);
+            } break;
+            case 'w':
+                if (!string2int(optarg, m_cfg.m_nTriggerRingSamples)) {
+                    printf("Unrecognized number of samples to keep in memory: %s\n", optarg);
+                    exit(51);
+                }
+                break;
+
+            case 'x':
+                if (!string2double(optarg, m_cfg.m_dCpuBudgetPerc) || m_cfg.m_dCpuBudgetPerc <= 0
+                    || m_cfg.m_dCpuBudgetPerc > 100) {
+                    printf("Invalid CPU budget: %s. Expected a percentage of a core between 0 and 100.\n", optarg);
+                    exit(51);
+                }
+                break;
 
                 // Local data saving options
             case 'm':
@@ -571,12 +969,60 @@ void CMonitorCollectorApp::parse_args(int argc, char** argv)
 
                 // if the filename contains the JSON extension, remove it
                 size_t nchars = m_cfg.m_strOutputFilenamePrefix.size();
-                if (nchars > 5 && m_cfg.m_strOutputFilenamePrefix.substr(nchars - 5) == ".json")
+                if (nchars > 5
+                    && (m_cfg.m_strOutputFilenamePrefix.substr(nchars - 5) == ".json"
+                        || m_cfg.m_strOutputFilenamePrefix.substr(nchars - 5) == ".cbor"))
                     m_cfg.m_strOutputFilenamePrefix = m_cfg.m_strOutputFilenamePrefix.substr(0, nchars - 5);
             } break;
             case 'P':
                 m_output.enable_json_pretty_print();
+                m_cfg.m_bOutputPretty = true;
                 break;
+            case 'O': {
+                std::vector<std::string> tokens = split_string_in_array(optarg, ',');
+                m_cfg.m_nOutputFormats = 0;
+                for (auto token : tokens) {
+                    OutputFormat f = string2OutputFormat(token);
+                    if (f == OF_INVALID) {
+                        printf("Unrecognized output format provided: %s\n", token.c_str());
+                        exit(51);
+                    }
+                    m_cfg.m_nOutputFormats |= f;
+                }
+            } break;
+            case 'R': {
+                std::vector<std::string> tokens = split_string_in_array(optarg, ',');
+                if (tokens.empty() || tokens.size() > 3 || tokens[0].empty()
+                    || (tokens.size() > 1
+                        && (!string2int(tokens[1].c_str(), m_cfg.m_nShmRingSlots) || m_cfg.m_nShmRingSlots == 0
+                            || m_cfg.m_nShmRingSlots > UINT32_MAX))
+                    || (tokens.size() > 2
+                        && (!string2int(tokens[2].c_str(), m_cfg.m_nShmRingSlotKB) || m_cfg.m_nShmRingSlotKB == 0))) {
+                    printf("Invalid shared-memory ring: %s\n", optarg);
+                    exit(51);
+                }
+                m_cfg.m_strShmRingName = tokens[0];
+            } break;
+            case 'u': {
+                std::vector<std::string> tokens = split_string_in_array(optarg, ',');
+                bool valid = !tokens.empty() && tokens.size() <= 4 && !tokens[0].empty();
+                if (valid && tokens.size() > 1) {
+                    valid = tokens[1] == "json" || tokens[1] == "cbor";
+                    m_cfg.m_nStreamFormat = tokens[1] == "cbor" ? STREAM_FORMAT_CBOR : STREAM_FORMAT_NDJSON;
+                }
+                if (valid && tokens.size() > 2)
+                    valid = string2int(tokens[2].c_str(), m_cfg.m_nStreamQueueLen) && m_cfg.m_nStreamQueueLen > 0
+                        && m_cfg.m_nStreamQueueLen <= UINT32_MAX;
+                if (valid && tokens.size() > 3) {
+                    valid = tokens[3] == "skip" || tokens[3] == "disconnect";
+                    m_cfg.m_nStreamPolicy = tokens[3] == "disconnect" ? STREAM_POLICY_DISCONNECT : STREAM_POLICY_SKIP;
+                }
+                if (!valid) {
+                    printf("Invalid stream socket: %s\n", optarg);
+                    exit(51);
+                }
+                m_cfg.m_strStreamSocket = tokens[0];
+            } break;
 
                 // Remote data collector options
             case 'i':
@@ -594,7 +1040,87 @@ void CMonitorCollectorApp::parse_args(int argc, char** argv)
             case 'D':
                 m_cfg.m_strRemoteDatabaseName = optarg;
                 break;
+            case 'B': {
+                std::string points, msec;
+                uint64_t value;
+                if (!split_string_on_first_separator(optarg, ',', points, msec))
+                    points = optarg;
+                if (!string2int(points.c_str(), value) || value == 0) {
+                    printf("Invalid number of points per batch: %s\n", optarg);
+                    exit(51);
+                }
+                m_cfg.m_remoteSenderCfg.batch_max_points = value;
+                if (!msec.empty()) {
+                    if (!string2int(msec.c_str(), value)) {
+                        printf("Invalid batch delay: %s\n", optarg);
+                        exit(51);
+                    }
+                    m_cfg.m_remoteSenderCfg.batch_max_msec = value;
+                }
+            } break;
+            case 'Q': {
+                uint64_t value;
+                if (!string2int(optarg, value) || value == 0) {
+                    printf("Invalid queue size: %s\n", optarg);
+                    exit(51);
+                }
+                m_cfg.m_remoteSenderCfg.queue_max_batches = value;
+            } break;
+            case 'W': {
+                std::string dir, max_mb;
+                uint64_t value;
+                if (split_string_on_first_separator(optarg, ',', dir, max_mb)) {
+                    if (!string2int(max_mb.c_str(), value) || value == 0) {
+                        printf("Invalid spool size: %s\n", optarg);
+                        exit(51);
+                    }
+                    m_cfg.m_remoteSenderCfg.spool_max_bytes = value * 1024 * 1024;
+                } else
+                    dir = optarg;
+                m_cfg.m_remoteSenderCfg.spool_dir = dir;
+            } break;
+            case 'U':
+                if (!string2int(optarg, m_cfg.m_nRemoteUdpPayloadSize) || m_cfg.m_nRemoteUdpPayloadSize == 0
+                    || m_cfg.m_nRemoteUdpPayloadSize > UDP_SENDER_MAX_PAYLOAD_SIZE) {
+                    printf("Invalid UDP payload size: %s\n", optarg);
+                    exit(51);
+                }
+                break;
+            case 'z':
+                m_cfg.m_remoteSenderCfg.gzip = true;
+                break;
+            case 'T':
+                if (!m_output.set_influxdb_precision(optarg)) {
+                    printf("Invalid timestamp precision: %s\n", optarg);
+                    exit(51);
+                }
+                break;
+            case 'S': {
+                std::string errmsg;
+                if (!m_output.add_output_filter(optarg, errmsg)) {
+                    printf("Invalid sink filter '%s': %s\n", optarg, errmsg.c_str());
+                    exit(51);
+                }
+                m_cfg.m_vecOutputFilters.push_back(optarg);
+            } break;
+            case 'L': {
+                std::string errmsg;
+                if (!m_output.add_task_series_limit(optarg, errmsg)) {
+                    printf("Invalid sink task limit '%s': %s\n", optarg, errmsg.c_str());
+                    exit(51);
+                }
+            } break;
             case 'r': {
+                if (strstr(optarg, "://")) {
+                    remote_endpoint_t endpoint;
+                    if (!string2RemoteEndpoint(optarg, endpoint)) {
+                        printf("Invalid remote endpoint: %s\n", optarg);
+                        exit(52);
+                    }
+                    m_cfg.m_remoteEndpoints.push_back(endpoint);
+                    break;
+                }
+
                 RemoteType t = string2RemoteType(optarg);
                 if (t == REMOTE_INVALID) {
                     printf("Unrecognized remote type: %s\n", optarg);
@@ -638,6 +1164,9 @@ void CMonitorCollectorApp::parse_args(int argc, char** argv)
 
     // check arguments we just parsed:
 
+    if (m_cfg.m_nRemote == REMOTE_OTLP && !m_cfg.m_strRemoteAddress.empty() && m_cfg.m_nRemotePort == 0)
+        // the standard OTLP/HTTP port:
+        m_cfg.m_nRemotePort = OTLP_DEFAULT_PORT;
     if (!m_cfg.m_strRemoteAddress.empty() && m_cfg.m_nRemotePort <= 0) {
         printf("Option --remote-ip=%s provided but the --remote-port option was not provided\n",
             m_cfg.m_strRemoteAddress.c_str());
@@ -648,17 +1177,96 @@ void CMonitorCollectorApp::parse_args(int argc, char** argv)
         exit(54);
     }
 
+    if (m_cfg.m_strOutputFilenamePrefix == "stdout" && (m_cfg.m_nOutputFormats & OF_JSON)
+        && (m_cfg.m_nOutputFormats & OF_CBOR)) {
+        printf("Option --output-filename=stdout can be used only with a single --output-format\n");
+        exit(56);
+    }
+
     if ((m_cfg.m_nCollectFlags & PK_CGROUP_PROCESSES) && (m_cfg.m_nCollectFlags & PK_CGROUP_THREADS)) {
         printf("If --collect=cgroup_threads is provided, it is not required to provide --collect=cgroup_processes "
                "since implicitly statistics for all processes will already be collected\n");
         exit(55);
     }
 
+    // intervals not multiple of each other might require a sampling loop much faster than each of them:
+    CMonitorSamplingPlan plan;
+    if (!plan.init(m_cfg.m_nCollectFlags, m_cfg.m_nSamplingIntervalMsec, m_cfg.m_mapFamilyIntervalMsec,
+            MIN_SAMPLING_TICK_MSEC)) {
+        printf("The sampling intervals of the statistics families require sampling more often than every %lumsecs: "
+               "please use intervals that are multiple of each other\n",
+            MIN_SAMPLING_TICK_MSEC);
+        exit(51);
+    }
+
+    if (m_triggers.empty() && m_cfg.m_nTriggerRingSamples > 0) {
+        printf("Option --trigger-ring requires at least one --trigger rule\n");
+        exit(57);
+    }
+    if (!m_triggers.empty() && m_triggers.get_burst_interval_msec() >= m_cfg.m_nSamplingIntervalMsec) {
+        printf("The --trigger-burst interval must be shorter than the --sampling-interval\n");
+        exit(57);
+    }
+    if (m_cfg.m_nTriggerRingSamples > 0 && !m_cfg.m_mapFamilyIntervalMsec.empty()) {
+        printf("Option --trigger-ring cannot be used with per-family sampling intervals\n");
+        exit(57);
+    }
+
     optind = 0; /* reset getopt lib */
 
     // if some options were not provided, we'll provide good defaults:
 
     fill_with_defaults();
+
+    // resolve the cgroups to monitor now, to report errors before going in background:
+    select_cgroups();
+}
+
+void CMonitorCollectorApp::select_cgroups()
+{
+    if ((m_cfg.m_nCollectFlags & (PK_ALL_CGROUP | PK_CGROUP_THREADS)) == 0)
+        return;
+
+    if (m_cfg.m_bCgroupDiscovery) {
+        // the cgroups matching the patterns are picked from the hierarchy by init_cgroups_collectors()
+        for (const std::string& token : split_string_in_array(m_cfg.m_strCGroupName, ',')) {
+            std::string pattern = trim_string(token);
+            if (!pattern.empty() && pattern != "self")
+                m_cgroup_patterns.push_back(pattern);
+        }
+        if (m_cfg.m_nSamples == SPECIAL_NUMSAMPLES_UNTIL_CGROUP_ALIVE) {
+            printf("Option --num-samples=until-cgroup-alive cannot be used together with --cgroup-discovery\n");
+            exit(51);
+        }
+    } else {
+        if (m_cfg.m_strCGroupName.find_first_of(",*?[") == std::string::npos) {
+            // a single cgroup, or our own one: CMonitorCgroups::init() takes care of validating it
+            m_cgroup_names.push_back(m_cfg.m_strCGroupName);
+            return;
+        }
+
+        CMonitorCgroups probe(&m_cfg, &m_output);
+        if (!probe.expand_cgroup_names(m_cfg.m_strCGroupName, m_cgroup_names) || m_cgroup_names.empty()) {
+            printf("No cgroup matches --cgroup-name=%s\n", m_cfg.m_strCGroupName.c_str());
+            exit(51);
+        }
+        if (m_cgroup_names.size() == 1)
+            return;
+
+        if (std::find(m_cgroup_names.begin(), m_cgroup_names.end(), "self") != m_cgroup_names.end()) {
+            printf("The 'self' cgroup cannot be monitored together with other cgroups\n");
+            exit(51);
+        }
+    }
+
+    m_bPerCgroupOutput = true;
+    if (!m_cfg.m_remoteEndpoints.empty() || m_cfg.m_nRemote != REMOTE_NONE || !m_cfg.m_strShmRingName.empty()
+        || !m_cfg.m_strStreamSocket.empty() || m_cfg.m_strOutputFilenamePrefix == "stdout"
+        || m_cfg.m_strOutputFilenamePrefix == "none") {
+        printf("Several cgroups can be monitored (--cgroup-name=%s%s) only when saving data into local files\n",
+            m_cfg.m_strCGroupName.c_str(), m_cfg.m_bCgroupDiscovery ? " --cgroup-discovery" : "");
+        exit(51);
+    }
 }
 
 void CMonitorCollectorApp::fill_with_defaults()
@@ -684,6 +1292,24 @@ void CMonitorCollectorApp::fill_with_defaults()
         m_cfg.m_strOutputFilenamePrefix = filename;
     }
 
+    if ((m_cfg.m_nRemote == REMOTE_INFLUXDB || m_cfg.m_nRemote == REMOTE_INFLUXDB_UDP
+            || m_cfg.m_nRemote == REMOTE_PROMETHEUS_REMOTE_WRITE || m_cfg.m_nRemote == REMOTE_OTLP)
+        && !m_cfg.m_strRemoteAddress.empty() && m_cfg.m_nRemotePort != 0) {
+        // the endpoint given with --remote-ip/--remote-port comes first:
+        remote_endpoint_t endpoint;
+        endpoint.type = m_cfg.m_nRemote;
+        endpoint.address = m_cfg.m_strRemoteAddress;
+        endpoint.port = m_cfg.m_nRemotePort;
+        m_cfg.m_remoteEndpoints.insert(m_cfg.m_remoteEndpoints.begin(), endpoint);
+    }
+    for (auto& endpoint : m_cfg.m_remoteEndpoints)
+        if (endpoint.type == REMOTE_INFLUXDB && endpoint.dbname.empty())
+            endpoint.dbname = m_cfg.m_strRemoteDatabaseName;
+        else if (endpoint.type == REMOTE_PROMETHEUS_REMOTE_WRITE && endpoint.path.empty())
+            endpoint.path = PROMETHEUS_REMOTE_WRITE_DEFAULT_PATH;
+        else if (endpoint.type == REMOTE_OTLP && endpoint.path.empty())
+            endpoint.path = OTLP_DEFAULT_PATH;
+
     if (m_cfg.m_nRemote == REMOTE_PROMETHEUS && m_cfg.m_nRemotePort == 0)
         // provide a good default port:
         m_cfg.m_nRemotePort = CMONITOR_DEFAULT_PROMETHEUS_PORT;
@@ -696,14 +1322,112 @@ void CMonitorCollectorApp::fill_with_defaults()
 // Application core functions
 //------------------------------------------------------------------------------
 
-void CMonitorCollectorApp::output_sample_date_time(long loop, const std::string& utcTime)
+void CMonitorCollectorApp::output_sample_date_time(
+    CMonitorOutputFrontend& output, long loop, const std::string& utcTime)
 {
-    m_output.psection_start("timestamp");
-    m_output.pstring("UTC", utcTime.c_str());
-    m_output.plong("sample_index", loop);
+    output.psection_start("timestamp");
+    output.pstring("UTC", utcTime.c_str());
+    output.plong("sample_index", loop);
+    output.psection_end();
+}
+
+void CMonitorCollectorApp::output_scheduler_stats()
+{
+    const sampling_scheduler_stats_t& stats = m_scheduler.get_stats();
+    m_output.psection_start("cmonitor_scheduler");
+    m_output.plong("deadlines_missed", stats.overruns);
+    m_output.plong("deadlines_skipped", stats.skipped);
+    m_output.plong("jitter_usec", stats.last_jitter_usec);
+    m_output.plong("jitter_max_usec", stats.max_jitter_usec);
+    m_output.plong("jitter_avg_usec",
+        stats.deadlines > stats.overruns ? stats.total_jitter_usec / (stats.deadlines - stats.overruns) : 0);
     m_output.psection_end();
 }
 
+CpuBudgetAction CMonitorCollectorApp::check_cpu_budget(uint64_t now_msec, bool ring_mode, uint64_t& tick)
+{
+    if (!m_cpu_budget.check(now_msec, CMonitorCpuBudget::get_process_cpu_nsec()))
+        return CPU_BUDGET_NONE;
+
+    // with --trigger-ring the sampling loop does not follow the sampling plan, see run_main_loop():
+    unsigned int task_families = m_cfg.m_nCollectFlags & (PK_CGROUP_PROCESSES | PK_CGROUP_THREADS);
+    size_t num_tasks = 0;
+    if (task_families)
+        for (const auto& cg : m_cgroups)
+            num_tasks = std::max(num_tasks, cg.collector->get_num_tasks());
+    CpuBudgetAction action
+        = m_cpu_budget.degrade(task_families && !ring_mode, num_tasks, m_cfg.m_nOutputFields == PF_ALL);
+    CMonitorLogger::instance()->LogDebug("CPU usage %.2f%% is above the budget of %.2f%%: degrading the sampling: %s",
+        m_cpu_budget.get_last_usage_perc(), m_cpu_budget.get_budget_perc(), CMonitorCpuBudget::action2string(action));
+
+    switch (action) {
+    case CPU_BUDGET_LENGTHEN_TASK_INTERVAL: {
+        std::map<unsigned int, uint64_t> family_intervals = m_cfg.m_mapFamilyIntervalMsec;
+        for (unsigned int family : { PK_CGROUP_PROCESSES, PK_CGROUP_THREADS }) {
+            if ((task_families & family) == 0)
+                continue;
+            auto it = m_cfg.m_mapFamilyIntervalMsec.find(family);
+            uint64_t interval_msec = it != m_cfg.m_mapFamilyIntervalMsec.end() ? it->second
+                                                                               : m_cfg.m_nSamplingIntervalMsec;
+            family_intervals[family] = interval_msec * m_cpu_budget.get_task_interval_factor();
+        }
+
+        uint64_t prev_tick_msec = m_sampling_plan.get_tick_msec();
+        // longer task intervals are multiples of the previous ones: the tick cannot get shorter
+        m_sampling_plan.init(
+            m_cfg.m_nCollectFlags, m_cfg.m_nSamplingIntervalMsec, family_intervals, MIN_SAMPLING_TICK_MSEC);
+        if (m_sampling_plan.get_tick_msec() != prev_tick_msec) {
+            // the tick can only get longer, when the tasks were the families sampled most often:
+            tick = tick * prev_tick_msec / m_sampling_plan.get_tick_msec();
+            if (!m_triggers.is_bursting()) // otherwise the interval is restored at the end of the burst
+                m_scheduler.set_interval(m_sampling_plan.get_tick_msec());
+        }
+    } break;
+    case CPU_BUDGET_CAP_TASKS:
+        m_cfg.m_nMaxTasks = m_cpu_budget.get_max_tasks();
+        for (auto& cg : m_cgroups)
+            if (cg.cfg)
+                cg.cfg->m_nMaxTasks = m_cfg.m_nMaxTasks;
+        break;
+    case CPU_BUDGET_DISABLE_DEEP_FIELDS:
+        m_cfg.m_nOutputFields = PF_USED_BY_CHART_SCRIPT_ONLY;
+        for (auto& cg : m_cgroups)
+            if (cg.cfg)
+                cg.cfg->m_nOutputFields = m_cfg.m_nOutputFields;
+        break;
+    case CPU_BUDGET_EXHAUSTED:
+        CMonitorLogger::instance()->LogError(
+            "CPU usage %.2f%% is above the budget of %.2f%% but the sampling cannot be degraded any further",
+            m_cpu_budget.get_last_usage_perc(), m_cpu_budget.get_budget_perc());
+        break;
+    case CPU_BUDGET_NONE:
+        break;
+    }
+    return action;
+}
+
+void CMonitorCollectorApp::output_cpu_budget(CMonitorOutputFrontend& output, CpuBudgetAction action)
+{
+    output.psection_start("cmonitor_cpu_budget");
+    output.psubsection_start("status");
+    output.pdouble("budget_perc", m_cpu_budget.get_budget_perc());
+    output.pdouble("usage_perc", m_cpu_budget.get_last_usage_perc()); // of the last window
+    output.plong("level", m_cpu_budget.get_level());
+    if (action != CPU_BUDGET_NONE)
+        output.pstring("action", CMonitorCpuBudget::action2string(action));
+    output.plong("task_interval_factor", m_cpu_budget.get_task_interval_factor());
+    output.plong("max_tasks", m_cfg.m_nMaxTasks);
+    output.plong("deep_fields", m_cfg.m_nOutputFields == PF_ALL);
+    output.psubsection_end();
+
+    // CPU time spent by the sampling thread on each KPI family of this sample:
+    output.psubsection_start("family_cost_usec");
+    for (const auto& it : m_cpu_budget.get_family_costs())
+        output.plong(performanceKpiFamily2string((PerformanceKpiFamily)it.first).c_str(), it.second / 1000);
+    output.psubsection_end();
+    output.psection_end();
+}
+
 void CMonitorCollectorApp::check_pid_file()
 {
     // immediately stop running if another instance of this software is already running.
@@ -721,20 +1445,246 @@ void CMonitorCollectorApp::check_pid_file()
     // else: this is the first instance of this software... continue
 }
 
-void CMonitorCollectorApp::do_sampling_sleep()
+uint64_t CMonitorCollectorApp::do_sampling_sleep()
 {
-    if (m_cfg.m_nSamplingIntervalMsec > 1000) {
-        // usleep() cannot sleep more than 1sec, so actually do 2 sleeps:
-        unsigned int num_secs = m_cfg.m_nSamplingIntervalMsec / 1000;
-        unsigned int num_msecs_left = (m_cfg.m_nSamplingIntervalMsec - num_secs * 1000);
-        if (sleep(num_secs) == 0)
-            usleep(num_msecs_left * 1000);
-    } else
-        usleep(m_cfg.m_nSamplingIntervalMsec * 1000);
+    // a signal interrupting the sleep makes the sampling start immediately only if we are exiting; the same
+    // happens when the cgroups monitored with --num-samples=until-cgroup-alive are gone
+    while (true) {
+        bool woken_up;
+        uint64_t elapsed_deadlines = m_scheduler.wait_next_deadline(m_cgroup_events_fd, &woken_up);
+        if (g_bExiting || elapsed_deadlines > 0)
+            return elapsed_deadlines;
+        if (woken_up) {
+            char buf[4096];
+            while (read(m_cgroup_events_fd, buf, sizeof(buf)) > 0)
+                ; // the events just tell that some "populated" key might have changed
+            if (!is_any_cgroup_alive()) {
+                CMonitorLogger::instance()->LogDebug("All the monitored cgroups are gone: taking the last sample");
+                m_bCgroupsGone = true;
+                return 0;
+            }
+        }
+    }
+}
+
+void CMonitorCollectorApp::init_cgroup_events_watch()
+{
+    // with cgroups v1 there is no notification: the main loop checks the cgroups after each sample
+    m_cgroup_events_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_cgroup_events_fd == -1)
+        return;
+    size_t nwatches = 0;
+    for (auto& cg : m_cgroups) {
+        std::string events_file = cg.collector->get_events_file();
+        if (!events_file.empty() && inotify_add_watch(m_cgroup_events_fd, events_file.c_str(), IN_MODIFY) != -1)
+            nwatches++;
+    }
+    if (nwatches != m_cgroups.size()) {
+        // the cgroups without notifications would keep us sleeping until the next deadline anyway
+        close(m_cgroup_events_fd);
+        m_cgroup_events_fd = -1;
+        return;
+    }
+    CMonitorLogger::instance()->LogDebug("Watching the cgroup.events file of %zu cgroups", nwatches);
+}
+
+bool CMonitorCollectorApp::is_any_cgroup_alive()
+{
+    return std::any_of(m_cgroups.begin(), m_cgroups.end(),
+        [](const monitored_cgroup_t& cg) -> bool { return cg.collector->cgroup_is_alive(); });
+}
+
+void CMonitorCollectorApp::disable_unwanted_kpi_families()
+{
+    // output sections produced by each KPI family:
+    static const struct {
+        PerformanceKpiFamily family;
+        std::vector<const char*> sections;
+    } family_sections[] = {
+        { PK_BAREMETAL_CPU, { "stat" } },
+        { PK_BAREMETAL_DISK, { "disks" } },
+        { PK_BAREMETAL_MEMORY, { "proc_meminfo", "proc_vmstat" } },
+        { PK_BAREMETAL_NETWORK, { "network_interfaces" } },
+        { PK_BAREMETAL_LOAD, { "proc_loadavg" } },
+        { PK_CGROUP_CPU_ACCT, { "cgroup_cpuacct_stats" } },
+        { PK_CGROUP_MEMORY, { "cgroup_memory_stats" } },
+        { PK_CGROUP_NETWORK_INTERFACES, { "cgroup_network" } },
+        { PK_CGROUP_PROCESSES, { "cgroup_tasks" } },
+        { PK_CGROUP_THREADS, { "cgroup_tasks" } },
+    };
+
+    for (const auto& fs : family_sections) {
+        if ((m_cfg.m_nCollectFlags & fs.family) == 0)
+            continue;
+
+        bool wanted = false;
+        for (const char* section : fs.sections)
+            wanted |= m_output.is_section_wanted(section);
+        if (!wanted) {
+            CMonitorLogger::instance()->LogDebug("No output sink wants the KPI family '%s': disabling its sampling",
+                performanceKpiFamily2string(fs.family).c_str());
+            m_cfg.m_nCollectFlags &= ~fs.family;
+        }
+    }
+}
+
+void CMonitorCollectorApp::init_cgroups_collectors()
+{
+    // the per-task files can be read by several threads, see --sampling-threads:
+    if ((m_cfg.m_nCollectFlags & (PK_CGROUP_PROCESSES | PK_CGROUP_THREADS))
+        && !m_task_sampling_pool.init(m_cfg.m_nSamplingThreads)) {
+        CMonitorLogger::instance()->LogError(
+            "Could not start %u threads to sample the tasks inside the cgroups. Using a single thread.\n",
+            m_cfg.m_nSamplingThreads);
+        m_task_sampling_pool.init(1);
+    }
+
+    if (m_cfg.m_bCgroupDiscovery) {
+        CMonitorCgroups probe(&m_cfg, &m_output);
+        std::string hierarchy_path;
+        if (!probe.detect_hierarchy_path(hierarchy_path) || !m_cgroup_tree.init(hierarchy_path)) {
+            CMonitorLogger::instance()->LogError("Failed to discover the cgroups of the host. CGroup mode disabled.");
+            return;
+        }
+        std::vector<std::string> selected;
+        select_discovered_cgroups(m_cgroup_tree.get_cgroups(),
+            std::set<std::string>(m_cgroup_names.begin(), m_cgroup_names.end()), true, selected);
+        m_cgroup_names.insert(m_cgroup_names.end(), selected.begin(), selected.end());
+        CMonitorLogger::instance()->LogDebug(
+            "Discovered %zu cgroups, %zu to monitor", m_cgroup_tree.get_num_cgroups(), m_cgroup_names.size());
+    }
+
+    for (const auto& name : m_cgroup_names)
+        add_monitored_cgroup(name);
+}
+
+bool CMonitorCollectorApp::add_monitored_cgroup(const std::string& name)
+{
+    monitored_cgroup_t cg;
+    cg.name = name;
+    if (m_bPerCgroupOutput) {
+        // each collector disables the KPI families it fails to read from its own cgroup only:
+        cg.cfg.reset(new CMonitorCollectorAppConfig(m_cfg));
+        cg.output.reset(new CMonitorOutputFrontend());
+    }
+
+    cg.collector.reset(new CMonitorCgroups(
+        cg.cfg ? cg.cfg.get() : &m_cfg, cg.output ? cg.output.get() : &m_output, &m_task_sampling_pool));
+    cg.collector->set_cgroup_name(name);
+    cg.collector->init(m_cfg.m_nCollectFlags & PK_CGROUP_THREADS);
+    if (m_cfg.m_bCgroupDiscovery && cg.collector->get_detected_cgroup_version() == CG_NONE)
+        return false; // e.g. removed right after its creation: the function has already logged errors
+
+    cg.collector->sample_cpuacct(0);
+    cg.collector->sample_processes(0, PF_NONE /* do not emit JSON */);
+    cg.collector->sample_processes(0, PF_NONE /* do not emit JSON */);
+    std::string baseline_time_str;
+    get_timestamp(&cg.baseline_time, baseline_time_str);
+
+    if (cg.output) {
+        // e.g. "docker/0123abcd" is saved into "<prefix>.docker_0123abcd.json"
+        std::string filename_prefix = m_cfg.m_strOutputFilenamePrefix + "." + name;
+        while (filename_prefix.back() == '/')
+            filename_prefix.pop_back();
+        replace_string(filename_prefix, "/", "_", true /* allOccurrences */);
+
+        // a cgroup removed and then recreated with the same name (e.g. a restarted service) must not overwrite
+        // the samples of its previous instance: each new instance gets its own files, "<prefix>.<cgroup>.N.json"
+        if (++m_cgroup_output_instances[filename_prefix] > 1)
+            filename_prefix = get_unused_filename_prefix(filename_prefix, { ".json", ".cbor" });
+
+        if (m_cfg.m_bOutputPretty)
+            cg.output->enable_json_pretty_print();
+        if (!m_triggers.empty()) {
+            cg.output->enable_kpi_lookup();
+            cg.output->init_sample_ring(m_cfg.m_nTriggerRingSamples);
+        }
+        for (const auto& filter : m_cfg.m_vecOutputFilters) {
+            std::string errmsg;
+            cg.output->add_output_filter(filter, errmsg); // already validated by parse_args()
+        }
+        if (((m_cfg.m_nOutputFormats & OF_JSON) && !cg.output->init_json_output_file(filename_prefix))
+            || ((m_cfg.m_nOutputFormats & OF_CBOR) && !cg.output->init_cbor_output_file(filename_prefix))) {
+            // e.g. too many open files: the other cgroups keep being monitored
+            CMonitorLogger::instance()->LogError(
+                "Cannot save the statistics of cgroup %s: not monitoring it", name.c_str());
+            return false;
+        }
+
+        // the output files of each cgroup describe just the cgroup:
+        CMonitorHeaderInfo header_info_generator(cg.cfg.get(), cg.output.get());
+        cg.output->pheader_start();
+        header_info_generator.header_cmonitor_info(
+            m_argc, m_argv, m_cfg.m_nSamplingIntervalMsec, m_cfg.m_nSamples, m_cfg.m_nCollectFlags);
+        header_info_generator.header_identity();
+        cg.collector->output_config();
+        header_info_generator.header_custom_metadata();
+        cg.output->push_header();
+    }
+
+    m_cgroups.push_back(std::move(cg));
+    return true;
+}
+
+void CMonitorCollectorApp::update_discovered_cgroups()
+{
+    std::vector<std::string> added, removed;
+    if (!m_cgroup_tree.update(added, removed))
+        return;
+
+    for (const auto& name : removed) {
+        auto it = std::find_if(m_cgroups.begin(), m_cgroups.end(),
+            [&name](const monitored_cgroup_t& cg) -> bool { return cg.name == name; });
+        if (it == m_cgroups.end())
+            continue;
+        CMonitorLogger::instance()->LogDebug("Cgroup %s has been removed: stopped monitoring it", name.c_str());
+        it->output->psample_array_end();
+        it->output->close();
+        m_cgroups.erase(it);
+    }
+
+    // the removals free some slots for the cgroups refused because of --cgroup-discovery-max: all the cgroups of
+    // the tree are considered again then, otherwise only the new ones can be worth monitoring
+    std::set<std::string> monitored;
+    for (const auto& cg : m_cgroups)
+        monitored.insert(cg.name);
+    std::vector<std::string> selected;
+    bool whole_tree = m_bCgroupDiscoveryMaxReached && !removed.empty();
+    select_discovered_cgroups(whole_tree ? m_cgroup_tree.get_cgroups() : added, monitored, whole_tree, selected);
+
+    // the new cgroups get their first reading now and are emitted starting from the next sample:
+    for (const auto& name : selected) {
+        if (!add_monitored_cgroup(name))
+            continue;
+        CMonitorLogger::instance()->LogDebug("Started monitoring the cgroup %s", name.c_str());
+        m_cgroups.back().output->psample_array_start();
+    }
+}
+
+void CMonitorCollectorApp::select_discovered_cgroups(const std::vector<std::string>& candidates,
+    const std::set<std::string>& monitored, bool whole_tree, std::vector<std::string>& selectedOUT)
+{
+    // each cgroup keeps several files open and is sampled at each interval:
+    bool all_selected = m_cgroup_tree.select_cgroups_to_monitor(
+        candidates, m_cgroup_patterns, monitored, m_cfg.m_nCgroupDiscoveryMax, selectedOUT);
+    if (all_selected) {
+        // only a look at the whole tree tells that no cgroup is waiting for a slot anymore:
+        if (whole_tree)
+            m_bCgroupDiscoveryMaxReached = false;
+        return;
+    }
+    if (!m_bCgroupDiscoveryMaxReached)
+        CMonitorLogger::instance()->LogError("Reached the --cgroup-discovery-max limit of %lu cgroups: not monitoring "
+                                             "the other cgroups until some of the monitored ones are removed",
+            m_cfg.m_nCgroupDiscoveryMax);
+    m_bCgroupDiscoveryMaxReached = true;
 }
 
 void CMonitorCollectorApp::init_collector(int argc, char** argv)
 {
+    m_argc = argc;
+    m_argv = argv;
+
     // if only one instance allowed, do the check:
     if (!m_cfg.m_bAllowMultipleInstances)
         check_pid_file();
@@ -781,22 +1731,74 @@ void CMonitorCollectorApp::init_collector(int argc, char** argv)
 #endif
 
     // init the output channels:
-    m_output.init_json_output_file(m_cfg.m_strOutputFilenamePrefix);
-    if (!m_cfg.m_strRemoteAddress.empty() && m_cfg.m_nRemotePort != 0 && m_cfg.m_nRemote == REMOTE_INFLUXDB) {
-        // We are attempting to send the data remotely
-        m_output.init_influxdb_connection(m_cfg.m_strRemoteAddress, m_cfg.m_nRemotePort, m_cfg.m_strRemoteDatabaseName);
+    if ((m_cfg.m_nOutputFormats & OF_JSON) && !m_output.init_json_output_file(m_cfg.m_strOutputFilenamePrefix)) {
+        fprintf(stderr, "Failed to open the JSON output file. Aborting.\n");
+        exit(13);
+    }
+    if ((m_cfg.m_nOutputFormats & OF_CBOR) && !m_output.init_cbor_output_file(m_cfg.m_strOutputFilenamePrefix)) {
+        fprintf(stderr, "Failed to open the CBOR output file. Aborting.\n");
+        exit(13);
+    }
+    if (!m_cfg.m_strShmRingName.empty()
+        && !m_output.init_shm_ring(
+            m_cfg.m_strShmRingName, m_cfg.m_nShmRingSlots, m_cfg.m_nShmRingSlotKB * 1024)) {
+        fprintf(stderr, "Failed to create the shared-memory ring %s. Aborting.\n", m_cfg.m_strShmRingName.c_str());
+        exit(13);
+    }
+    if (!m_cfg.m_strStreamSocket.empty()
+        && !m_output.init_stream_socket(
+            m_cfg.m_strStreamSocket, m_cfg.m_nStreamFormat, m_cfg.m_nStreamQueueLen, m_cfg.m_nStreamPolicy)) {
+        fprintf(stderr, "Failed to listen on the stream socket %s. Aborting.\n", m_cfg.m_strStreamSocket.c_str());
+        exit(14);
+    }
+    // We are attempting to send the data remotely: each endpoint gets its own connection and queue
+    size_t num_http_endpoints = std::count_if(m_cfg.m_remoteEndpoints.begin(), m_cfg.m_remoteEndpoints.end(),
+        [](const remote_endpoint_t& e) -> bool { return e.type != REMOTE_INFLUXDB_UDP; });
+    for (const auto& endpoint : m_cfg.m_remoteEndpoints) {
+        if (endpoint.type != REMOTE_INFLUXDB_UDP) {
+            remote_sender_config_t sender_cfg = m_cfg.m_remoteSenderCfg;
+            if (endpoint.queue_max_batches)
+                sender_cfg.queue_max_batches = endpoint.queue_max_batches;
+            if (endpoint.has_spool) {
+                // a spool of its own, or none at all to drop the batches that do not fit the queue:
+                sender_cfg.spool_dir = endpoint.spool_dir;
+                if (endpoint.spool_max_bytes)
+                    sender_cfg.spool_max_bytes = endpoint.spool_max_bytes;
+            } else if (!sender_cfg.spool_dir.empty() && num_http_endpoints > 1) {
+                // each endpoint replays its own backlog: give each one a subfolder of the spool directory
+                mkdir(sender_cfg.spool_dir.c_str(), 0755);
+                sender_cfg.spool_dir += fmt::format("/{}_{}_{}", endpoint.address, endpoint.port,
+                    endpoint.type == REMOTE_INFLUXDB         ? endpoint.dbname
+                        : endpoint.type == REMOTE_OTLP ? "otlp"
+                                                       : "remote_write");
+            }
+            if (endpoint.type == REMOTE_INFLUXDB)
+                m_output.init_influxdb_connection(endpoint.address, endpoint.port, endpoint.dbname, sender_cfg);
+            else if (endpoint.type == REMOTE_OTLP)
+                m_output.init_otlp_connection(
+                    endpoint.address, endpoint.port, endpoint.path, m_cfg.m_mapCustomMetadata, sender_cfg);
+            else
+                m_output.init_prometheus_remote_write_connection(
+                    endpoint.address, endpoint.port, endpoint.path, m_cfg.m_mapCustomMetadata, sender_cfg);
+        } else
+            m_output.init_influxdb_udp_connection(endpoint.address, endpoint.port, m_cfg.m_nRemoteUdpPayloadSize);
     }
 #ifdef PROMETHEUS_SUPPORT
-    // initialize prometheus exposer to scrape the registry on incoming HTTP requests
-    // IMPORTANT: for some reason cmonitor_collector will deadlock (inside CivetServer used by prometheus client
-    // library) if prometheus server is initialized BEFORE daemonization happens, so it's important to run this
-    // initialization step AFTER the fork()
+    // start the built-in HTTP server answering Prometheus scrapes;
+    // NOTE: this must happen AFTER the fork() since threads do not survive it
     if (!m_cfg.m_strRemoteAddress.empty() && m_cfg.m_nRemotePort != 0 && m_cfg.m_nRemote == REMOTE_PROMETHEUS) {
-        auto listenAddress = m_cfg.m_strRemoteAddress + ":" + std::to_string(m_cfg.m_nRemotePort);
-        m_output.init_prometheus_connection(listenAddress, m_cfg.m_mapCustomMetadata);
+        if (!m_output.init_prometheus_connection(m_cfg.m_strRemoteAddress, m_cfg.m_nRemotePort,
+                m_cfg.m_mapCustomMetadata, m_cfg.m_remoteSenderCfg.gzip)) {
+            fprintf(stderr, "Failed to listen for Prometheus scrapes on %s:%u. Aborting.\n",
+                m_cfg.m_strRemoteAddress.c_str(), (unsigned int)m_cfg.m_nRemotePort);
+            exit(12);
+        }
     }
 #endif
 
+    // KPI families whose sections are filtered out for all enabled sinks are not even sampled:
+    disable_unwanted_kpi_families();
+
     bool bCollectCGroupInfo = // force newline
         (m_cfg.m_nCollectFlags & PK_CGROUP_CPU_ACCT) || // force newline
         (m_cfg.m_nCollectFlags & PK_CGROUP_MEMORY) || // force newline
@@ -808,7 +1810,7 @@ void CMonitorCollectorApp::init_collector(int argc, char** argv)
     // if (bCollectCGroupInfo)
     // if cgroup monitoring is enabled we assume the user is interested in the CPU usage, computed from system-wide
     // statistic files, only of the CPUs that can be used by the cgroup-under-monitor:
-    // m_system_collector.set_monitored_cpus(m_cgroups_collector.get_cgroup_cpus());
+    // m_system_collector.set_monitored_cpus(m_cgroups[0].collector->get_cgroup_cpus());
 
     // INIT SYSTEM/BAREMETAL STATS COLLECTOR
     m_system_collector.init();
@@ -817,22 +1819,28 @@ void CMonitorCollectorApp::init_collector(int argc, char** argv)
     m_system_collector.sample_net_dev(0, PF_NONE /* do not emit JSON data */);
     m_system_collector.get_list_monitored_files(monitoredFiles);
 
-    // INIT CGROUP STATS COLLECTOR
+    // INIT CGROUP STATS COLLECTORS
     if (bCollectCGroupInfo) {
-        m_cgroups_collector.init(m_cfg.m_nCollectFlags & PK_CGROUP_THREADS);
-
-        m_cgroups_collector.sample_cpuacct(0);
-        m_cgroups_collector.sample_processes(0, PF_NONE /* do not emit JSON */);
-        m_cgroups_collector.sample_processes(0, PF_NONE /* do not emit JSON */);
-
-        m_cgroups_collector.get_list_monitored_files(monitoredFiles);
+        init_cgroups_collectors();
+        for (auto& cg : m_cgroups)
+            cg.collector->get_list_monitored_files(monitoredFiles);
+        if (m_cfg.m_nSamples == SPECIAL_NUMSAMPLES_UNTIL_CGROUP_ALIVE && !m_cgroups.empty())
+            init_cgroup_events_watch();
     }
+    std::string baseline_time_str;
+    get_timestamp(&m_baseline_time, baseline_time_str);
 
     // debug info
     monitoredFiles.erase(""); // remove empty string in case it was added by mistake
     CMonitorLogger::instance()->LogDebug("List of continuosly-open monitored files (%zu): %s", monitoredFiles.size(),
         stl_container2string(monitoredFiles, ", ").c_str());
 
+    // the trigger rules might need the KPIs of the header, e.g. the cgroup limits:
+    if (!m_triggers.empty()) {
+        m_output.enable_kpi_lookup();
+        m_output.init_sample_ring(m_cfg.m_nTriggerRingSamples);
+    }
+
     // HEADER GENERATION:
     // write stuff that is present only in the very first sample (never changes):
     m_output.pheader_start();
@@ -844,91 +1852,312 @@ void CMonitorCollectorApp::init_collector(int argc, char** argv)
     m_header_info_generator.header_proc_meminfo();
     m_header_info_generator.header_proc_cpuinfo();
     m_header_info_generator.header_sys_devices_numa_nodes();
-    if (bCollectCGroupInfo)
-        m_cgroups_collector.output_config(); // needs to run _BEFORE_ lscpu() and proc_cpuinfo()
+    if (!m_bPerCgroupOutput && !m_cgroups.empty())
+        m_cgroups[0].collector->output_config(); // needs to run _BEFORE_ lscpu() and proc_cpuinfo()
     m_header_info_generator.header_lshw();
     m_header_info_generator.header_custom_metadata();
     m_output.push_header();
 
-    // first time just sleep() a bit so the first snapshot has some real-ish data
-    if (m_cfg.m_nSamplingIntervalMsec <= 60000) {
+    // first time just sleep a bit so the first snapshot has some real-ish data; if there is a long time between
+    // snapshots do a quick one after 60secs so we have one in the bank. All the next samples are then scheduled
+    // at regular intervals from the first one.
+    m_sampling_plan.init(m_cfg.m_nCollectFlags, m_cfg.m_nSamplingIntervalMsec, m_cfg.m_mapFamilyIntervalMsec,
+        MIN_SAMPLING_TICK_MSEC); // already validated by parse_args()
+    if (m_sampling_plan.is_multi_rate())
         CMonitorLogger::instance()->LogDebug(
-            "Sleeping for the first sampling interval=%lumsecs", m_cfg.m_nSamplingIntervalMsec);
-        do_sampling_sleep();
-    } else {
-        CMonitorLogger::instance()->LogDebug("Sleeping for the first sampling interval=60secs");
-        sleep(60); // if a long time between snapshot do a quick one now so we have one in the bank
-    }
+            "KPI families have different sampling intervals: sampling loop runs every %lumsecs",
+            m_sampling_plan.get_tick_msec());
+
+    // with --trigger-ring the sampling loop always runs at the burst interval, see run_main_loop()
+    uint64_t loop_interval_msec = m_cfg.m_nTriggerRingSamples > 0 ? m_triggers.get_burst_interval_msec()
+                                                                   : m_sampling_plan.get_tick_msec();
+    uint64_t first_delay_msec = std::min(loop_interval_msec, (uint64_t)60000);
+    CMonitorLogger::instance()->LogDebug("Sleeping for the first sampling interval=%lumsecs", first_delay_msec);
+    m_scheduler.init(loop_interval_msec, m_cfg.m_nMissedDeadlinePolicy);
+    m_scheduler.start(first_delay_msec);
+    if (m_cfg.m_dCpuBudgetPerc > 0)
+        m_cpu_budget.init(m_cfg.m_dCpuBudgetPerc, m_cfg.m_nSamplingIntervalMsec);
+    do_sampling_sleep();
 }
 
 int CMonitorCollectorApp::run_main_loop()
 {
+    // selected again if --cpu-budget disables the deep fields while running:
     std::set<std::string> charted_stats_from_meminfo;
-    if (m_cfg.m_nOutputFields == PF_USED_BY_CHART_SCRIPT_ONLY) {
-        charted_stats_from_meminfo.insert("MemTotal");
-        charted_stats_from_meminfo.insert("MemFree");
-        charted_stats_from_meminfo.insert("Cached");
-    }
-    // else: leave empty
-
     std::set<std::string> charted_stats_from_cgroup_memory_v1, charted_stats_from_cgroup_memory_v2;
-    if (m_cfg.m_nOutputFields == PF_USED_BY_CHART_SCRIPT_ONLY) {
-        // cgroups v1
-        charted_stats_from_cgroup_memory_v1.insert("stat.cache");
-        charted_stats_from_cgroup_memory_v1.insert("stat.rss");
-        charted_stats_from_cgroup_memory_v1.insert("failcnt");
-        // cgroups v2
-        charted_stats_from_cgroup_memory_v2.insert("stat.anon");
-        charted_stats_from_cgroup_memory_v2.insert("stat.file");
-        charted_stats_from_cgroup_memory_v2.insert("events.oom_kill");
-    }
-    // else: leave empty
+    auto select_charted_stats = [&]() {
+        if (m_cfg.m_nOutputFields == PF_USED_BY_CHART_SCRIPT_ONLY) {
+            charted_stats_from_meminfo.insert("MemTotal");
+            charted_stats_from_meminfo.insert("MemFree");
+            charted_stats_from_meminfo.insert("Cached");
+
+            // cgroups v1
+            charted_stats_from_cgroup_memory_v1.insert("stat.cache");
+            charted_stats_from_cgroup_memory_v1.insert("stat.rss");
+            charted_stats_from_cgroup_memory_v1.insert("failcnt");
+            // cgroups v2
+            charted_stats_from_cgroup_memory_v2.insert("stat.anon");
+            charted_stats_from_cgroup_memory_v2.insert("stat.file");
+            charted_stats_from_cgroup_memory_v2.insert("events.oom_kill");
+        }
+        // else: leave empty
+    };
+    select_charted_stats();
 
     double current_time;
     std::string current_time_str;
-    get_timestamp(&current_time, current_time_str);
+
+    // each KPI family computes its deltas over the time elapsed since it was last sampled; the cgroups have
+    // their own times since they might have been discovered after the start:
+    std::map<unsigned int, double> last_sample_time; // keyed by the families passed to get_elapsed()
+    auto update_last_sample_time
+        = [&](std::map<unsigned int, double>& times, double baseline_time, unsigned int families) -> double {
+        auto it = times.insert(std::make_pair(families, baseline_time)).first;
+        double elapsed = current_time - it->second;
+        it->second = current_time;
+        return elapsed;
+    };
+    auto get_elapsed = [&](unsigned int families) -> double {
+        return update_last_sample_time(last_sample_time, m_baseline_time, families);
+    };
+    auto get_cgroup_elapsed = [&](monitored_cgroup_t& cg, unsigned int families) -> double {
+        return update_last_sample_time(cg.last_sample_time, cg.baseline_time, families);
+    };
+
+    // with --trigger-ring the samples to write compute their deltas, and thus their elapsed times, against the
+    // last written sample: the state of the collectors is saved before the first held sample and restored before
+    // the next sample to write, so that the events happened during the held samples, if discarded, are not lost
+    std::map<unsigned int, double> saved_last_sample_time;
+    bool has_saved_delta_baselines = false;
+    auto save_delta_baselines = [&]() {
+        saved_last_sample_time = last_sample_time;
+        m_system_collector.save_delta_baselines();
+        for (auto& cg : m_cgroups) {
+            cg.saved_last_sample_time = cg.last_sample_time;
+            cg.has_saved_delta_baselines = true;
+            cg.collector->save_delta_baselines();
+        }
+        has_saved_delta_baselines = true;
+    };
+    auto restore_delta_baselines = [&]() {
+        last_sample_time.swap(saved_last_sample_time);
+        m_system_collector.restore_delta_baselines();
+        for (auto& cg : m_cgroups) {
+            if (!cg.has_saved_delta_baselines)
+                continue; // discovered after the last written sample
+            cg.last_sample_time.swap(cg.saved_last_sample_time);
+            cg.has_saved_delta_baselines = false;
+            cg.collector->restore_delta_baselines();
+        }
+        has_saved_delta_baselines = false;
+    };
+
+    // with --cpu-budget the CPU time spent sampling each KPI family is measured, on this thread only:
+    auto sample_family = [&](unsigned int family, auto sample) {
+        if (!m_cpu_budget.is_enabled()) {
+            sample();
+            return;
+        }
+        uint64_t start_nsec = CMonitorCpuBudget::get_thread_cpu_nsec();
+        sample();
+        m_cpu_budget.add_family_cost(family, CMonitorCpuBudget::get_thread_cpu_nsec() - start_nsec);
+    };
+    unsigned int tasks_family = (m_cfg.m_nCollectFlags & PK_CGROUP_THREADS) ? PK_CGROUP_THREADS : PK_CGROUP_PROCESSES;
 
     // start actual data samples:
     CMonitorLogger::instance()->LogDebug("Starting sampling of performance data; collect flags=%u, interval=%lumsecs",
         m_cfg.m_nCollectFlags, m_cfg.m_nSamplingIntervalMsec);
     m_output.psample_array_start();
-    double previous_time = current_time;
-    for (unsigned int loop = 0; m_cfg.m_nSamples == 0 || loop < m_cfg.m_nSamples; loop++) {
+    for (auto& cg : m_cgroups)
+        if (cg.output)
+            cg.output->psample_array_start();
+    // with --trigger-ring all the samples are taken at the burst interval: those which are not on the
+    // --sampling-interval schedule are held in memory and written only if a trigger rule fires on a later one
+    bool ring_mode = m_cfg.m_nTriggerRingSamples > 0;
+    uint64_t next_regular_msec = 0; // when the next sample on the --sampling-interval schedule is due
+    std::vector<CMonitorOutputFrontend*> pending_outputs; // the outputs with a sample to write or hold
+    uint64_t tick = 0;
+
+    // the loop counts the written samples, while the sample index counts also the held ones:
+    for (unsigned int loop = 0, sample_index = 0; m_cfg.m_nSamples == 0 || loop < m_cfg.m_nSamples; sample_index++) {
+        unsigned int due = m_sampling_plan.get_due_families(tick);
 #ifndef TEST_COLLECTOR_PERFORMANCES // when testing performances we want to push cmonitor_collector at 100% CPU usage
                                     // and then look at hotspots
-        if (loop != 0) {
-            do_sampling_sleep();
+        if (sample_index != 0) {
+            // with per-family sampling intervals there might be ticks where no family is due:
+            do {
+                // deadlines skipped because sampling took too long still move the plan forward, and the families
+                // due at the skipped ticks are sampled now:
+                uint64_t elapsed_ticks = do_sampling_sleep();
+                if (ring_mode || m_triggers.is_bursting())
+                    due = m_cfg.m_nCollectFlags; // per-family intervals do not apply at the burst interval
+                else if (elapsed_ticks > 0) {
+                    due = m_sampling_plan.get_due_families(tick + 1, tick + elapsed_ticks);
+                    tick += elapsed_ticks;
+                }
+            } while (due == 0 && !g_bExiting && !m_bCgroupsGone);
+            if (m_bCgroupsGone)
+                due = m_cfg.m_nCollectFlags; // the last sample, taken right after the cgroups became empty
         }
 #endif
-        CMonitorLogger::instance()->LogDebug("*** Starting sample %u/%lu ***", loop, m_cfg.m_nSamples);
+        CMonitorLogger::instance()->LogDebug(
+            "*** Starting sample %u/%lu; sampling families %u ***", loop, m_cfg.m_nSamples, due);
+
+        uint64_t now_msec = get_monotonic_msec();
+        bool hold = false;
+        if (ring_mode && !m_triggers.is_bursting()) {
+            hold = now_msec + m_triggers.get_burst_interval_msec() / 2 < next_regular_msec;
+            if (!hold) {
+                next_regular_msec += m_sampling_plan.get_tick_msec();
+                if (next_regular_msec <= now_msec) // first sample or back from a burst
+                    next_regular_msec = now_msec + m_sampling_plan.get_tick_msec();
+            }
+            if (hold && !has_saved_delta_baselines)
+                save_delta_baselines(); // right after the last written sample
+            else if (!hold && has_saved_delta_baselines)
+                restore_delta_baselines();
+        }
 
         // get timestamp for the new sample
-        previous_time = current_time;
         if (!get_timestamp(&current_time, current_time_str))
             continue; // failed in getting current time...
 
-        double elapsed = current_time - previous_time;
         m_output.psample_start();
 
         // always provide basic sample information like timestamp
-        output_sample_date_time(loop, current_time_str);
+        output_sample_date_time(m_output, sample_index, current_time_str);
+        output_scheduler_stats();
 
         // baremetal stats:
-        m_system_collector.sample_loadavg();
-        m_system_collector.sample_cpu_stat(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
-        m_system_collector.sample_memory(charted_stats_from_meminfo);
-        m_system_collector.sample_net_dev(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
-        m_system_collector.sample_diskstats(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
+        m_cpu_budget.start_sample();
+        if (due & PK_BAREMETAL_LOAD)
+            sample_family(PK_BAREMETAL_LOAD, [&]() { m_system_collector.sample_loadavg(); });
+        if (due & PK_BAREMETAL_CPU)
+            sample_family(PK_BAREMETAL_CPU, [&]() {
+                m_system_collector.sample_cpu_stat(
+                    get_elapsed(PK_BAREMETAL_CPU), m_cfg.m_nOutputFields /* emit JSON */);
+            });
+        if (due & PK_BAREMETAL_MEMORY)
+            sample_family(PK_BAREMETAL_MEMORY, [&]() { m_system_collector.sample_memory(charted_stats_from_meminfo); });
+        if (due & PK_BAREMETAL_NETWORK)
+            sample_family(PK_BAREMETAL_NETWORK, [&]() {
+                m_system_collector.sample_net_dev(
+                    get_elapsed(PK_BAREMETAL_NETWORK), m_cfg.m_nOutputFields /* emit JSON */);
+            });
+        if (due & PK_BAREMETAL_DISK)
+            sample_family(PK_BAREMETAL_DISK, [&]() {
+                m_system_collector.sample_diskstats(
+                    get_elapsed(PK_BAREMETAL_DISK), m_cfg.m_nOutputFields /* emit JSON */);
+            });
         // m_system_collector.sample_filesystems(); // not really useful...specially for ephemeral containers!
 
         // cgroup stats:
-        m_cgroups_collector.sample_cpuacct(elapsed);
-        m_cgroups_collector.sample_memory(charted_stats_from_cgroup_memory_v1, charted_stats_from_cgroup_memory_v2);
-        m_cgroups_collector.sample_process_list();
-        m_cgroups_collector.sample_network_interfaces(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
-        m_cgroups_collector.sample_processes(elapsed, m_cfg.m_nOutputFields /* emit JSON */);
+        for (auto& cg : m_cgroups) {
+            if (cg.output) {
+                if ((due & (PK_ALL_CGROUP | PK_CGROUP_THREADS)) == 0 || !cg.collector->cgroup_still_exists())
+                    continue;
+                cg.output->psample_start();
+                output_sample_date_time(*cg.output, sample_index, current_time_str);
+            }
+
+            if (due & PK_CGROUP_CPU_ACCT)
+                sample_family(PK_CGROUP_CPU_ACCT,
+                    [&]() { cg.collector->sample_cpuacct(get_cgroup_elapsed(cg, PK_CGROUP_CPU_ACCT)); });
+            if (due & PK_CGROUP_MEMORY)
+                sample_family(PK_CGROUP_MEMORY, [&]() {
+                    cg.collector->sample_memory(
+                        charted_stats_from_cgroup_memory_v1, charted_stats_from_cgroup_memory_v2);
+                });
+            if (due & (PK_CGROUP_PROCESSES | PK_CGROUP_THREADS | PK_CGROUP_NETWORK_INTERFACES))
+                sample_family((due & tasks_family) ? tasks_family : PK_CGROUP_NETWORK_INTERFACES,
+                    [&]() { cg.collector->sample_process_list(); });
+            if (due & PK_CGROUP_NETWORK_INTERFACES)
+                sample_family(PK_CGROUP_NETWORK_INTERFACES, [&]() {
+                    cg.collector->sample_network_interfaces(
+                        get_cgroup_elapsed(cg, PK_CGROUP_NETWORK_INTERFACES), m_cfg.m_nOutputFields /* emit JSON */);
+                });
+            if (due & (PK_CGROUP_PROCESSES | PK_CGROUP_THREADS))
+                sample_family(tasks_family, [&]() {
+                    cg.collector->sample_processes(get_cgroup_elapsed(cg, PK_CGROUP_PROCESSES | PK_CGROUP_THREADS),
+                        m_cfg.m_nOutputFields /* emit JSON */);
+                });
+
+            if (cg.output)
+                pending_outputs.push_back(cg.output.get());
+        }
 
-        m_output.push_current_sample();
+        // self-stats about remote streaming (queued/sent/dropped points, etc):
+        if (m_output.has_remote_senders())
+            m_output.pstats();
+        pending_outputs.push_back(&m_output);
+
+        // with --cpu-budget, the sampling is degraded when the collector uses too much CPU:
+        if (m_cpu_budget.is_enabled()) {
+            CpuBudgetAction action = check_cpu_budget(now_msec, ring_mode, tick);
+            if (action == CPU_BUDGET_DISABLE_DEEP_FIELDS)
+                select_charted_stats();
+            for (auto output : pending_outputs)
+                output_cpu_budget(*output, action);
+        }
+
+        // the rules are evaluated before writing the sample since, if one fires, the held samples are written first:
+        const trigger_rule_t* fired = nullptr;
+        if (!m_triggers.empty()) {
+            for (auto output : pending_outputs) {
+                const trigger_rule_t* rule = m_triggers.evaluate([output](const trigger_kpi_t& kpi, double& valueOUT) {
+                    return output->get_kpi_value(kpi.section, kpi.subsection, kpi.measurement, valueOUT);
+                });
+                if (!rule)
+                    continue;
+                output->psection_start("cmonitor_trigger");
+                output->pstring("rule", rule->text.c_str());
+                output->plong("burst_interval_msec", m_triggers.get_burst_interval_msec());
+                output->plong("held_samples", output->get_num_held_samples());
+                output->psection_end();
+                fired = rule;
+            }
+
+            switch (m_triggers.update(now_msec, fired != nullptr)) {
+            case TRIGGER_BURST_STARTED:
+                CMonitorLogger::instance()->LogDebug("Trigger rule '%s' fired: sampling every %lumsecs for %lumsecs",
+                    fired->text.c_str(), m_triggers.get_burst_interval_msec(), m_triggers.get_burst_duration_msec());
+                if (!ring_mode)
+                    m_scheduler.set_interval(m_triggers.get_burst_interval_msec());
+                break;
+            case TRIGGER_BURST_ENDED:
+                CMonitorLogger::instance()->LogDebug("Burst sampling ended");
+                if (!ring_mode)
+                    m_scheduler.set_interval(m_sampling_plan.get_tick_msec());
+                break;
+            case TRIGGER_BURST_EXTENDED:
+            case TRIGGER_NONE:
+                break;
+            }
+            if (fired)
+                hold = false;
+        }
+
+        for (auto output : pending_outputs) {
+            if (hold)
+                output->hold_current_sample();
+            else {
+                if (fired)
+                    output->push_held_samples(); // the lead-up to the event
+                else
+                    output->discard_held_samples(); // older than the sample being written
+                output->push_current_sample();
+            }
+        }
+        pending_outputs.clear();
+        if (!hold) {
+            loop++;
+            if (has_saved_delta_baselines) {
+                // a held sample written because a trigger rule fired: the next samples are compared with it
+                has_saved_delta_baselines = false;
+                for (auto& cg : m_cgroups)
+                    cg.has_saved_delta_baselines = false;
+            }
+        }
 
         // in debug mode provide an indication of how much optimized is cmonitor_collector:
         if (m_cfg.m_bDebug) {
@@ -939,15 +2168,26 @@ int CMonitorCollectorApp::run_main_loop()
                     "Sampling time was %.3fmsec", (time_after_sampling - current_time) * 1000);
         }
 
+        if (m_cfg.m_bCgroupDiscovery)
+            update_discovered_cgroups();
+
         if (g_bExiting)
             break; // graceful exit allows to produce a valid JSON on SIGTERM signals!
-        if (m_cfg.m_nSamples == SPECIAL_NUMSAMPLES_UNTIL_CGROUP_ALIVE && !m_cgroups_collector.cgroup_still_exists())
+        if (m_cfg.m_nSamples == SPECIAL_NUMSAMPLES_UNTIL_CGROUP_ALIVE && (m_bCgroupsGone || !is_any_cgroup_alive()))
             break;
     }
 
     /* finish-of */
     m_output.psample_array_end();
     m_output.close();
+    if (m_cgroup_events_fd != -1)
+        close(m_cgroup_events_fd);
+    for (auto& cg : m_cgroups) {
+        if (cg.output) {
+            cg.output->psample_array_end();
+            cg.output->close();
+        }
+    }
     fflush(NULL);
 
     CMonitorLogger::instance()->LogDebug("Exiting gracefully with return code 0. Logged %lu errors in this run.",
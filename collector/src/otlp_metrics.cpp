@@ -0,0 +1,132 @@
+/*
+ * otlp_metrics.cpp -- encoder for the OpenTelemetry OTLP/HTTP metrics protocol
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "otlp_metrics.h"
+#include "protobuf_wire.h"
+#include <string.h>
+
+// ----------------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------------
+
+#define OTLP_AGGREGATION_TEMPORALITY_CUMULATIVE (2)
+
+// ----------------------------------------------------------------------------------
+// OTLP messages
+// ----------------------------------------------------------------------------------
+
+void otlp_append_attribute(std::string& out, unsigned int field, const std::string& key, const std::string& value)
+{
+    size_t any_value_size = 1 + pb_varint_size(value.size()) + value.size();
+    size_t key_value_size = 1 + pb_varint_size(key.size()) + key.size() + 1 + pb_varint_size(any_value_size)
+        + any_value_size;
+
+    out.push_back(PB_TAG(field, PB_WIRE_LEN));
+    pb_append_varint(out, key_value_size);
+    pb_append_len_field(out, 1, key); // KeyValue.key
+    out.push_back(PB_TAG(2, PB_WIRE_LEN)); // KeyValue.value
+    pb_append_varint(out, any_value_size);
+    pb_append_len_field(out, 1, value); // AnyValue.string_value
+}
+
+static void append_data_point(std::string& out, const std::string& encoded_attributes, uint64_t start_time_nsec,
+    uint64_t time_nsec, unsigned int value_field, uint64_t value_bits)
+{
+    size_t data_point_size = encoded_attributes.size() + (start_time_nsec ? 1 + 8 : 0) + 1 + 8 + 1 + 8;
+
+    out.push_back(PB_TAG(1, PB_WIRE_LEN)); // Gauge/Sum.data_points
+    pb_append_varint(out, data_point_size);
+    out += encoded_attributes;
+    if (start_time_nsec) {
+        out.push_back(PB_TAG(2, PB_WIRE_FIXED64)); // NumberDataPoint.start_time_unix_nano
+        pb_append_fixed64(out, start_time_nsec);
+    }
+    out.push_back(PB_TAG(3, PB_WIRE_FIXED64)); // NumberDataPoint.time_unix_nano
+    pb_append_fixed64(out, time_nsec);
+    out.push_back(PB_TAG(value_field, PB_WIRE_FIXED64));
+    pb_append_fixed64(out, value_bits);
+}
+
+void otlp_append_data_point(std::string& out, const std::string& encoded_attributes, uint64_t start_time_nsec,
+    uint64_t time_nsec, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    append_data_point(out, encoded_attributes, start_time_nsec, time_nsec, 4 /* as_double */, bits);
+}
+
+void otlp_append_data_point(std::string& out, const std::string& encoded_attributes, uint64_t start_time_nsec,
+    uint64_t time_nsec, int64_t value)
+{
+    append_data_point(out, encoded_attributes, start_time_nsec, time_nsec, 6 /* as_int */, (uint64_t)value);
+}
+
+void otlp_append_metric(std::string& out, const std::string& name, const char* description, bool is_counter,
+    const std::string& encoded_data_points)
+{
+    size_t description_len = description ? strlen(description) : 0;
+    size_t data_size = encoded_data_points.size() + (is_counter ? 2 + 2 : 0);
+    size_t metric_size = 1 + pb_varint_size(name.size()) + name.size() + 1 + pb_varint_size(data_size) + data_size;
+    if (description_len)
+        metric_size += 1 + pb_varint_size(description_len) + description_len;
+
+    out.push_back(PB_TAG(2, PB_WIRE_LEN)); // ScopeMetrics.metrics
+    pb_append_varint(out, metric_size);
+    pb_append_len_field(out, 1, name); // Metric.name
+    if (description_len)
+        pb_append_len_field(out, 2, description, description_len); // Metric.description
+    out.push_back(PB_TAG(is_counter ? 7 : 5, PB_WIRE_LEN)); // Metric.sum or Metric.gauge
+    pb_append_varint(out, data_size);
+    out += encoded_data_points;
+    if (is_counter) {
+        out.push_back(PB_TAG(2, PB_WIRE_VARINT)); // Sum.aggregation_temporality
+        out.push_back(OTLP_AGGREGATION_TEMPORALITY_CUMULATIVE);
+        out.push_back(PB_TAG(3, PB_WIRE_VARINT)); // Sum.is_monotonic
+        out.push_back(1);
+    }
+}
+
+void otlp_append_scope_metrics(std::string& out, const std::string& scope_name, const std::string& scope_version,
+    const std::string& encoded_metrics)
+{
+    size_t scope_size = 1 + pb_varint_size(scope_name.size()) + scope_name.size() + 1
+        + pb_varint_size(scope_version.size()) + scope_version.size();
+    size_t scope_metrics_size = 1 + pb_varint_size(scope_size) + scope_size + encoded_metrics.size();
+
+    out.push_back(PB_TAG(2, PB_WIRE_LEN)); // ResourceMetrics.scope_metrics
+    pb_append_varint(out, scope_metrics_size);
+    out.push_back(PB_TAG(1, PB_WIRE_LEN)); // ScopeMetrics.scope
+    pb_append_varint(out, scope_size);
+    pb_append_len_field(out, 1, scope_name); // InstrumentationScope.name
+    pb_append_len_field(out, 2, scope_version); // InstrumentationScope.version
+    out += encoded_metrics;
+}
+
+void otlp_append_resource_metrics(
+    std::string& out, const std::string& encoded_resource_attributes, const std::string& encoded_scope_metrics)
+{
+    size_t resource_size = encoded_resource_attributes.size();
+    size_t resource_metrics_size
+        = 1 + pb_varint_size(resource_size) + resource_size + encoded_scope_metrics.size();
+
+    out.push_back(PB_TAG(1, PB_WIRE_LEN)); // ExportMetricsServiceRequest.resource_metrics
+    pb_append_varint(out, resource_metrics_size);
+    pb_append_len_field(out, 1, encoded_resource_attributes); // ResourceMetrics.resource
+    out += encoded_scope_metrics;
+}
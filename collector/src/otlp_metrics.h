@@ -0,0 +1,85 @@
+/*
+ * otlp_metrics.h -- encoder for the OpenTelemetry OTLP/HTTP metrics protocol
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <string>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define OTLP_DEFAULT_PORT (4318)
+#define OTLP_DEFAULT_PORT_STR "4318"
+#define OTLP_DEFAULT_PATH "/v1/metrics"
+
+// binary protobuf encoding of OTLP/HTTP; JSON encoding is not supported
+#define OTLP_HEADERS "Content-Type: application/x-protobuf\r\n"
+
+// the KeyValue lists of the messages below:
+#define OTLP_RESOURCE_ATTRIBUTES_FIELD (1) // Resource.attributes
+#define OTLP_DATA_POINT_ATTRIBUTES_FIELD (7) // NumberDataPoint.attributes
+
+//------------------------------------------------------------------------------
+// OTLP metrics protobuf encoding
+//
+// An OTLP/HTTP metrics request body is an ExportMetricsServiceRequest message:
+//     message ExportMetricsServiceRequest { repeated ResourceMetrics resource_metrics = 1; }
+//     message ResourceMetrics { Resource resource = 1; repeated ScopeMetrics scope_metrics = 2; }
+//     message Resource { repeated KeyValue attributes = 1; }
+//     message ScopeMetrics { InstrumentationScope scope = 1; repeated Metric metrics = 2; }
+//     message InstrumentationScope { string name = 1; string version = 2; }
+//     message Metric { string name = 1; string description = 2; Gauge gauge = 5; Sum sum = 7; }
+//     message Gauge { repeated NumberDataPoint data_points = 1; }
+//     message Sum { repeated NumberDataPoint data_points = 1; int32 aggregation_temporality = 2;
+//                   bool is_monotonic = 3; }
+//     message NumberDataPoint { repeated KeyValue attributes = 7; fixed64 start_time_unix_nano = 2;
+//                               fixed64 time_unix_nano = 3; double as_double = 4; sfixed64 as_int = 6; }
+//     message KeyValue { string key = 1; AnyValue value = 2; }
+//     message AnyValue { string string_value = 1; ... }
+// Each function appends one field to an enclosing message, given its already-encoded contents.
+// Like for remote-write, the ResourceMetrics of each sample can simply be appended to the current
+// batch: a batch is a valid ExportMetricsServiceRequest at any time.
+//------------------------------------------------------------------------------
+
+// appends a KeyValue having a string value to the given attributes field
+void otlp_append_attribute(std::string& out, unsigned int field, const std::string& key, const std::string& value);
+
+// appends a Gauge/Sum.data_points field; start_time_nsec is omitted when zero, as done for gauges
+void otlp_append_data_point(std::string& out, const std::string& encoded_attributes, uint64_t start_time_nsec,
+    uint64_t time_nsec, double value);
+void otlp_append_data_point(std::string& out, const std::string& encoded_attributes, uint64_t start_time_nsec,
+    uint64_t time_nsec, int64_t value);
+
+// appends a ScopeMetrics.metrics field; counters become monotonic cumulative Sums, all other KPIs Gauges
+void otlp_append_metric(std::string& out, const std::string& name, const char* description, bool is_counter,
+    const std::string& encoded_data_points);
+
+// appends a ResourceMetrics.scope_metrics field
+void otlp_append_scope_metrics(std::string& out, const std::string& scope_name, const std::string& scope_version,
+    const std::string& encoded_metrics);
+
+// appends an ExportMetricsServiceRequest.resource_metrics field
+void otlp_append_resource_metrics(
+    std::string& out, const std::string& encoded_resource_attributes, const std::string& encoded_scope_metrics);
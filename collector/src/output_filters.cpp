@@ -0,0 +1,192 @@
+/*
+ * output_filters.cpp -- per-sink include/exclude filters for the output KPIs
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "output_filters.h"
+#include "utils_string.h"
+#include <fnmatch.h>
+
+// ----------------------------------------------------------------------------------
+// Helper functions
+// ----------------------------------------------------------------------------------
+
+OutputSink string2OutputSink(const std::string& str)
+{
+    if (to_lower(str) == "json" || to_lower(str) == "file")
+        return SINK_LOCAL_FILE;
+    if (to_lower(str) == "influxdb")
+        return SINK_INFLUXDB;
+    if (to_lower(str) == "prometheus")
+        return SINK_PROMETHEUS;
+    if (to_lower(str) == "otlp")
+        return SINK_OTLP;
+
+    return SINK_MAX;
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorOutputFilters
+// ----------------------------------------------------------------------------------
+
+bool CMonitorOutputFilters::add_rules(const std::string& sink_and_rules, std::string& errmsg)
+{
+    std::string sink_str, rules_str;
+    if (!split_string_on_first_separator(sink_and_rules, ':', sink_str, rules_str)) {
+        errmsg = "expected format is SINK:RULE[,RULE...]";
+        return false;
+    }
+
+    OutputSink sink = string2OutputSink(sink_str);
+    if (sink == SINK_MAX) {
+        errmsg = "unknown sink '" + sink_str + "'; valid sinks are 'json', 'influxdb', 'prometheus', 'otlp'";
+        return false;
+    }
+
+    sink_rules_t& sink_rules = m_sink_rules[sink];
+    for (const auto& token : split_string_in_array(rules_str, ',')) {
+        if (token.size() < 2 || (token[0] != '+' && token[0] != '-')) {
+            errmsg = "invalid rule '" + token + "'; each rule must be +GLOB or -GLOB";
+            return false;
+        }
+
+        filter_rule_t rule;
+        rule.include = (token[0] == '+');
+        if (!split_string_on_first_separator(token.substr(1), '/', rule.section_glob, rule.measurement_glob))
+            rule.section_glob = token.substr(1);
+        if (rule.measurement_glob == "*")
+            rule.measurement_glob.clear();
+
+        // a list starting with an include rule means "only what is explicitly included":
+        if (sink_rules.rules.empty())
+            sink_rules.default_include = !rule.include;
+        sink_rules.rules.push_back(rule);
+    }
+
+    m_has_rules = true;
+    return true;
+}
+
+bool CMonitorOutputFilters::add_task_series_limit(const std::string& sink_and_limit, std::string& errmsg)
+{
+    std::vector<std::string> tokens = split_string_in_array(sink_and_limit, ':');
+    if (tokens.size() < 2 || tokens.size() > 3) {
+        errmsg = "expected format is SINK:MAX_SERIES[:pid|tgid|cmd]";
+        return false;
+    }
+
+    OutputSink sink = string2OutputSink(tokens[0]);
+    if (sink != SINK_INFLUXDB && sink != SINK_PROMETHEUS && sink != SINK_OTLP) {
+        errmsg = "unknown sink '" + tokens[0] + "'; valid sinks are 'influxdb', 'prometheus', 'otlp'";
+        return false;
+    }
+
+    task_series_limit_t limit;
+    uint64_t max_series;
+    if (!string2int(tokens[1].c_str(), max_series) || max_series == 0 || max_series > UINT32_MAX) {
+        errmsg = "invalid number of series '" + tokens[1] + "'";
+        return false;
+    }
+    limit.max_series = (unsigned int)max_series;
+
+    std::string key = tokens.size() == 3 ? to_lower(tokens[2]) : "pid";
+    if (key == "pid")
+        limit.key = TASK_SERIES_BY_PID;
+    else if (key == "tgid")
+        limit.key = TASK_SERIES_BY_TGID;
+    else if (key == "cmd")
+        limit.key = TASK_SERIES_BY_CMD;
+    else {
+        errmsg = "invalid aggregation '" + tokens[2] + "'; valid ones are 'pid', 'tgid', 'cmd'";
+        return false;
+    }
+
+    m_task_series_limits[sink] = limit;
+    m_has_rules = true; // measurements of capped tasks are restricted to some sinks
+    return true;
+}
+
+sink_mask_t CMonitorOutputFilters::get_section_mask(const std::string& section) const
+{
+    sink_mask_t ret = 0;
+    for (unsigned int sink = 0; sink < SINK_MAX; sink++) {
+        const sink_rules_t& sink_rules = m_sink_rules[sink];
+
+        // only rules on whole sections can exclude it; an include of any measurement inside it is enough
+        // to consider it wanted
+        bool wanted = sink_rules.default_include;
+        for (const auto& rule : sink_rules.rules) {
+            if (fnmatch(rule.section_glob.c_str(), section.c_str(), 0) != 0)
+                continue;
+            if (rule.measurement_glob.empty())
+                wanted = rule.include;
+            else if (rule.include)
+                wanted = true;
+        }
+
+        if (wanted)
+            ret |= SINK_MASK(sink);
+    }
+    return ret;
+}
+
+sink_mask_t CMonitorOutputFilters::compute_measurement_mask(const std::string& section, const char* measurement) const
+{
+    sink_mask_t ret = 0;
+    for (unsigned int sink = 0; sink < SINK_MAX; sink++) {
+        const sink_rules_t& sink_rules = m_sink_rules[sink];
+
+        bool wanted = sink_rules.default_include;
+        for (const auto& rule : sink_rules.rules) {
+            if (fnmatch(rule.section_glob.c_str(), section.c_str(), 0) == 0
+                && (rule.measurement_glob.empty() || fnmatch(rule.measurement_glob.c_str(), measurement, 0) == 0))
+                wanted = rule.include;
+        }
+
+        if (wanted)
+            ret |= SINK_MASK(sink);
+    }
+    return ret;
+}
+
+uint32_t CMonitorOutputFilters::intern_section(const std::string& section)
+{
+    auto it = m_section_ids.find(section);
+    if (it != m_section_ids.end())
+        return it->second;
+
+    uint32_t id = m_sections.size();
+    m_sections.push_back(interned_section_t());
+    m_sections.back().name = section;
+    m_section_ids[section] = id;
+    return id;
+}
+
+sink_mask_t CMonitorOutputFilters::get_measurement_mask(uint32_t section_id, const char* measurement)
+{
+    interned_section_t& sec = m_sections[section_id];
+
+    auto it = sec.measurement_ids.find(measurement);
+    if (it != sec.measurement_ids.end())
+        return m_measurement_masks[it->second];
+
+    // first time this measurement is produced: compile its mask
+    uint32_t id = m_measurement_masks.size();
+    m_measurement_masks.push_back(compute_measurement_mask(sec.name, measurement));
+    sec.measurement_ids[measurement] = id;
+    return m_measurement_masks[id];
+}
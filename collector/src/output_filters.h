@@ -0,0 +1,127 @@
+/*
+ * output_filters.h -- per-sink include/exclude filters for the output KPIs
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+enum OutputSink {
+    SINK_LOCAL_FILE = 0, // JSON and/or CBOR files (or stdout)
+    SINK_INFLUXDB,
+    SINK_PROMETHEUS, // scrapes and remote-write
+    SINK_OTLP,
+
+    SINK_MAX
+};
+
+typedef uint8_t sink_mask_t;
+
+#define SINK_MASK(sink) ((sink_mask_t)(1 << (sink)))
+#define SINK_MASK_ALL ((sink_mask_t)((1 << SINK_MAX) - 1))
+
+OutputSink string2OutputSink(const std::string&);
+
+// how the per-task series of a sink are grouped before being capped:
+enum TaskSeriesKey {
+    TASK_SERIES_BY_PID = 0, // one series per process/thread
+    TASK_SERIES_BY_TGID, // one series per process: its threads are summed
+    TASK_SERIES_BY_CMD, // one series per command name
+};
+
+typedef struct {
+    unsigned int max_series = 0; // 0 means no cap
+    TaskSeriesKey key = TASK_SERIES_BY_PID;
+} task_series_limit_t;
+
+//------------------------------------------------------------------------------
+// CMonitorOutputFilters
+//
+// Each sink can be given an ordered list of include/exclude rules, e.g.
+//     prometheus:+cgroup_*
+//     influxdb:-cgroup_tasks,+cgroup_tasks/usr,+cgroup_tasks/sys
+// Every rule is a '+' (include) or '-' (exclude) followed by a section glob and an optional
+// measurement glob: SECTION_GLOB[/MEASUREMENT_GLOB]. The last matching rule wins; when no rule
+// matches a measurement, it is included unless the very first rule of the sink is an include rule.
+//
+// Rules are compiled once: every (section, measurement) pair is interned the first time it gets
+// produced and its sink bitmask is cached, so that steady-state filtering costs a single hash lookup.
+//
+// Remote sinks can also cap the number of per-task series, e.g.
+//     prometheus:20:cmd
+// keeps only the top-20 commands by score and folds all the other tasks into a single "other" series,
+// labelled other="true".
+//------------------------------------------------------------------------------
+
+class CMonitorOutputFilters {
+public:
+    CMonitorOutputFilters() { }
+
+    bool add_rules(const std::string& sink_and_rules, std::string& errmsg);
+    bool add_task_series_limit(const std::string& sink_and_limit, std::string& errmsg);
+    bool empty() const { return !m_has_rules; }
+
+    const task_series_limit_t& get_task_series_limit(OutputSink sink) const { return m_task_series_limits[sink]; }
+
+    // returns the sinks that might want at least one measurement of the given section:
+    sink_mask_t get_section_mask(const std::string& section) const;
+
+    // returns the sinks that want the given measurement, without interning it:
+    sink_mask_t compute_measurement_mask(const std::string& section, const char* measurement) const;
+
+    // interning API
+    uint32_t intern_section(const std::string& section);
+    sink_mask_t get_measurement_mask(uint32_t section_id, const char* measurement);
+
+private:
+    typedef struct {
+        bool include;
+        std::string section_glob;
+        std::string measurement_glob; // empty means "all measurements"
+    } filter_rule_t;
+
+    typedef struct {
+        bool default_include = true;
+        std::vector<filter_rule_t> rules;
+    } sink_rules_t;
+
+    typedef struct {
+        std::string name;
+        std::unordered_map<std::string, uint32_t> measurement_ids;
+    } interned_section_t;
+
+private:
+    bool m_has_rules = false;
+    sink_rules_t m_sink_rules[SINK_MAX];
+    task_series_limit_t m_task_series_limits[SINK_MAX];
+
+    std::unordered_map<std::string, uint32_t> m_section_ids;
+    std::vector<interned_section_t> m_sections; // indexed by section ID
+    std::vector<sink_mask_t> m_measurement_masks; // indexed by measurement ID
+};
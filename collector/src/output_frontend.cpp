@@ -21,16 +21,32 @@
 
 #include "output_frontend.h"
 #include "cmonitor.h"
-#include "influxdb.h"
+#include "remote_worker.h"
+#include "udp_sender.h"
 #include "logger.h"
 #include "utils_string.h"
 #include <algorithm>
+#include <atomic>
 #include <assert.h>
 #include <fmt/format.h>
-#include <netdb.h>
 #include <sys/time.h>
 #include <unistd.h>
 
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+static size_t hash_labels(const std::map<std::string, std::string>& labels)
+{
+    std::hash<std::string> hasher;
+    size_t ret = 0;
+    for (const auto& label : labels) {
+        ret = ret * 31 + hasher(label.first);
+        ret = ret * 31 + hasher(label.second);
+    }
+    return ret;
+}
+
 //------------------------------------------------------------------------------
 // Init functions
 //------------------------------------------------------------------------------
@@ -41,30 +57,60 @@ void CMonitorOutputFrontend::close()
         fclose(m_outputJson);
         m_outputJson = nullptr;
     }
-    if (m_influxdb_client_conn) {
-        delete m_influxdb_client_conn;
-        m_influxdb_client_conn = nullptr;
+    if (m_outputCbor) {
+        fclose(m_outputCbor);
+        m_outputCbor = nullptr;
     }
+    delete m_shm_ring; // readers still attached see the ring as closed
+    m_shm_ring = nullptr;
+    delete m_stream_server;
+    m_stream_server = nullptr;
+    // deleting the workers sends out what is still pending, in parallel for all endpoints:
+    for (auto conn : m_influxdb_http_conns)
+        conn->close();
+    for (auto conn : m_remote_write_conns)
+        conn->close();
+    for (auto conn : m_otlp_conns)
+        conn->close();
+    for (auto conn : m_influxdb_http_conns)
+        delete conn;
+    m_influxdb_http_conns.clear();
+    for (auto conn : m_remote_write_conns)
+        delete conn;
+    m_remote_write_conns.clear();
+    m_remote_write_labels.clear();
+    m_remote_write_series.clear();
+    for (auto conn : m_otlp_conns)
+        delete conn;
+    m_otlp_conns.clear();
+    m_otlp_resource_labels.clear();
+    m_otlp_series.clear();
+    m_otlp_metrics.clear();
+    for (auto conn : m_influxdb_udp_conns)
+        delete conn;
+    m_influxdb_udp_conns.clear();
 #ifdef PROMETHEUS_SUPPORT
+    delete m_prometheus_server; // stops serving scrapes
+    m_prometheus_server = nullptr;
+    m_prometheus_enabled = false;
+
     for (const auto& kpi : m_prometheus_kpi_map) {
         delete kpi.second;
     }
+    m_prometheus_sections.clear(); // holds pointers into the KPIs
+    m_prometheus_live_series_kpi = nullptr;
     m_prometheus_kpi_map.clear();
     m_default_labels.clear();
-
-    // finally release exposer first (which holds references to the registry):
-    m_prometheus_exposer = nullptr;
-    m_prometheus_registry = nullptr;
 #endif
 }
 
-void CMonitorOutputFrontend::init_json_output_file(const std::string& filenamePrefix)
+bool CMonitorOutputFrontend::init_json_output_file(const std::string& filenamePrefix)
 {
     if (filenamePrefix == "stdout") {
         // open stdout as FILE*
         if ((m_outputJson = fdopen(STDOUT_FILENO, "w")) == 0) {
-            perror("opening stdout for write");
-            exit(13);
+            CMonitorLogger::instance()->LogErrorWithErrno("Failed to open stdout for saving JSON output.\n");
+            return false;
         }
     } else if (filenamePrefix == "none") {
         m_outputJson = nullptr;
@@ -80,67 +126,225 @@ void CMonitorOutputFrontend::init_json_output_file(const std::string& filenamePr
         if ((m_outputJson = fopen(outFile.c_str(), "w")) == 0) {
             CMonitorLogger::instance()->LogErrorWithErrno(
                 "Failed to open %s as JSON file for saving output.\n", outFile.c_str());
-            exit(13);
+            return false;
         }
 
         printf("Opened output JSON file '%s'\n", outFile.c_str());
     }
+
+    if (m_outputJson)
+        m_enabled_sinks |= SINK_MASK(SINK_LOCAL_FILE);
+    return true;
 }
 
-std::string hostname_to_ip(const std::string& hostname)
+bool CMonitorOutputFrontend::init_cbor_output_file(const std::string& filenamePrefix)
 {
-    struct hostent* he;
-    struct in_addr** addr_list;
-    std::string ip;
-    int i;
+    if (filenamePrefix == "stdout") {
+        // open stdout as FILE*
+        if ((m_outputCbor = fdopen(STDOUT_FILENO, "w")) == 0) {
+            CMonitorLogger::instance()->LogErrorWithErrno("Failed to open stdout for saving CBOR output.\n");
+            return false;
+        }
+    } else if (filenamePrefix == "none") {
+        m_outputCbor = nullptr;
+        CMonitorLogger::instance()->LogDebug("Disabled CBOR generation (filename prefix = none)");
+    } else {
 
-    if ((he = gethostbyname(hostname.c_str())) == NULL)
-        return "";
+        std::string outFile(filenamePrefix);
+        if (filenamePrefix.size() > 5 && filenamePrefix.substr(filenamePrefix.size() - 5) != ".cbor")
+            outFile += ".cbor";
 
-    addr_list = (struct in_addr**)he->h_addr_list;
-    for (i = 0; addr_list[i] != NULL; i++) {
-        // Return the first one;
-        ip = inet_ntoa(*addr_list[i]);
-        return ip;
+        // open output files
+        if ((m_outputCbor = fopen(outFile.c_str(), "wb")) == 0) {
+            CMonitorLogger::instance()->LogErrorWithErrno(
+                "Failed to open %s as CBOR file for saving output.\n", outFile.c_str());
+            return false;
+        }
+
+        printf("Opened output CBOR file '%s'\n", outFile.c_str());
     }
 
-    return "";
+    if (m_outputCbor)
+        m_enabled_sinks |= SINK_MASK(SINK_LOCAL_FILE);
+
+    m_cbor_buffer.reserve(4096);
+    return true;
 }
 
-void CMonitorOutputFrontend::init_influxdb_connection(
-    const std::string& hostname, unsigned int port, const std::string& dbname)
+bool CMonitorOutputFrontend::init_shm_ring(const std::string& name, unsigned int num_slots, size_t max_payload)
 {
-    std::string ipaddress = hostname_to_ip(hostname);
-    if (ipaddress.empty()) {
-        char buf[1024];
-        herror(buf);
-        fprintf(stderr, "Lookup of IP address for hostname %s failed, bailing out: %s\n", hostname.c_str(), buf);
+    CMonitorShmRingWriter* ring = new CMonitorShmRingWriter();
+    if (!ring->init(name, num_slots, max_payload)) {
+        delete ring;
+        return false;
+    }
+    delete m_shm_ring;
+    m_shm_ring = ring;
+
+    CMonitorLogger::instance()->LogDebug("init_shm_ring() initialized shared-memory ring %s", ring->get_name().c_str());
+    printf("Initialized shared-memory ring %s with %u slots\n", ring->get_name().c_str(), num_slots);
+
+    // local consumers get the same KPIs of the local files:
+    m_enabled_sinks |= SINK_MASK(SINK_LOCAL_FILE);
+    return true;
+}
+
+bool CMonitorOutputFrontend::init_stream_socket(
+    const std::string& path, StreamFormat format, unsigned int max_queue_len, StreamSlowSubscriberPolicy policy)
+{
+    CMonitorStreamServer* server = new CMonitorStreamServer();
+    if (!server->init(path, max_queue_len, policy)) {
+        delete server;
+        return false;
+    }
+    delete m_stream_server;
+    m_stream_server = server;
+    m_stream_format = format;
+
+    CMonitorLogger::instance()->LogDebug("init_stream_socket() listening on %s", path.c_str());
+    printf("Streaming %s samples to the subscribers of %s\n", format == STREAM_FORMAT_CBOR ? "CBOR" : "NDJSON",
+        path.c_str());
+
+    // subscribers get the same KPIs of the local files:
+    m_enabled_sinks |= SINK_MASK(SINK_LOCAL_FILE);
+    return true;
+}
+
+void CMonitorOutputFrontend::init_influxdb_connection(const std::string& hostname, unsigned int port,
+    const std::string& dbname, const remote_sender_config_t& sender_cfg)
+{
+    // the connection itself is established lazily and kept open across samples:
+    std::string path = "/write?db=" + dbname;
+    if (!m_influxdb_precision_param.empty())
+        path += "&precision=" + m_influxdb_precision_param;
+
+    CMonitorRemoteWorker* conn = new CMonitorRemoteWorker();
+    if (!conn->init(hostname, port, path, "", sender_cfg)) {
+        fprintf(stderr, "Lookup of IP address for hostname %s failed, bailing out\n", hostname.c_str());
         exit(98);
     }
+    m_influxdb_http_conns.push_back(conn);
+
+    CMonitorLogger::instance()->LogDebug(
+        "init_influxdb_connection() initialized InfluxDB connection to %s:%d", hostname.c_str(), port);
+    printf("Initialized InfluxDB connection to %s:%d\n", hostname.c_str(), port);
 
-    m_influxdb_client_conn = new influx_client_t();
-    m_influxdb_client_conn->host = strdup(ipaddress.c_str()); // force newline
-    m_influxdb_client_conn->port = port; // force newline
-    m_influxdb_client_conn->db = strdup(dbname.c_str()); // force newline
-    m_influxdb_client_conn->usr = strdup("usr"); // force newline
-    m_influxdb_client_conn->pwd = strdup("pwd"); // force newline
+    m_enabled_sinks |= SINK_MASK(SINK_INFLUXDB);
+}
 
-    CMonitorLogger::instance()->LogDebug("init_influxdb_connection() initialized InfluxDB connection to %s:%d",
-        m_influxdb_client_conn->host, m_influxdb_client_conn->port);
-    printf("Initialized InfluxDB connection to %s:%d\n", m_influxdb_client_conn->host, m_influxdb_client_conn->port);
+bool CMonitorOutputFrontend::set_influxdb_precision(const std::string& precision)
+{
+    // the /write endpoint (InfluxDB 1.x and the 1.x compatibility API of InfluxDB 2.x) wants
+    // n, u, ms or s as precision; nanoseconds are the default and need no parameter at all
+    if (precision == "s") {
+        m_influxdb_precision_param = "s";
+        m_influxdb_ts_divisor = 1000000000;
+    } else if (precision == "ms") {
+        m_influxdb_precision_param = "ms";
+        m_influxdb_ts_divisor = 1000000;
+    } else if (precision == "us") {
+        m_influxdb_precision_param = "u";
+        m_influxdb_ts_divisor = 1000;
+    } else if (precision == "ns") {
+        m_influxdb_precision_param.clear();
+        m_influxdb_ts_divisor = 1;
+    } else
+        return false;
+    return true;
+}
+
+void CMonitorOutputFrontend::init_influxdb_udp_connection(
+    const std::string& hostname, unsigned int port, unsigned int max_payload)
+{
+    CMonitorUdpSender* conn = new CMonitorUdpSender();
+    if (!conn->init(hostname, port, max_payload)) {
+        fprintf(stderr, "Failed to create UDP socket towards %s:%u, bailing out\n", hostname.c_str(), port);
+        exit(98);
+    }
+    m_influxdb_udp_conns.push_back(conn);
+
+    CMonitorLogger::instance()->LogDebug(
+        "init_influxdb_udp_connection() initialized InfluxDB UDP socket towards %s:%u, max payload %u bytes",
+        hostname.c_str(), port, conn->get_max_payload());
+    printf("Initialized InfluxDB UDP socket towards %s:%u\n", hostname.c_str(), port);
+
+    m_enabled_sinks |= SINK_MASK(SINK_INFLUXDB);
+}
+
+void CMonitorOutputFrontend::init_prometheus_remote_write_connection(const std::string& hostname, unsigned int port,
+    const std::string& path, const std::map<std::string, std::string>& metaData,
+    const remote_sender_config_t& sender_cfg)
+{
+    // the protocol mandates snappy compression of each batch:
+    remote_sender_config_t cfg = sender_cfg;
+    cfg.gzip = false;
+    cfg.snappy = true;
+
+    CMonitorRemoteWorker* conn = new CMonitorRemoteWorker();
+    if (!conn->init(hostname, port, path, PROMETHEUS_REMOTE_WRITE_HEADERS, cfg)) {
+        fprintf(stderr, "Lookup of IP address for hostname %s failed, bailing out\n", hostname.c_str());
+        exit(98);
+    }
+    m_remote_write_conns.push_back(conn);
+
+    // the metadata provided from command line becomes labels of EACH series, like in the Prometheus pull mode;
+    // "job" and "instance" are the labels a Prometheus server would attach to scraped series:
+    m_remote_write_labels.insert(metaData.begin(), metaData.end());
+    m_remote_write_labels.insert(std::make_pair("job", "cmonitor"));
+
+    CMonitorLogger::instance()->LogDebug(
+        "init_prometheus_remote_write_connection() initialized remote-write connection to %s:%u%s", hostname.c_str(),
+        port, path.c_str());
+    printf("Initialized Prometheus remote-write connection to %s:%u%s\n", hostname.c_str(), port, path.c_str());
+
+    m_enabled_sinks |= SINK_MASK(SINK_PROMETHEUS);
+}
+
+void CMonitorOutputFrontend::init_otlp_connection(const std::string& hostname, unsigned int port,
+    const std::string& path, const std::map<std::string, std::string>& metaData,
+    const remote_sender_config_t& sender_cfg)
+{
+    // OTLP/HTTP receivers accept gzip but not snappy:
+    remote_sender_config_t cfg = sender_cfg;
+    cfg.snappy = false;
+
+    CMonitorRemoteWorker* conn = new CMonitorRemoteWorker();
+    if (!conn->init(hostname, port, path, OTLP_HEADERS, cfg)) {
+        fprintf(stderr, "Lookup of IP address for hostname %s failed, bailing out\n", hostname.c_str());
+        exit(98);
+    }
+    m_otlp_conns.push_back(conn);
+
+    // the metadata provided from command line describes the whole host: it becomes a resource attribute,
+    // like the semantic-convention ones
+    m_otlp_resource_labels.insert(metaData.begin(), metaData.end());
+    m_otlp_resource_labels.insert(std::make_pair("service.name", "cmonitor"));
+    m_otlp_resource_labels.insert(std::make_pair("service.version", VERSION_STRING));
+
+    CMonitorLogger::instance()->LogDebug("init_otlp_connection() initialized OTLP connection to %s:%u%s",
+        hostname.c_str(), port, path.c_str());
+    printf("Initialized OTLP connection to %s:%u%s\n", hostname.c_str(), port, path.c_str());
+
+    m_enabled_sinks |= SINK_MASK(SINK_OTLP);
 }
 
 #ifdef PROMETHEUS_SUPPORT
-void CMonitorOutputFrontend::init_prometheus_connection(
-    const std::string& url, const std::map<std::string, std::string>& metaData)
+bool CMonitorOutputFrontend::init_prometheus_connection(const std::string& address, unsigned int port,
+    const std::map<std::string, std::string>& metaData, bool gzip)
 {
-    m_prometheus_exposer = prometheus::detail::make_unique<prometheus::Exposer>(url);
-    m_prometheus_registry = std::make_shared<prometheus::Registry>();
-    m_prometheus_exposer->RegisterCollectable(m_prometheus_registry);
+    m_prometheus_server = new CMonitorPrometheusServer();
+    if (!m_prometheus_server->init(address, port, gzip)) {
+        delete m_prometheus_server;
+        m_prometheus_server = nullptr;
+        return false;
+    }
 
     m_prometheus_enabled = true;
-    CMonitorLogger::instance()->LogDebug("init_prometheus_connection() initialized Prometheus port to %s", url.c_str());
-    printf("Initialized Prometheus HTTP server listening at http://%s/metrics\n", url.c_str());
+    m_enabled_sinks |= SINK_MASK(SINK_PROMETHEUS);
+    CMonitorLogger::instance()->LogDebug("init_prometheus_connection() initialized Prometheus port to %s:%u",
+        address.c_str(), m_prometheus_server->get_port());
+    printf("Initialized Prometheus HTTP server listening at http://%s:%u/metrics\n", address.c_str(),
+        m_prometheus_server->get_port());
 
     // store the metadata provided from command line as Prometheus labels associated with EACH metric
     if (!metaData.empty()) {
@@ -148,27 +352,55 @@ void CMonitorOutputFrontend::init_prometheus_connection(
             m_default_labels.insert(std::make_pair(entry.first, entry.second));
         }
     }
+
+    m_prometheus_live_series_kpi = new PrometheusGauge("cmonitor_prometheus_live_series",
+        "Number of labelled time series currently exposed by cmonitor", m_default_labels);
+    m_prometheus_kpi_map.insert(std::pair<std::string, PrometheusKpi*>(
+        m_prometheus_live_series_kpi->get_kpi_name(), m_prometheus_live_series_kpi));
+    return true;
 }
 
+#endif
+
 void CMonitorOutputFrontend::init_prometheus_kpis(const prometheus_kpi_descriptor* kpi, size_t size)
 {
+    // the OTLP sink uses the descriptors to tell counters from gauges:
+    for (size_t i = 0; i < size; i++)
+        m_kpi_descriptors[kpi[i].kpi_name] = &kpi[i];
+
+#ifdef PROMETHEUS_SUPPORT
+    if (!m_prometheus_enabled)
+        return;
+
     // loop the metric list and create the prometheus KPI metrics.
     for (size_t i = 0; i < size; i++) {
         PrometheusKpi* prometheus_kpi = NULL;
-        if (kpi[i].kpi_type == prometheus::MetricType::Counter) {
-            prometheus_kpi
-                = new PrometheusCounter(m_prometheus_registry, kpi[i].kpi_name, kpi[i].description, m_default_labels);
-        } else if (kpi[i].kpi_type == prometheus::MetricType::Gauge) {
-            prometheus_kpi
-                = new PrometheusGauge(m_prometheus_registry, kpi[i].kpi_name, kpi[i].description, m_default_labels);
+        if (kpi[i].kpi_type == PrometheusKpiType::Counter) {
+            prometheus_kpi = new PrometheusCounter(kpi[i].kpi_name, kpi[i].description, m_default_labels);
+        } else if (kpi[i].kpi_type == PrometheusKpiType::Gauge) {
+            prometheus_kpi = new PrometheusGauge(kpi[i].kpi_name, kpi[i].description, m_default_labels);
         } else {
             assert(0);
         }
 
         m_prometheus_kpi_map.insert(std::pair<std::string, PrometheusKpi*>(kpi[i].kpi_name, prometheus_kpi));
     }
-}
 #endif
+}
+
+bool CMonitorOutputFrontend::is_section_wanted(const char* section) const
+{
+    if (m_filters.empty())
+        return true;
+    return (m_filters.get_section_mask(section) & m_enabled_sinks) != 0;
+}
+
+bool CMonitorOutputFrontend::is_measurement_wanted(const char* section, const char* measurement) const
+{
+    if (m_filters.empty())
+        return true;
+    return (m_filters.compute_measurement_mask(section, measurement) & m_enabled_sinks) != 0;
+}
 
 void CMonitorOutputFrontend::enable_json_pretty_print()
 {
@@ -192,18 +424,18 @@ bool CMonitorOutputFrontend::contains_char_to_escape(const char* string)
 }
 
 /* static */
-void CMonitorOutputFrontend::get_quoted_field_value(std::string& out, const char* value)
+void CMonitorOutputFrontend::append_quoted_field_value(std::string& out, const char* value)
 {
-    out.clear();
     // see https://docs.influxdata.com/influxdb/v1.7/write_protocols/line_protocol_tutorial/
     // For string field values use a backslash character \ to escape:
     // - double quotes
+    out += '"';
     for (const char* p = value; *p != '\0'; p++) {
-        if (*p == '"') {
-            out += "\\\"";
-        } else
-            out += *p;
+        if (*p == '"')
+            out += '\\';
+        out += *p;
     }
+    out += '"';
 }
 
 /* static */
@@ -229,160 +461,576 @@ void CMonitorOutputFrontend::get_quoted_tag_value(std::string& out, const char*
     }
 }
 
-std::string CMonitorOutputFrontend::generate_influxdb_line(
-    CMonitorMeasurementVector& measurements, const std::string& meas_name, const std::string& ts_nsec)
+/* static */
+void CMonitorOutputFrontend::append_escaped_measurement_name(std::string& out, const std::string& name)
 {
-    // format data according to the InfluxDB "line protocol":
     // see https://docs.influxdata.com/influxdb/v1.7/write_protocols/line_protocol_tutorial/
+    // For measurements always use a backslash character \ to escape:
+    // - commas
+    // - spaces
+    for (char c : name) {
+        if (c == ',' || c == ' ')
+            out += '\\';
+        out += c;
+    }
+}
 
-    CMonitorLogger::instance()->LogDebug("generate_influxdb_line() generating measurement: %s\n", meas_name.c_str());
-
-    std::string ret;
-    ret.reserve(1024);
+const std::string& CMonitorOutputFrontend::get_influxdb_series_prefix(
+    const CMonitorOutputSection& sec, const CMonitorOutputSubsection* subsec, const CMonitorOutputSubSubsection* subsubsec)
+{
+    static const std::map<std::string, std::string> no_labels;
+    const std::map<std::string, std::string>& subsec_labels = subsec ? subsec->m_labels : no_labels;
+    const std::map<std::string, std::string>& subsubsec_labels = subsubsec ? subsubsec->m_labels : no_labels;
+
+    // the series is identified by its position in the hierarchy; use a separator that cannot appear in names:
+    m_influxdb_series_key.assign(sec.m_name);
+    if (subsec) {
+        m_influxdb_series_key += '\x1f';
+        m_influxdb_series_key += subsec->m_name;
+    }
+    if (subsubsec) {
+        m_influxdb_series_key += '\x1f';
+        m_influxdb_series_key += subsubsec->m_name;
+    }
 
-    // Measurement
-    assert(!contains_char_to_escape(meas_name.c_str()));
-    ret += meas_name;
+    m_influxdb_sample_series++;
+    influxdb_series_t& series = m_influxdb_series[m_influxdb_series_key];
+    series.last_sample = m_influxdb_sample_idx;
+    if (!series.prefix.empty() && series.subsec_labels == subsec_labels && series.subsubsec_labels == subsubsec_labels)
+        return series.prefix; // fast path: nothing changed since last sample
+
+    // new series (or its labels changed, e.g. a PID got reused by another command): generate its prefix.
+    // Sections whose children carry labels (e.g. per-CPU, per-disk, per-process data) become a single
+    // measurement whose children are told apart by tags; otherwise the children names are part of the
+    // measurement name.
+    std::map<std::string, std::string> tags = m_influxdb_tags;
+    for (const auto& label : subsec_labels)
+        tags[label.first] = label.second;
+    for (const auto& label : subsubsec_labels)
+        tags[label.first] = label.second;
+
+    std::string meas_name = sec.m_name;
+    if (subsec && subsec_labels.empty() && subsubsec_labels.empty())
+        meas_name += "_" + subsec->m_name;
+    if (subsubsec)
+        meas_name += "_" + subsubsec->m_name;
+
+    series.subsec_labels = subsec_labels;
+    series.subsubsec_labels = subsubsec_labels;
+    series.prefix.clear();
+    append_escaped_measurement_name(series.prefix, meas_name);
 
     // Tag set
     // NOTE: unlike fields, tags are indexed and can be used to tag measurements and allow to search
-    //       for them:
-    if (!m_influxdb_tagset.empty())
-        ret += "," + m_influxdb_tagset;
+    //       for them; tags are emitted sorted by key, as recommended by InfluxDB for best write performance:
+    std::string tmp;
+    for (const auto& tag : tags) {
+        if (tag.second.empty())
+            continue; // empty tag values are not valid line protocol
+        get_quoted_tag_value(tmp, tag.first.c_str());
+        series.prefix += "," + tmp + "=";
+        get_quoted_tag_value(tmp, tag.second.c_str());
+        series.prefix += tmp;
+    }
 
     // Whitespace I
-    ret += " ";
+    series.prefix += " ";
+
+    CMonitorLogger::instance()->LogDebug(
+        "get_influxdb_series_prefix() generated prefix for new InfluxDB series: %s\n", series.prefix.c_str());
+    return series.prefix;
+}
+
+bool CMonitorOutputFrontend::append_influxdb_line(
+    const std::string& series_prefix, const CMonitorMeasurementVector& measurements, const std::string& ts)
+{
+    // format data according to the InfluxDB "line protocol":
+    // see https://docs.influxdata.com/influxdb/v1.7/write_protocols/line_protocol_tutorial/
+
+    // a line without fields is not valid line protocol:
+    if (count_measurements_for_sink(measurements, SINK_INFLUXDB) == 0)
+        return false;
+
+    std::string& buf = *m_influxdb_buffer;
+
+    // Measurement, tag set and whitespace I
+    buf += series_prefix;
 
     // Field set
-    std::string tmp;
-    tmp.reserve(256);
+    bool first = true;
     for (size_t n = 0; n < measurements.size(); n++) {
         auto& m = measurements[n];
+        if ((m.m_sinks & SINK_MASK(SINK_INFLUXDB)) == 0)
+            continue;
+
+        if (!first)
+            buf += ',';
+        first = false;
 
         // Field Name
         assert(!contains_char_to_escape(m.m_name.data()));
-        ret += m.m_name.data();
+        buf += m.m_name.data();
 
-        ret += "=";
+        buf += '=';
 
         // Field Value
         if (m.m_numeric) {
-            ret += m.m_value.data();
+            buf += m.m_value.data();
         } else {
-            get_quoted_field_value(tmp, m.m_value.data());
-
-            ret += "\"";
-            ret += tmp;
-            ret += "\"";
+            append_quoted_field_value(buf, m.m_value.data());
         }
-
-        if (n < measurements.size() - 1)
-            ret += ",";
     }
 
     // Whitespace II
-    ret += " ";
+    buf += ' ';
 
     // Timestamp
-    ret += ts_nsec;
+    buf += ts;
+    buf += '\n';
 
-    return ret;
+    return true;
 }
 
 void CMonitorOutputFrontend::push_current_sections_to_influxdb(bool is_header)
 {
     if (is_header) {
-        // instead of actually pushing something towards the InfluxDB server, generate the tagsets:
-
-        // collect tags
-        std::vector<std::pair<std::string /* tag name */, std::string /* tag value */>> tags;
+        // instead of actually pushing something towards the InfluxDB server, collect the host-wide tags:
+        m_influxdb_tags.clear();
         for (auto& sec : m_current_sections) {
             if (sec.m_name == "identity") {
-                tags.push_back(std::make_pair("hostname", sec.get_value_for_measurement("hostname")));
+                m_influxdb_tags["hostname"] = sec.get_value_for_measurement("hostname");
 
                 std::string ips = sec.get_value_for_measurement("all_ip_addresses");
                 replace_string(ips, ",", " ", true);
-                tags.push_back(std::make_pair("all_ip_addresses", ips));
+                m_influxdb_tags["all_ip_addresses"] = ips;
             } else if (sec.m_name == "os_release") {
-                tags.push_back(std::make_pair("os_name", sec.get_value_for_measurement("name")));
-                tags.push_back(std::make_pair("os_pretty_name", sec.get_value_for_measurement("pretty_name")));
+                m_influxdb_tags["os_name"] = sec.get_value_for_measurement("name");
+                m_influxdb_tags["os_pretty_name"] = sec.get_value_for_measurement("pretty_name");
             } else if (sec.m_name == "cgroup_config") {
-                tags.push_back(std::make_pair("cgroup_name", sec.get_value_for_measurement("name")));
+                m_influxdb_tags["cgroup_name"] = sec.get_value_for_measurement("name");
             } else if (sec.m_name == "lscpu") {
-                tags.push_back(std::make_pair("cpu_model_name", sec.get_value_for_measurement("model_name")));
+                m_influxdb_tags["cpu_model_name"] = sec.get_value_for_measurement("model_name");
             }
         }
 
-        // now prepare the tagset line according to the protocol:
-        //  https://docs.influxdata.com/influxdb/v1.7/write_protocols/line_protocol_tutorial/
-
-        std::string tmp;
-        for (auto& tag : tags) {
-            assert(!contains_char_to_escape(tag.first.c_str()));
-            get_quoted_tag_value(tmp, tag.second.c_str());
-
-            m_influxdb_tagset += tag.first + "=" + tmp + ",";
-        }
-
-        if (!m_influxdb_tagset.empty())
-            m_influxdb_tagset.pop_back();
-
-        CMonitorLogger::instance()->LogDebug(
-            "push_current_sections_to_influxdb() generated tagset for InfluxDB:\n %s\n", m_influxdb_tagset.c_str());
+        // all series prefixes embed these tags:
+        m_influxdb_series.clear();
 
     } else {
-        struct timeval tv;
-        gettimeofday(&tv, 0);
-        uint64_t ts_nsec = ((uint64_t)tv.tv_sec * 1E9) + ((uint64_t)tv.tv_usec * 1E3);
+        // integer math only: a double cannot represent a nanosecond timestamp exactly
+        struct timespec ts = get_current_sample_time();
+        uint64_t ts_nsec = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        uint64_t ts_value = ts_nsec / m_influxdb_ts_divisor;
 
 #if FMTLIB_MAJOR_VER >= 6
-        std::string ts_nsec_str = fmt::format_int(ts_nsec).str();
+        std::string ts_str = fmt::format_int(ts_value).str();
 #else
-        std::string ts_nsec_str = fmt::format("{}", ts_nsec);
+        std::string ts_str = fmt::format("{}", ts_value);
 #endif
 
-        std::string all_measurements;
-        all_measurements.reserve(4096);
+        // the payload of the previous samples might still be in use by the remote workers:
+        // in such case it cannot be recycled and a new one is started
+        if (!m_influxdb_buffer || m_influxdb_buffer.use_count() > 1)
+            m_influxdb_buffer = std::make_shared<std::string>();
+        else {
+            std::atomic_thread_fence(std::memory_order_acquire); // pairs with the release of the workers' references
+            m_influxdb_buffer->clear();
+        }
+
+        m_influxdb_sample_idx++;
+        m_influxdb_sample_series = 0;
+        unsigned int num_points = 0;
         for (size_t sec_idx = 0; sec_idx < m_current_sections.size(); sec_idx++) {
             auto& sec = m_current_sections[sec_idx];
             if (sec.m_measurements.empty()) {
 
                 for (size_t subsec_idx = 0; subsec_idx < sec.m_subsections.size(); subsec_idx++) {
                     auto& subsec = sec.m_subsections[subsec_idx];
+                    if ((subsec.m_sinks & SINK_MASK(SINK_INFLUXDB)) == 0)
+                        continue; // e.g. a task beyond the cardinality cap: not even its series prefix is built
                     if (subsec.m_measurements.empty()) {
                         for (size_t subsubsec_idx = 0; subsubsec_idx < subsec.m_subsubsections.size();
                              subsubsec_idx++) {
                             auto& subsubsec = subsec.m_subsubsections[subsubsec_idx];
-                            all_measurements += generate_influxdb_line(
-                                subsubsec.m_measurements, subsubsec.m_name + "_" + subsubsec.m_name, ts_nsec_str);
-
-                            if (subsubsec_idx < subsec.m_subsubsections.size() - 1)
-                                all_measurements += "\n";
+                            num_points += append_influxdb_line(get_influxdb_series_prefix(sec, &subsec, &subsubsec),
+                                subsubsec.m_measurements, ts_str);
                         }
                     } else {
-                        all_measurements += generate_influxdb_line(
-                            subsec.m_measurements, subsec.m_name + "_" + subsec.m_name, ts_nsec_str);
-
-                        if (subsec_idx < sec.m_subsections.size() - 1)
-                            all_measurements += "\n";
+                        num_points += append_influxdb_line(
+                            get_influxdb_series_prefix(sec, &subsec), subsec.m_measurements, ts_str);
                     }
                 }
 
             } else {
-                all_measurements += generate_influxdb_line(sec.m_measurements, sec.m_name, ts_nsec_str);
+                num_points
+                    += append_influxdb_line(get_influxdb_series_prefix(sec), sec.m_measurements, ts_str);
             }
+        }
 
-            if (sec_idx < m_current_sections.size() - 1)
-                all_measurements += "\n";
+        // forget the series that disappeared (e.g. processes that exited):
+        if (m_influxdb_series.size() > m_influxdb_sample_series) {
+            for (auto it = m_influxdb_series.begin(); it != m_influxdb_series.end();) {
+                if (it->second.last_sample != m_influxdb_sample_idx)
+                    it = m_influxdb_series.erase(it);
+                else
+                    ++it;
+            }
         }
 
         size_t num_measurements = get_current_sample_measurements();
         CMonitorLogger::instance()->LogDebug(
-            "push_current_sections_to_influxdb() pushing to InfluxDB %zu measurements for timestamp: %s\n",
-            num_measurements, ts_nsec_str.c_str());
+            "push_current_sections_to_influxdb() queueing for InfluxDB %zu measurements for timestamp: %s\n",
+            num_measurements, ts_str.c_str());
+
+        // lines are batched across samples: they will be POSTed once the batch is full or old enough
+        // the same payload is shared read-only by all endpoints:
+        for (auto conn : m_influxdb_http_conns)
+            conn->submit(m_influxdb_buffer, num_points);
+        for (auto conn : m_influxdb_udp_conns)
+            conn->send(*m_influxdb_buffer);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Low level Prometheus remote-write functions
+//------------------------------------------------------------------------------
+
+/* static */
+void CMonitorOutputFrontend::get_prometheus_metric_name(
+    std::string& out, const std::string& section, const char* measurement)
+{
+    // Prometheus metric names are SECTION_MEASUREMENT, with chars that are not allowed in metric names
+    // mangled in a single pass:
+    out.clear();
+    auto append_mangled = [&out](char c) {
+        switch (c) {
+        case '-':
+        case '.':
+        case '(':
+            out.push_back('_');
+            break;
+        case ')':
+            break;
+        default:
+            out.push_back(c);
+            break;
+        }
+    };
+    for (char c : section)
+        append_mangled(c);
+    out.push_back('_');
+    for (const char* p = measurement; *p != '\0'; p++)
+        append_mangled(*p);
+}
+
+/* static */
+void CMonitorOutputFrontend::get_series_key(
+    std::string& out, const std::string& section, const std::string& parent_name, const std::string& object_name)
+{
+    // use a separator that cannot appear in names:
+    out.assign(section);
+    if (!parent_name.empty()) {
+        out += '\x1f';
+        out += parent_name;
+    }
+    if (!object_name.empty()) {
+        out += '\x1f';
+        out += object_name;
+    }
+}
+
+const CMonitorOutputFrontend::remote_write_series_t& CMonitorOutputFrontend::get_remote_write_labels(
+    const std::string& section,
+    const std::string& parent_name, const std::string& object_name,
+    const std::map<std::string, std::string>& object_labels)
+{
+    get_series_key(m_remote_write_series_key, section, parent_name, object_name);
+    remote_write_series_t& series = m_remote_write_series[m_remote_write_series_key];
+    bool is_new = series.last_sample == 0;
+    series.last_sample = m_remote_write_sample_idx;
+    if (!is_new && series.object_labels == object_labels)
+        return series; // fast path: nothing changed since last sample
+
+    // same labels of the series exposed in pull mode, plus the host-wide ones; a std::map keeps them sorted by name
+    // as required by the remote-write specification. Names coming from the command line metadata or from the
+    // samplers might contain characters that receivers refuse:
+    std::map<std::string, std::string> labels;
+    std::string name;
+    for (const auto& label : m_remote_write_labels) {
+        name = label.first;
+        remote_write_sanitize_label_name(name);
+        labels[name] = label.second;
+    }
+    if (!object_name.empty())
+        labels["metric"] = object_name;
+    for (const auto& label : object_labels) {
+        name = label.first;
+        remote_write_sanitize_label_name(name);
+        labels[name] = label.second;
+    }
+    labels.erase(PROMETHEUS_REMOTE_WRITE_NAME_LABEL); // reserved for the metric name
+
+    // "__name__" must take its place in the sorted sequence: e.g. uppercase names sort before it
+    series.object_labels = object_labels;
+    series.labels_before_name.clear();
+    series.labels_after_name.clear();
+    for (const auto& label : labels) {
+        if (label.second.empty())
+            continue; // an empty label value is the same as a missing label
+        std::string& out
+            = label.first < PROMETHEUS_REMOTE_WRITE_NAME_LABEL ? series.labels_before_name : series.labels_after_name;
+        remote_write_append_label(out, label.first, label.second);
+    }
+    return series;
+}
+
+unsigned int CMonitorOutputFrontend::append_remote_write_timeseries(const std::string& section,
+    const remote_write_series_t& series, const CMonitorMeasurementVector& measurements, int64_t ts_msec)
+{
+    unsigned int n = 0;
+    for (const auto& measurement : measurements) {
+        if (!measurement.m_numeric || (measurement.m_sinks & SINK_MASK(SINK_PROMETHEUS)) == 0)
+            continue;
+        get_prometheus_metric_name(m_remote_write_metric_name, section, measurement.m_name.data());
+        if (m_kpi_descriptors.find(m_remote_write_metric_name) == m_kpi_descriptors.end())
+            continue; // same KPIs exposed by the pull endpoint
+        remote_write_append_timeseries(*m_remote_write_buffer, m_remote_write_metric_name, series.labels_before_name,
+            series.labels_after_name, measurement.m_dvalue, ts_msec);
+        n++;
+    }
+    return n;
+}
 
-        post_http_send_line(m_influxdb_client_conn, all_measurements.data(), all_measurements.size());
+void CMonitorOutputFrontend::push_current_sections_to_prometheus_remote_write(bool is_header)
+{
+    static const std::map<std::string, std::string> no_labels;
+    if (is_header) {
+        // instead of actually pushing something, collect the host-wide labels:
+        for (auto& sec : m_current_sections)
+            if (sec.m_name == "identity")
+                m_remote_write_labels.insert(std::make_pair("instance", sec.get_value_for_measurement("hostname")));
+
+        // all encoded labels embed the host-wide ones:
+        m_remote_write_series.clear();
+        return;
     }
+
+    struct timespec ts = get_current_sample_time();
+    int64_t ts_msec = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+    // the payload of the previous samples might still be in use by the remote workers:
+    // in such case it cannot be recycled and a new one is started
+    if (!m_remote_write_buffer || m_remote_write_buffer.use_count() > 1)
+        m_remote_write_buffer = std::make_shared<std::string>();
+    else {
+        std::atomic_thread_fence(std::memory_order_acquire); // pairs with the release of the workers' references
+        m_remote_write_buffer->clear();
+    }
+
+    // every measurement becomes a series with a single sample; the series layout is the same of the pull mode
+    m_remote_write_sample_idx++;
+    unsigned int num_series = 0;
+    for (const auto& sec : m_current_sections) {
+        if (!sec.m_measurements.empty()) {
+            num_series += append_remote_write_timeseries(
+                sec.m_name, get_remote_write_labels(sec.m_name, "", "", no_labels), sec.m_measurements, ts_msec);
+            continue;
+        }
+
+        for (const auto& subsec : sec.m_subsections) {
+            if ((subsec.m_sinks & SINK_MASK(SINK_PROMETHEUS)) == 0)
+                continue;
+            if (!subsec.m_measurements.empty()) {
+                num_series += append_remote_write_timeseries(sec.m_name,
+                    get_remote_write_labels(sec.m_name, "", subsec.m_name, no_labels), subsec.m_measurements,
+                    ts_msec);
+                continue;
+            }
+
+            for (const auto& subsubsec : subsec.m_subsubsections) {
+                if (subsubsec.m_name != "proc_info")
+                    num_series += append_remote_write_timeseries(sec.m_name,
+                        get_remote_write_labels(sec.m_name, subsec.m_name, subsubsec.m_name, subsubsec.m_labels),
+                        subsubsec.m_measurements, ts_msec);
+            }
+        }
+    }
+
+    // forget the series that disappeared (e.g. processes that exited):
+    for (auto it = m_remote_write_series.begin(); it != m_remote_write_series.end();) {
+        if (it->second.last_sample != m_remote_write_sample_idx)
+            it = m_remote_write_series.erase(it);
+        else
+            ++it;
+    }
+
+    CMonitorLogger::instance()->LogDebug(
+        "push_current_sections_to_prometheus_remote_write() queueing %u series for timestamp %lld\n", num_series,
+        (long long)ts_msec);
+    for (auto conn : m_remote_write_conns)
+        conn->submit(m_remote_write_buffer, num_series);
+}
+
+//------------------------------------------------------------------------------
+// Low level OTLP functions
+//------------------------------------------------------------------------------
+
+const CMonitorOutputFrontend::otlp_series_t& CMonitorOutputFrontend::get_otlp_series(const std::string& section,
+    const std::string& parent_name, const std::string& object_name,
+    const std::map<std::string, std::string>& object_labels, uint64_t ts_nsec)
+{
+    get_series_key(m_otlp_series_key, section, parent_name, object_name);
+
+    otlp_series_t& series = m_otlp_series[m_otlp_series_key];
+    bool is_new = series.last_sample == 0;
+    series.last_sample = m_otlp_sample_idx;
+    if (is_new) {
+        // series that disappeared are forgotten, so a series coming back (e.g. a recycled PID) restarts its
+        // cumulative Sums here; start time == time tells the receiver that the previous values are unrelated
+        series.start_time_nsec = ts_nsec;
+    }
+    if (!is_new && series.object_labels == object_labels)
+        return series; // fast path: nothing changed since last sample
+
+    // same labels of the Prometheus series, except for the host-wide ones which are resource attributes:
+    std::map<std::string, std::string> attributes;
+    if (!object_name.empty())
+        attributes["metric"] = object_name;
+    for (const auto& label : object_labels)
+        attributes[label.first] = label.second;
+
+    series.object_labels = object_labels;
+    series.encoded_attributes.clear();
+    for (const auto& attribute : attributes)
+        if (!attribute.second.empty())
+            otlp_append_attribute(
+                series.encoded_attributes, OTLP_DATA_POINT_ATTRIBUTES_FIELD, attribute.first, attribute.second);
+    return series;
+}
+
+unsigned int CMonitorOutputFrontend::append_otlp_data_points(const std::string& section,
+    const otlp_series_t& series, const CMonitorMeasurementVector& measurements, uint64_t ts_nsec)
+{
+    unsigned int n = 0;
+    for (const auto& measurement : measurements) {
+        if (!measurement.m_numeric || (measurement.m_sinks & SINK_MASK(SINK_OTLP)) == 0)
+            continue;
+
+        get_prometheus_metric_name(m_otlp_metric_name, section, measurement.m_name.data());
+        auto it = m_otlp_metrics.find(m_otlp_metric_name);
+        if (it == m_otlp_metrics.end()) {
+            it = m_otlp_metrics.emplace(m_otlp_metric_name, otlp_metric_t()).first;
+            auto descriptor = m_kpi_descriptors.find(m_otlp_metric_name);
+            if (descriptor != m_kpi_descriptors.end())
+                it->second.descriptor = descriptor->second;
+        }
+
+        otlp_metric_t& metric = it->second;
+        if (metric.last_section != m_otlp_section_idx) {
+            // first data point of this metric in the section in progress:
+            metric.last_section = m_otlp_section_idx;
+            metric.data_points.clear();
+            m_otlp_section_metrics.emplace_back(&it->first, &metric);
+        }
+
+        bool is_counter = metric.descriptor && metric.descriptor->kpi_type == PrometheusKpiType::Counter;
+        uint64_t start_time_nsec = is_counter ? series.start_time_nsec : 0;
+        if (measurement.m_integer)
+            otlp_append_data_point(metric.data_points, series.encoded_attributes, start_time_nsec, ts_nsec,
+                (int64_t)measurement.m_lvalue);
+        else
+            otlp_append_data_point(
+                metric.data_points, series.encoded_attributes, start_time_nsec, ts_nsec, measurement.m_dvalue);
+        n++;
+    }
+    return n;
+}
+
+void CMonitorOutputFrontend::push_current_sections_to_otlp(bool is_header)
+{
+    static const std::map<std::string, std::string> no_labels;
+    if (is_header) {
+        // instead of actually pushing something, collect the resource attributes:
+        for (auto& sec : m_current_sections)
+            if (sec.m_name == "identity")
+                m_otlp_resource_labels.insert(std::make_pair("host.name", sec.get_value_for_measurement("hostname")));
+
+        m_otlp_resource_attributes.clear();
+        for (const auto& label : m_otlp_resource_labels)
+            if (!label.second.empty())
+                otlp_append_attribute(
+                    m_otlp_resource_attributes, OTLP_RESOURCE_ATTRIBUTES_FIELD, label.first, label.second);
+        return;
+    }
+
+    struct timespec ts = get_current_sample_time();
+    uint64_t ts_nsec = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    // the payload of the previous samples might still be in use by the remote workers:
+    // in such case it cannot be recycled and a new one is started
+    if (!m_otlp_buffer || m_otlp_buffer.use_count() > 1)
+        m_otlp_buffer = std::make_shared<std::string>();
+    else {
+        std::atomic_thread_fence(std::memory_order_acquire); // pairs with the release of the workers' references
+        m_otlp_buffer->clear();
+    }
+
+    // each section becomes an instrumentation scope, holding one Metric per KPI with one data point per series
+    m_otlp_sample_idx++;
+    m_otlp_encoded_scopes.clear();
+    unsigned int num_points = 0;
+    for (const auto& sec : m_current_sections) {
+        m_otlp_section_idx++;
+        m_otlp_section_metrics.clear();
+
+        unsigned int section_points = 0;
+        if (!sec.m_measurements.empty())
+            section_points += append_otlp_data_points(sec.m_name,
+                get_otlp_series(sec.m_name, "", "", no_labels, ts_nsec), sec.m_measurements, ts_nsec);
+        for (const auto& subsec : sec.m_subsections) {
+            if ((subsec.m_sinks & SINK_MASK(SINK_OTLP)) == 0)
+                continue;
+            if (!subsec.m_measurements.empty()) {
+                section_points += append_otlp_data_points(sec.m_name,
+                    get_otlp_series(sec.m_name, "", subsec.m_name, no_labels, ts_nsec), subsec.m_measurements,
+                    ts_nsec);
+                continue;
+            }
+
+            for (const auto& subsubsec : subsec.m_subsubsections) {
+                if (subsubsec.m_name != "proc_info")
+                    section_points += append_otlp_data_points(sec.m_name,
+                        get_otlp_series(sec.m_name, subsec.m_name, subsubsec.m_name, subsubsec.m_labels, ts_nsec),
+                        subsubsec.m_measurements, ts_nsec);
+            }
+        }
+        if (section_points == 0)
+            continue;
+
+        m_otlp_encoded_metrics.clear();
+        for (const auto& metric : m_otlp_section_metrics) {
+            const prometheus_kpi_descriptor* descriptor = metric.second->descriptor;
+            otlp_append_metric(m_otlp_encoded_metrics, *metric.first, descriptor ? descriptor->description : nullptr,
+                descriptor && descriptor->kpi_type == PrometheusKpiType::Counter, metric.second->data_points);
+        }
+        otlp_append_scope_metrics(m_otlp_encoded_scopes, sec.m_name, VERSION_STRING, m_otlp_encoded_metrics);
+        num_points += section_points;
+    }
+    otlp_append_resource_metrics(*m_otlp_buffer, m_otlp_resource_attributes, m_otlp_encoded_scopes);
+
+    // forget the series that disappeared (e.g. processes that exited):
+    for (auto it = m_otlp_series.begin(); it != m_otlp_series.end();) {
+        if (it->second.last_sample != m_otlp_sample_idx)
+            it = m_otlp_series.erase(it);
+        else
+            ++it;
+    }
+
+    CMonitorLogger::instance()->LogDebug(
+        "push_current_sections_to_otlp() queueing %u data points for timestamp %llu\n", num_points,
+        (unsigned long long)ts_nsec);
+    for (auto conn : m_otlp_conns)
+        conn->submit(m_otlp_buffer, num_points);
 }
 
 //------------------------------------------------------------------------------
@@ -390,75 +1038,212 @@ void CMonitorOutputFrontend::push_current_sections_to_influxdb(bool is_header)
 //------------------------------------------------------------------------------
 
 #ifdef PROMETHEUS_SUPPORT
-void CMonitorOutputFrontend::push_current_sections_to_prometheus()
+prometheus_series_t CMonitorOutputFrontend::resolve_prometheus_series(
+    const std::string& section, const char* measurement, const std::map<std::string, std::string>& labels)
 {
-    std::string metric_name;
-    std::map<std::string, std::string> lbl;
-    for (size_t i = 0; i < m_current_sections.size(); i++) {
-        auto& sec = m_current_sections[i];
-        metric_name = sec.m_name;
-        if (sec.m_measurements.empty()) {
-            for (size_t i = 0; i < sec.m_subsections.size(); i++) {
-                auto& subsec = sec.m_subsections[i];
-                if (subsec.m_measurements.empty()) {
-                    for (size_t i = 0; i < subsec.m_subsubsections.size(); i++) {
-                        auto& subsubsec = subsec.m_subsubsections[i];
-                        lbl = { { "metric", subsubsec.m_name } };
-                        if (!subsubsec.m_labels.empty()) {
-                            for (const auto& entry : subsubsec.m_labels) {
-                                lbl.insert(std::make_pair(entry.first, entry.second));
-                            }
-                        }
-                        for (size_t n = 0; n < subsubsec.m_measurements.size(); n++) {
-                            auto& measurement = subsubsec.m_measurements[n];
-                            if (subsubsec.m_name != "proc_info")
-                                generate_prometheus_metric(
-                                    metric_name, measurement.m_name.data(), measurement.m_dvalue, lbl);
-                        }
-                    }
+    get_prometheus_metric_name(m_prometheus_metric_name, section, measurement);
 
-                } else {
-                    for (size_t n = 0; n < subsec.m_measurements.size(); n++) {
-                        auto& measurement = subsec.m_measurements[n];
-                        lbl = { { "metric", subsec.m_name } };
-                        generate_prometheus_metric(metric_name, measurement.m_name.data(), measurement.m_dvalue, lbl);
-                    }
-                }
+    auto kpi = m_prometheus_kpi_map.find(m_prometheus_metric_name);
+    if (kpi == m_prometheus_kpi_map.end()) {
+        CMonitorLogger::instance()->LogDebug(
+            "KPI %s is not enabled for Prometheus output frontend... thus skipping", m_prometheus_metric_name.c_str());
+        return prometheus_series_t(); // remember that this measurement is not exposed
+    }
+    return kpi->second->get_series(labels);
+}
+
+void CMonitorOutputFrontend::push_prometheus_measurements(prometheus_section_t& psec, const std::string& section,
+    const std::string& parent_name, const std::string& object_name,
+    const std::map<std::string, std::string>& object_labels, size_t object_labels_hash,
+    const CMonitorMeasurementVector& measurements)
+{
+    // locate the series of this section/subsection/subsubsection:
+    m_prometheus_group_key = parent_name;
+    if (!object_name.empty()) {
+        m_prometheus_group_key.push_back('\x1f');
+        m_prometheus_group_key += object_name;
+    }
+    prometheus_series_group_t& group = psec.groups[m_prometheus_group_key];
+    group.last_sample = psec.samples;
+    if (group.object_labels_hash != object_labels_hash || group.object_labels != object_labels) {
+        // e.g. a PID got reused by a different process: all series must be resolved again; the hashes of two
+        // different label sets can be equal, so the labels themselves are compared when the hashes match
+        remove_prometheus_series(group.bindings);
+        group.object_labels = object_labels;
+        group.object_labels_hash = object_labels_hash;
+    }
+
+    std::map<std::string, std::string> labels; // built only when some series must be resolved
+    for (size_t n = 0; n < measurements.size(); n++) {
+        const auto& measurement = measurements[n];
+        if ((measurement.m_sinks & SINK_MASK(SINK_PROMETHEUS)) == 0)
+            continue;
+
+        // samplers almost always emit the same measurements in the same order, so the
+        // measurement position is a good index; its name is checked anyway:
+        if (n >= group.bindings.size())
+            group.bindings.resize(n + 1);
+        prometheus_binding_t& binding = group.bindings[n];
+        if (binding.measurement.empty() || strcmp(binding.measurement.c_str(), measurement.m_name.data()) != 0) {
+            if (labels.empty() && !object_name.empty()) {
+                labels = { { "metric", object_name } };
+                labels.insert(object_labels.begin(), object_labels.end());
             }
-        } else {
-            for (size_t n = 0; n < sec.m_measurements.size(); n++) {
-                auto& measurement = sec.m_measurements[n];
-                generate_prometheus_metric(sec.m_name, measurement.m_name.data(), measurement.m_dvalue);
+            if (binding.series.kpi && !labels.empty()) {
+                binding.series.kpi->remove_series(binding.series);
+                m_prometheus_live_series--;
             }
+            binding.measurement = measurement.m_name.data();
+            binding.series = resolve_prometheus_series(section, measurement.m_name.data(), labels);
+            if (binding.series.kpi && !labels.empty())
+                m_prometheus_live_series++;
         }
+
+        if (binding.series.kpi)
+            binding.series.set_value(measurement.m_dvalue);
     }
 }
 
-void CMonitorOutputFrontend::generate_prometheus_metric(const std::string& metric_name, const std::string& metric_data,
-    double metric_value, const std::map<std::string, std::string>& labels)
+void CMonitorOutputFrontend::remove_prometheus_series(std::vector<prometheus_binding_t>& bindings)
 {
+    for (const auto& binding : bindings) {
+        if (binding.series.kpi) {
+            binding.series.kpi->remove_series(binding.series);
+            m_prometheus_live_series--;
+            m_prometheus_removed_series++;
+        }
+    }
+    bindings.clear();
+}
 
-    std::string prometheus_metric_name = metric_name + "_" + metric_data;
-    // FIXME: all this string processing for every single KPI is very inefficient.
-    // need to optimize this code, doing just 1 pass on the "metric_name" and "metric_data" strings to produce the
-    // correct output in a local buffer.
-    std::replace(prometheus_metric_name.begin(), prometheus_metric_name.end(), '-', '_');
-    std::replace(prometheus_metric_name.begin(), prometheus_metric_name.end(), '.', '_');
-    std::replace(prometheus_metric_name.begin(), prometheus_metric_name.end(), '(', '_');
-    prometheus_metric_name.erase(
-        std ::remove(prometheus_metric_name.begin(), prometheus_metric_name.end(), ')'), prometheus_metric_name.end());
+void CMonitorOutputFrontend::remove_stale_prometheus_series(prometheus_section_t& psec)
+{
+    // Processes exit, network interfaces and disks get removed: their series would stay in the registry,
+    // and in every scrape, forever. Staleness is measured in samples of the section, so that sections
+    // collected less frequently than others do not lose their series.
+    for (auto it = psec.groups.begin(); it != psec.groups.end();) {
+        if (!it->first.empty() && psec.samples - it->second.last_sample >= PROMETHEUS_STALE_SERIES_SAMPLES) {
+            remove_prometheus_series(it->second.bindings);
+            it = psec.groups.erase(it);
+        } else
+            ++it;
+    }
+}
 
-    auto kpi = m_prometheus_kpi_map.find(prometheus_metric_name);
-    if (kpi != m_prometheus_kpi_map.end()) {
-        PrometheusKpi* prometheus_kpi = kpi->second;
-        prometheus_kpi->set_kpi_value(metric_value, labels);
-    } else {
-        CMonitorLogger::instance()->LogDebug(
-            "KPI %s is not enabled for Prometheus output frontend... thus skipping", prometheus_metric_name.c_str());
+void CMonitorOutputFrontend::push_current_sections_to_prometheus()
+{
+    static const std::map<std::string, std::string> no_labels;
+    for (const auto& sec : m_current_sections) {
+        prometheus_section_t& psec = m_prometheus_sections[sec.m_name];
+        psec.samples++;
+
+        if (!sec.m_measurements.empty()) {
+            // these series have no labels: they never become stale
+            push_prometheus_measurements(psec, sec.m_name, "", "", no_labels, 0, sec.m_measurements);
+            continue;
+        }
+
+        for (const auto& subsec : sec.m_subsections) {
+            if ((subsec.m_sinks & SINK_MASK(SINK_PROMETHEUS)) == 0)
+                continue;
+            if (!subsec.m_measurements.empty()) {
+                push_prometheus_measurements(
+                    psec, sec.m_name, "", subsec.m_name, no_labels, 0, subsec.m_measurements);
+                continue;
+            }
+
+            for (const auto& subsubsec : subsec.m_subsubsections) {
+                if (subsubsec.m_name != "proc_info")
+                    push_prometheus_measurements(psec, sec.m_name, subsec.m_name, subsubsec.m_name,
+                        subsubsec.m_labels, subsubsec.m_labels_hash, subsubsec.m_measurements);
+            }
+        }
+
+        remove_stale_prometheus_series(psec);
     }
+
+    if (m_prometheus_live_series_kpi)
+        m_prometheus_live_series_kpi->set_kpi_value(m_prometheus_live_series);
+
+    render_prometheus_payload();
+}
+
+void CMonitorOutputFrontend::render_prometheus_payload()
+{
+    // the exposition text is rendered once per sample: scrapes just send out the latest payload
+    std::string& payload = m_prometheus_server->get_back_buffer();
+    for (const auto& kpi : m_prometheus_kpi_map)
+        kpi.second->render(payload);
+    m_prometheus_server->swap_buffers();
 }
 #endif
 
+//------------------------------------------------------------------------------
+// Section walk
+//------------------------------------------------------------------------------
+
+size_t CMonitorOutputFrontend::count_measurements_for_sink(
+    const CMonitorMeasurementVector& measurements, OutputSink sink) const
+{
+    if (m_filters.empty())
+        return measurements.size();
+
+    size_t n = 0;
+    for (const auto& m : measurements)
+        if (m.m_sinks & SINK_MASK(sink))
+            n++;
+    return n;
+}
+
+size_t CMonitorOutputFrontend::count_subsections_for_sink(const CMonitorOutputSection& sec, OutputSink sink) const
+{
+    size_t n = 0;
+    for (const auto& subsec : sec.m_subsections)
+        if (subsec.m_sinks & SINK_MASK(sink))
+            n++;
+    return n;
+}
+
+template <typename ObjectStartFn, typename MeasurementsFn, typename ObjectEndFn>
+void CMonitorOutputFrontend::walk_current_sections(
+    OutputSink sink, ObjectStartFn object_start, MeasurementsFn measurements, ObjectEndFn object_end)
+{
+    for (size_t sec_idx = 0; sec_idx < m_current_sections.size(); sec_idx++) {
+        auto& sec = m_current_sections[sec_idx];
+
+        if (sec.m_measurements.empty()) {
+            size_t num_subsections = count_subsections_for_sink(sec, sink), subsec_pos = 0;
+            object_start(sec.m_name, num_subsections, SECOND_LEVEL);
+            for (size_t subsec_idx = 0; subsec_idx < sec.m_subsections.size(); subsec_idx++) {
+                auto& subsec = sec.m_subsections[subsec_idx];
+                if ((subsec.m_sinks & SINK_MASK(sink)) == 0)
+                    continue;
+                bool is_last_subsec = ++subsec_pos == num_subsections;
+                if (subsec.m_measurements.empty()) {
+                    object_start(subsec.m_name, subsec.m_subsubsections.size(), THIRD_LEVEL);
+                    for (size_t subsubsec_idx = 0; subsubsec_idx < subsec.m_subsubsections.size(); subsubsec_idx++) {
+                        auto& subsubsec = subsec.m_subsubsections[subsubsec_idx];
+                        object_start(subsubsec.m_name,
+                            count_measurements_for_sink(subsubsec.m_measurements, sink), FOURTH_LEVEL);
+                        measurements(subsubsec.m_measurements, FIFTH_LEVEL);
+                        object_end(subsubsec_idx == subsec.m_subsubsections.size() - 1, FOURTH_LEVEL);
+                    }
+                    object_end(is_last_subsec, THIRD_LEVEL);
+                } else {
+                    object_start(
+                        subsec.m_name, count_measurements_for_sink(subsec.m_measurements, sink), THIRD_LEVEL);
+                    measurements(subsec.m_measurements, FOURTH_LEVEL);
+                    object_end(is_last_subsec, THIRD_LEVEL);
+                }
+            }
+        } else {
+            object_start(sec.m_name, count_measurements_for_sink(sec.m_measurements, sink), SECOND_LEVEL);
+            measurements(sec.m_measurements, THIRD_LEVEL);
+        }
+        object_end(sec_idx == m_current_sections.size() - 1, SECOND_LEVEL);
+    }
+}
+
 //------------------------------------------------------------------------------
 // Low level JSON functions
 //------------------------------------------------------------------------------
@@ -474,8 +1259,19 @@ void CMonitorOutputFrontend::push_json_indent(unsigned int indent)
 
 void CMonitorOutputFrontend::push_json_measurements(CMonitorMeasurementVector& measurements, unsigned int indent)
 {
+    bool first = true;
     for (size_t n = 0; n < measurements.size(); n++) {
         auto& m = measurements[n];
+        if ((m.m_sinks & SINK_MASK(SINK_LOCAL_FILE)) == 0)
+            continue;
+
+        // add separator from previous measurement
+        if (!first) {
+            fputs(",", m_outputJson);
+            if (m_json_pretty_print)
+                fputs("\n", m_outputJson);
+        }
+        first = false;
 
         push_json_indent(indent);
 
@@ -497,14 +1293,10 @@ void CMonitorOutputFrontend::push_json_measurements(CMonitorMeasurementVector& m
             fputs(m.m_value.data(), m_outputJson);
             fputs("\"", m_outputJson);
         }
-
-        bool last = (n == measurements.size() - 1);
-        if (!last)
-            fputs(",", m_outputJson);
-
-        if (m_json_pretty_print)
-            fputs("\n", m_outputJson);
     }
+
+    if (!first && m_json_pretty_print)
+        fputs("\n", m_outputJson);
 }
 
 void CMonitorOutputFrontend::push_json_object_start(const std::string& str, unsigned int indent)
@@ -550,9 +1342,6 @@ void CMonitorOutputFrontend::push_current_sections_to_json(bool is_header)
 {
     // convert the current sample into JSON format:
 
-    // we do all the JSON with max 4 indentation levels:
-    enum { FIRST_LEVEL = 1, SECOND_LEVEL = 2, THIRD_LEVEL = 3, FOURTH_LEVEL = 4, FIFTH_LEVEL = 5 };
-
     if (is_header) {
         fputs("{\n", m_outputJson); // document begin
         push_json_object_start("header", FIRST_LEVEL);
@@ -564,33 +1353,15 @@ void CMonitorOutputFrontend::push_current_sections_to_json(bool is_header)
         if (m_json_pretty_print)
             fputs("\n", m_outputJson);
     }
-    for (size_t sec_idx = 0; sec_idx < m_current_sections.size(); sec_idx++) {
-        auto& sec = m_current_sections[sec_idx];
-
-        push_json_object_start(sec.m_name, SECOND_LEVEL);
-        if (sec.m_measurements.empty()) {
-            for (size_t subsec_idx = 0; subsec_idx < sec.m_subsections.size(); subsec_idx++) {
-                auto& subsec = sec.m_subsections[subsec_idx];
-                if (subsec.m_measurements.empty()) {
-                    push_json_object_start(subsec.m_name, THIRD_LEVEL);
-                    for (size_t subsubsec_idx = 0; subsubsec_idx < subsec.m_subsubsections.size(); subsubsec_idx++) {
-                        auto& subsubsec = subsec.m_subsubsections[subsubsec_idx];
-                        push_json_object_start(subsubsec.m_name, FOURTH_LEVEL);
-                        push_json_measurements(subsubsec.m_measurements, FIFTH_LEVEL);
-                        push_json_object_end(subsubsec_idx == subsec.m_subsubsections.size() - 1, FOURTH_LEVEL);
-                    }
-                    push_json_object_end(subsec_idx == sec.m_subsections.size() - 1, THIRD_LEVEL);
-                } else {
-                    push_json_object_start(subsec.m_name, THIRD_LEVEL);
-                    push_json_measurements(subsec.m_measurements, FOURTH_LEVEL);
-                    push_json_object_end(subsec_idx == sec.m_subsections.size() - 1, THIRD_LEVEL);
-                }
-            }
-        } else {
-            push_json_measurements(sec.m_measurements, THIRD_LEVEL);
-        }
-        push_json_object_end(sec_idx == m_current_sections.size() - 1, SECOND_LEVEL);
-    }
+    walk_current_sections(
+        SINK_LOCAL_FILE,
+        [this](const std::string& name, size_t /* num_children */, unsigned int level) {
+            push_json_object_start(name, level);
+        },
+        [this](CMonitorMeasurementVector& measurements, unsigned int level) {
+            push_json_measurements(measurements, level);
+        },
+        [this](bool last, unsigned int level) { push_json_object_end(last, level); });
     if (is_header) {
         push_json_indent(FIRST_LEVEL);
         fputs("},\n", m_outputJson); // for sure at least 1 sample will follow
@@ -605,6 +1376,175 @@ void CMonitorOutputFrontend::push_current_sections_to_json(bool is_header)
         "push_current_sections_to_json() writing on the JSON output %lu measurements\n", num_measurements);
 }
 
+void CMonitorOutputFrontend::push_current_sections_to_ndjson(bool is_header)
+{
+    // same tree of the JSON file, on a single line: each frame owns its buffer since it is queued for
+    // the subscribers, so just reserve the size of the previous one
+    std::string frame;
+    frame.reserve(m_stream_frame_size_hint + m_stream_frame_size_hint / 8);
+    frame += is_header ? "{\"header\":{" : "{";
+    walk_current_sections(
+        SINK_LOCAL_FILE,
+        [&frame](const std::string& name, size_t /* num_children */, unsigned int /* level */) {
+            frame += '"';
+            frame += name;
+            frame += "\":{";
+        },
+        [&frame](CMonitorMeasurementVector& measurements, unsigned int /* level */) {
+            bool first = true;
+            for (auto& m : measurements) {
+                if ((m.m_sinks & SINK_MASK(SINK_LOCAL_FILE)) == 0)
+                    continue;
+                if (!first)
+                    frame += ',';
+                first = false;
+
+                frame += '"';
+                frame += m.m_name.data();
+                if (m.m_numeric) {
+                    frame += "\":";
+                    frame += m.m_value.data();
+                } else {
+                    m.enforce_valid_json_string_value();
+                    frame += "\":\"";
+                    frame += m.m_value.data();
+                    frame += '"';
+                }
+            }
+        },
+        [&frame](bool last, unsigned int /* level */) { frame += last ? "}" : "},"; });
+    frame += is_header ? "}}\n" : "}\n";
+
+    m_stream_frame_size_hint = frame.size();
+    if (is_header)
+        m_stream_server->publish_header(std::move(frame));
+    else
+        m_stream_server->publish(std::move(frame));
+}
+
+//------------------------------------------------------------------------------
+// Low level CBOR functions
+//------------------------------------------------------------------------------
+
+void CMonitorOutputFrontend::push_cbor_head(uint8_t major_type, uint64_t value)
+{
+    // see RFC 8949, section 3: the "additional info" in the low 5 bits either holds the value itself
+    // or tells how many big-endian bytes follow
+    uint8_t mt = (uint8_t)(major_type << 5);
+    if (value < 24) {
+        m_cbor_buffer += (char)(mt | value);
+    } else if (value <= UINT8_MAX) {
+        m_cbor_buffer += (char)(mt | 24);
+        m_cbor_buffer += (char)value;
+    } else if (value <= UINT16_MAX) {
+        m_cbor_buffer += (char)(mt | 25);
+        for (int shift = 8; shift >= 0; shift -= 8)
+            m_cbor_buffer += (char)(value >> shift);
+    } else if (value <= UINT32_MAX) {
+        m_cbor_buffer += (char)(mt | 26);
+        for (int shift = 24; shift >= 0; shift -= 8)
+            m_cbor_buffer += (char)(value >> shift);
+    } else {
+        m_cbor_buffer += (char)(mt | 27);
+        for (int shift = 56; shift >= 0; shift -= 8)
+            m_cbor_buffer += (char)(value >> shift);
+    }
+}
+
+void CMonitorOutputFrontend::push_cbor_string(const char* str, size_t len)
+{
+    push_cbor_head(CBOR_MAJOR_TYPE_TEXT_STRING, len);
+    m_cbor_buffer.append(str, len);
+}
+
+void CMonitorOutputFrontend::push_cbor_measurements(CMonitorMeasurementVector& measurements)
+{
+    for (auto& m : measurements) {
+        if ((m.m_sinks & SINK_MASK(SINK_LOCAL_FILE)) == 0)
+            continue;
+
+        push_cbor_string(m.m_name.data(), strlen(m.m_name.data()));
+
+        if (m.m_integer) {
+            if (m.m_lvalue >= 0)
+                push_cbor_head(CBOR_MAJOR_TYPE_UNSIGNED_INT, (uint64_t)m.m_lvalue);
+            else
+                push_cbor_head(CBOR_MAJOR_TYPE_NEGATIVE_INT, (uint64_t)(-1 - m.m_lvalue));
+        } else if (m.m_numeric) {
+            uint64_t bits;
+            static_assert(sizeof(bits) == sizeof(m.m_dvalue), "double is expected to be 64bits");
+            memcpy(&bits, &m.m_dvalue, sizeof(bits));
+
+            m_cbor_buffer += (char)CBOR_FLOAT64_HEAD;
+            for (int shift = 56; shift >= 0; shift -= 8)
+                m_cbor_buffer += (char)(bits >> shift);
+        } else {
+            // CBOR text strings must be valid UTF-8 but m_value was probably read from disk or from kernel:
+            // apply the same sanitization used for JSON so that both encodings carry exactly the same tree
+            m.enforce_valid_json_string_value();
+            push_cbor_string(m.m_value.data(), strlen(m.m_value.data()));
+        }
+    }
+}
+
+void CMonitorOutputFrontend::flush_cbor_buffer()
+{
+    if (!m_cbor_buffer.empty() && m_outputCbor)
+        fwrite(m_cbor_buffer.data(), 1, m_cbor_buffer.size(), m_outputCbor);
+    m_cbor_buffer.clear();
+}
+
+void CMonitorOutputFrontend::push_current_sections_to_cbor(bool is_header)
+{
+    // convert the current sample into CBOR format; the document has exactly the same structure of the JSON one:
+    //   { "header": { ... }, "samples": [ { ... }, { ... }, ... ] }
+    // but since the number of samples is not known in advance, the outer map and the samples array
+    // are encoded with indefinite length and terminated by psample_array_end()
+
+    if (is_header && m_outputCbor) {
+        m_cbor_buffer += (char)CBOR_INDEFINITE_MAP_HEAD; // document begin
+        push_cbor_string("header");
+    }
+
+    size_t sample_start = m_cbor_buffer.size();
+    push_cbor_head(CBOR_MAJOR_TYPE_MAP, m_current_sections.size());
+    walk_current_sections(
+        SINK_LOCAL_FILE,
+        [this](const std::string& name, size_t num_children, unsigned int /* level */) {
+            push_cbor_string(name);
+            push_cbor_head(CBOR_MAJOR_TYPE_MAP, num_children);
+        },
+        [this](CMonitorMeasurementVector& measurements, unsigned int /* level */) {
+            push_cbor_measurements(measurements);
+        },
+        [](bool /* last */, unsigned int /* level */) {
+            // definite-length maps need no terminator
+        });
+
+    // the shared-memory ring gets the very same encoding of the sample (or header), without the document framing:
+    if (m_shm_ring) {
+        if (is_header)
+            m_shm_ring->publish_header(m_cbor_buffer.data() + sample_start, m_cbor_buffer.size() - sample_start);
+        else
+            m_shm_ring->publish(m_cbor_buffer.data() + sample_start, m_cbor_buffer.size() - sample_start);
+    }
+    if (m_stream_server && m_stream_format == STREAM_FORMAT_CBOR) {
+        // like in NDJSON, the header is wrapped as { "header": {...} } to tell it apart from the samples
+        std::string frame;
+        if (is_header)
+            frame = "\xA1\x66" "header"; // map of 1 pair, text string of 6 bytes
+        frame.append(m_cbor_buffer.data() + sample_start, m_cbor_buffer.size() - sample_start);
+        if (is_header)
+            m_stream_server->publish_header(std::move(frame));
+        else
+            m_stream_server->publish(std::move(frame));
+    }
+
+    CMonitorLogger::instance()->LogDebug(
+        "push_current_sections_to_cbor() writing on the CBOR output %zu bytes\n", m_cbor_buffer.size());
+    flush_cbor_buffer();
+}
+
 //------------------------------------------------------------------------------
 // Generic routines
 //------------------------------------------------------------------------------
@@ -616,9 +1556,21 @@ void CMonitorOutputFrontend::push_current_sections(bool is_header)
     if (m_outputJson)
         push_current_sections_to_json(is_header);
 
-    if (m_influxdb_client_conn)
+    if (m_outputCbor || m_shm_ring || (m_stream_server && m_stream_format == STREAM_FORMAT_CBOR))
+        push_current_sections_to_cbor(is_header);
+
+    if (m_stream_server && m_stream_format == STREAM_FORMAT_NDJSON)
+        push_current_sections_to_ndjson(is_header);
+
+    if (!m_influxdb_http_conns.empty() || !m_influxdb_udp_conns.empty())
         push_current_sections_to_influxdb(is_header);
 
+    if (!m_remote_write_conns.empty())
+        push_current_sections_to_prometheus_remote_write(is_header);
+
+    if (!m_otlp_conns.empty())
+        push_current_sections_to_otlp(is_header);
+
 #ifdef PROMETHEUS_SUPPORT
     if (m_prometheus_enabled)
         push_current_sections_to_prometheus();
@@ -626,8 +1578,95 @@ void CMonitorOutputFrontend::push_current_sections(bool is_header)
 
     fflush(NULL); /* force I/O output now */
 
+    if (is_header && m_keep_header)
+        m_header_sections = m_current_sections;
+
     // IMPORTANT: clear() but do not shrink_to_fit() to avoid a bunch of reallocations for next sample:
     m_current_sections.clear();
+    m_current_sample_time = { 0, 0 };
+    m_header_in_progress = false;
+}
+
+struct timespec CMonitorOutputFrontend::get_current_sample_time() const
+{
+    if (m_current_sample_time.tv_sec != 0)
+        return m_current_sample_time;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts;
+}
+
+bool CMonitorOutputFrontend::get_kpi_value(
+    const std::string& section, const std::string& subsection, const std::string& measurement, double& valueOUT) const
+{
+    auto find_in = [&](const std::vector<CMonitorOutputSection>& sections) -> bool {
+        for (const auto& sec : sections) {
+            if (sec.m_name != section)
+                continue;
+            const CMonitorMeasurementVector* measurements = &sec.m_measurements;
+            if (!subsection.empty()) {
+                auto subsec = std::find_if(sec.m_subsections.begin(), sec.m_subsections.end(),
+                    [&](const CMonitorOutputSubsection& s) -> bool { return s.m_name == subsection; });
+                if (subsec == sec.m_subsections.end())
+                    continue;
+                measurements = &subsec->m_measurements;
+            }
+            for (const auto& m : *measurements) {
+                if (m.m_numeric && strcmp(m.m_name.data(), measurement.c_str()) == 0) {
+                    valueOUT = m.m_dvalue;
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+    return find_in(m_current_sections) || find_in(m_header_sections);
+}
+
+void CMonitorOutputFrontend::hold_current_sample()
+{
+    if (m_held_samples_max == 0) {
+        m_current_sections.clear();
+        m_current_sample_time = { 0, 0 };
+        return;
+    }
+
+    held_sample_t held;
+    if (m_held_samples.size() >= m_held_samples_max) {
+        // recycle the oldest sample, so that its vectors keep their capacity:
+        held = std::move(m_held_samples.front());
+        m_held_samples.pop_front();
+    }
+    held.time = get_current_sample_time();
+    held.sections.swap(m_current_sections);
+    m_held_samples.push_back(std::move(held));
+
+    m_current_sections.clear();
+    m_current_sample_time = { 0, 0 };
+}
+
+size_t CMonitorOutputFrontend::push_held_samples()
+{
+    size_t num_held = m_held_samples.size();
+    if (num_held == 0)
+        return 0;
+
+    // the sample in progress, if any, is set aside while the held ones are written:
+    std::vector<CMonitorOutputSection> in_progress;
+    in_progress.swap(m_current_sections);
+    struct timespec in_progress_time = m_current_sample_time;
+
+    for (auto& held : m_held_samples) {
+        m_current_sections.swap(held.sections);
+        m_current_sample_time = held.time;
+        push_current_sections(false);
+    }
+    m_held_samples.clear();
+
+    m_current_sections.swap(in_progress);
+    m_current_sample_time = in_progress_time;
+    return num_held;
 }
 
 size_t CMonitorOutputFrontend::get_current_sample_measurements() const
@@ -670,12 +1709,70 @@ void CMonitorOutputFrontend::pstats()
     plong("long", m_long);
     plong("double", m_double);
     plong("hex", m_hex);
+
+    // first endpoint of each kind reports as "influxdb_*", the next ones as "influxdb2_*", "influxdb3_*", etc:
+    for (size_t n = 0; n < m_influxdb_http_conns.size(); n++)
+        pstats_remote_worker(n == 0 ? "influxdb_" : fmt::format("influxdb{}_", n + 1), m_influxdb_http_conns[n]);
+    for (size_t n = 0; n < m_remote_write_conns.size(); n++)
+        pstats_remote_worker(
+            n == 0 ? "prometheus_rw_" : fmt::format("prometheus_rw{}_", n + 1), m_remote_write_conns[n]);
+    for (size_t n = 0; n < m_otlp_conns.size(); n++)
+        pstats_remote_worker(n == 0 ? "otlp_" : fmt::format("otlp{}_", n + 1), m_otlp_conns[n]);
+    for (size_t n = 0; n < m_influxdb_udp_conns.size(); n++) {
+        std::string prefix = n == 0 ? "influxdb_udp_" : fmt::format("influxdb{}_udp_", n + 1);
+        const udp_sender_stats_t& stats = m_influxdb_udp_conns[n]->get_stats();
+        plong((prefix + "datagrams").c_str(), stats.datagrams);
+        plong((prefix + "bytes").c_str(), stats.bytes);
+        plong((prefix + "points_sent").c_str(), stats.sent);
+        plong((prefix + "points_dropped").c_str(), stats.dropped);
+    }
+    if (m_shm_ring) {
+        const shm_ring_stats_t& stats = m_shm_ring->get_stats();
+        plong("shm_ring_published", stats.published);
+        plong("shm_ring_oversized", stats.oversized);
+        plong("shm_ring_bytes", stats.bytes);
+    }
+    if (m_stream_server) {
+        stream_server_stats_t stats = m_stream_server->get_stats();
+        plong("stream_subscribers", stats.subscribers);
+        plong("stream_frames", stats.frames);
+        plong("stream_bytes_sent", stats.bytes_sent);
+        plong("stream_skipped", stats.skipped);
+        plong("stream_disconnected", stats.disconnected);
+    }
+#ifdef PROMETHEUS_SUPPORT
+    if (m_prometheus_enabled) {
+        prometheus_server_stats_t stats = m_prometheus_server->get_stats();
+        plong("prometheus_live_series", m_prometheus_live_series);
+        plong("prometheus_removed_series", m_prometheus_removed_series);
+        plong("prometheus_payload_bytes", stats.payload_bytes);
+        plong("prometheus_payload_gzip_bytes", stats.payload_gzip_bytes);
+        plong("prometheus_payload_allocations", stats.payload_allocations);
+        plong("prometheus_scrapes", stats.scrapes);
+        plong("prometheus_gzip_scrapes", stats.gzip_scrapes);
+        plong("prometheus_scrape_errors", stats.errors);
+    }
+#endif
     psection_end();
 }
 
+void CMonitorOutputFrontend::pstats_remote_worker(const std::string& prefix, CMonitorRemoteWorker* conn)
+{
+    remote_sender_stats_t stats = conn->get_stats();
+    plong((prefix + "points_queued").c_str(), stats.queued);
+    plong((prefix + "points_sent").c_str(), stats.sent);
+    plong((prefix + "points_dropped").c_str(), stats.dropped);
+    plong((prefix + "points_retried").c_str(), stats.retried);
+    plong((prefix + "points_spooled").c_str(), stats.spooled);
+    plong((prefix + "points_pending").c_str(), conn->get_pending_points());
+    plong((prefix + "batch_uncompressed_bytes").c_str(), stats.batch_uncompressed_bytes);
+    plong((prefix + "batch_compressed_bytes").c_str(), stats.batch_compressed_bytes);
+}
+
 void CMonitorOutputFrontend::pheader_start()
 {
-    // empty for now
+    // the header is never filtered: e.g. InfluxDB tags are built from it
+    m_header_in_progress = true;
 }
 
 void CMonitorOutputFrontend::psample_array_start()
@@ -683,6 +1780,11 @@ void CMonitorOutputFrontend::psample_array_start()
     if (m_outputJson) {
         push_json_array_start("samples", 1);
     }
+    if (m_outputCbor) {
+        push_cbor_string("samples");
+        m_cbor_buffer += (char)CBOR_INDEFINITE_ARRAY_HEAD;
+        flush_cbor_buffer();
+    }
 }
 
 void CMonitorOutputFrontend::psample_array_end()
@@ -690,11 +1792,17 @@ void CMonitorOutputFrontend::psample_array_end()
     if (m_outputJson) {
         push_json_array_end(1);
     }
+    if (m_outputCbor) {
+        m_cbor_buffer += (char)CBOR_BREAK; // end of samples array
+        m_cbor_buffer += (char)CBOR_BREAK; // document end
+        flush_cbor_buffer();
+    }
 }
 
 void CMonitorOutputFrontend::psample_start()
 {
-    // empty for now
+    // remote sinks stamp the sample with this time, even if it gets written later (see hold_current_sample())
+    clock_gettime(CLOCK_REALTIME, &m_current_sample_time);
 }
 
 void CMonitorOutputFrontend::psection_start(const char* section)
@@ -705,6 +1813,9 @@ void CMonitorOutputFrontend::psection_start(const char* section)
     sec.m_name = section;
     m_current_sections.push_back(sec);
 
+    if (!m_filters.empty())
+        m_current_section_filter_id = m_filters.intern_section(sec.m_name);
+
     // when adding new measurements, add them as children of this new section:
     m_current_meas_list = &m_current_sections.back().m_measurements;
 }
@@ -715,23 +1826,36 @@ void CMonitorOutputFrontend::psection_end()
     m_current_meas_list = nullptr;
 }
 
-void CMonitorOutputFrontend::psubsection_start(const char* subsection, const std::map<std::string, std::string>& labels)
+void CMonitorOutputFrontend::psubsection_start(
+    const char* subsection, const std::map<std::string, std::string>& labels, sink_mask_t sinks)
 {
     m_subsections++;
 
-    CMonitorOutputSubsection subsec;
+    m_current_sections.back().m_subsections.emplace_back();
+    CMonitorOutputSubsection& subsec = m_current_sections.back().m_subsections.back();
     subsec.m_name = subsection;
-    subsec.m_labels = labels;
-    m_current_sections.back().m_subsections.push_back(subsec);
+    if (wants_labels())
+        subsec.m_labels = labels;
+    subsec.m_sinks = sinks;
+    m_current_object_sinks = sinks;
 
     // when adding new measurements, add them as children of this new subsection:
     m_current_meas_list = &m_current_sections.back().m_subsections.back().m_measurements;
 }
 
+void CMonitorOutputFrontend::psubsection_start(const char* subsection, const char* label_name, const char* label_value)
+{
+    if (wants_labels())
+        psubsection_start(subsection, { { label_name, label_value } });
+    else
+        psubsection_start(subsection);
+}
+
 void CMonitorOutputFrontend::psubsection_end()
 {
     // stop adding measurements to last section:
     m_current_meas_list = nullptr;
+    m_current_object_sinks = SINK_MASK_ALL;
 }
 
 void CMonitorOutputFrontend::psubsubsection_start(
@@ -739,10 +1863,13 @@ void CMonitorOutputFrontend::psubsubsection_start(
 {
     m_subsubsections++;
 
-    CMonitorOutputSubSubsection subsubsec;
+    m_current_sections.back().m_subsections.back().m_subsubsections.emplace_back();
+    CMonitorOutputSubSubsection& subsubsec = m_current_sections.back().m_subsections.back().m_subsubsections.back();
     subsubsec.m_name = resource;
-    subsubsec.m_labels = labels;
-    m_current_sections.back().m_subsections.back().m_subsubsections.push_back(subsubsec);
+    if (wants_labels()) {
+        subsubsec.m_labels = labels;
+        subsubsec.m_labels_hash = hash_labels(labels);
+    }
 
     // when adding new measurements, add them as children of this new sub-subsection:
     m_current_meas_list = &m_current_sections.back().m_subsections.back().m_subsubsections.back().m_measurements;
@@ -760,24 +1887,36 @@ void CMonitorOutputFrontend::psubsubsection_end()
 
 void CMonitorOutputFrontend::plong(const char* name, long long value)
 {
-    m_long++;
     assert(m_current_meas_list);
+    sink_mask_t sinks = get_measurement_sinks(name);
+    if (sinks == 0)
+        return; // no enabled sink wants this KPI
+    m_long++;
 
     m_current_meas_list->push_back(CMonitorOutputMeasurement(name, value));
+    m_current_meas_list->back().m_sinks = sinks;
 }
 
 void CMonitorOutputFrontend::pdouble(const char* name, double value)
 {
-    m_double++;
     assert(m_current_meas_list);
+    sink_mask_t sinks = get_measurement_sinks(name);
+    if (sinks == 0)
+        return; // no enabled sink wants this KPI
+    m_double++;
 
     m_current_meas_list->push_back(CMonitorOutputMeasurement(name, value));
+    m_current_meas_list->back().m_sinks = sinks;
 }
 
 void CMonitorOutputFrontend::pstring(const char* name, const char* value)
 {
-    m_string++;
     assert(m_current_meas_list);
+    sink_mask_t sinks = get_measurement_sinks(name);
+    if (sinks == 0)
+        return; // no enabled sink wants this KPI
+    m_string++;
 
     m_current_meas_list->push_back(CMonitorOutputMeasurement(name, value));
+    m_current_meas_list->back().m_sinks = sinks;
 }
@@ -23,25 +23,29 @@
 // Includes
 //------------------------------------------------------------------------------
 
+#include <algorithm>
 #include <array>
+#include <deque>
+#include <map>
 #include <set>
 #include <string.h>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "otlp_metrics.h"
+#include "output_filters.h"
+#include "prometheus_remote_write.h"
+#include "remote_worker.h"
+#include "shm_ring.h"
+#include "stream_server.h"
 #include "system.h"
 
 // Prometheus
 #ifdef PROMETHEUS_SUPPORT
 #include "prometheus_counter.h"
 #include "prometheus_gauge.h"
-#include <prometheus/counter.h>
-#include <prometheus/detail/future_std.h>
-#include <prometheus/exposer.h>
-#include <prometheus/family.h>
-#include <prometheus/gauge.h>
-#include <prometheus/labels.h>
-#include <prometheus/registry.h>
+#include "prometheus_server.h"
 #endif
 
 //------------------------------------------------------------------------------
@@ -51,15 +55,30 @@
 #define CMONITOR_MEASUREMENT_NAME_MAXLEN (64)
 #define CMONITOR_MEASUREMENT_VALUE_MAXLEN (256) // some strings like e.g. "uname -a" can be pretty long
 
+// CBOR encoding, see RFC 8949
+#define CBOR_MAJOR_TYPE_UNSIGNED_INT (0)
+#define CBOR_MAJOR_TYPE_NEGATIVE_INT (1)
+#define CBOR_MAJOR_TYPE_TEXT_STRING (3)
+#define CBOR_MAJOR_TYPE_ARRAY (4)
+#define CBOR_MAJOR_TYPE_MAP (5)
+#define CBOR_MAJOR_TYPE_SIMPLE (7)
+#define CBOR_FLOAT64_HEAD (0xFB)
+#define CBOR_INDEFINITE_ARRAY_HEAD (0x9F)
+#define CBOR_INDEFINITE_MAP_HEAD (0xBF)
+#define CBOR_BREAK (0xFF)
+
+// labelled Prometheus series not updated for this many samples of their section get removed from the registry
+#define PROMETHEUS_STALE_SERIES_SAMPLES (5)
+
 //------------------------------------------------------------------------------
 // Forward declarations
 //------------------------------------------------------------------------------
 
-struct _influx_client_t;
-typedef struct _influx_client_t influx_client_t;
+class CMonitorRemoteSender;
+class CMonitorUdpSender;
 
 //------------------------------------------------------------------------------
-// The JSON/InfluxDB frontend
+// The JSON/CBOR/InfluxDB frontend
 //
 // Allows only the following logical hierarchy:
 //  SAMPLE
@@ -89,15 +108,75 @@ public:
     // setup API
     //------------------------------------------------------------------------------
 
-    void init_json_output_file(const std::string& filenamePrefix);
-    void init_influxdb_connection(const std::string& hostname, unsigned int port, const std::string& dbname);
+    // return false, after logging the error, if the file cannot be opened
+    bool init_json_output_file(const std::string& filenamePrefix);
+    bool init_cbor_output_file(const std::string& filenamePrefix);
+    bool init_shm_ring(const std::string& name, unsigned int num_slots = SHM_RING_DEFAULT_SLOTS,
+        size_t max_payload = SHM_RING_DEFAULT_SLOT_KB * 1024);
+    bool init_stream_socket(const std::string& path, StreamFormat format = STREAM_FORMAT_NDJSON,
+        unsigned int max_queue_len = STREAM_SERVER_DEFAULT_QUEUE_LEN,
+        StreamSlowSubscriberPolicy policy = STREAM_POLICY_SKIP);
+    void init_influxdb_connection(const std::string& hostname, unsigned int port, const std::string& dbname,
+        const remote_sender_config_t& sender_cfg = remote_sender_config_t());
+    void init_influxdb_udp_connection(const std::string& hostname, unsigned int port, unsigned int max_payload);
+    void init_prometheus_remote_write_connection(const std::string& hostname, unsigned int port,
+        const std::string& path = PROMETHEUS_REMOTE_WRITE_DEFAULT_PATH,
+        const std::map<std::string, std::string>& metaData = {},
+        const remote_sender_config_t& sender_cfg = remote_sender_config_t());
+    void init_otlp_connection(const std::string& hostname, unsigned int port,
+        const std::string& path = OTLP_DEFAULT_PATH, const std::map<std::string, std::string>& metaData = {},
+        const remote_sender_config_t& sender_cfg = remote_sender_config_t());
     void enable_json_pretty_print();
+    bool set_influxdb_precision(const std::string& precision); // one of s|ms|us|ns; must precede init_influxdb_*
+    bool add_output_filter(const std::string& sink_and_rules, std::string& errmsg)
+    {
+        return m_filters.add_rules(sink_and_rules, errmsg);
+    }
+    bool add_task_series_limit(const std::string& sink_and_limit, std::string& errmsg)
+    {
+        return m_filters.add_task_series_limit(sink_and_limit, errmsg);
+    }
     void close();
 
+    // returns true if at least one enabled sink wants some measurement of the given section;
+    // samplers can use this to skip reading statistics that would be discarded anyway
+    bool is_section_wanted(const char* section) const;
+    bool is_measurement_wanted(const char* section, const char* measurement) const;
+
+    // samplers producing per-task series use these to enforce the cardinality caps of each sink
+    sink_mask_t get_enabled_sinks() const { return m_enabled_sinks; }
+
+    // the labels of the subsections are used only by the remote sinks: when none is enabled, samplers can
+    // avoid building them
+    bool wants_labels() const { return (m_enabled_sinks & ~SINK_MASK(SINK_LOCAL_FILE)) != 0; }
+    const task_series_limit_t& get_task_series_limit(OutputSink sink) const
+    {
+        return m_filters.get_task_series_limit(sink);
+    }
+
+    // returns true if data is being streamed to some remote endpoint; their self-stats are reported by pstats()
+    bool has_remote_senders() const
+    {
+        return !m_influxdb_http_conns.empty() || !m_influxdb_udp_conns.empty() || !m_remote_write_conns.empty()
+            || !m_otlp_conns.empty();
+    }
+
+    // samplers register the descriptors of their KPIs only if some typed sink (Prometheus, OTLP) needs them
+    bool wants_kpi_descriptors() const
+    {
 #ifdef PROMETHEUS_SUPPORT
-    void init_prometheus_connection(const std::string& port, const std::map<std::string, std::string>& metaData = {});
+        if (m_prometheus_enabled)
+            return true;
+#endif
+        return !m_otlp_conns.empty() || !m_remote_write_conns.empty();
+    }
     void init_prometheus_kpis(const prometheus_kpi_descriptor* kpi, size_t size);
+
+#ifdef PROMETHEUS_SUPPORT
+    bool init_prometheus_connection(const std::string& address, unsigned int port,
+        const std::map<std::string, std::string>& metaData = {}, bool gzip = false);
     bool is_prometheus_enabled() const { return m_prometheus_enabled; }
+    unsigned int get_prometheus_port() const { return m_prometheus_server ? m_prometheus_server->get_port() : 0; }
 #endif
 
     //------------------------------------------------------------------------------
@@ -113,7 +192,11 @@ public:
     void psection_start(const char* section);
     void psection_end();
 
-    void psubsection_start(const char* resource, const std::map<std::string, std::string>& labels = {});
+    // the measurements of the subsection (and of its subsubsections) reach only the given sinks:
+    void psubsection_start(const char* resource, const std::map<std::string, std::string>& labels = {},
+        sink_mask_t sinks = SINK_MASK_ALL);
+    // same as above, for the common case of a single label: the labels are built only if wants_labels()
+    void psubsection_start(const char* resource, const char* label_name, const char* label_value);
     void psubsection_end();
 
     void psubsubsection_start(const char* resource, const std::map<std::string, std::string>& labels = {});
@@ -138,6 +221,23 @@ public:
     void push_header() { push_current_sections(true); } // writes on file, stdout or socket
     void push_current_sample() { push_current_sections(false); } // writes on file, stdout or socket
 
+    // looks up a numeric measurement of the current sample or, if not found there, of the header; the header is
+    // kept in memory only after enable_kpi_lookup() has been called
+    void enable_kpi_lookup() { m_keep_header = true; }
+    bool get_kpi_value(const std::string& section, const std::string& subsection, const std::string& measurement,
+        double& valueOUT) const;
+
+    //------------------------------------------------------------------------------
+    // Ring of held samples:
+    //------------------------------------------------------------------------------
+
+    // samples can be held in memory instead of being written: only the last num_samples ones are kept
+    void init_sample_ring(size_t num_samples) { m_held_samples_max = num_samples; }
+    void hold_current_sample();
+    size_t push_held_samples(); // writes the held samples, oldest first, and returns how many they were
+    void discard_held_samples() { m_held_samples.clear(); }
+    size_t get_num_held_samples() const { return m_held_samples.size(); }
+
 private:
     class CMonitorOutputMeasurement {
     public:
@@ -147,6 +247,7 @@ private:
             strncpy(m_value.data(), value, CMONITOR_MEASUREMENT_VALUE_MAXLEN - 1);
             m_dvalue = 0;
             m_numeric = false;
+            m_integer = false;
         }
         CMonitorOutputMeasurement(const char* name, double value)
         {
@@ -161,6 +262,7 @@ private:
             strncpy(m_value.data(), tmp.c_str(), CMONITOR_MEASUREMENT_VALUE_MAXLEN - 1);
             m_dvalue = value;
             m_numeric = true;
+            m_integer = false;
         }
         CMonitorOutputMeasurement(const char* name, long long value)
         {
@@ -173,13 +275,19 @@ private:
             // according to https://www.zverovich.net/2020/06/13/fast-int-to-string-revisited.html
             // fmt::format_int is be the fastest way to convert integers
 #if FMTLIB_MAJOR_VER >= 6
-            auto tmp = fmt::format_int(value);
+            fmt::format_int tmp(value);
 #else
             auto tmp = fmt::format("{}", value);
 #endif
-            strncpy(m_value.data(), tmp.c_str(), CMONITOR_MEASUREMENT_VALUE_MAXLEN - 1);
+            // copy exactly size() chars and terminate explicitly: relying on c_str() of a temporary
+            // fmt::format_int gets miscompiled by some GCC versions at -O2
+            size_t len = std::min(tmp.size(), (size_t)CMONITOR_MEASUREMENT_VALUE_MAXLEN - 1);
+            memcpy(m_value.data(), tmp.data(), len);
+            m_value[len] = '\0';
             m_dvalue = value;
+            m_lvalue = value;
             m_numeric = true;
+            m_integer = true;
         }
 
         void enforce_valid_json_string_value()
@@ -202,7 +310,10 @@ private:
         std::array<char, CMONITOR_MEASUREMENT_NAME_MAXLEN> m_name; // use std::array to void dynamic allocations
         std::array<char, CMONITOR_MEASUREMENT_VALUE_MAXLEN> m_value; // use std::array to void dynamic allocations
         double m_dvalue = 0; // double value to avoid atof conversion
+        long long m_lvalue = 0; // exact integer value, valid only when m_integer is set (used by binary encoders)
         bool m_numeric;
+        bool m_integer;
+        sink_mask_t m_sinks = SINK_MASK_ALL; // which output sinks want this measurement
     };
 
     typedef std::vector<CMonitorOutputMeasurement> CMonitorMeasurementVector;
@@ -211,6 +322,7 @@ private:
     public:
         std::string m_name;
         std::map<std::string, std::string> m_labels;
+        size_t m_labels_hash = 0; // computed once, when the labels are set: sinks compare this instead of m_labels
         CMonitorMeasurementVector m_measurements;
 
         std::string get_value_for_measurement(const std::string& name) const
@@ -226,6 +338,7 @@ private:
     public:
         std::string m_name;
         std::map<std::string, std::string> m_labels;
+        sink_mask_t m_sinks = SINK_MASK_ALL; // which output sinks want this subsection
         std::vector<CMonitorOutputSubSubsection> m_subsubsections;
         CMonitorMeasurementVector m_measurements;
 
@@ -253,6 +366,35 @@ private:
         }
     };
 
+    //------------------------------------------------------------------------------
+    // Section walk shared by all tree-shaped encoders (JSON, CBOR)
+    //------------------------------------------------------------------------------
+
+    // we do all the JSON/CBOR with max 4 nesting levels below the document root:
+    enum { FIRST_LEVEL = 1, SECOND_LEVEL = 2, THIRD_LEVEL = 3, FOURTH_LEVEL = 4, FIFTH_LEVEL = 5 };
+
+    // invokes, in document order:
+    //   object_start(name, num_children, level)   for each section/subsection/subsubsection
+    //   measurements(measurement_vector, level)   for each list of measurements
+    //   object_end(is_last, level)                when a section/subsection/subsubsection is complete
+    template <typename ObjectStartFn, typename MeasurementsFn, typename ObjectEndFn>
+    void walk_current_sections(
+        OutputSink sink, ObjectStartFn object_start, MeasurementsFn measurements, ObjectEndFn object_end);
+    size_t count_measurements_for_sink(const CMonitorMeasurementVector& measurements, OutputSink sink) const;
+    size_t count_subsections_for_sink(const CMonitorOutputSection& sec, OutputSink sink) const;
+
+    //------------------------------------------------------------------------------
+    // Output filters
+    //------------------------------------------------------------------------------
+
+    sink_mask_t get_measurement_sinks(const char* name)
+    {
+        if (m_filters.empty() || m_header_in_progress)
+            return SINK_MASK_ALL; // fast path
+        return m_filters.get_measurement_mask(m_current_section_filter_id, name) & m_enabled_sinks
+            & m_current_object_sinks;
+    }
+
     //------------------------------------------------------------------------------
     // JSON low-level functions
     //------------------------------------------------------------------------------
@@ -264,30 +406,113 @@ private:
     void push_json_array_start(const std::string& str, unsigned int indent);
     void push_json_array_end(unsigned int indent);
     void push_current_sections_to_json(bool is_header);
+    void push_current_sections_to_ndjson(bool is_header);
+
+    //------------------------------------------------------------------------------
+    // CBOR low-level functions
+    //------------------------------------------------------------------------------
+
+    void push_cbor_head(uint8_t major_type, uint64_t value);
+    void push_cbor_string(const char* str, size_t len);
+    void push_cbor_string(const std::string& str) { push_cbor_string(str.data(), str.size()); }
+    void push_cbor_measurements(CMonitorMeasurementVector& measurements);
+    void flush_cbor_buffer();
+    void push_current_sections_to_cbor(bool is_header);
 
     //------------------------------------------------------------------------------
     // InfluxDB low-level functions
     //------------------------------------------------------------------------------
 
     static bool contains_char_to_escape(const char* string);
-    static void get_quoted_field_value(std::string& out, const char* value);
+    static void append_quoted_field_value(std::string& out, const char* value);
     static void get_quoted_tag_value(std::string& out, const char* value);
+    static void append_escaped_measurement_name(std::string& out, const std::string& name);
 
-    std::string generate_influxdb_line(
-        CMonitorMeasurementVector& measurements, const std::string& meas_name, const std::string& ts_nsec);
+    const std::string& get_influxdb_series_prefix(const CMonitorOutputSection& sec,
+        const CMonitorOutputSubsection* subsec = nullptr, const CMonitorOutputSubSubsection* subsubsec = nullptr);
+    bool append_influxdb_line(
+        const std::string& series_prefix, const CMonitorMeasurementVector& measurements, const std::string& ts);
 
     void push_current_sections_to_influxdb(bool is_header);
 
+    //------------------------------------------------------------------------------
+    // Prometheus remote-write low-level functions
+    //------------------------------------------------------------------------------
+
+    // metric names are the same for the Prometheus pull (scrapes) and push (remote-write) modes:
+    static void get_prometheus_metric_name(std::string& out, const std::string& section, const char* measurement);
+
+    // series are identified by their position in the section/subsection/subsubsection hierarchy:
+    static void get_series_key(
+        std::string& out, const std::string& section, const std::string& parent_name, const std::string& object_name);
+
+    typedef struct {
+        std::map<std::string, std::string> object_labels; // labels the encoded labels were generated from
+        std::string labels_before_name; // encoded labels whose names sort before "__name__"
+        std::string labels_after_name; // encoded labels whose names sort after "__name__"
+        uint64_t last_sample = 0; // last sample that produced this series
+    } remote_write_series_t;
+
+    const remote_write_series_t& get_remote_write_labels(const std::string& section, const std::string& parent_name,
+        const std::string& object_name, const std::map<std::string, std::string>& object_labels);
+    unsigned int append_remote_write_timeseries(const std::string& section, const remote_write_series_t& series,
+        const CMonitorMeasurementVector& measurements, int64_t ts_msec);
+    void push_current_sections_to_prometheus_remote_write(bool is_header);
+
+    //------------------------------------------------------------------------------
+    // OTLP low-level functions
+    //------------------------------------------------------------------------------
+
+    typedef struct {
+        std::map<std::string, std::string> object_labels; // labels the encoded attributes were generated from
+        std::string encoded_attributes; // encoded NumberDataPoint.attributes fields
+        uint64_t start_time_nsec = 0; // start of the cumulative Sums: when the series (re)appeared
+        uint64_t last_sample = 0; // last sample that produced this series
+    } otlp_series_t;
+
+    const otlp_series_t& get_otlp_series(const std::string& section, const std::string& parent_name,
+        const std::string& object_name, const std::map<std::string, std::string>& object_labels, uint64_t ts_nsec);
+    unsigned int append_otlp_data_points(const std::string& section, const otlp_series_t& series,
+        const CMonitorMeasurementVector& measurements, uint64_t ts_nsec);
+    void push_current_sections_to_otlp(bool is_header);
+
+    void pstats_remote_worker(const std::string& prefix, CMonitorRemoteWorker* conn);
+
     // main output routine:
     void push_current_sections(bool is_header);
+    struct timespec get_current_sample_time() const;
 
 //------------------------------------------------------------------------------
 // Prometheus low-level functions
 //------------------------------------------------------------------------------
 #ifdef PROMETHEUS_SUPPORT
+    // The series updated by each section/subsection/subsubsection are resolved only the first time
+    // they get produced: steady-state updates go straight to the Gauge/Counter objects.
+    typedef struct {
+        std::string measurement; // name of the measurement the series was resolved for
+        prometheus_series_t series;
+    } prometheus_binding_t;
+    typedef struct {
+        std::map<std::string, std::string> object_labels; // the labels the series were resolved with
+        size_t object_labels_hash = 0; // their hash: a cheap pre-check before comparing them
+        std::vector<prometheus_binding_t> bindings; // indexed by position of the measurement
+        uint64_t last_sample = 0; // last sample of the section that updated this group
+    } prometheus_series_group_t;
+    typedef struct {
+        uint64_t samples = 0; // how many times this section has been produced
+        std::unordered_map<std::string, prometheus_series_group_t> groups; // keyed by subsection/subsubsection path
+    } prometheus_section_t;
+
+    prometheus_series_t resolve_prometheus_series(
+        const std::string& section, const char* measurement, const std::map<std::string, std::string>& labels);
+    void push_prometheus_measurements(prometheus_section_t& psec, const std::string& section,
+        const std::string& parent_name, const std::string& object_name,
+        const std::map<std::string, std::string>& object_labels, size_t object_labels_hash,
+        const CMonitorMeasurementVector& measurements);
+    void remove_prometheus_series(std::vector<prometheus_binding_t>& bindings);
+    void remove_stale_prometheus_series(prometheus_section_t& section);
     void push_current_sections_to_prometheus();
-    void generate_prometheus_metric(const std::string& metric_name, const std::string& metric_data, double metric_value,
-        const std::map<std::string, std::string>& labels = {});
+    void render_prometheus_payload();
 #endif
 
 private:
@@ -295,23 +520,109 @@ private:
     std::vector<CMonitorOutputSection> m_current_sections;
     CMonitorMeasurementVector* m_current_meas_list
         = nullptr; // pointer to current CMonitorMeasurementVector inside m_current_sections
+    bool m_header_in_progress = false; // output filters do not apply to the header
+    struct timespec m_current_sample_time = { 0, 0 }; // when psample_start() was called; remote sinks stamp with it
+
+    // header kept for get_kpi_value()
+    bool m_keep_header = false;
+    std::vector<CMonitorOutputSection> m_header_sections;
+
+    // held samples, oldest first
+    typedef struct {
+        struct timespec time;
+        std::vector<CMonitorOutputSection> sections;
+    } held_sample_t;
+    std::deque<held_sample_t> m_held_samples;
+    size_t m_held_samples_max = 0;
+
+    // Output filters
+    CMonitorOutputFilters m_filters;
+    sink_mask_t m_enabled_sinks = 0;
+    uint32_t m_current_section_filter_id = 0;
+    sink_mask_t m_current_object_sinks = SINK_MASK_ALL; // sinks of the subsection in progress
 
     // InfluxDB internals
-    influx_client_t* m_influxdb_client_conn = nullptr;
-    std::string m_influxdb_tagset;
+    std::vector<CMonitorRemoteWorker*> m_influxdb_http_conns; // each endpoint has its own connection and queue
+    std::vector<CMonitorUdpSender*> m_influxdb_udp_conns;
+    std::map<std::string, std::string> m_influxdb_tags; // host-wide tags, extracted from the header
+    std::string m_influxdb_precision_param; // value of the precision= query parameter; empty for nanoseconds
+    uint64_t m_influxdb_ts_divisor = 1; // converts nanoseconds to the timestamp precision
+
+    typedef struct {
+        std::map<std::string, std::string> subsec_labels; // labels the prefix was generated from
+        std::map<std::string, std::string> subsubsec_labels;
+        std::string prefix; // escaped "measurement,tagset " ready to be followed by the field set
+        uint64_t last_sample = 0; // last sample that produced this series
+    } influxdb_series_t;
+    std::unordered_map<std::string, influxdb_series_t> m_influxdb_series; // keyed by section/subsection path
+    std::string m_influxdb_series_key; // reused for the series lookups
+    std::shared_ptr<std::string> m_influxdb_buffer; // line protocol of the current sample; recycled when possible
+    uint64_t m_influxdb_sample_idx = 0;
+    size_t m_influxdb_sample_series = 0; // how many series the current sample produced
+
+    // Prometheus remote-write internals
+    std::vector<CMonitorRemoteWorker*> m_remote_write_conns;
+    std::map<std::string, std::string> m_remote_write_labels; // host-wide labels: job, instance and custom metadata
+    std::unordered_map<std::string, remote_write_series_t> m_remote_write_series; // keyed by section/subsection path
+    std::string m_remote_write_series_key; // reused for the series lookups
+    std::string m_remote_write_metric_name; // reused for each measurement
+    std::shared_ptr<std::string> m_remote_write_buffer; // TimeSeries of the current sample; recycled when possible
+    uint64_t m_remote_write_sample_idx = 0;
+
+    // OTLP internals
+    std::vector<CMonitorRemoteWorker*> m_otlp_conns;
+    std::map<std::string, std::string> m_otlp_resource_labels; // service.name, host.name and custom metadata
+    std::string m_otlp_resource_attributes; // encoded Resource.attributes, built from the header
+    std::unordered_map<std::string, otlp_series_t> m_otlp_series; // keyed by section/subsection path
+    std::string m_otlp_series_key; // reused for the series lookups
+
+    // the data points of each section are grouped by metric: one Metric message per KPI, not per series
+    typedef struct {
+        const prometheus_kpi_descriptor* descriptor = nullptr; // nullptr if unknown: the KPI is exported as a Gauge
+        std::string data_points; // encoded data points of the section in progress; its capacity is recycled
+        uint64_t last_section = 0; // last section that produced data points for this metric
+    } otlp_metric_t;
+    std::unordered_map<std::string, otlp_metric_t> m_otlp_metrics; // keyed by metric name
+    std::vector<std::pair<const std::string*, otlp_metric_t*>> m_otlp_section_metrics; // in order of appearance
+    std::string m_otlp_metric_name; // reused for each measurement
+    std::string m_otlp_encoded_metrics; // Metric messages of the section in progress
+    std::string m_otlp_encoded_scopes; // ScopeMetrics messages of the sample in progress
+    std::shared_ptr<std::string> m_otlp_buffer; // ResourceMetrics of the current sample; recycled when possible
+    uint64_t m_otlp_sample_idx = 0;
+    uint64_t m_otlp_section_idx = 0;
+
+    // KPI descriptors registered by the samplers, keyed by metric name; they point to static tables
+    std::unordered_map<std::string, const prometheus_kpi_descriptor*> m_kpi_descriptors;
 
     // JSON internals
     FILE* m_outputJson = nullptr;
     std::string m_onelevel_indent_string;
     bool m_json_pretty_print = false;
 
+    // CBOR internals
+    FILE* m_outputCbor = nullptr;
+    std::string m_cbor_buffer; // each sample is encoded here and then written with a single fwrite()
+
+    // shared-memory ring internals: samples are published with the same CBOR encoding of the file
+    CMonitorShmRingWriter* m_shm_ring = nullptr;
+
+    // Unix socket streaming internals
+    CMonitorStreamServer* m_stream_server = nullptr;
+    StreamFormat m_stream_format = STREAM_FORMAT_NDJSON;
+    size_t m_stream_frame_size_hint = 0; // size of the last NDJSON frame, to avoid reallocations
+
 // Prometheus exposer
 #ifdef PROMETHEUS_SUPPORT
     bool m_prometheus_enabled = false;
-    std::unique_ptr<prometheus::Exposer> m_prometheus_exposer;
-    std::shared_ptr<prometheus::Registry> m_prometheus_registry;
-    std::map<std::string, PrometheusKpi*> m_prometheus_kpi_map;
+    CMonitorPrometheusServer* m_prometheus_server = nullptr;
+    std::map<std::string, PrometheusKpi*> m_prometheus_kpi_map; // sorted by name, as rendered in the payload
     std::map<std::string, std::string> m_default_labels;
+    std::unordered_map<std::string, prometheus_section_t> m_prometheus_sections; // keyed by section name
+    std::string m_prometheus_group_key; // reused for the group lookups
+    std::string m_prometheus_metric_name; // reused while resolving new series
+    PrometheusKpi* m_prometheus_live_series_kpi = nullptr;
+    uint64_t m_prometheus_live_series = 0; // labelled series currently in the registry
+    uint64_t m_prometheus_removed_series = 0;
 #endif
 
     // Stats on the generated output
@@ -17,42 +17,16 @@
 #ifdef PROMETHEUS_SUPPORT
 #include "prometheus_counter.h"
 
-PrometheusCounter::PrometheusCounter(std::shared_ptr<prometheus::Registry> prometheus_registry, std::string kpi_name,
-    std::string kpi_description, std::map<std::string, std::string>& labels)
-    : m_prometheus_kpi_family(
-        prometheus::BuildCounter().Name(kpi_name).Help(kpi_description).Labels(labels).Register(*prometheus_registry))
-    , m_prometheus_kpi(m_prometheus_kpi_family.Add({}))
-
-{
-    m_prometheus_kpi_name = kpi_name;
-}
-
-void PrometheusCounter::set_kpi_value(double kpi_value)
-{
-    double previous_kpi_value = m_prometheus_kpi.Value();
-    if (kpi_value < previous_kpi_value) {
-        CMonitorLogger::instance()->LogError(
-            "PrometheusCounter::set_kpi_value, the current KPI value=%ld is less than the previous KPI value=%ld",
-            (uint64_t)kpi_value, (uint64_t)previous_kpi_value);
-        return;
-    } else if (kpi_value > previous_kpi_value) {
-        m_prometheus_kpi.Increment(kpi_value - previous_kpi_value);
-    }
-}
-
-void PrometheusCounter::set_kpi_value(double kpi_value, const std::map<std::string, std::string>& labels)
+void PrometheusCounter::set_series_value(prometheus_series_data_t& series, double kpi_value)
 {
-    prometheus::Counter& prometheus_kpi = m_prometheus_kpi_family.Add(labels);
-
-    double previous_kpi_value = prometheus_kpi.Value();
-    if (kpi_value < previous_kpi_value) {
+    // counters can only go up: values read from the kernel that went backwards are discarded
+    if (kpi_value < series.value) {
         CMonitorLogger::instance()->LogError("PrometheusCounter::set_kpi_value with kpi_name=%s, the current KPI value "
                                              "= %ld is less than the previous KPI "
                                              "value = %ld",
-            m_prometheus_kpi_name.c_str(), (uint64_t)kpi_value, (uint64_t)previous_kpi_value);
+            m_prometheus_kpi_name.c_str(), (uint64_t)kpi_value, (uint64_t)series.value);
         return;
-    } else if (kpi_value > previous_kpi_value) {
-        prometheus_kpi.Increment(kpi_value - previous_kpi_value);
     }
+    series.value = kpi_value;
 }
-#endif
\ No newline at end of file
+#endif
@@ -1,23 +1,15 @@
 /*
- * prometheus_counter.h
+ * prometheus_counter.h -- code for collecting prometheus counter metrics
  * Developer: Satyabrata Bharati.
  * (C) Copyright 2022 Francesco Montorsi
  *
  *  Description:
- Defines PrometheusCounter class which creates and maintains "prometheus::Family<prometheus::Counter>" and
- "prometheus::Counter" class reference for each KPI.
+ Defines PrometheusCounter class, used for each KPI with type "COUNTER".
  One object of PrometheusCounter class gets created per KPI, during application startup.
 
- prometheus::Family<prometheus::Counter> :
- This class creates a new metric of type prometheus::Counter.
- Every metric is uniquely identified by its name and a set of key-value pairs, also known as labels.
+ A counter represents a value that can only increase.
+ Every KPI is uniquely identified by its name; each distinct set of labels creates a new time series of it.
  Prometheus's query language allows filtering and aggregation based on metric name and these labels.
- Each new set of labels adds a new dimensional data and is exposed in Prometheus as a time series.
- It is possible to filter the time series with Prometheus's query language by appending a set of labels to match in
- curly braces ({}).
-
- prometheus::Counter :
- This class represents the metric type counter whose value can only increase.
 
  * This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU General Public License as published by
@@ -39,17 +31,15 @@
 #include <map>
 #include <string>
 
-// prometheus
-#include <prometheus/counter.h>
-#include <prometheus/family.h>
-#include <prometheus/registry.h>
-
 #include "prometheus_kpi.h"
 
 class PrometheusCounter : public PrometheusKpi {
 public:
-    PrometheusCounter(std::shared_ptr<prometheus::Registry> prometheus_registry, std::string kpi_name,
-        std::string kpi_description, std::map<std::string, std::string>& labels);
+    PrometheusCounter(const std::string& kpi_name, const std::string& kpi_description,
+        const std::map<std::string, std::string>& const_labels)
+        : PrometheusKpi(kpi_name, kpi_description, const_labels)
+    {
+    }
 
     PrometheusCounter(const PrometheusCounter&) = delete; // Copy constructor
     PrometheusCounter(PrometheusCounter&&) = delete; // Move constructor
@@ -58,18 +48,8 @@ public:
 
     virtual ~PrometheusCounter() = default;
 
-    virtual void set_kpi_value(double kpi_value);
-    virtual void set_kpi_value(double kpi_value, const std::map<std::string, std::string>& labels);
-
-private:
-    PrometheusCounter() = default;
-
-private:
-    // This is a reference inside the prometheus::Registry (m_prometheus_registry) whose lifetime must be longer than
-    // PrometheusCounter class.
-    prometheus::Family<prometheus::Counter>& m_prometheus_kpi_family;
-    // prometheus::Counter reference
-    prometheus::Counter& m_prometheus_kpi;
+    virtual void set_series_value(prometheus_series_data_t& series, double kpi_value);
+    virtual const char* get_type_name() const { return "counter"; }
 };
 #endif
 #endif
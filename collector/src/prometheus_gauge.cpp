@@ -18,22 +18,5 @@
 #ifdef PROMETHEUS_SUPPORT
 #include "prometheus_gauge.h"
 
-PrometheusGauge::PrometheusGauge(std::shared_ptr<prometheus::Registry> prometheus_registry, std::string kpi_name,
-    std::string kpi_description, std::map<std::string, std::string>& labels)
-    : m_prometheus_kpi_family(
-        prometheus::BuildGauge().Name(kpi_name).Help(kpi_description).Labels(labels).Register(*prometheus_registry))
-    , m_prometheus_kpi(m_prometheus_kpi_family.Add({}))
-
-{
-    m_prometheus_kpi_name = kpi_name;
-}
-
-void PrometheusGauge::set_kpi_value(double kpi_value) { m_prometheus_kpi.Set(kpi_value); }
-
-void PrometheusGauge::set_kpi_value(double kpi_value, const std::map<std::string, std::string>& labels)
-{
-    prometheus::Gauge& prometheus_kpi = m_prometheus_kpi_family.Add(labels);
-
-    prometheus_kpi.Set(kpi_value);
-}
-#endif
\ No newline at end of file
+void PrometheusGauge::set_series_value(prometheus_series_data_t& series, double kpi_value) { series.value = kpi_value; }
+#endif
@@ -4,21 +4,12 @@
  * (C) Copyright 2022 Francesco Montorsi
  *
  *  Description:
- Defines PrometheusGauge class which creates and maintains "prometheus::Family<prometheus::Gauge>" and
- "prometheus::Gauge" class reference for each kpi with type "GAUGE".
+ Defines PrometheusGauge class, used for each KPI with type "GAUGE".
  One object of PrometheusGauge class gets created per KPI, during application startup.
 
- prometheus::Family<prometheus::Gauge> :
- This class creates a new metric of type prometheus::Gauge.
- Every metric is uniquely identified by its name and a set of key-value pairs, also known as labels.
+ A gauge represents a value that can arbitrarily go up and down.
+ Every KPI is uniquely identified by its name; each distinct set of labels creates a new time series of it.
  Prometheus's query language allows filtering and aggregation based on metric name and these labels.
- Each new set of labels adds a new dimensional data and is exposed in Prometheus as a time series.
- It is possible to filter the time series with Prometheus's query language by appending a set of labels to match in
- curly braces ({}).
-
- * prometheus::Gauge :
- This class represents the metric type gauge whose value can arbitrarily go up and down.
-
 
  * This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU General Public License as published by
@@ -38,17 +29,15 @@
 #include <map>
 #include <string>
 
-// prometheus
-#include <prometheus/family.h>
-#include <prometheus/gauge.h>
-#include <prometheus/registry.h>
-
 #include "prometheus_kpi.h"
 
 class PrometheusGauge : public PrometheusKpi {
 public:
-    PrometheusGauge(std::shared_ptr<prometheus::Registry> prometheus_registry, std::string kpi_name,
-        std::string kpi_description, std::map<std::string, std::string>& labels);
+    PrometheusGauge(const std::string& kpi_name, const std::string& kpi_description,
+        const std::map<std::string, std::string>& const_labels)
+        : PrometheusKpi(kpi_name, kpi_description, const_labels)
+    {
+    }
 
     PrometheusGauge(const PrometheusGauge&) = delete; // Copy constructor
     PrometheusGauge(PrometheusGauge&&) = delete; // Move constructor
@@ -57,18 +46,8 @@ public:
 
     virtual ~PrometheusGauge() = default;
 
-    virtual void set_kpi_value(double kpi_value);
-    virtual void set_kpi_value(double kpi_value, const std::map<std::string, std::string>& labels);
-
-private:
-    PrometheusGauge() = default;
-
-private:
-    // This is a reference inside the prometheus::Registry (m_prometheus_registry) whose lifetime must be longer than
-    // PrometheusGauge class.
-    prometheus::Family<prometheus::Gauge>& m_prometheus_kpi_family;
-    // prometheus::Gauge reference
-    prometheus::Gauge& m_prometheus_kpi;
+    virtual void set_series_value(prometheus_series_data_t& series, double kpi_value);
+    virtual const char* get_type_name() const { return "gauge"; }
 };
 #endif
 #endif
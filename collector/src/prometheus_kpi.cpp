@@ -0,0 +1,141 @@
+/*
+ * prometheus_kpi.cpp -- time series storage and text exposition shared by all prometheus metrics
+ * Developer: Satyabrata Bharati.
+ * (C) Copyright 2022 Francesco Montorsi
+ *
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef PROMETHEUS_SUPPORT
+#include "prometheus_kpi.h"
+#include <cmath>
+#include <fmt/format.h>
+
+PrometheusKpi::PrometheusKpi(const std::string& kpi_name, const std::string& kpi_description,
+    const std::map<std::string, std::string>& const_labels)
+    : m_prometheus_kpi_name(kpi_name)
+    , m_const_labels(const_labels)
+{
+    // HELP text escaping: only backslash and newline
+    for (char c : kpi_description) {
+        if (c == '\\')
+            m_prometheus_kpi_help += "\\\\";
+        else if (c == '\n')
+            m_prometheus_kpi_help += "\\n";
+        else
+            m_prometheus_kpi_help.push_back(c);
+    }
+
+    m_default_series = find_or_add_series({});
+}
+
+prometheus_series_t PrometheusKpi::get_series(const std::map<std::string, std::string>& labels)
+{
+    prometheus_series_t ret;
+    ret.kpi = this;
+    ret.data = find_or_add_series(labels);
+    ret.data->refs++;
+    return ret;
+}
+
+prometheus_series_data_t* PrometheusKpi::find_or_add_series(const std::map<std::string, std::string>& labels)
+{
+    std::map<std::string, std::string> all_labels(labels);
+    all_labels.insert(m_const_labels.begin(), m_const_labels.end()); // labels of the series take precedence
+
+    std::string rendered_labels;
+    for (const auto& label : all_labels) {
+        if (label.second.empty())
+            continue; // an empty label value is equivalent to a missing label
+        rendered_labels += rendered_labels.empty() ? "{" : ",";
+        rendered_labels += label.first;
+        rendered_labels += "=\"";
+        append_escaped_label_value(rendered_labels, label.second);
+        rendered_labels += "\"";
+    }
+    if (!rendered_labels.empty())
+        rendered_labels += "}";
+
+    std::unique_ptr<prometheus_series_data_t>& series = m_series[rendered_labels];
+    if (!series) {
+        series.reset(new prometheus_series_data_t);
+        series->labels = rendered_labels;
+    }
+    return series.get();
+}
+
+void PrometheusKpi::remove_series(const prometheus_series_t& series)
+{
+    if (series.data == nullptr || series.data == m_default_series)
+        return;
+    // e.g. two subsections having the same labels share the series: the other one keeps updating it
+    if (series.data->refs > 1) {
+        series.data->refs--;
+        return;
+    }
+    m_series.erase(series.data->labels);
+}
+
+void PrometheusKpi::render(std::string& out) const
+{
+    out += "# HELP ";
+    out += m_prometheus_kpi_name;
+    out += " ";
+    out += m_prometheus_kpi_help;
+    out += "\n# TYPE ";
+    out += m_prometheus_kpi_name;
+    out += " ";
+    out += get_type_name();
+    out += "\n";
+    for (const auto& series : m_series) {
+        out += m_prometheus_kpi_name;
+        out += series.second->labels;
+        out += " ";
+        append_value(out, series.second->value);
+        out += "\n";
+    }
+}
+
+/* static */
+void PrometheusKpi::append_escaped_label_value(std::string& out, const std::string& value)
+{
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (c == '\n')
+            out += "\\n";
+        else
+            out.push_back(c);
+    }
+}
+
+/* static */
+void PrometheusKpi::append_value(std::string& out, double value)
+{
+    if (std::isnan(value)) {
+        out += "NaN";
+    } else if (std::isinf(value)) {
+        out += value > 0 ? "+Inf" : "-Inf";
+    } else if (value == std::trunc(value) && std::fabs(value) < 9.2e18) {
+        // most KPIs are integer counters: print them exactly and without exponent
+#if FMTLIB_MAJOR_VER >= 6
+        fmt::format_int tmp((long long)value);
+        out.append(tmp.data(), tmp.size());
+#else
+        out += fmt::format("{}", (long long)value);
+#endif
+    } else {
+        out += fmt::format("{}", value); // shortest representation that parses back to the same value
+    }
+}
+#endif
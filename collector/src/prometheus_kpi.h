@@ -5,8 +5,10 @@
 
 * Description:
 * Defines PrometheusKpi class which is an abstract base class for PrometheusCounter
-* class which creates Counter Family Object for each KPI with type "COUNTER" and
-* PrometheusGauge class which creates Gauge Family Object for each KPI with type "GAUGE".
+* class, used for each KPI with type "COUNTER", and PrometheusGauge class, used for
+* each KPI with type "GAUGE".
+* Every KPI owns its time series, i.e. one value for each distinct set of labels, and
+* renders them in the Prometheus text exposition format (version 0.0.4).
 
 * This program is free software: you can redistribute it and/or modify
  it under the terms of the GNU General Public License as published by
@@ -20,22 +22,52 @@
  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#ifdef PROMETHEUS_SUPPORT
 #ifndef _PROMETHEUS_KPI_H_
 #define _PROMETHEUS_KPI_H_
 
-#include "logger.h"
-#include <prometheus/metric_type.h>
+// The KPI descriptors are available also without Prometheus support: other typed sinks (OTLP)
+// use them to tell counters from gauges.
+enum class PrometheusKpiType {
+    Counter, // force newline
+    Gauge // force newline
+};
 
+// NOTE: plain C strings keep the descriptor tables free of static constructors
 typedef struct {
-    std::string kpi_name;
-    prometheus::MetricType kpi_type;
-    std::string description;
+    const char* kpi_name;
+    PrometheusKpiType kpi_type;
+    const char* description;
 } prometheus_kpi_descriptor;
 
+#ifdef PROMETHEUS_SUPPORT
+
+#include "logger.h"
+#include <map>
+#include <memory>
+#include <string>
+
+class PrometheusKpi;
+
+// The value of a KPI for a specific set of labels
+typedef struct {
+    std::string labels; // rendered label set, e.g. {metric="cpu",pid="1"}; empty if the series has no labels
+    double value = 0;
+    unsigned int refs = 0; // get_series() calls not balanced by remove_series() yet
+} prometheus_series_data_t;
+
+// A time series, resolved once inside its KPI: updating it does not require any lookup.
+// It stays valid until the series is removed from its KPI.
+typedef struct {
+    PrometheusKpi* kpi = nullptr; // nullptr if the KPI is not exposed to Prometheus
+    prometheus_series_data_t* data = nullptr;
+
+    void set_value(double kpi_value) const;
+} prometheus_series_t;
+
 class PrometheusKpi {
 public:
-    PrometheusKpi() = default;
+    PrometheusKpi(const std::string& kpi_name, const std::string& kpi_description,
+        const std::map<std::string, std::string>& const_labels);
     PrometheusKpi(const PrometheusKpi&) = delete; // Copy constructor
     PrometheusKpi(PrometheusKpi&&) = delete; // Move constructor
     PrometheusKpi& operator=(const PrometheusKpi&) = delete; // Copy assignment operator
@@ -43,11 +75,45 @@ public:
 
     virtual ~PrometheusKpi() = default;
 
-    virtual void set_kpi_value(double kpi_value) = 0;
-    virtual void set_kpi_value(double kpi_value, const std::map<std::string, std::string>& labels) = 0;
+    void set_kpi_value(double kpi_value) { set_series_value(*m_default_series, kpi_value); }
+    void set_kpi_value(double kpi_value, const std::map<std::string, std::string>& labels)
+    {
+        set_series_value(*find_or_add_series(labels), kpi_value);
+    }
+
+    // returns the series having the given labels, creating it if needed; several callers may get the same series
+    prometheus_series_t get_series(const std::map<std::string, std::string>& labels);
+
+    // releases a series obtained from get_series(), which must not be used anymore by the caller afterwards;
+    // the series is removed when all the callers that got it have released it
+    void remove_series(const prometheus_series_t& series);
+
+    // appends the HELP/TYPE comments and one line for each series in text exposition format
+    void render(std::string& out) const;
+
+    const std::string& get_kpi_name() const { return m_prometheus_kpi_name; }
+    size_t get_num_series() const { return m_series.size(); }
+
+    // type-specific update policy
+    virtual void set_series_value(prometheus_series_data_t& series, double kpi_value) = 0;
+    virtual const char* get_type_name() const = 0;
+
+    static void append_escaped_label_value(std::string& out, const std::string& value);
+    static void append_value(std::string& out, double value);
 
 protected:
+    prometheus_series_data_t* find_or_add_series(const std::map<std::string, std::string>& labels);
+
     std::string m_prometheus_kpi_name; // kpi_name
+    std::string m_prometheus_kpi_help;
+    std::map<std::string, std::string> m_const_labels; // added to every series
+
+    // all series of this KPI, keyed by their rendered label set; the std::map keeps the rendering sorted
+    std::map<std::string, std::unique_ptr<prometheus_series_data_t>> m_series;
+    prometheus_series_data_t* m_default_series = nullptr; // the one having only the constant labels
 };
+
+inline void prometheus_series_t::set_value(double kpi_value) const { kpi->set_series_value(*data, kpi_value); }
+
 #endif
 #endif
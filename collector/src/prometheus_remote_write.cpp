@@ -0,0 +1,90 @@
+/*
+ * prometheus_remote_write.cpp -- encoder for the Prometheus remote-write protocol
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "prometheus_remote_write.h"
+#include "protobuf_wire.h"
+
+// ----------------------------------------------------------------------------------
+// Remote-write labels
+// ----------------------------------------------------------------------------------
+
+static size_t label_size(size_t name_len, size_t value_len)
+{
+    return 1 + pb_varint_size(name_len) + name_len + 1 + pb_varint_size(value_len) + value_len;
+}
+
+static void append_label(std::string& out, const char* name, size_t name_len, const char* value, size_t value_len)
+{
+    out.push_back(PB_TAG(1, PB_WIRE_LEN)); // TimeSeries.labels
+    pb_append_varint(out, label_size(name_len, value_len));
+    out.push_back(PB_TAG(1, PB_WIRE_LEN)); // Label.name
+    pb_append_varint(out, name_len);
+    out.append(name, name_len);
+    out.push_back(PB_TAG(2, PB_WIRE_LEN)); // Label.value
+    pb_append_varint(out, value_len);
+    out.append(value, value_len);
+}
+
+// ----------------------------------------------------------------------------------
+// Remote-write messages
+// ----------------------------------------------------------------------------------
+
+void remote_write_sanitize_label_name(std::string& name)
+{
+    for (size_t i = 0; i < name.size(); i++) {
+        char c = name[i];
+        bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (i > 0 && c >= '0' && c <= '9');
+        if (!valid)
+            name[i] = '_';
+    }
+    if (name.empty())
+        name = "_";
+}
+
+void remote_write_append_label(std::string& out, const std::string& name, const std::string& value)
+{
+    append_label(out, name.data(), name.size(), value.data(), value.size());
+}
+
+void remote_write_append_timeseries(std::string& out, const std::string& metric_name,
+    const std::string& labels_before_name, const std::string& labels_after_name, double value,
+    int64_t timestamp_msec)
+{
+    static const char name_label[] = PROMETHEUS_REMOTE_WRITE_NAME_LABEL;
+    const size_t name_label_len = sizeof(name_label) - 1;
+
+    size_t name_size = label_size(name_label_len, metric_name.size());
+    size_t sample_size = 1 + 8 + 1 + pb_varint_size((uint64_t)timestamp_msec);
+    size_t timeseries_size = labels_before_name.size() + 1 + pb_varint_size(name_size) + name_size
+        + labels_after_name.size() + 1 + pb_varint_size(sample_size) + sample_size;
+
+    out.push_back(PB_TAG(1, PB_WIRE_LEN)); // WriteRequest.timeseries
+    pb_append_varint(out, timeseries_size);
+
+    out += labels_before_name;
+    append_label(out, name_label, name_label_len, metric_name.data(), metric_name.size());
+    out += labels_after_name;
+
+    out.push_back(PB_TAG(2, PB_WIRE_LEN)); // TimeSeries.samples
+    pb_append_varint(out, sample_size);
+    out.push_back(PB_TAG(1, PB_WIRE_FIXED64)); // Sample.value, little endian
+    pb_append_double(out, value);
+    out.push_back(PB_TAG(2, PB_WIRE_VARINT)); // Sample.timestamp
+    pb_append_varint(out, (uint64_t)timestamp_msec);
+}
@@ -0,0 +1,68 @@
+/*
+ * prometheus_remote_write.h -- encoder for the Prometheus remote-write protocol
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <string>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define PROMETHEUS_REMOTE_WRITE_DEFAULT_PATH "/api/v1/write"
+
+// headers mandated by the remote-write 1.0 specification; bodies must be snappy-compressed
+#define PROMETHEUS_REMOTE_WRITE_HEADERS                                                                                \
+    "Content-Type: application/x-protobuf\r\n"                                                                         \
+    "Content-Encoding: snappy\r\n"                                                                                     \
+    "X-Prometheus-Remote-Write-Version: 0.1.0\r\n"
+
+//------------------------------------------------------------------------------
+// Remote-write protobuf encoding
+//
+// A remote-write request body is a prometheus.WriteRequest message:
+//     message WriteRequest { repeated TimeSeries timeseries = 1; ... }
+//     message TimeSeries { repeated Label labels = 1; repeated Sample samples = 2; }
+//     message Label { string name = 1; string value = 2; }
+//     message Sample { double value = 1; int64 timestamp = 2; }
+// The few messages needed are encoded by hand. Since the concatenation of encoded repeated
+// fields is itself a valid encoding, the TimeSeries of each sample can simply be appended
+// to the current batch: a batch is a valid WriteRequest at any time.
+// Labels must be sorted by name, with the metric name in the "__name__" label; label names
+// must match [a-zA-Z_][a-zA-Z0-9_]*.
+//------------------------------------------------------------------------------
+
+#define PROMETHEUS_REMOTE_WRITE_NAME_LABEL "__name__"
+
+// replaces the characters not allowed in a label name with underscores
+void remote_write_sanitize_label_name(std::string& name);
+
+// appends a Label field, as found inside a TimeSeries message
+void remote_write_append_label(std::string& out, const std::string& name, const std::string& value);
+
+// appends a WriteRequest.timeseries field made of the pre-encoded labels sorting before "__name__",
+// the __name__ label, the pre-encoded labels sorting after "__name__" and a single sample
+void remote_write_append_timeseries(std::string& out, const std::string& metric_name,
+    const std::string& labels_before_name, const std::string& labels_after_name, double value,
+    int64_t timestamp_msec);
@@ -0,0 +1,452 @@
+/*
+ * prometheus_server.cpp -- minimal built-in HTTP server exposing the /metrics endpoint
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "prometheus_server.h"
+#include "logger.h"
+#include "utils_misc.h"
+#include "utils_string.h"
+#include <algorithm>
+#include <errno.h>
+#include <netdb.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// ----------------------------------------------------------------------------------
+// CMonitorPrometheusServer
+// ----------------------------------------------------------------------------------
+
+bool CMonitorPrometheusServer::init(const std::string& address, unsigned int port, bool gzip)
+{
+    if (gzip && !m_zstream_initialized) {
+        // windowBits = 15 + 16 selects the gzip wrapper instead of the zlib one
+        memset(&m_zstream, 0, sizeof(m_zstream));
+        if (deflateInit2(&m_zstream, PROMETHEUS_SERVER_GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY)
+            != Z_OK) {
+            CMonitorLogger::instance()->LogError("Cannot initialize the gzip compressor\n");
+            return false;
+        }
+        m_zstream_initialized = true;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+    struct addrinfo* res = nullptr;
+    int ret = getaddrinfo(address.empty() ? nullptr : address.c_str(), std::to_string(port).c_str(), &hints, &res);
+    if (ret != 0 || res == nullptr) {
+        CMonitorLogger::instance()->LogError(
+            "Lookup of listen address %s failed: %s\n", address.c_str(), gai_strerror(ret));
+        return false;
+    }
+
+    m_listen_fd = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (m_listen_fd != -1)
+        setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (m_listen_fd == -1 || bind(m_listen_fd, res->ai_addr, res->ai_addrlen) != 0
+        || listen(m_listen_fd, PROMETHEUS_SERVER_MAX_CONNECTIONS) != 0) {
+        CMonitorLogger::instance()->LogError(
+            "Failed to listen on %s:%u: %s\n", address.c_str(), port, strerror(errno));
+        freeaddrinfo(res);
+        close();
+        return false;
+    }
+    freeaddrinfo(res);
+
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(m_listen_fd, (struct sockaddr*)&addr, &len) == 0)
+        m_port = ntohs(addr.ss_family == AF_INET6 ? ((struct sockaddr_in6*)&addr)->sin6_port
+                                                  : ((struct sockaddr_in*)&addr)->sin_port);
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll_fd == -1 || m_stop_fd == -1) {
+        CMonitorLogger::instance()->LogError("Failed to create the epoll/eventfd descriptors: %s\n", strerror(errno));
+        close();
+        return false;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = m_listen_fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_listen_fd, &ev);
+    ev.data.fd = m_stop_fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_stop_fd, &ev);
+
+    m_thread = std::thread(&CMonitorPrometheusServer::run, this);
+    return true;
+}
+
+void CMonitorPrometheusServer::close()
+{
+    if (m_thread.joinable()) {
+        uint64_t one = 1;
+        ssize_t ret = write(m_stop_fd, &one, sizeof(one));
+        (void)ret;
+        m_thread.join();
+    }
+
+    while (!m_connections.empty())
+        close_connection(m_connections.begin()->first);
+    for (int* fd : { &m_listen_fd, &m_epoll_fd, &m_stop_fd }) {
+        if (*fd != -1)
+            ::close(*fd);
+        *fd = -1;
+    }
+    if (m_zstream_initialized)
+        deflateEnd(&m_zstream);
+    m_zstream_initialized = false;
+}
+
+std::string& CMonitorPrometheusServer::get_back_buffer()
+{
+    // the back buffer holds the payload published before the current one: connections which started sending
+    // it before the last swap might still hold a reference to it, in which case a new buffer is needed
+    if (!m_back_buffer || m_back_buffer.use_count() > 1) {
+        size_t size_hint = m_payload_bytes;
+        m_back_buffer = std::make_shared<prometheus_payload_t>();
+        m_back_buffer->text.reserve(size_hint + size_hint / 8);
+        m_payload_allocations++;
+    } else {
+        // pairs with the release done by the server thread when it dropped its last reference to this buffer
+        std::atomic_thread_fence(std::memory_order_acquire);
+        m_back_buffer->text.clear();
+    }
+    m_back_buffer->gzipped.clear();
+    return m_back_buffer->text;
+}
+
+void CMonitorPrometheusServer::swap_buffers()
+{
+    if (m_zstream_initialized && !gzip_payload(*m_back_buffer)) {
+        CMonitorLogger::instance()->LogError("Failed to gzip the Prometheus payload: serving it uncompressed\n");
+        m_back_buffer->gzipped.clear();
+    }
+    m_payload_bytes = m_back_buffer->text.size();
+    m_payload_gzip_bytes = m_back_buffer->gzipped.size();
+
+    // after this store no new scrape can pick up the previous payload, which becomes the next back buffer
+    std::atomic_store(&m_payload, std::shared_ptr<const prometheus_payload_t>(m_back_buffer));
+    m_front_buffer.swap(m_back_buffer);
+}
+
+bool CMonitorPrometheusServer::gzip_payload(prometheus_payload_t& payload)
+{
+    if (deflateReset(&m_zstream) != Z_OK)
+        return false;
+
+    payload.gzipped.resize(deflateBound(&m_zstream, payload.text.size()));
+    m_zstream.next_in = (Bytef*)payload.text.data();
+    m_zstream.avail_in = payload.text.size();
+    m_zstream.next_out = (Bytef*)&payload.gzipped[0];
+    m_zstream.avail_out = payload.gzipped.size();
+    if (deflate(&m_zstream, Z_FINISH) != Z_STREAM_END)
+        return false;
+    payload.gzipped.resize(m_zstream.total_out);
+    return true;
+}
+
+prometheus_server_stats_t CMonitorPrometheusServer::get_stats() const
+{
+    prometheus_server_stats_t ret;
+    ret.connections = m_connections_accepted;
+    ret.scrapes = m_scrapes;
+    ret.gzip_scrapes = m_gzip_scrapes;
+    ret.errors = m_errors;
+    ret.payload_bytes = m_payload_bytes;
+    ret.payload_gzip_bytes = m_payload_gzip_bytes;
+    ret.payload_allocations = m_payload_allocations;
+    return ret;
+}
+
+void CMonitorPrometheusServer::run()
+{
+    struct epoll_event events[32];
+    while (true) {
+        int n = epoll_wait(m_epoll_fd, events, 32, 1000 /* msec */);
+        if (n < 0 && errno != EINTR)
+            break;
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == m_stop_fd)
+                return;
+            if (fd == m_listen_fd) {
+                accept_connections();
+                continue;
+            }
+
+            auto it = m_connections.find(fd);
+            if (it == m_connections.end())
+                continue;
+            if (events[i].events & EPOLLOUT) {
+                if (!handle_writable(fd, it->second)) {
+                    close_connection(fd);
+                    continue;
+                }
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                handle_readable(fd, it->second);
+        }
+
+        close_idle_connections();
+    }
+}
+
+void CMonitorPrometheusServer::accept_connections()
+{
+    while (true) {
+        int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1)
+            return; // EAGAIN or a connection that went away already
+
+        if (m_connections.size() >= PROMETHEUS_SERVER_MAX_CONNECTIONS) {
+            ::close(fd);
+            m_errors++;
+            continue;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        m_connections[fd].last_activity_msec = get_monotonic_msec();
+        m_connections_accepted++;
+    }
+}
+
+void CMonitorPrometheusServer::handle_readable(int fd, connection_t& conn)
+{
+    char buf[4096];
+    while (true) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            conn.rx.append(buf, n);
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            close_connection(fd); // peer closed the connection
+            return;
+        }
+        if (errno != EINTR)
+            break;
+    }
+    conn.last_activity_msec = get_monotonic_msec();
+    if (conn.rx.size() > PROMETHEUS_SERVER_MAX_REQUEST_SIZE) {
+        m_errors++;
+        close_connection(fd);
+        return;
+    }
+
+    // pipelined requests are served one at a time: the next one is processed when the current response is sent
+    size_t end_of_head = conn.rx.find("\r\n\r\n");
+    if (!conn.tx_head.empty() || end_of_head == std::string::npos)
+        return;
+
+    std::string head = conn.rx.substr(0, end_of_head + 4);
+    conn.rx.erase(0, end_of_head + 4);
+    prepare_response(conn, head);
+    if (!handle_writable(fd, conn))
+        close_connection(fd);
+}
+
+// returns true if the given (lowercase) request head lists gzip among the accepted encodings
+static bool accepts_gzip(const std::string& lower_head)
+{
+    size_t start = lower_head.find("\r\naccept-encoding:");
+    if (start == std::string::npos)
+        return false;
+    start += 18;
+    size_t end = lower_head.find("\r\n", start);
+    for (const std::string& coding : split_string_in_array(lower_head.substr(start, end - start), ',')) {
+        // e.g. " gzip", "gzip;q=0.5" or "gzip; q=0" (which means NOT acceptable)
+        std::string name = coding, params;
+        size_t semicolon = coding.find(';');
+        if (semicolon != std::string::npos) {
+            name = coding.substr(0, semicolon);
+            params = coding.substr(semicolon + 1);
+        }
+        name.erase(std::remove(name.begin(), name.end(), ' '), name.end());
+        params.erase(std::remove(params.begin(), params.end(), ' '), params.end());
+        if (name == "gzip" || name == "x-gzip")
+            return params.compare(0, 3, "q=0") != 0 || strtod(params.c_str() + 2, nullptr) > 0;
+    }
+    return false;
+}
+
+void CMonitorPrometheusServer::prepare_response(connection_t& conn, const std::string& request_head)
+{
+    // request line is: METHOD SP TARGET SP VERSION
+    size_t sp1 = request_head.find(' ');
+    size_t sp2 = sp1 == std::string::npos ? std::string::npos : request_head.find(' ', sp1 + 1);
+    size_t eol = request_head.find("\r\n");
+    std::string method, target, version;
+    if (sp2 != std::string::npos && sp2 < eol) {
+        method = request_head.substr(0, sp1);
+        target = request_head.substr(sp1 + 1, sp2 - sp1 - 1);
+        version = request_head.substr(sp2 + 1, eol - sp2 - 1);
+    }
+
+    std::string lower_head = to_lower(request_head);
+    conn.close_after_tx = version != "HTTP/1.1"
+        ? lower_head.find("\r\nconnection: keep-alive\r\n") == std::string::npos
+        : lower_head.find("\r\nconnection: close\r\n") != std::string::npos;
+
+    int status = 200;
+    const char* reason = "OK";
+    bool send_body = true, gzipped = false;
+    std::shared_ptr<const std::string> body;
+    if (method.empty()) {
+        status = 400;
+        reason = "Bad Request";
+        conn.close_after_tx = true;
+    } else if (method != "GET" && method != "HEAD") {
+        status = 405;
+        reason = "Method Not Allowed";
+        conn.close_after_tx = true; // a request body might follow: do not try to parse it
+    } else if (target != "/metrics" && target.compare(0, 9, "/metrics?") != 0) {
+        status = 404;
+        reason = "Not Found";
+    } else {
+        send_body = method == "GET";
+        std::shared_ptr<const prometheus_payload_t> payload = std::atomic_load(&m_payload);
+        if (payload) {
+            gzipped = !payload->gzipped.empty() && accepts_gzip(lower_head);
+            // the body shares the ownership of the whole snapshot, which stays alive until the body is sent
+            body = std::shared_ptr<const std::string>(payload, gzipped ? &payload->gzipped : &payload->text);
+        }
+    }
+    if (status == 200) {
+        m_scrapes++;
+        if (gzipped)
+            m_gzip_scrapes++;
+    } else
+        m_errors++;
+
+    size_t body_size = body ? body->size() : 0;
+    conn.tx_head = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+    if (status == 200)
+        conn.tx_head += "Content-Type: " PROMETHEUS_TEXT_FORMAT_CONTENT_TYPE "\r\n";
+    if (gzipped)
+        conn.tx_head += "Content-Encoding: gzip\r\n";
+    if (status == 200 && m_zstream_initialized)
+        conn.tx_head += "Vary: Accept-Encoding\r\n";
+    conn.tx_head += "Content-Length: " + std::to_string(body_size) + "\r\n";
+    if (conn.close_after_tx)
+        conn.tx_head += "Connection: close\r\n";
+    conn.tx_head += "\r\n";
+    conn.tx_body = send_body ? body : nullptr;
+    conn.tx_offset = 0;
+}
+
+bool CMonitorPrometheusServer::handle_writable(int fd, connection_t& conn)
+{
+    while (!conn.tx_head.empty()) {
+        size_t head_size = conn.tx_head.size();
+        size_t body_size = conn.tx_body ? conn.tx_body->size() : 0;
+        if (conn.tx_offset == head_size + body_size) {
+            // response complete
+            conn.tx_head.clear();
+            conn.tx_body = nullptr;
+            if (conn.close_after_tx)
+                return false;
+
+            size_t end_of_head = conn.rx.find("\r\n\r\n");
+            if (end_of_head == std::string::npos)
+                break;
+            std::string head = conn.rx.substr(0, end_of_head + 4);
+            conn.rx.erase(0, end_of_head + 4);
+            prepare_response(conn, head);
+            continue;
+        }
+
+        struct iovec iov[2];
+        int iovcnt = 0;
+        if (conn.tx_offset < head_size) {
+            iov[iovcnt].iov_base = (void*)(conn.tx_head.data() + conn.tx_offset);
+            iov[iovcnt++].iov_len = head_size - conn.tx_offset;
+            if (body_size) {
+                iov[iovcnt].iov_base = (void*)conn.tx_body->data();
+                iov[iovcnt++].iov_len = body_size;
+            }
+        } else {
+            iov[iovcnt].iov_base = (void*)(conn.tx_body->data() + conn.tx_offset - head_size);
+            iov[iovcnt++].iov_len = head_size + body_size - conn.tx_offset;
+        }
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                m_errors++;
+                return false;
+            }
+
+            // socket buffer full: wait for the scraper to read
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN | EPOLLOUT;
+            ev.data.fd = fd;
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+            return true;
+        }
+        conn.tx_offset += n;
+        conn.last_activity_msec = get_monotonic_msec();
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    return true;
+}
+
+void CMonitorPrometheusServer::close_connection(int fd)
+{
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    m_connections.erase(fd);
+}
+
+void CMonitorPrometheusServer::close_idle_connections()
+{
+    uint64_t now = get_monotonic_msec();
+    for (auto it = m_connections.begin(); it != m_connections.end();) {
+        int fd = it->first;
+        bool idle = now - it->second.last_activity_msec > PROMETHEUS_SERVER_IDLE_TIMEOUT_MSEC;
+        ++it;
+        if (idle)
+            close_connection(fd);
+    }
+}
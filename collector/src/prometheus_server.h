@@ -0,0 +1,143 @@
+/*
+ * prometheus_server.h -- minimal built-in HTTP server exposing the /metrics endpoint
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <zlib.h>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define PROMETHEUS_SERVER_MAX_CONNECTIONS (64)
+#define PROMETHEUS_SERVER_MAX_REQUEST_SIZE (8192) // requests with larger heads are refused
+#define PROMETHEUS_SERVER_IDLE_TIMEOUT_MSEC (30000) // idle keep-alive connections are closed after this time
+
+#define PROMETHEUS_SERVER_GZIP_LEVEL (Z_BEST_SPEED)
+
+#define PROMETHEUS_TEXT_FORMAT_CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+typedef struct {
+    uint64_t connections = 0; // connections accepted
+    uint64_t scrapes = 0; // successful GET /metrics
+    uint64_t gzip_scrapes = 0; // successful GET /metrics answered with the gzipped payload
+    uint64_t errors = 0; // requests answered with an HTTP error or broken connections
+    uint64_t payload_bytes = 0; // size of the last published exposition text
+    uint64_t payload_gzip_bytes = 0; // size of its gzipped copy (zero when compression is disabled)
+    uint64_t payload_allocations = 0; // back buffers allocated because the previous one was still being sent
+} prometheus_server_stats_t;
+
+// An immutable snapshot of the exposition text, shared by all the scrapes started while it was the latest one
+typedef struct {
+    std::string text;
+    std::string gzipped; // the text above compressed once with gzip; empty when compression is disabled
+} prometheus_payload_t;
+
+//------------------------------------------------------------------------------
+// CMonitorPrometheusServer
+//
+// A tiny HTTP/1.1 server, run by a single thread driven by epoll, that answers
+//     GET /metrics
+// with the exposition text (format 0.0.4) rendered by the sampling loop. Keep-alive connections are supported.
+//
+// The payload is double-buffered: once per sample the output frontend renders the text into the back
+// buffer and swaps it with the served one. The swap is an atomic pointer store, so that scrapes never
+// touch the KPIs, never wait for the sampling loop and, however many scrapers are connected, just send
+// out the bytes of an immutable snapshot. When gzip is enabled the snapshot is also compressed once,
+// at swap time, for the scrapers sending "Accept-Encoding: gzip".
+// The back buffer is recycled as long as no connection is still sending it, so that in steady state
+// publishing a new payload does not allocate memory.
+//
+// This replaces the exposer of the prometheus-cpp library, which pulled in civetweb,
+// OpenSSL and libcurl and could not be started before daemonizing.
+//------------------------------------------------------------------------------
+
+class CMonitorPrometheusServer {
+public:
+    CMonitorPrometheusServer() { }
+    ~CMonitorPrometheusServer() { close(); }
+
+    // starts listening on the given address; port 0 selects an ephemeral port (see get_port())
+    bool init(const std::string& address, unsigned int port, bool gzip = false);
+    void close();
+
+    // payload publishing, to be used always from the same thread: the exposition text must be rendered into
+    // the (empty) string returned by get_back_buffer(); swap_buffers() then makes it the payload of next scrapes
+    std::string& get_back_buffer();
+    void swap_buffers();
+
+    unsigned int get_port() const { return m_port; }
+    prometheus_server_stats_t get_stats() const;
+
+private:
+    typedef struct {
+        std::string rx; // request bytes received so far
+        std::string tx_head; // response head being sent
+        std::shared_ptr<const std::string> tx_body; // response body being sent; kept alive until sent
+        size_t tx_offset = 0; // bytes of head+body already sent
+        bool close_after_tx = false;
+        uint64_t last_activity_msec = 0;
+    } connection_t;
+
+    bool gzip_payload(prometheus_payload_t& payload);
+
+    void run();
+    void accept_connections();
+    void handle_readable(int fd, connection_t& conn);
+    bool handle_writable(int fd, connection_t& conn); // returns false when the connection must be closed
+    void prepare_response(connection_t& conn, const std::string& request_head);
+    void close_connection(int fd);
+    void close_idle_connections();
+
+private:
+    int m_listen_fd = -1;
+    int m_epoll_fd = -1;
+    int m_stop_fd = -1; // eventfd used to wake up the server thread at close()
+    unsigned int m_port = 0;
+    std::thread m_thread;
+
+    std::map<int, connection_t> m_connections; // accessed only by the server thread
+
+    // payload buffers; m_payload is the only one accessed also by the server thread, through std::atomic_load()
+    std::shared_ptr<const prometheus_payload_t> m_payload;
+    std::shared_ptr<prometheus_payload_t> m_front_buffer; // same as m_payload
+    std::shared_ptr<prometheus_payload_t> m_back_buffer; // previous payload, or a new one being rendered
+
+    // gzip
+    z_stream m_zstream;
+    bool m_zstream_initialized = false;
+
+    std::atomic<uint64_t> m_connections_accepted { 0 };
+    std::atomic<uint64_t> m_scrapes { 0 };
+    std::atomic<uint64_t> m_gzip_scrapes { 0 };
+    std::atomic<uint64_t> m_errors { 0 };
+    std::atomic<uint64_t> m_payload_bytes { 0 };
+    std::atomic<uint64_t> m_payload_gzip_bytes { 0 };
+    std::atomic<uint64_t> m_payload_allocations { 0 };
+};
@@ -0,0 +1,88 @@
+/*
+ * protobuf_wire.h -- minimal helpers to hand-encode protobuf messages
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+//------------------------------------------------------------------------------
+// Protobuf wire format
+//
+// The push protocols (Prometheus remote-write, OTLP) use only a handful of protobuf messages,
+// which are encoded by hand rather than depending on libprotobuf.
+// See https://protobuf.dev/programming-guides/encoding/
+//------------------------------------------------------------------------------
+
+enum { PB_WIRE_VARINT = 0, PB_WIRE_FIXED64 = 1, PB_WIRE_LEN = 2 };
+
+// single-byte tag: valid for field numbers up to 15
+#define PB_TAG(field, wire_type) ((char)((field) << 3 | (wire_type)))
+
+inline size_t pb_varint_size(uint64_t v)
+{
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+inline void pb_append_varint(std::string& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+// fixed64, sfixed64 and double are all encoded as 8 little-endian bytes
+inline void pb_append_fixed64(std::string& out, uint64_t v)
+{
+    for (unsigned int i = 0; i < 8; i++)
+        out.push_back((char)(v >> (8 * i)));
+}
+
+inline void pb_append_double(std::string& out, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    pb_append_fixed64(out, bits);
+}
+
+// appends a LEN field: a string, bytes or an already-encoded sub-message
+inline void pb_append_len_field(std::string& out, unsigned int field, const char* data, size_t len)
+{
+    out.push_back(PB_TAG(field, PB_WIRE_LEN));
+    pb_append_varint(out, len);
+    out.append(data, len);
+}
+
+inline void pb_append_len_field(std::string& out, unsigned int field, const std::string& data)
+{
+    pb_append_len_field(out, field, data.data(), data.size());
+}
@@ -0,0 +1,349 @@
+/*
+ * remote_sender.cpp -- batching, queueing and spooling of data sent to remote HTTP endpoints
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "remote_sender.h"
+#include "logger.h"
+#include "snappy_codec.h"
+#include "utils_files.h"
+#include "utils_misc.h"
+#include <algorithm>
+#include <dirent.h>
+#include <fmt/format.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// ----------------------------------------------------------------------------------
+// CMonitorRemoteSender - init/close
+// ----------------------------------------------------------------------------------
+
+bool CMonitorRemoteSender::init(const std::string& hostname, unsigned int port, const std::string& path,
+    const std::string& extra_headers, const remote_sender_config_t& cfg)
+{
+    m_cfg = cfg;
+    m_cfg.batch_max_points = std::max(m_cfg.batch_max_points, 1U);
+    m_cfg.queue_max_batches = std::max(m_cfg.queue_max_batches, 1U);
+    m_path = path;
+    m_extra_headers = extra_headers;
+    m_extra_headers_gzip = extra_headers + "Content-Encoding: gzip\r\n";
+
+    if (m_cfg.gzip && !m_zstream_initialized) {
+        // windowBits = 15 + 16 selects the gzip wrapper instead of the zlib one
+        memset(&m_zstream, 0, sizeof(m_zstream));
+        if (deflateInit2(&m_zstream, REMOTE_SENDER_GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            CMonitorLogger::instance()->LogError("Cannot initialize the gzip compressor\n");
+            return false;
+        }
+        m_zstream_initialized = true;
+    }
+
+    if (!m_cfg.spool_dir.empty()) {
+        mkdir(m_cfg.spool_dir.c_str(), 0755);
+        if (!file_or_dir_exists(m_cfg.spool_dir.c_str())) {
+            CMonitorLogger::instance()->LogError("Cannot create spool directory %s\n", m_cfg.spool_dir.c_str());
+            return false;
+        }
+        load_spool();
+    }
+
+    return m_http.init(hostname, port);
+}
+
+CMonitorRemoteSender::~CMonitorRemoteSender()
+{
+    close();
+    if (m_zstream_initialized)
+        deflateEnd(&m_zstream);
+}
+
+void CMonitorRemoteSender::close()
+{
+    flush(true /* force */);
+
+    // at exit the limit of batches per flush does not apply: keep sending as long as the endpoint accepts data
+    for (uint64_t pending = get_pending_points(); pending > 0 && !m_queue.empty();) {
+        flush();
+        uint64_t left = get_pending_points();
+        if (left >= pending)
+            break;
+        pending = left;
+    }
+
+    // anything still in memory would be lost: move it to the spool to replay it at next run
+    while (!m_queue.empty() && !m_cfg.spool_dir.empty() && spill_to_spool(m_queue.front()))
+        m_queue.pop_front();
+
+    for (const auto& b : m_queue)
+        m_stats.dropped += b.npoints;
+    m_queue.clear();
+    m_http.disconnect();
+}
+
+uint64_t CMonitorRemoteSender::get_pending_points() const
+{
+    uint64_t ret = m_current_batch.npoints;
+    for (const auto& b : m_queue)
+        ret += b.npoints;
+    for (const auto& f : m_spool)
+        ret += f.npoints;
+    return ret;
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorRemoteSender - batching and sending
+// ----------------------------------------------------------------------------------
+
+void CMonitorRemoteSender::enqueue(const std::string& records, unsigned int npoints)
+{
+    if (npoints == 0)
+        return;
+
+    // the worker thread may enqueue several samples at once: never let them grow a batch beyond its limit
+    if (m_current_batch.npoints >= m_cfg.batch_max_points)
+        close_current_batch();
+    if (m_current_batch.npoints == 0)
+        m_current_batch_start_msec = get_monotonic_msec();
+
+    m_current_batch.payload += records;
+    m_current_batch.npoints += npoints;
+    m_stats.queued += npoints;
+}
+
+void CMonitorRemoteSender::close_current_batch()
+{
+    if (m_queue.size() >= m_cfg.queue_max_batches) {
+        // queue is full: make room by spilling (or dropping) the oldest batch
+        batch_t& oldest = m_queue.front();
+        if (m_cfg.spool_dir.empty() || !spill_to_spool(oldest)) {
+            CMonitorLogger::instance()->LogDebug(
+                "Remote sender queue is full: dropping a batch of %u points", oldest.npoints);
+            m_stats.dropped += oldest.npoints;
+        }
+        m_queue.pop_front();
+    }
+
+    size_t uncompressed_size = m_current_batch.payload.size();
+    m_stats.batch_uncompressed_bytes = uncompressed_size;
+    if (m_cfg.snappy) {
+        snappy_compress(m_current_batch.payload.data(), m_current_batch.payload.size(), m_compression_buffer);
+        m_current_batch.payload.swap(m_compression_buffer);
+    } else if (m_cfg.gzip && !gzip_batch(m_current_batch))
+        CMonitorLogger::instance()->LogError("Failed to gzip a batch of %u points: sending it uncompressed\n",
+            m_current_batch.npoints);
+    m_stats.batch_compressed_bytes = m_current_batch.payload.size();
+
+    m_queue.push_back(std::move(m_current_batch));
+    m_current_batch = batch_t();
+    m_current_batch.payload.reserve(uncompressed_size);
+}
+
+bool CMonitorRemoteSender::gzip_batch(batch_t& batch)
+{
+    // the compressor state is reused across batches to avoid reallocating its (large) internal buffers:
+    if (deflateReset(&m_zstream) != Z_OK)
+        return false;
+
+    m_compression_buffer.resize(deflateBound(&m_zstream, batch.payload.size()));
+    m_zstream.next_in = (Bytef*)batch.payload.data();
+    m_zstream.avail_in = batch.payload.size();
+    m_zstream.next_out = (Bytef*)&m_compression_buffer[0];
+    m_zstream.avail_out = m_compression_buffer.size();
+    if (deflate(&m_zstream, Z_FINISH) != Z_STREAM_END)
+        return false;
+    m_compression_buffer.resize(m_zstream.total_out);
+
+    // the old uncompressed payload ends up in m_compression_buffer, whose capacity is reused for next batch:
+    batch.payload.swap(m_compression_buffer);
+    batch.gzipped = true;
+    return true;
+}
+
+void CMonitorRemoteSender::flush(bool force)
+{
+    if (m_current_batch.npoints > 0
+        && (force || m_current_batch.npoints >= m_cfg.batch_max_points
+            || get_monotonic_msec() - m_current_batch_start_msec >= m_cfg.batch_max_msec))
+        close_current_batch();
+
+    // send the oldest data first: the spool always contains data older than the in-memory queue
+    for (unsigned int n = 0; n < REMOTE_SENDER_MAX_BATCHES_PER_FLUSH; n++) {
+        if (!m_spool.empty()) {
+            batch_t batch;
+            batch.failed_before = m_spool_head_failed_before;
+            if (!read_from_spool(m_spool.front(), batch)) {
+                remove_oldest_spool_file(true /* dropped */);
+                continue;
+            }
+
+            bool done = send_batch(batch);
+            m_spool_head_failed_before = batch.failed_before;
+            if (!done)
+                break;
+            remove_oldest_spool_file(false /* sent */);
+            m_spool_head_failed_before = false;
+        } else if (!m_queue.empty()) {
+            if (!send_batch(m_queue.front()))
+                break;
+            m_queue.pop_front();
+        } else
+            break;
+    }
+}
+
+bool CMonitorRemoteSender::send_batch(batch_t& batch)
+{
+    int status = m_http.post(
+        m_path, batch.gzipped ? m_extra_headers_gzip : m_extra_headers, batch.payload.data(), batch.payload.size());
+    if (status == HTTP_CLIENT_ERR_BACKOFF)
+        return false; // no attempt was actually done
+
+    if (batch.failed_before)
+        m_stats.retried += batch.npoints;
+
+    if (status / 100 == 2) {
+        if (m_failing)
+            CMonitorLogger::instance()->LogError("Remote endpoint %s:%u is accepting data again\n",
+                m_http.get_hostname().c_str(), m_http.get_port());
+        m_failing = false;
+        m_stats.sent += batch.npoints;
+        return true;
+    }
+    if (status / 100 == 4 && status != 408 && status != 429) {
+        // the server will never accept this batch (e.g. malformed data): no point in retrying it
+        CMonitorLogger::instance()->LogError("Remote endpoint %s:%u rejected a batch of %u points with status %d: %s\n",
+            m_http.get_hostname().c_str(), m_http.get_port(), batch.npoints, status,
+            m_http.get_last_response_body().c_str());
+        m_stats.dropped += batch.npoints;
+        return true;
+    }
+
+    // transient failure (network error, timeout, 5xx): keep the batch and retry at next flush;
+    // log only the transitions to avoid flooding the log while the endpoint is down
+    if (!m_failing)
+        CMonitorLogger::instance()->LogError("Failed to push data to remote endpoint %s:%u (status %d): %s\n",
+            m_http.get_hostname().c_str(), m_http.get_port(), status, m_http.get_last_response_body().c_str());
+    m_failing = true;
+    batch.failed_before = true;
+    return false;
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorRemoteSender - spool
+// ----------------------------------------------------------------------------------
+
+std::string CMonitorRemoteSender::get_spool_filename(const spool_file_t& f) const
+{
+    // the sequence number comes first and is zero-padded, so that lexicographic order is also chronological
+    return fmt::format("{}/{:020}-{}.batch", m_cfg.spool_dir, f.seq, f.npoints);
+}
+
+void CMonitorRemoteSender::load_spool()
+{
+    DIR* dir = opendir(m_cfg.spool_dir.c_str());
+    if (!dir)
+        return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        unsigned long long seq;
+        unsigned int npoints;
+        char ext[8];
+        if (sscanf(entry->d_name, "%llu-%u.%7s", &seq, &npoints, ext) != 3 || strcmp(ext, "batch") != 0)
+            continue;
+
+        spool_file_t f = { seq, npoints, 0 };
+        struct stat st;
+        if (stat(get_spool_filename(f).c_str(), &st) != 0)
+            continue;
+        f.size = st.st_size;
+        m_spool.push_back(f);
+        m_spool_bytes += f.size;
+    }
+    closedir(dir);
+
+    std::sort(m_spool.begin(), m_spool.end(),
+        [](const spool_file_t& a, const spool_file_t& b) -> bool { return a.seq < b.seq; });
+    if (!m_spool.empty()) {
+        m_spool_next_seq = m_spool.back().seq + 1;
+        CMonitorLogger::instance()->LogDebug("Found %zu batches to replay in spool directory %s", m_spool.size(),
+            m_cfg.spool_dir.c_str());
+    }
+}
+
+bool CMonitorRemoteSender::spill_to_spool(const batch_t& batch)
+{
+    // respect the spool size limit by dropping the oldest data:
+    while (!m_spool.empty() && m_spool_bytes + batch.payload.size() > m_cfg.spool_max_bytes)
+        remove_oldest_spool_file(true /* dropped */);
+    if (batch.payload.size() > m_cfg.spool_max_bytes)
+        return false;
+
+    spool_file_t f = { m_spool_next_seq++, batch.npoints, batch.payload.size() };
+    std::string filename = get_spool_filename(f);
+    std::string tmp_filename = filename + ".tmp";
+
+    // write + rename so that a crash never leaves a truncated batch behind:
+    FILE* fp = fopen(tmp_filename.c_str(), "w");
+    if (!fp)
+        return false;
+    bool ok = fwrite(batch.payload.data(), 1, batch.payload.size(), fp) == batch.payload.size();
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        unlink(tmp_filename.c_str());
+        CMonitorLogger::instance()->LogError("Failed to write spool file %s\n", filename.c_str());
+        return false;
+    }
+
+    if (m_spool.empty())
+        m_spool_head_failed_before = batch.failed_before;
+    m_spool.push_back(f);
+    m_spool_bytes += f.size;
+    m_stats.spooled += f.npoints;
+    return true;
+}
+
+bool CMonitorRemoteSender::read_from_spool(const spool_file_t& f, batch_t& batch)
+{
+    FILE* fp = fopen(get_spool_filename(f).c_str(), "r");
+    if (!fp)
+        return false;
+
+    batch.payload.resize(f.size);
+    bool ok = fread(&batch.payload[0], 1, f.size, fp) == f.size;
+    fclose(fp);
+    batch.npoints = f.npoints;
+
+    // the gzip magic number can never be the start of a text payload (snappy batches are always compressed):
+    batch.gzipped
+        = !m_cfg.snappy && f.size >= 2 && (uint8_t)batch.payload[0] == 0x1f && (uint8_t)batch.payload[1] == 0x8b;
+    return ok;
+}
+
+void CMonitorRemoteSender::remove_oldest_spool_file(bool dropped)
+{
+    const spool_file_t& f = m_spool.front();
+    unlink(get_spool_filename(f).c_str());
+    if (dropped) {
+        CMonitorLogger::instance()->LogDebug("Dropping spooled batch of %u points", f.npoints);
+        m_stats.dropped += f.npoints;
+    }
+    m_spool_bytes -= f.size;
+    m_spool.pop_front();
+    m_spool_head_failed_before = false;
+}
@@ -0,0 +1,160 @@
+/*
+ * remote_sender.h -- batching, queueing and spooling of data sent to remote HTTP endpoints
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include "http_client.h"
+#include <deque>
+#include <stdint.h>
+#include <string>
+#include <zlib.h>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define REMOTE_SENDER_DEFAULT_BATCH_POINTS (5000)
+#define REMOTE_SENDER_DEFAULT_BATCH_MSEC (1000)
+#define REMOTE_SENDER_DEFAULT_QUEUE_BATCHES (64)
+#define REMOTE_SENDER_DEFAULT_SPOOL_MAX_MB (256)
+
+// same as above, to be used in help strings:
+#define REMOTE_SENDER_DEFAULT_BATCH_POINTS_STR "5000"
+#define REMOTE_SENDER_DEFAULT_BATCH_MSEC_STR "1000"
+#define REMOTE_SENDER_DEFAULT_QUEUE_BATCHES_STR "64"
+#define REMOTE_SENDER_DEFAULT_SPOOL_MAX_MB_STR "256"
+
+// upper bound to the number of requests done by a single flush(), to bound the time spent
+// replaying a long backlog inside the sampling loop:
+#define REMOTE_SENDER_MAX_BATCHES_PER_FLUSH (16)
+
+// text payloads like the line protocol compress very well already at the fastest level:
+#define REMOTE_SENDER_GZIP_LEVEL (Z_BEST_SPEED)
+
+typedef struct {
+    unsigned int batch_max_points = REMOTE_SENDER_DEFAULT_BATCH_POINTS;
+    unsigned int batch_max_msec = REMOTE_SENDER_DEFAULT_BATCH_MSEC;
+    unsigned int queue_max_batches = REMOTE_SENDER_DEFAULT_QUEUE_BATCHES;
+    std::string spool_dir; // empty means: drop batches when the in-memory queue is full
+    uint64_t spool_max_bytes = (uint64_t)REMOTE_SENDER_DEFAULT_SPOOL_MAX_MB * 1024 * 1024;
+    bool gzip = false; // send batches with "Content-Encoding: gzip"
+    bool snappy = false; // compress batches with snappy; the caller provides the Content-Encoding header
+} remote_sender_config_t;
+
+typedef struct {
+    uint64_t queued = 0; // points accepted by enqueue()
+    uint64_t sent = 0; // points acknowledged by the server
+    uint64_t dropped = 0; // points lost because of queue/spool overflow or rejected by the server
+    uint64_t retried = 0; // points sent again after a failed attempt (counted at every new attempt)
+    uint64_t spooled = 0; // points spilled to disk
+    uint64_t batch_uncompressed_bytes = 0; // size of the last closed batch
+    uint64_t batch_compressed_bytes = 0; // size on the wire of the last closed batch (same as above if not compressed)
+} remote_sender_stats_t;
+
+//------------------------------------------------------------------------------
+// CMonitorRemoteSender
+//
+// Accumulates records into batches and POSTs them to an HTTP endpoint over a
+// CMonitorHttpClient. A batch is closed when it reaches the configured number of points or
+// when it becomes older than the configured delay, whichever comes first.
+// Closed batches wait in a bounded in-memory queue until the server accepts them; when the
+// queue is full the oldest batches are spilled to the spool directory (if any) and replayed
+// in order, before any newer batch, once the server is reachable again. The spool survives
+// restarts of the collector.
+// When gzip (or snappy, for protocols mandating it) is enabled, each batch is compressed once,
+// when it gets closed; spooled batches are stored compressed as well.
+//------------------------------------------------------------------------------
+
+class CMonitorRemoteSender {
+public:
+    CMonitorRemoteSender() { }
+    ~CMonitorRemoteSender();
+
+    bool init(const std::string& hostname, unsigned int port, const std::string& path, const std::string& extra_headers,
+        const remote_sender_config_t& cfg);
+
+    // appends to the current batch the given records, which must be already separated/terminated
+    // as required by the wire protocol
+    void enqueue(const std::string& records, unsigned int npoints);
+
+    // closes the current batch if it is full or old enough (or if force is true) and then tries to
+    // send all queued batches
+    void flush(bool force = false);
+
+    // last attempt to send everything; what cannot be sent is moved to the spool (if any)
+    void close();
+
+    const remote_sender_stats_t& get_stats() const { return m_stats; }
+    uint64_t get_pending_points() const;
+    CMonitorHttpClient& get_http_client() { return m_http; }
+
+private:
+    typedef struct {
+        std::string payload;
+        unsigned int npoints = 0;
+        bool failed_before = false;
+        bool gzipped = false;
+    } batch_t;
+
+    typedef struct {
+        uint64_t seq;
+        unsigned int npoints;
+        uint64_t size;
+    } spool_file_t;
+
+    void close_current_batch();
+    bool gzip_batch(batch_t& batch);
+    bool send_batch(batch_t& batch); // returns true if the batch must be removed from the queue
+
+    // spool
+    void load_spool();
+    std::string get_spool_filename(const spool_file_t& f) const;
+    bool spill_to_spool(const batch_t& batch);
+    bool read_from_spool(const spool_file_t& f, batch_t& batch);
+    void remove_oldest_spool_file(bool dropped);
+
+private:
+    remote_sender_config_t m_cfg;
+    std::string m_path;
+    std::string m_extra_headers;
+    std::string m_extra_headers_gzip; // same as above plus the Content-Encoding header
+    CMonitorHttpClient m_http;
+
+    // compression
+    z_stream m_zstream;
+    bool m_zstream_initialized = false;
+    std::string m_compression_buffer; // reused across batches
+
+    batch_t m_current_batch;
+    uint64_t m_current_batch_start_msec = 0;
+    std::deque<batch_t> m_queue;
+
+    std::deque<spool_file_t> m_spool; // always older than anything in m_queue
+    uint64_t m_spool_bytes = 0;
+    uint64_t m_spool_next_seq = 0;
+    bool m_spool_head_failed_before = false;
+
+    bool m_failing = false;
+
+    remote_sender_stats_t m_stats;
+};
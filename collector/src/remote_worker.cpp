@@ -0,0 +1,124 @@
+/*
+ * remote_worker.cpp -- background thread driving one remote endpoint
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "remote_worker.h"
+#include "logger.h"
+#include <algorithm>
+
+// ----------------------------------------------------------------------------------
+// CMonitorRemoteWorker - sampling-loop side
+// ----------------------------------------------------------------------------------
+
+bool CMonitorRemoteWorker::init(const std::string& hostname, unsigned int port, const std::string& path,
+    const std::string& extra_headers, const remote_sender_config_t& cfg)
+{
+    if (!m_sender.init(hostname, port, path, extra_headers, cfg))
+        return false;
+
+    m_hostname = hostname;
+    m_port = port;
+    m_batch_max_msec = std::max(cfg.batch_max_msec, 1U);
+    m_max_pending_points = (uint64_t)std::max(cfg.batch_max_points, 1U) * std::max(cfg.queue_max_batches, 1U);
+    m_thread = std::thread(&CMonitorRemoteWorker::run, this);
+    return true;
+}
+
+void CMonitorRemoteWorker::submit(const remote_payload_t& payload, unsigned int npoints)
+{
+    if (npoints == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_pending.push_back({ payload, npoints });
+        m_pending_points += npoints;
+        while (m_pending_points > m_max_pending_points && m_pending.size() > 1) {
+            m_pending_points -= m_pending.front().npoints;
+            m_dropped_before_sender += m_pending.front().npoints;
+            m_pending.pop_front();
+        }
+    }
+    m_cond.notify_one();
+}
+
+void CMonitorRemoteWorker::close()
+{
+    if (!m_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_one();
+    m_thread.join();
+}
+
+remote_sender_stats_t CMonitorRemoteWorker::get_stats()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    remote_sender_stats_t ret = m_stats_snapshot;
+
+    // points that did not reach the sender yet are accounted here:
+    ret.queued += m_pending_points + m_dropped_before_sender;
+    ret.dropped += m_dropped_before_sender;
+    return ret;
+}
+
+uint64_t CMonitorRemoteWorker::get_pending_points()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_sender_pending_points_snapshot + m_pending_points;
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorRemoteWorker - worker thread
+// ----------------------------------------------------------------------------------
+
+void CMonitorRemoteWorker::run()
+{
+    std::deque<pending_sample_t> samples;
+    bool stop = false;
+    while (!stop) {
+        {
+            // wake up at least once per batch period, to send batches that became old enough:
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait_for(lock, std::chrono::milliseconds(m_batch_max_msec),
+                [this]() -> bool { return m_stop || !m_pending.empty(); });
+            samples.swap(m_pending);
+            m_pending_points = 0;
+            stop = m_stop;
+        }
+
+        for (auto& s : samples)
+            m_sender.enqueue(*s.payload, s.npoints);
+        samples.clear(); // release the payloads as soon as possible: the sampling loop can then reuse them
+
+        if (stop)
+            m_sender.close();
+        else
+            m_sender.flush();
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stats_snapshot = m_sender.get_stats();
+        m_sender_pending_points_snapshot = m_sender.get_pending_points();
+    }
+
+    CMonitorLogger::instance()->LogDebug("Stopped the sender thread of remote endpoint %s:%u", m_hostname.c_str(), m_port);
+}
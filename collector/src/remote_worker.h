@@ -0,0 +1,99 @@
+/*
+ * remote_worker.h -- background thread driving one remote endpoint
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include "remote_sender.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+// the encoded data of a sample; it is produced once and shared read-only by all endpoints
+typedef std::shared_ptr<const std::string> remote_payload_t;
+
+//------------------------------------------------------------------------------
+// CMonitorRemoteWorker
+//
+// Owns a CMonitorRemoteSender (i.e. a connection, a batch queue and a spool) and drives it
+// from a dedicated thread, so that a slow or unreachable endpoint never delays the sampling
+// loop nor the other endpoints. The sampling loop just hands over a reference to the payload
+// of each sample; the worker appends it to its own current batch and flushes it according
+// to the batching policy.
+// If the worker falls behind, the payloads waiting for it are bounded to the same number of
+// points its queue can hold; beyond that the oldest samples are dropped.
+//------------------------------------------------------------------------------
+
+class CMonitorRemoteWorker {
+public:
+    CMonitorRemoteWorker() { }
+    ~CMonitorRemoteWorker() { close(); }
+
+    bool init(const std::string& hostname, unsigned int port, const std::string& path, const std::string& extra_headers,
+        const remote_sender_config_t& cfg);
+
+    // never blocks on the network
+    void submit(const remote_payload_t& payload, unsigned int npoints);
+
+    // stops the thread after a last attempt to send everything (see CMonitorRemoteSender::close)
+    void close();
+
+    // snapshots of the sender state, updated by the worker thread after each flush
+    remote_sender_stats_t get_stats();
+    uint64_t get_pending_points();
+
+    const std::string& get_hostname() const { return m_hostname; }
+    unsigned int get_port() const { return m_port; }
+
+private:
+    typedef struct {
+        remote_payload_t payload;
+        unsigned int npoints;
+    } pending_sample_t;
+
+    void run();
+
+private:
+    CMonitorRemoteSender m_sender; // accessed only by the worker thread once started
+    std::string m_hostname;
+    unsigned int m_port = 0;
+    unsigned int m_batch_max_msec = REMOTE_SENDER_DEFAULT_BATCH_MSEC;
+    uint64_t m_max_pending_points = 0;
+    std::thread m_thread;
+
+    // shared with the worker thread
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<pending_sample_t> m_pending;
+    uint64_t m_pending_points = 0;
+    bool m_stop = false;
+    uint64_t m_dropped_before_sender = 0; // points dropped because the worker fell behind
+    remote_sender_stats_t m_stats_snapshot;
+    uint64_t m_sender_pending_points_snapshot = 0;
+};
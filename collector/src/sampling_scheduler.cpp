@@ -0,0 +1,172 @@
+/*
+ * sampling_scheduler.cpp -- drift-free scheduling of the sampling loop
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sampling_scheduler.h"
+#include <algorithm>
+#include <errno.h>
+#include <poll.h>
+
+// ----------------------------------------------------------------------------------
+// Helpers
+// ----------------------------------------------------------------------------------
+
+#define NSEC_PER_SEC (1000000000ULL)
+
+static uint64_t timespec_to_nsec(const struct timespec& ts) { return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec; }
+
+static struct timespec nsec_to_timespec(uint64_t nsec)
+{
+    struct timespec ts;
+    ts.tv_sec = nsec / NSEC_PER_SEC;
+    ts.tv_nsec = nsec % NSEC_PER_SEC;
+    return ts;
+}
+
+static uint64_t get_monotonic_nsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return timespec_to_nsec(ts);
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorSamplingPlan
+// ----------------------------------------------------------------------------------
+
+static uint64_t gcd(uint64_t a, uint64_t b) { return b == 0 ? a : gcd(b, a % b); }
+
+bool CMonitorSamplingPlan::init(unsigned int collect_flags, uint64_t default_interval_msec,
+    const std::map<unsigned int, uint64_t>& family_intervals, uint64_t min_tick_msec)
+{
+    // group the families by interval:
+    std::map<uint64_t, unsigned int> intervals;
+    unsigned int default_families = collect_flags;
+    for (const auto& it : family_intervals) {
+        if ((it.first & collect_flags) == 0 || it.second == 0)
+            continue;
+        intervals[it.second] |= it.first & collect_flags;
+        default_families &= ~it.first;
+    }
+    if (default_families || intervals.empty())
+        intervals[default_interval_msec] |= default_families;
+
+    uint64_t tick_msec = 0;
+    for (const auto& it : intervals)
+        tick_msec = gcd(it.first, tick_msec);
+    if (tick_msec < min_tick_msec || tick_msec == 0)
+        return false;
+
+    m_tick_msec = tick_msec;
+    m_tick_periods.clear();
+    for (const auto& it : intervals)
+        m_tick_periods[it.first / m_tick_msec] |= it.second;
+    return true;
+}
+
+unsigned int CMonitorSamplingPlan::get_due_families(uint64_t tick) const
+{
+    unsigned int ret = 0;
+    for (const auto& it : m_tick_periods)
+        if (tick % it.first == 0)
+            ret |= it.second;
+    return ret;
+}
+
+unsigned int CMonitorSamplingPlan::get_due_families(uint64_t first_tick, uint64_t last_tick) const
+{
+    unsigned int ret = 0;
+    for (const auto& it : m_tick_periods)
+        if (last_tick / it.first * it.first >= first_tick) // the last multiple of the period not after last_tick
+            ret |= it.second;
+    return ret;
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorSamplingScheduler
+// ----------------------------------------------------------------------------------
+
+void CMonitorSamplingScheduler::init(uint64_t interval_msec, MissedDeadlinePolicy policy)
+{
+    m_interval_nsec = interval_msec * 1000000;
+    m_policy = policy;
+    m_stats = sampling_scheduler_stats_t();
+}
+
+void CMonitorSamplingScheduler::start(uint64_t first_delay_msec)
+{
+    m_deadline = nsec_to_timespec(get_monotonic_nsec() + first_delay_msec * 1000000);
+}
+
+void CMonitorSamplingScheduler::set_interval(uint64_t interval_msec)
+{
+    m_interval_nsec = interval_msec * 1000000;
+    m_deadline = nsec_to_timespec(get_monotonic_nsec() + m_interval_nsec);
+}
+
+uint64_t CMonitorSamplingScheduler::wait_next_deadline(int wakeup_fd, bool* woken_upOUT)
+{
+    uint64_t deadline = timespec_to_nsec(m_deadline);
+    uint64_t now = get_monotonic_nsec();
+    if (woken_upOUT)
+        *woken_upOUT = false;
+
+    if (now < deadline) {
+        int ret;
+        if (wakeup_fd == -1) {
+            // TIMER_ABSTIME: resuming after a signal does not extend the sleep, and the deadline does not depend
+            // on when we got here
+            ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &m_deadline, nullptr);
+        } else {
+            // ppoll() takes a relative timeout, whose nsec resolution is enough to keep the same precision:
+            struct timespec timeout = nsec_to_timespec(deadline - now);
+            struct pollfd pfd = { wakeup_fd, POLLIN, 0 };
+            int nready = ppoll(&pfd, 1, &timeout, nullptr);
+            if (nready > 0) {
+                m_stats.wakeups++;
+                if (woken_upOUT)
+                    *woken_upOUT = true;
+                return 0;
+            }
+            ret = nready == -1 ? errno : 0;
+        }
+        now = get_monotonic_nsec();
+        if (ret == EINTR && now < deadline)
+            return 0; // keep the same deadline for the next wait
+
+        m_stats.deadlines++;
+        m_stats.last_jitter_usec = (now - deadline) / 1000;
+        m_stats.max_jitter_usec = std::max(m_stats.max_jitter_usec, m_stats.last_jitter_usec);
+        m_stats.total_jitter_usec += m_stats.last_jitter_usec;
+    } else {
+        // the previous sample took longer than the interval: do not wait at all
+        m_stats.deadlines++;
+        m_stats.overruns++;
+    }
+
+    deadline += m_interval_nsec;
+    uint64_t missed = 0;
+    if (m_policy == MISSED_DEADLINE_SKIP && now >= deadline && m_interval_nsec > 0) {
+        // realign to the original grid of deadlines, so that samples stay equally spaced
+        missed = (now - deadline) / m_interval_nsec + 1;
+        deadline += missed * m_interval_nsec;
+        m_stats.skipped += missed;
+    }
+    m_deadline = nsec_to_timespec(deadline);
+    return 1 + missed;
+}
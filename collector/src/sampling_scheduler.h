@@ -0,0 +1,122 @@
+/*
+ * sampling_scheduler.h -- drift-free scheduling of the sampling loop
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <map>
+#include <stdint.h>
+#include <time.h>
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+// what to do when sampling took longer than the sampling interval and the next deadline(s) already passed
+enum MissedDeadlinePolicy {
+    MISSED_DEADLINE_SKIP, // skip the missed deadlines: the next sample is taken at the next deadline in the future
+    MISSED_DEADLINE_CATCH_UP, // take the missed samples back-to-back until the schedule is caught up
+};
+
+typedef struct {
+    uint64_t deadlines = 0; // deadlines waited for
+    uint64_t overruns = 0; // waits started when the deadline had already passed
+    uint64_t skipped = 0; // deadlines skipped because of MISSED_DEADLINE_SKIP
+    uint64_t wakeups = 0; // waits ended before the deadline because the wakeup file descriptor became readable
+    uint64_t last_jitter_usec = 0; // delay of the last wakeup with respect to its deadline
+    uint64_t max_jitter_usec = 0;
+    uint64_t total_jitter_usec = 0; // sum of all the wakeup delays, to compute the average
+} sampling_scheduler_stats_t;
+
+//------------------------------------------------------------------------------
+// CMonitorSamplingPlan
+//
+// Decides which KPI families are sampled at each tick of the sampling loop when families have different
+// sampling intervals, e.g. CPU every 100msecs and disks every 10secs. The tick is the greatest common divisor
+// of all the intervals, so that families whose intervals are multiples of each other are sampled together.
+// Intervals which are not multiple of each other can make the tick very short (e.g. 1001msecs and 1000msecs
+// give a 1msec tick): the plan refuses a tick shorter than the given minimum.
+// At tick 0 all the families are due.
+//------------------------------------------------------------------------------
+
+class CMonitorSamplingPlan {
+public:
+    CMonitorSamplingPlan() { }
+
+    // families are bitmasks of PerformanceKpiFamily values: those in collect_flags without an interval
+    // in family_intervals are sampled at the default interval.
+    // Returns false if the resulting tick is shorter than min_tick_msec: in that case the plan is not changed
+    bool init(unsigned int collect_flags, uint64_t default_interval_msec,
+        const std::map<unsigned int, uint64_t>& family_intervals, uint64_t min_tick_msec = 1);
+
+    uint64_t get_tick_msec() const { return m_tick_msec; }
+    bool is_multi_rate() const { return m_tick_periods.size() > 1; }
+
+    // returns the bitmask of the families to sample at the given tick; it can be zero
+    unsigned int get_due_families(uint64_t tick) const;
+
+    // returns the bitmask of the families due at any of the ticks in [first_tick, last_tick], e.g. after
+    // some ticks have been skipped because sampling took too long
+    unsigned int get_due_families(uint64_t first_tick, uint64_t last_tick) const;
+
+private:
+    uint64_t m_tick_msec = 0;
+    std::map<uint64_t /* period in ticks */, unsigned int /* families */> m_tick_periods;
+};
+
+//------------------------------------------------------------------------------
+// CMonitorSamplingScheduler
+//
+// Schedules the samples at absolute deadlines on CLOCK_MONOTONIC:
+//     start + first_delay, start + first_delay + interval, start + first_delay + 2*interval, ...
+// so that, unlike sleeping for the sampling interval after each sample, the time spent sampling does
+// not delay all the following samples and the number of samples collected in a given time is exact.
+//------------------------------------------------------------------------------
+
+class CMonitorSamplingScheduler {
+public:
+    CMonitorSamplingScheduler() { }
+
+    void init(uint64_t interval_msec, MissedDeadlinePolicy policy = MISSED_DEADLINE_SKIP);
+
+    // sets the first deadline first_delay_msec from now
+    void start(uint64_t first_delay_msec);
+
+    // changes the interval between the deadlines: the next deadline becomes one new interval from now
+    void set_interval(uint64_t interval_msec);
+
+    // sleeps until the next deadline, then moves the deadline forward according to the policy;
+    // returns how many deadlines elapsed: 1 plus those skipped because of MISSED_DEADLINE_SKIP, or 0 if
+    // the sleep was interrupted by a signal.
+    // If wakeup_fd is provided, the sleep ends as soon as it becomes readable: in that case woken_upOUT is set,
+    // 0 is returned and the deadline does not move
+    uint64_t wait_next_deadline(int wakeup_fd = -1, bool* woken_upOUT = nullptr);
+
+    const sampling_scheduler_stats_t& get_stats() const { return m_stats; }
+    uint64_t get_interval_msec() const { return m_interval_nsec / 1000000; }
+
+private:
+    uint64_t m_interval_nsec = 0;
+    MissedDeadlinePolicy m_policy = MISSED_DEADLINE_SKIP;
+    struct timespec m_deadline = { 0, 0 };
+    sampling_scheduler_stats_t m_stats;
+};
@@ -0,0 +1,253 @@
+/*
+ * shm_ring.cpp -- lock-free shared-memory ring of samples, for local consumers
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "shm_ring.h"
+#include "logger.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// ----------------------------------------------------------------------------------
+// Helpers
+// ----------------------------------------------------------------------------------
+
+#define SHM_RING_SLOT_ALIGNMENT (64) // one cache line
+
+static std::string get_shm_name(const std::string& name)
+{
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorShmRingWriter
+// ----------------------------------------------------------------------------------
+
+bool CMonitorShmRingWriter::init(const std::string& name, unsigned int num_slots, size_t max_payload)
+{
+    close();
+    if (num_slots == 0 || max_payload == 0)
+        return false;
+
+    m_name = get_shm_name(name);
+    m_slot_size = (sizeof(shm_ring_slot_t) + max_payload + SHM_RING_SLOT_ALIGNMENT - 1) / SHM_RING_SLOT_ALIGNMENT
+        * SHM_RING_SLOT_ALIGNMENT;
+    m_mapping_size = sizeof(shm_ring_control_t) + (1 + (size_t)num_slots) * m_slot_size;
+
+    // readers attached to a ring left over by a previous run keep their own (stale) mapping:
+    shm_unlink(m_name.c_str());
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd == -1) {
+        CMonitorLogger::instance()->LogError("Failed to create the shared memory %s: %s\n", m_name.c_str(),
+            strerror(errno));
+        return false;
+    }
+    if (ftruncate(fd, m_mapping_size) != 0) {
+        CMonitorLogger::instance()->LogError("Failed to resize the shared memory %s to %zu bytes: %s\n",
+            m_name.c_str(), m_mapping_size, strerror(errno));
+        ::close(fd);
+        shm_unlink(m_name.c_str());
+        return false;
+    }
+    m_mapping = mmap(nullptr, m_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m_mapping == MAP_FAILED) {
+        CMonitorLogger::instance()->LogError("Failed to map the shared memory %s: %s\n", m_name.c_str(),
+            strerror(errno));
+        m_mapping = nullptr;
+        shm_unlink(m_name.c_str());
+        return false;
+    }
+
+    // ftruncate() zero-filled the object: all slots have an even (i.e. stable) sequence number
+    m_control = (shm_ring_control_t*)m_mapping;
+    m_control->version = SHM_RING_VERSION;
+    m_control->num_slots = num_slots;
+    m_control->slot_size = m_slot_size;
+    m_control->writer_pid = getpid();
+    m_control->magic.store(SHM_RING_MAGIC, std::memory_order_release);
+
+    m_stats = shm_ring_stats_t();
+    CMonitorLogger::instance()->LogDebug("Initialized shared memory ring %s: %u slots of %zu bytes\n",
+        m_name.c_str(), num_slots, m_slot_size);
+    return true;
+}
+
+void CMonitorShmRingWriter::close()
+{
+    if (!m_mapping)
+        return;
+
+    // readers still attached can detect that no more samples will come:
+    m_control->closed.store(1, std::memory_order_release);
+    munmap(m_mapping, m_mapping_size);
+    shm_unlink(m_name.c_str());
+    m_mapping = nullptr;
+    m_control = nullptr;
+}
+
+void CMonitorShmRingWriter::write_slot(shm_ring_slot_t* slot, uint64_t index, const char* data, size_t len)
+{
+    uint32_t flags = 0;
+    if (len > get_max_payload()) {
+        flags |= SHM_RING_FLAG_OVERSIZED;
+        len = 0;
+        m_stats.oversized++;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    // seqlock write side: readers that saw the previous (even) sequence number will notice the change
+    uint64_t seq = slot->seq.load(std::memory_order_relaxed);
+    slot->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->index.store(index, std::memory_order_relaxed);
+    slot->timestamp_nsec.store((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec, std::memory_order_relaxed);
+    slot->length.store((uint32_t)len, std::memory_order_relaxed);
+    slot->flags.store(flags, std::memory_order_relaxed);
+    memcpy((char*)(slot + 1), data, len);
+
+    slot->seq.store(seq + 2, std::memory_order_release);
+    m_stats.bytes += len;
+}
+
+void CMonitorShmRingWriter::publish_header(const char* data, size_t len)
+{
+    if (!m_mapping)
+        return;
+    write_slot((shm_ring_slot_t*)((char*)m_mapping + sizeof(shm_ring_control_t)), 0, data, len);
+}
+
+void CMonitorShmRingWriter::publish(const char* data, size_t len)
+{
+    if (!m_mapping)
+        return;
+
+    uint64_t index = m_control->write_index.load(std::memory_order_relaxed);
+    size_t n = 1 + index % m_control->num_slots;
+    write_slot((shm_ring_slot_t*)((char*)m_mapping + sizeof(shm_ring_control_t) + n * m_slot_size), index, data, len);
+
+    // makes the new sample visible to the readers:
+    m_control->write_index.store(index + 1, std::memory_order_release);
+    m_stats.published++;
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorShmRingReader
+// ----------------------------------------------------------------------------------
+
+bool CMonitorShmRingReader::open(const std::string& name)
+{
+    close();
+
+    int fd = shm_open(get_shm_name(name).c_str(), O_RDONLY, 0);
+    if (fd == -1)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(shm_ring_control_t)) {
+        ::close(fd);
+        return false;
+    }
+    m_mapping_size = st.st_size;
+    m_mapping = mmap(nullptr, m_mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (m_mapping == MAP_FAILED) {
+        m_mapping = nullptr;
+        return false;
+    }
+
+    m_control = (const shm_ring_control_t*)m_mapping;
+    if (m_control->magic.load(std::memory_order_acquire) != SHM_RING_MAGIC || m_control->version != SHM_RING_VERSION
+        || m_control->num_slots == 0 || m_control->slot_size <= sizeof(shm_ring_slot_t)
+        || sizeof(shm_ring_control_t) + (1 + m_control->num_slots) * m_control->slot_size > m_mapping_size) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CMonitorShmRingReader::close()
+{
+    if (m_mapping)
+        munmap(m_mapping, m_mapping_size);
+    m_mapping = nullptr;
+    m_control = nullptr;
+}
+
+const shm_ring_slot_t* CMonitorShmRingReader::get_slot(uint64_t n) const
+{
+    return (const shm_ring_slot_t*)((const char*)m_mapping + sizeof(shm_ring_control_t) + n * m_control->slot_size);
+}
+
+bool CMonitorShmRingReader::read_slot(const shm_ring_slot_t* slot, shm_ring_record_t& out) const
+{
+    // seqlock read side: the copy is valid only if no write started or completed meanwhile
+    uint64_t seq = slot->seq.load(std::memory_order_acquire);
+    if (seq & 1)
+        return false;
+
+    out.index = slot->index.load(std::memory_order_relaxed);
+    out.timestamp_nsec = slot->timestamp_nsec.load(std::memory_order_relaxed);
+    out.flags = slot->flags.load(std::memory_order_relaxed);
+    size_t len = std::min((size_t)slot->length.load(std::memory_order_relaxed),
+        (size_t)(m_control->slot_size - sizeof(shm_ring_slot_t)));
+    out.payload.assign((const char*)(slot + 1), len);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->seq.load(std::memory_order_relaxed) == seq;
+}
+
+bool CMonitorShmRingReader::read_header(shm_ring_record_t& out) const
+{
+    // the header slot is published once, before any sample; it has no timestamp until then
+    return read_slot(get_slot(0), out) && out.timestamp_nsec != 0;
+}
+
+ShmRingReadResult CMonitorShmRingReader::read(uint64_t index, shm_ring_record_t& out) const
+{
+    uint64_t write_index = get_write_index();
+    if (index >= write_index)
+        return SHM_RING_READ_NOT_YET;
+    if (write_index - index > m_control->num_slots)
+        return SHM_RING_READ_OVERWRITTEN;
+
+    // a torn copy means the writer lapped the reader while copying
+    if (!read_slot(get_slot(1 + index % m_control->num_slots), out) || out.index != index)
+        return SHM_RING_READ_OVERWRITTEN;
+    return SHM_RING_READ_OK;
+}
+
+bool CMonitorShmRingReader::read_latest(shm_ring_record_t& out) const
+{
+    for (;;) {
+        uint64_t write_index = get_write_index();
+        if (write_index == 0)
+            return false;
+        if (read(write_index - 1, out) == SHM_RING_READ_OK)
+            return true;
+        // the writer published newer samples meanwhile: try with the new latest one
+    }
+}
@@ -0,0 +1,170 @@
+/*
+ * shm_ring.h -- lock-free shared-memory ring of samples, for local consumers
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define SHM_RING_MAGIC (0x474e49524e4f4d43ULL) // "CMONRING" in little endian
+#define SHM_RING_VERSION (1)
+
+#define SHM_RING_DEFAULT_SLOTS (64)
+#define SHM_RING_DEFAULT_SLOTS_STR "64"
+#define SHM_RING_DEFAULT_SLOT_KB (256)
+#define SHM_RING_DEFAULT_SLOT_KB_STR "256"
+
+#define SHM_RING_FLAG_OVERSIZED (1) // the sample did not fit the slot: the record has no payload
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the shared-memory ring requires lock-free 64bit atomics");
+
+//------------------------------------------------------------------------------
+// Shared-memory layout
+//
+// The POSIX shared-memory object contains a control block, followed by the header slot and then
+// by the ring of sample slots, all of the same size:
+//     [shm_ring_control_t][header slot][slot 0][slot 1]...[slot N-1]
+// The N-th sample published lives in slot N % num_slots. Every slot starts with a shm_ring_slot_t
+// followed by the payload, i.e. the CBOR encoding of the sample (same tree of the JSON samples).
+//
+// Each slot is protected by a seqlock: the writer makes the sequence number odd, writes the slot
+// and makes it even again. Readers copy the slot out and retry/give up when the sequence number
+// changed meanwhile: they never block the collector, which never waits for them.
+//------------------------------------------------------------------------------
+
+typedef struct {
+    std::atomic<uint64_t> magic; // set to SHM_RING_MAGIC once the ring is fully initialized
+    uint32_t version;
+    uint32_t num_slots;
+    uint64_t slot_size; // bytes of each slot, including its shm_ring_slot_t
+    uint64_t writer_pid;
+    std::atomic<uint64_t> write_index; // number of samples published so far
+    std::atomic<uint64_t> closed; // set when the collector exits
+    uint8_t padding[16];
+} shm_ring_control_t;
+
+typedef struct {
+    std::atomic<uint64_t> seq; // odd while the slot is being written
+    std::atomic<uint64_t> index; // index of the sample held by the slot
+    std::atomic<uint64_t> timestamp_nsec; // CLOCK_REALTIME time of publication
+    std::atomic<uint32_t> length; // payload bytes
+    std::atomic<uint32_t> flags; // SHM_RING_FLAG_*
+} shm_ring_slot_t;
+
+static_assert(sizeof(shm_ring_control_t) == 64, "the control block is expected to fill one cache line");
+
+typedef struct {
+    uint64_t index = 0;
+    uint64_t timestamp_nsec = 0;
+    uint32_t flags = 0;
+    std::string payload;
+} shm_ring_record_t;
+
+enum ShmRingReadResult {
+    SHM_RING_READ_OK = 0,
+    SHM_RING_READ_NOT_YET, // the sample has not been published yet
+    SHM_RING_READ_OVERWRITTEN, // the reader is too slow: the slot was reused for a newer sample
+};
+
+typedef struct {
+    uint64_t published = 0; // samples written into the ring
+    uint64_t oversized = 0; // samples too big for a slot, published without payload
+    uint64_t bytes = 0; // payload bytes written into the ring
+} shm_ring_stats_t;
+
+//------------------------------------------------------------------------------
+// CMonitorShmRingWriter
+//
+// Used by the collector: publishing a sample is a memcpy() into the mapped memory, without any
+// system call. The shared-memory object is removed when the writer is closed.
+//------------------------------------------------------------------------------
+
+class CMonitorShmRingWriter {
+public:
+    CMonitorShmRingWriter() { }
+    ~CMonitorShmRingWriter() { close(); }
+
+    // name is a POSIX shared-memory name, e.g. "/cmonitor"; the leading slash is added if missing
+    bool init(const std::string& name, unsigned int num_slots, size_t max_payload);
+    void close();
+
+    // the header is kept in its own slot: it is never overwritten by the samples
+    void publish_header(const char* data, size_t len);
+    void publish(const char* data, size_t len);
+
+    const shm_ring_stats_t& get_stats() const { return m_stats; }
+    const std::string& get_name() const { return m_name; }
+    size_t get_max_payload() const { return m_slot_size - sizeof(shm_ring_slot_t); }
+
+private:
+    void write_slot(shm_ring_slot_t* slot, uint64_t index, const char* data, size_t len);
+
+    std::string m_name;
+    void* m_mapping = nullptr;
+    size_t m_mapping_size = 0;
+    size_t m_slot_size = 0;
+    shm_ring_control_t* m_control = nullptr;
+    shm_ring_stats_t m_stats;
+};
+
+//------------------------------------------------------------------------------
+// CMonitorShmRingReader
+//
+// Used by the local consumers: any number of readers, in any number of processes, can attach
+// to the same ring. Readers copy the records out of the shared memory, so that their contents
+// can be validated against concurrent updates.
+//------------------------------------------------------------------------------
+
+class CMonitorShmRingReader {
+public:
+    CMonitorShmRingReader() { }
+    ~CMonitorShmRingReader() { close(); }
+
+    bool open(const std::string& name);
+    void close();
+
+    // number of samples published so far; the next sample will have this index
+    uint64_t get_write_index() const { return m_control->write_index.load(std::memory_order_acquire); }
+    unsigned int get_num_slots() const { return m_control->num_slots; }
+    bool is_writer_closed() const { return m_control->closed.load(std::memory_order_acquire) != 0; }
+
+    bool read_header(shm_ring_record_t& out) const;
+    ShmRingReadResult read(uint64_t index, shm_ring_record_t& out) const;
+
+    // reads the most recent sample; returns false if nothing was published yet
+    bool read_latest(shm_ring_record_t& out) const;
+
+private:
+    bool read_slot(const shm_ring_slot_t* slot, shm_ring_record_t& out) const;
+    const shm_ring_slot_t* get_slot(uint64_t n) const; // n = 0 is the header slot
+
+    void* m_mapping = nullptr;
+    size_t m_mapping_size = 0;
+    const shm_ring_control_t* m_control = nullptr;
+};
@@ -0,0 +1,199 @@
+/*
+ * snappy_codec.cpp -- compressor/decompressor for the snappy block format
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "snappy_codec.h"
+#include <algorithm>
+#include <string.h>
+
+// ----------------------------------------------------------------------------------
+// Constants
+// ----------------------------------------------------------------------------------
+
+// input is compressed in independent blocks, so that all copy offsets fit 16 bits:
+#define SNAPPY_BLOCK_SIZE (1 << 16)
+#define SNAPPY_HASH_BITS (14)
+#define SNAPPY_MIN_MATCH (4)
+
+enum { SNAPPY_TAG_LITERAL = 0, SNAPPY_TAG_COPY1 = 1, SNAPPY_TAG_COPY2 = 2, SNAPPY_TAG_COPY4 = 3 };
+
+// ----------------------------------------------------------------------------------
+// Compression
+// ----------------------------------------------------------------------------------
+
+static inline uint32_t load32(const char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hash32(uint32_t v) { return (v * 0x1e35a7bd) >> (32 - SNAPPY_HASH_BITS); }
+
+static void append_varint(std::string& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+static void append_literal(std::string& out, const char* p, size_t len)
+{
+    if (len == 0)
+        return;
+    size_t n = len - 1;
+    if (n < 60)
+        out.push_back((char)(n << 2 | SNAPPY_TAG_LITERAL));
+    else {
+        // tags 60..63 mean that the length-1 follows in 1..4 little-endian bytes
+        unsigned int nbytes = n < (1 << 8) ? 1 : n < (1 << 16) ? 2 : n < (1 << 24) ? 3 : 4;
+        out.push_back((char)((59 + nbytes) << 2 | SNAPPY_TAG_LITERAL));
+        for (unsigned int i = 0; i < nbytes; i++)
+            out.push_back((char)(n >> (8 * i)));
+    }
+    out.append(p, len);
+}
+
+static void append_copy(std::string& out, size_t offset, size_t len)
+{
+    // a copy element encodes at most 64 bytes; split longer matches leaving at least 4 bytes for the last one
+    while (len > 0) {
+        size_t n = len > 64 ? (len - 64 < SNAPPY_MIN_MATCH ? 60 : 64) : len;
+        if (n >= 4 && n < 12 && offset < 2048) {
+            out.push_back((char)((offset >> 8) << 5 | (n - 4) << 2 | SNAPPY_TAG_COPY1));
+            out.push_back((char)(offset & 0xff));
+        } else {
+            out.push_back((char)((n - 1) << 2 | SNAPPY_TAG_COPY2));
+            out.push_back((char)(offset & 0xff));
+            out.push_back((char)(offset >> 8));
+        }
+        len -= n;
+    }
+}
+
+void snappy_compress(const char* in, size_t in_len, std::string& out)
+{
+    out.clear();
+    out.reserve(32 + in_len + in_len / 6); // worst case
+    append_varint(out, in_len);
+
+    uint16_t table[1 << SNAPPY_HASH_BITS];
+    for (size_t block_start = 0; block_start < in_len; block_start += SNAPPY_BLOCK_SIZE) {
+        const char* block = in + block_start;
+        const size_t block_len = std::min(in_len - block_start, (size_t)SNAPPY_BLOCK_SIZE);
+        memset(table, 0, sizeof(table));
+
+        size_t pos = 0, literal_start = 0;
+        while (pos + SNAPPY_MIN_MATCH <= block_len) {
+            uint32_t v = load32(block + pos);
+            uint32_t h = hash32(v);
+            size_t candidate = table[h];
+            table[h] = (uint16_t)pos;
+            if (candidate >= pos || load32(block + candidate) != v) {
+                pos++;
+                continue;
+            }
+
+            size_t len = SNAPPY_MIN_MATCH;
+            while (pos + len < block_len && block[candidate + len] == block[pos + len])
+                len++;
+            append_literal(out, block + literal_start, pos - literal_start);
+            append_copy(out, pos - candidate, len);
+            pos += len;
+            literal_start = pos;
+        }
+        append_literal(out, block + literal_start, block_len - literal_start);
+    }
+}
+
+// ----------------------------------------------------------------------------------
+// Decompression
+// ----------------------------------------------------------------------------------
+
+bool snappy_uncompress(const char* in, size_t in_len, std::string& out)
+{
+    const uint8_t* p = (const uint8_t*)in;
+    const uint8_t* end = p + in_len;
+
+    uint64_t expected_len = 0;
+    for (unsigned int shift = 0;; shift += 7) {
+        if (p == end || shift > 63)
+            return false;
+        expected_len |= (uint64_t)(*p & 0x7f) << shift;
+        if ((*p++ & 0x80) == 0)
+            break;
+    }
+
+    out.clear();
+    out.reserve(expected_len);
+    while (p < end) {
+        uint8_t tag = *p++;
+        size_t len, offset;
+        switch (tag & 3) {
+        case SNAPPY_TAG_LITERAL:
+            len = tag >> 2;
+            if (len >= 60) {
+                unsigned int nbytes = len - 59;
+                if ((size_t)(end - p) < nbytes)
+                    return false;
+                len = 0;
+                for (unsigned int i = 0; i < nbytes; i++)
+                    len |= (size_t)p[i] << (8 * i);
+                p += nbytes;
+            }
+            len++;
+            if ((size_t)(end - p) < len)
+                return false;
+            out.append((const char*)p, len);
+            p += len;
+            continue;
+
+        case SNAPPY_TAG_COPY1:
+            if (end - p < 1)
+                return false;
+            len = ((tag >> 2) & 7) + 4;
+            offset = (size_t)(tag >> 5) << 8 | p[0];
+            p += 1;
+            break;
+        case SNAPPY_TAG_COPY2:
+            if (end - p < 2)
+                return false;
+            len = (tag >> 2) + 1;
+            offset = p[0] | (size_t)p[1] << 8;
+            p += 2;
+            break;
+        default:
+            if (end - p < 4)
+                return false;
+            len = (tag >> 2) + 1;
+            offset = p[0] | (size_t)p[1] << 8 | (size_t)p[2] << 16 | (size_t)p[3] << 24;
+            p += 4;
+            break;
+        }
+
+        if (offset == 0 || offset > out.size())
+            return false;
+        // source and destination can overlap (e.g. runs of the same byte): copy byte by byte
+        size_t from = out.size() - offset;
+        for (size_t i = 0; i < len; i++)
+            out.push_back(out[from + i]);
+    }
+    return out.size() == expected_len;
+}
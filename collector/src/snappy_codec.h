@@ -0,0 +1,44 @@
+/*
+ * snappy_codec.h -- compressor/decompressor for the snappy block format
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+//------------------------------------------------------------------------------
+// Snappy block format
+//
+// The Prometheus remote-write protocol mandates snappy compression of the request bodies
+// (block format, not the framing format). The format is simple enough that a small greedy
+// compressor is implemented here rather than depending on libsnappy: the output is not as
+// small as the one of the reference implementation but any snappy decoder can read it.
+// See https://github.com/google/snappy/blob/main/format_description.txt
+//------------------------------------------------------------------------------
+
+// compresses the given buffer into "out" (whose previous contents are lost)
+void snappy_compress(const char* in, size_t in_len, std::string& out);
+
+// returns false if the input is not a valid snappy block
+bool snappy_uncompress(const char* in, size_t in_len, std::string& out);
@@ -0,0 +1,355 @@
+/*
+ * stream_server.cpp -- Unix domain socket streaming of the samples to local subscribers
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stream_server.h"
+#include "logger.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define STREAM_SERVER_MAX_IOVEC (16) // frames sent with a single sendmsg()
+
+// ----------------------------------------------------------------------------------
+// CMonitorStreamServer
+// ----------------------------------------------------------------------------------
+
+bool CMonitorStreamServer::init(const std::string& path, unsigned int max_queue_len, StreamSlowSubscriberPolicy policy)
+{
+    close();
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path) || max_queue_len == 0) {
+        CMonitorLogger::instance()->LogError("Invalid stream socket path %s\n", path.c_str());
+        return false;
+    }
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // a socket file left over by a previous run would make bind() fail; never remove anything else though
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path.c_str());
+
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listen_fd == -1 || bind(m_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0
+        || listen(m_listen_fd, STREAM_SERVER_MAX_SUBSCRIBERS) != 0) {
+        CMonitorLogger::instance()->LogError("Failed to listen on %s: %s\n", path.c_str(), strerror(errno));
+        close();
+        return false;
+    }
+    m_path = path;
+    m_max_queue_len = max_queue_len;
+    m_policy = policy;
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll_fd == -1 || m_wakeup_fd == -1 || m_stop_fd == -1) {
+        CMonitorLogger::instance()->LogError("Failed to create the epoll/eventfd descriptors: %s\n", strerror(errno));
+        close();
+        return false;
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    for (int fd : { m_listen_fd, m_wakeup_fd, m_stop_fd }) {
+        ev.data.fd = fd;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    m_thread = std::thread(&CMonitorStreamServer::run, this);
+    return true;
+}
+
+void CMonitorStreamServer::close()
+{
+    if (m_thread.joinable()) {
+        uint64_t one = 1;
+        ssize_t ret = write(m_stop_fd, &one, sizeof(one));
+        (void)ret;
+        m_thread.join();
+    }
+
+    while (!m_subscribers.empty())
+        close_subscriber(m_subscribers.begin()->first);
+    for (int* fd : { &m_listen_fd, &m_epoll_fd, &m_wakeup_fd, &m_stop_fd }) {
+        if (*fd != -1)
+            ::close(*fd);
+        *fd = -1;
+    }
+    if (!m_path.empty())
+        unlink(m_path.c_str());
+    m_path.clear();
+
+    m_pending.clear();
+    m_pending_header = nullptr;
+    m_header = nullptr;
+}
+
+void CMonitorStreamServer::publish_header(std::string&& frame)
+{
+    if (m_epoll_fd == -1)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_pending_lock);
+        m_pending_header = std::make_shared<const std::string>(std::move(frame));
+    }
+
+    uint64_t one = 1;
+    ssize_t ret = write(m_wakeup_fd, &one, sizeof(one));
+    (void)ret;
+}
+
+void CMonitorStreamServer::publish(std::string&& frame)
+{
+    if (m_epoll_fd == -1)
+        return;
+
+    frame_ptr_t ptr = std::make_shared<const std::string>(std::move(frame)); // allocate outside the lock
+    {
+        std::lock_guard<std::mutex> lock(m_pending_lock);
+
+        // the server thread is not expected to lag behind, but the hand-over list is bounded as well:
+        if (m_pending.size() >= STREAM_SERVER_MAX_PENDING_FRAMES) {
+            m_pending.erase(m_pending.begin());
+            m_skipped++;
+        }
+        m_pending.push_back(std::move(ptr));
+    }
+    m_frames++;
+
+    uint64_t one = 1;
+    ssize_t ret = write(m_wakeup_fd, &one, sizeof(one));
+    (void)ret;
+}
+
+stream_server_stats_t CMonitorStreamServer::get_stats() const
+{
+    stream_server_stats_t ret;
+    ret.subscribers = m_subscribers_accepted;
+    ret.frames = m_frames;
+    ret.bytes_sent = m_bytes_sent;
+    ret.skipped = m_skipped;
+    ret.disconnected = m_disconnected;
+    return ret;
+}
+
+void CMonitorStreamServer::run()
+{
+    struct epoll_event events[32];
+    while (true) {
+        int n = epoll_wait(m_epoll_fd, events, 32, -1);
+        if (n < 0 && errno != EINTR)
+            break;
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == m_stop_fd)
+                return;
+            if (fd == m_listen_fd) {
+                accept_subscribers();
+                continue;
+            }
+            if (fd == m_wakeup_fd) {
+                uint64_t count;
+                ssize_t ret = read(m_wakeup_fd, &count, sizeof(count));
+                (void)ret;
+                dispatch_pending_frames();
+                continue;
+            }
+
+            auto it = m_subscribers.find(fd);
+            if (it == m_subscribers.end())
+                continue;
+            if ((events[i].events & EPOLLOUT) && !handle_writable(fd, it->second)) {
+                close_subscriber(fd);
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                handle_readable(fd);
+        }
+    }
+}
+
+void CMonitorStreamServer::accept_subscribers()
+{
+    while (true) {
+        int fd = accept4(m_listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1)
+            return; // EAGAIN or a subscriber that went away already
+
+        if (m_subscribers.size() >= STREAM_SERVER_MAX_SUBSCRIBERS) {
+            ::close(fd);
+            continue;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        subscriber_t& sub = m_subscribers[fd];
+        m_subscribers_accepted++;
+        m_num_subscribers = m_subscribers.size();
+
+        // the stream of each subscriber starts with the header, whenever it connects
+        if (m_header) {
+            sub.queue.push_back(m_header);
+            if (!handle_writable(fd, sub))
+                close_subscriber(fd);
+        }
+    }
+}
+
+void CMonitorStreamServer::dispatch_pending_frames()
+{
+    std::vector<frame_ptr_t> frames;
+    frame_ptr_t header;
+    {
+        std::lock_guard<std::mutex> lock(m_pending_lock);
+        frames.swap(m_pending);
+        header.swap(m_pending_header);
+    }
+    if (header) {
+        m_header = header;
+        frames.insert(frames.begin(), header);
+    }
+
+    for (auto it = m_subscribers.begin(); it != m_subscribers.end();) {
+        int fd = it->first;
+        subscriber_t& sub = it->second;
+        ++it; // the subscriber might be closed below
+
+        bool keep = true;
+        for (size_t n = 0; n < frames.size() && keep; n++)
+            keep = enqueue_frame(sub, frames[n]);
+        if (!keep || (!sub.waiting_writable && !handle_writable(fd, sub)))
+            close_subscriber(fd);
+    }
+}
+
+bool CMonitorStreamServer::enqueue_frame(subscriber_t& sub, const frame_ptr_t& frame)
+{
+    if (sub.queue.size() < m_max_queue_len) {
+        sub.queue.push_back(frame);
+        return true;
+    }
+
+    if (m_policy == STREAM_POLICY_DISCONNECT) {
+        m_disconnected++;
+        return false;
+    }
+
+    // STREAM_POLICY_SKIP: make room by discarding the oldest frame not being sent; the header is always kept
+    for (auto it = sub.queue.begin(); it != sub.queue.end(); ++it) {
+        if ((it == sub.queue.begin() && sub.tx_offset > 0) || *it == m_header)
+            continue;
+        sub.queue.erase(it);
+        sub.queue.push_back(frame);
+        m_skipped++;
+        return true;
+    }
+    m_skipped++; // nothing could be discarded: skip the new frame itself
+    return true;
+}
+
+bool CMonitorStreamServer::handle_writable(int fd, subscriber_t& sub)
+{
+    while (!sub.queue.empty()) {
+        struct iovec iov[STREAM_SERVER_MAX_IOVEC];
+        int iovcnt = 0;
+        for (auto it = sub.queue.begin(); it != sub.queue.end() && iovcnt < STREAM_SERVER_MAX_IOVEC; ++it) {
+            size_t offset = iovcnt == 0 ? sub.tx_offset : 0;
+            iov[iovcnt].iov_base = (void*)((*it)->data() + offset);
+            iov[iovcnt++].iov_len = (*it)->size() - offset;
+        }
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                return false; // subscriber went away
+
+            // socket buffer full: wait for the subscriber to read
+            update_epoll_events(fd, sub, true);
+            return true;
+        }
+        m_bytes_sent += n;
+
+        // pop the frames sent completely
+        size_t sent = sub.tx_offset + n;
+        while (!sub.queue.empty() && sent >= sub.queue.front()->size()) {
+            sent -= sub.queue.front()->size();
+            sub.queue.pop_front();
+        }
+        sub.tx_offset = sent;
+    }
+
+    update_epoll_events(fd, sub, false);
+    return true;
+}
+
+void CMonitorStreamServer::handle_readable(int fd)
+{
+    char buf[1024];
+    while (true) {
+        ssize_t n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (n > 0)
+            continue; // subscribers are not expected to send anything
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            close_subscriber(fd); // subscriber closed the connection
+            return;
+        }
+        if (errno != EINTR)
+            return;
+    }
+}
+
+void CMonitorStreamServer::update_epoll_events(int fd, subscriber_t& sub, bool want_writable)
+{
+    if (sub.waiting_writable == want_writable)
+        return;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = want_writable ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    sub.waiting_writable = want_writable;
+}
+
+void CMonitorStreamServer::close_subscriber(int fd)
+{
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    m_subscribers.erase(fd);
+    m_num_subscribers = m_subscribers.size();
+}
@@ -0,0 +1,139 @@
+/*
+ * stream_server.h -- Unix domain socket streaming of the samples to local subscribers
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define STREAM_SERVER_MAX_SUBSCRIBERS (32)
+#define STREAM_SERVER_DEFAULT_QUEUE_LEN (64) // frames queued per subscriber
+#define STREAM_SERVER_DEFAULT_QUEUE_LEN_STR "64"
+#define STREAM_SERVER_MAX_PENDING_FRAMES (1024) // frames handed over to the server thread and not dispatched yet
+
+enum StreamFormat {
+    STREAM_FORMAT_NDJSON, // one JSON object per line
+    STREAM_FORMAT_CBOR, // a CBOR sequence (RFC 8742): self-delimiting data items back to back
+};
+
+// what to do with a subscriber whose queue is full because it does not read fast enough
+enum StreamSlowSubscriberPolicy {
+    STREAM_POLICY_SKIP, // discard its oldest queued samples: the subscriber receives a downsampled stream
+    STREAM_POLICY_DISCONNECT, // close its connection
+};
+
+typedef struct {
+    uint64_t subscribers = 0; // connections accepted
+    uint64_t frames = 0; // frames published by the sampling loop
+    uint64_t bytes_sent = 0; // bytes sent to all subscribers
+    uint64_t skipped = 0; // frames discarded from the queues of slow subscribers
+    uint64_t disconnected = 0; // slow subscribers disconnected
+} stream_server_stats_t;
+
+//------------------------------------------------------------------------------
+// CMonitorStreamServer
+//
+// Listens on a Unix domain socket and sends each connected subscriber the stream of the encoded samples,
+// preceded by the header. Subscribers are not expected to send anything: data they send is discarded.
+//
+// The sampling loop only appends the new frame to a pending list and wakes up the server thread: the
+// server thread, driven by epoll, fans the frame out to the bounded queue of each subscriber and sends
+// it with non-blocking writes. Frames are shared by all the queues and never copied.
+// A slow subscriber thus never stalls the sampling loop, nor the other subscribers: when its queue is
+// full the configured StreamSlowSubscriberPolicy applies.
+//------------------------------------------------------------------------------
+
+class CMonitorStreamServer {
+public:
+    CMonitorStreamServer() { }
+    ~CMonitorStreamServer() { close(); }
+
+    // a stale socket file left at the given path by a previous run is replaced
+    bool init(const std::string& path, unsigned int max_queue_len = STREAM_SERVER_DEFAULT_QUEUE_LEN,
+        StreamSlowSubscriberPolicy policy = STREAM_POLICY_SKIP);
+    void close();
+
+    // frame publishing, from the sampling loop: the header is sent also to all subscribers connecting later
+    void publish_header(std::string&& frame);
+    void publish(std::string&& frame);
+
+    const std::string& get_path() const { return m_path; }
+    unsigned int get_num_subscribers() const { return m_num_subscribers; }
+    stream_server_stats_t get_stats() const;
+
+private:
+    typedef std::shared_ptr<const std::string> frame_ptr_t;
+
+    typedef struct {
+        std::deque<frame_ptr_t> queue; // the front frame is the one being sent
+        size_t tx_offset = 0; // bytes of the front frame already sent
+        bool waiting_writable = false;
+    } subscriber_t;
+
+    void run();
+    void accept_subscribers();
+    void dispatch_pending_frames();
+    bool enqueue_frame(subscriber_t& sub, const frame_ptr_t& frame); // returns false to disconnect
+    bool handle_writable(int fd, subscriber_t& sub); // returns false when the subscriber must be closed
+    void handle_readable(int fd);
+    void update_epoll_events(int fd, subscriber_t& sub, bool want_writable);
+    void close_subscriber(int fd);
+
+private:
+    std::string m_path;
+    unsigned int m_max_queue_len = STREAM_SERVER_DEFAULT_QUEUE_LEN;
+    StreamSlowSubscriberPolicy m_policy = STREAM_POLICY_SKIP;
+
+    int m_listen_fd = -1;
+    int m_epoll_fd = -1;
+    int m_wakeup_fd = -1; // eventfd signalled for new frames
+    int m_stop_fd = -1; // eventfd used to wake up the server thread at close()
+    std::thread m_thread;
+
+    // frames handed over by the sampling loop; the only state shared with the server thread
+    std::mutex m_pending_lock;
+    std::vector<frame_ptr_t> m_pending;
+    frame_ptr_t m_pending_header;
+
+    // accessed only by the server thread
+    std::map<int, subscriber_t> m_subscribers;
+    frame_ptr_t m_header;
+
+    std::atomic<unsigned int> m_num_subscribers { 0 };
+    std::atomic<uint64_t> m_subscribers_accepted { 0 };
+    std::atomic<uint64_t> m_frames { 0 };
+    std::atomic<uint64_t> m_bytes_sent { 0 };
+    std::atomic<uint64_t> m_skipped { 0 };
+    std::atomic<uint64_t> m_disconnected { 0 };
+};
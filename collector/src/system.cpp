@@ -20,6 +20,7 @@
 #include "system.h"
 #include "logger.h"
 #include "output_frontend.h"
+#include <algorithm>
 #include <mntent.h>
 #include <sys/vfs.h>
 
@@ -36,18 +37,17 @@ void CMonitorSystem::init()
     m_meminfo.set_file("/proc/meminfo");
     m_vmstat.set_file("/proc/vmstat");
 
-#ifdef PROMETHEUS_SUPPORT
-    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_CPU) == 0)) {
+    if (m_pOutput->wants_kpi_descriptors() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_CPU) == 0)) {
         size_t size = sizeof(g_prometheus_kpi_cpu) / sizeof(g_prometheus_kpi_cpu[0]);
         m_pOutput->init_prometheus_kpis(g_prometheus_kpi_cpu, size);
     }
 
-    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_DISK) == 0)) {
+    if (m_pOutput->wants_kpi_descriptors() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_DISK) == 0)) {
         size_t size = sizeof(g_prometheus_kpi_disk) / sizeof(g_prometheus_kpi_disk[0]);
         m_pOutput->init_prometheus_kpis(g_prometheus_kpi_disk, size);
     }
 
-    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_MEMORY) == 0)) {
+    if (m_pOutput->wants_kpi_descriptors() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_MEMORY) == 0)) {
         size_t size = sizeof(g_prometheus_kpi_proc_meminfo) / sizeof(g_prometheus_kpi_proc_meminfo[0]);
         m_pOutput->init_prometheus_kpis(g_prometheus_kpi_proc_meminfo, size);
 
@@ -57,16 +57,15 @@ void CMonitorSystem::init()
         }
     }
 
-    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_NETWORK) == 0)) {
+    if (m_pOutput->wants_kpi_descriptors() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_NETWORK) == 0)) {
         size_t size = sizeof(g_prometheus_kpi_network) / sizeof(g_prometheus_kpi_network[0]);
         m_pOutput->init_prometheus_kpis(g_prometheus_kpi_network, size);
     }
 
-    if (m_pOutput->is_prometheus_enabled() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_LOAD) == 0)) {
+    if (m_pOutput->wants_kpi_descriptors() && (!(m_pCfg->m_nCollectFlags & PK_BAREMETAL_LOAD) == 0)) {
         size_t size = sizeof(g_prometheus_kpi_load) / sizeof(g_prometheus_kpi_load[0]);
         m_pOutput->init_prometheus_kpis(g_prometheus_kpi_load, size);
     }
-#endif
 }
 
 /*
@@ -165,7 +164,7 @@ void CMonitorSystem::sample_filesystems()
             }
             // CMonitorLogger::instance()->LogDebug("%s, mounted on %s:\n", fs->mnt_dir, fs->mnt_fsname);
 
-            m_pOutput->psubsection_start(fs->mnt_fsname);
+            m_pOutput->psubsection_start(fs->mnt_fsname, "fs", fs->mnt_fsname);
             m_pOutput->pstring("fs_dir", fs->mnt_dir);
             m_pOutput->pstring("fs_type", fs->mnt_type);
             m_pOutput->pstring("fs_opts", fs->mnt_opts);
@@ -207,3 +206,27 @@ void CMonitorSystem::get_list_monitored_files(std::set<std::string>& list)
     if (m_pCfg->m_nCollectFlags & PK_BAREMETAL_DISK)
         list.insert(m_disk_stat.get_file());
 }
+
+void CMonitorSystem::save_delta_baselines()
+{
+    m_saved_delta_baselines.reset(new delta_baselines_t());
+    m_saved_delta_baselines->cpu_stat_old_ctxt = m_cpu_stat_old_ctxt;
+    m_saved_delta_baselines->cpu_stat_old_processes = m_cpu_stat_old_processes;
+    m_saved_delta_baselines->cpu_stat_prev_values.assign(
+        &m_cpu_stat_prev_values[0], &m_cpu_stat_prev_values[MAX_LOGICAL_CPU]);
+    m_saved_delta_baselines->previous_diskinfo = m_previous_diskinfo;
+    m_saved_delta_baselines->previous_netinfo = m_previous_netinfo;
+}
+
+void CMonitorSystem::restore_delta_baselines()
+{
+    if (!m_saved_delta_baselines)
+        return;
+    m_cpu_stat_old_ctxt = m_saved_delta_baselines->cpu_stat_old_ctxt;
+    m_cpu_stat_old_processes = m_saved_delta_baselines->cpu_stat_old_processes;
+    std::copy(m_saved_delta_baselines->cpu_stat_prev_values.begin(),
+        m_saved_delta_baselines->cpu_stat_prev_values.end(), &m_cpu_stat_prev_values[0]);
+    m_previous_diskinfo.swap(m_saved_delta_baselines->previous_diskinfo);
+    m_previous_netinfo.swap(m_saved_delta_baselines->previous_netinfo);
+    m_saved_delta_baselines.reset();
+}
@@ -26,324 +26,316 @@
 #include "cmonitor.h"
 #include "fast_file_reader.h"
 #include <map>
+#include <memory>
 #include <set>
 #include <string.h>
 #include <string>
 #include <unistd.h>
 #include <vector>
 
-#ifdef PROMETHEUS_SUPPORT
 #include "prometheus_kpi.h"
-#endif
 
 //------------------------------------------------------------------------------
 // Types
 //------------------------------------------------------------------------------
 
-#ifdef PROMETHEUS_SUPPORT
 static const prometheus_kpi_descriptor g_prometheus_kpi_load[] = {
     // proc_loadavg
-    { "proc_loadavg_load_avg_1min", prometheus::MetricType::Gauge,
+    { "proc_loadavg_load_avg_1min", PrometheusKpiType::Gauge,
         "Load average figures giving the number of jobs in the run queue (state R) or waiting for disk I/O (state D) "
         "averaged over 1min" },
-    { "proc_loadavg_load_avg_5min", prometheus::MetricType::Gauge,
+    { "proc_loadavg_load_avg_5min", PrometheusKpiType::Gauge,
         "Load average figures giving the number of jobs in the run queue (state R) or waiting for disk I/O (state D) "
         "averaged over 5min" },
-    { "proc_loadavg_load_avg_15min", prometheus::MetricType::Gauge,
+    { "proc_loadavg_load_avg_15min", PrometheusKpiType::Gauge,
         "Load average figures giving the number of jobs in the run queue (state R) or waiting for disk I/O (state D) "
         "averaged over 15min" },
 };
 static const prometheus_kpi_descriptor g_prometheus_kpi_disk[] = {
     // baremetal : disk
-    { "disks_reads", prometheus::MetricType::Gauge, "total reads completed successfully" },
-    { "disks_rmerge", prometheus::MetricType::Gauge, "total reads merged" },
-    { "disks_rkb", prometheus::MetricType::Gauge, "total number of sectors read from disk" },
-    { "disks_rmsec", prometheus::MetricType::Gauge, "total time spent reading (ms)" },
-    { "disks_writes", prometheus::MetricType::Gauge, "total writes completed successfully" },
-    { "disks_wmerge", prometheus::MetricType::Gauge, "total writes merged" },
-    { "disks_wmsec", prometheus::MetricType::Gauge, "total time spent writting (ms)" },
-    { "disks_wkb", prometheus::MetricType::Gauge, "total number of sectors writeen to disk" },
-    { "disks_inflight", prometheus::MetricType::Gauge, "I/Os currently in progress" },
-    { "disks_time", prometheus::MetricType::Gauge, "time spent doing I/Os (ms)" },
-    { "disks_backlog", prometheus::MetricType::Gauge, "weighted time spent doing I/Os (ms)" },
-    { "disks_xfers", prometheus::MetricType::Gauge, "total reads/writes in Kbyte" },
-    { "disks_bsize", prometheus::MetricType::Gauge, "total I/Os in Kbyte" },
+    { "disks_reads", PrometheusKpiType::Gauge, "total reads completed successfully" },
+    { "disks_rmerge", PrometheusKpiType::Gauge, "total reads merged" },
+    { "disks_rkb", PrometheusKpiType::Gauge, "total number of sectors read from disk" },
+    { "disks_rmsec", PrometheusKpiType::Gauge, "total time spent reading (ms)" },
+    { "disks_writes", PrometheusKpiType::Gauge, "total writes completed successfully" },
+    { "disks_wmerge", PrometheusKpiType::Gauge, "total writes merged" },
+    { "disks_wmsec", PrometheusKpiType::Gauge, "total time spent writting (ms)" },
+    { "disks_wkb", PrometheusKpiType::Gauge, "total number of sectors writeen to disk" },
+    { "disks_inflight", PrometheusKpiType::Gauge, "I/Os currently in progress" },
+    { "disks_time", PrometheusKpiType::Gauge, "time spent doing I/Os (ms)" },
+    { "disks_backlog", PrometheusKpiType::Gauge, "weighted time spent doing I/Os (ms)" },
+    { "disks_xfers", PrometheusKpiType::Gauge, "total reads/writes in Kbyte" },
+    { "disks_bsize", PrometheusKpiType::Gauge, "total I/Os in Kbyte" },
 };
 
 static const prometheus_kpi_descriptor g_prometheus_kpi_network[] = {
     // baremetal : network
-    { "network_interfaces_ibytes", prometheus::MetricType::Gauge,
+    { "network_interfaces_ibytes", PrometheusKpiType::Gauge,
         "total number of bytes of data received by the interface" },
-    { "network_interfaces_ipackets", prometheus::MetricType::Gauge,
+    { "network_interfaces_ipackets", PrometheusKpiType::Gauge,
         "total number of packets of data received by the interface" },
-    { "network_interfaces_ierrs", prometheus::MetricType::Gauge,
+    { "network_interfaces_ierrs", PrometheusKpiType::Gauge,
         "total number of receive errors detected by the device driver" },
-    { "network_interfaces_idrop", prometheus::MetricType::Gauge,
-        "total number of packets dropped by the device driver" },
-    { "network_interfaces_ififo", prometheus::MetricType::Gauge, "number of FIFO buffer errors" },
-    { "network_interfaces_iframe", prometheus::MetricType::Gauge, "number of packet framing errors" },
-    { "network_interfaces_obytes", prometheus::MetricType::Gauge,
+    { "network_interfaces_idrop", PrometheusKpiType::Gauge, "total number of packets dropped by the device driver" },
+    { "network_interfaces_ififo", PrometheusKpiType::Gauge, "number of FIFO buffer errors" },
+    { "network_interfaces_iframe", PrometheusKpiType::Gauge, "number of packet framing errors" },
+    { "network_interfaces_obytes", PrometheusKpiType::Gauge,
         "total number of bytes of data transmitted by the interface" },
-    { "network_interfaces_opackets", prometheus::MetricType::Gauge,
+    { "network_interfaces_opackets", PrometheusKpiType::Gauge,
         "The total number of packets of data transmitted by the interface" },
-    { "network_interfaces_oerrs", prometheus::MetricType::Gauge,
+    { "network_interfaces_oerrs", PrometheusKpiType::Gauge,
         "total number of transmitted errors detected by the device driver" },
-    { "network_interfaces_odrop", prometheus::MetricType::Gauge, "total number of packets dropped by the interface" },
-    { "network_interfaces_ofifo", prometheus::MetricType::Gauge, "total number of FIFO buffer errors" },
-    { "network_interfaces_ocolls", prometheus::MetricType::Gauge, "number of collisions detected on the interface" },
-    { "network_interfaces_ocarrier", prometheus::MetricType::Gauge,
+    { "network_interfaces_odrop", PrometheusKpiType::Gauge, "total number of packets dropped by the interface" },
+    { "network_interfaces_ofifo", PrometheusKpiType::Gauge, "total number of FIFO buffer errors" },
+    { "network_interfaces_ocolls", PrometheusKpiType::Gauge, "number of collisions detected on the interface" },
+    { "network_interfaces_ocarrier", PrometheusKpiType::Gauge,
         "number of carrier losses detected by the device driver" },
 };
 
 static const prometheus_kpi_descriptor g_prometheus_kpi_cpu[] = {
     // baremetal : cpu
-    { "stat_user", prometheus::MetricType::Gauge, "time spent in user mode" },
-    { "stat_nice", prometheus::MetricType::Gauge, "Time spent in user mode with low priority (nice)" },
-    { "stat_sys", prometheus::MetricType::Gauge, "Time spent in system mode" },
-    { "stat_idle", prometheus::MetricType::Gauge, "Time spent in the idle task" },
-    { "stat_iowait", prometheus::MetricType::Gauge, "Time waiting for I/O to complete" },
-    { "stat_hardirq", prometheus::MetricType::Gauge, "Time servicing interrupts" },
-    { "stat_softirq", prometheus::MetricType::Gauge, "Time servicing softirqs" },
-    { "stat_steal", prometheus::MetricType::Gauge,
+    { "stat_user", PrometheusKpiType::Gauge, "time spent in user mode" },
+    { "stat_nice", PrometheusKpiType::Gauge, "Time spent in user mode with low priority (nice)" },
+    { "stat_sys", PrometheusKpiType::Gauge, "Time spent in system mode" },
+    { "stat_idle", PrometheusKpiType::Gauge, "Time spent in the idle task" },
+    { "stat_iowait", PrometheusKpiType::Gauge, "Time waiting for I/O to complete" },
+    { "stat_hardirq", PrometheusKpiType::Gauge, "Time servicing interrupts" },
+    { "stat_softirq", PrometheusKpiType::Gauge, "Time servicing softirqs" },
+    { "stat_steal", PrometheusKpiType::Gauge,
         "Stolen time, which is the time spent in other operating systems when running in a virtualized environment " },
-    { "stat_guest", prometheus::MetricType::Gauge, "Time spent running a virtual CPU for guest operating systems" },
-    { "stat_guestnice", prometheus::MetricType::Gauge,
+    { "stat_guest", PrometheusKpiType::Gauge, "Time spent running a virtual CPU for guest operating systems" },
+    { "stat_guestnice", PrometheusKpiType::Gauge,
         "Time spent running a niced guest (virtual CPU for guest operating systems" },
 };
 
 static const prometheus_kpi_descriptor g_prometheus_kpi_proc_meminfo[] = {
     // baremetal : proc_meminfo
-    { "proc_meminfo_MemTotal", prometheus::MetricType::Counter, "Total amount of usable RAM, in kibibytes" },
-    { "proc_meminfo_MemAvailable", prometheus::MetricType::Gauge,
+    { "proc_meminfo_MemTotal", PrometheusKpiType::Gauge, "Total amount of usable RAM, in kibibytes" },
+    { "proc_meminfo_MemAvailable", PrometheusKpiType::Gauge,
         "An estimate of how much memory is available for starting new applications" },
-    { "proc_meminfo_MemFree", prometheus::MetricType::Gauge,
+    { "proc_meminfo_MemFree", PrometheusKpiType::Gauge,
         "The amount of physical RAM, in kibibytes, left unused by the system" },
-    { "proc_meminfo_Buffers", prometheus::MetricType::Counter,
+    { "proc_meminfo_Buffers", PrometheusKpiType::Gauge,
         "The amount, in kibibytes, of temporary storage for raw disk blocks" },
-    { "proc_meminfo_Cached", prometheus::MetricType::Gauge,
+    { "proc_meminfo_Cached", PrometheusKpiType::Gauge,
         "The amount of physical RAM, in kibibytes, used as cache memory" },
-    { "proc_meminfo_SwapCached", prometheus::MetricType::Counter,
+    { "proc_meminfo_SwapCached", PrometheusKpiType::Gauge,
         "The amount of memory, in kibibytes, that has once been moved into swap, then back into the main memory, but "
         "still also remains in the swapfile" },
-    { "proc_meminfo_Active", prometheus::MetricType::Gauge,
+    { "proc_meminfo_Active", PrometheusKpiType::Gauge,
         "The amount of memory, in kibibytes, that has been used more recently and is usually not reclaimed unless "
         "absolutely necessary" },
-    { "proc_meminfo_Inactive", prometheus::MetricType::Gauge,
+    { "proc_meminfo_Inactive", PrometheusKpiType::Gauge,
         "The amount of memory, in kibibytes, that has been used less recently and is more eligible to be reclaimed for "
         "other purposes" },
-    { "proc_meminfo_Active_anon", prometheus::MetricType::Gauge,
+    { "proc_meminfo_Active_anon", PrometheusKpiType::Gauge,
         "The amount of anonymous and tmpfs/shmem memory that is in active use" },
-    { "proc_meminfo_Inactive_anon", prometheus::MetricType::Counter,
+    { "proc_meminfo_Inactive_anon", PrometheusKpiType::Gauge,
         "The amount of anonymous and tmpfs/shmem memory that is a candidate for eviction" },
-    { "proc_meminfo_Active_file", prometheus::MetricType::Gauge,
+    { "proc_meminfo_Active_file", PrometheusKpiType::Gauge,
         "The amount of file cache memory, in kibibytes, that is in active use" },
-    { "proc_meminfo_Inactive_file", prometheus::MetricType::Gauge,
+    { "proc_meminfo_Inactive_file", PrometheusKpiType::Gauge,
         "The amount of file cache memory, in kibibytes, that is newly loaded from the disk, or is a candidate for "
         "reclaiming" },
-    { "proc_meminfo_Unevictable", prometheus::MetricType::Counter,
+    { "proc_meminfo_Unevictable", PrometheusKpiType::Gauge,
         "The amount of memory, in kibibytes, discovered by the pageout code, that is not evictable because it is "
         "locked into memory by user programs" },
-    { "proc_meminfo_Mlocked", prometheus::MetricType::Counter,
+    { "proc_meminfo_Mlocked", PrometheusKpiType::Gauge,
         "The total amount of memory, in kibibytes, that is not evictable because it is locked into memory by user "
         "programs" },
-    { "proc_meminfo_SwapTotal", prometheus::MetricType::Counter, "The total amount of swap available, in kibibytes" },
-    { "proc_meminfo_SwapFree", prometheus::MetricType::Counter, "The total amount of swap free, in kibibytes" },
-    { "proc_meminfo_Dirty", prometheus::MetricType::Gauge,
+    { "proc_meminfo_SwapTotal", PrometheusKpiType::Gauge, "The total amount of swap available, in kibibytes" },
+    { "proc_meminfo_SwapFree", PrometheusKpiType::Gauge, "The total amount of swap free, in kibibytes" },
+    { "proc_meminfo_Dirty", PrometheusKpiType::Gauge,
         "The total amount of memory, in kibibytes, waiting to be written back to the disk" },
-    { "proc_meminfo_Writeback", prometheus::MetricType::Counter,
+    { "proc_meminfo_Writeback", PrometheusKpiType::Gauge,
         "The total amount of memory, in kibibytes, actively being written back to the disk" },
-    { "proc_meminfo_AnonPages", prometheus::MetricType::Gauge,
+    { "proc_meminfo_AnonPages", PrometheusKpiType::Gauge,
         "The total amount of memory, in kibibytes, used by pages that are not backed by files and are mapped into "
         "userspace page tables" },
-    { "proc_meminfo_Mapped", prometheus::MetricType::Gauge,
+    { "proc_meminfo_Mapped", PrometheusKpiType::Gauge,
         "The memory, in kibibytes, used for files that have been mmaped, such as libraries" },
-    { "proc_meminfo_Shmem", prometheus::MetricType::Counter,
+    { "proc_meminfo_Shmem", PrometheusKpiType::Gauge,
         "The total amount of memory, in kibibytes, used by shared memory (shmem) and tmpfs" },
-    { "proc_meminfo_Slab", prometheus::MetricType::Gauge,
+    { "proc_meminfo_Slab", PrometheusKpiType::Gauge,
         "The total amount of memory, in kibibytes, used by the kernel to cache data structures for its own use" },
-    { "proc_meminfo_SReclaimable", prometheus::MetricType::Gauge,
-        "The part of Slab that can be reclaimed, such as caches" },
-    { "proc_meminfo_SUnreclaim", prometheus::MetricType::Gauge,
+    { "proc_meminfo_SReclaimable", PrometheusKpiType::Gauge, "The part of Slab that can be reclaimed, such as caches" },
+    { "proc_meminfo_SUnreclaim", PrometheusKpiType::Gauge,
         "The part of Slab that cannot be reclaimed even when lacking memory" },
-    { "proc_meminfo_KernelStack", prometheus::MetricType::Gauge,
+    { "proc_meminfo_KernelStack", PrometheusKpiType::Gauge,
         "The amount of memory, in kibibytes, used by the kernel stack allocations done for each task in the system" },
-    { "proc_meminfo_PageTables", prometheus::MetricType::Gauge,
+    { "proc_meminfo_PageTables", PrometheusKpiType::Gauge,
         "The total amount of memory, in kibibytes, dedicated to the lowest page table level" },
-    { "proc_meminfo_NFS_Unstable", prometheus::MetricType::Counter,
+    { "proc_meminfo_NFS_Unstable", PrometheusKpiType::Gauge,
         "The amount, in kibibytes, of NFS pages sent to the server but not yet committed to the stable storage" },
-    { "proc_meminfo_Bounce", prometheus::MetricType::Counter,
+    { "proc_meminfo_Bounce", PrometheusKpiType::Gauge,
         "The amount of memory, in kibibytes, used for the block device bounce buffers" },
-    { "proc_meminfo_WritebackTmp", prometheus::MetricType::Gauge,
+    { "proc_meminfo_WritebackTmp", PrometheusKpiType::Gauge,
         "The amount of memory, in kibibytes, used by FUSE for temporary writeback buffers" },
-    { "proc_meminfo_CommitLimit", prometheus::MetricType::Counter,
+    { "proc_meminfo_CommitLimit", PrometheusKpiType::Gauge,
         "The total amount of memory currently available to be allocated on the system based on the overcommit ratio "
         "(vm.overcommit_ratio)" },
-    { "proc_meminfo_Committed_AS", prometheus::MetricType::Gauge,
+    { "proc_meminfo_Committed_AS", PrometheusKpiType::Gauge,
         "The total amount of memory, in kibibytes, estimated to complete the workload" },
-    { "proc_meminfo_VmallocTotal", prometheus::MetricType::Counter,
+    { "proc_meminfo_VmallocTotal", PrometheusKpiType::Gauge,
         "The total amount of memory, in kibibytes, of total allocated virtual address space" },
-    { "proc_meminfo_VmallocUsed", prometheus::MetricType::Counter,
+    { "proc_meminfo_VmallocUsed", PrometheusKpiType::Gauge,
         "The total amount of memory, in kibibytes, of used virtual address space" },
-    { "proc_meminfo_VmallocChunk", prometheus::MetricType::Counter,
+    { "proc_meminfo_VmallocChunk", PrometheusKpiType::Gauge,
         "The largest contiguous block of memory, in kibibytes, of available virtual address space" },
-    { "proc_meminfo_Percpu", prometheus::MetricType::Counter, "The amount of memory dedicated to per-cpu objects" },
-    { "proc_meminfo_HardwareCorrupted", prometheus::MetricType::Counter,
+    { "proc_meminfo_Percpu", PrometheusKpiType::Gauge, "The amount of memory dedicated to per-cpu objects" },
+    { "proc_meminfo_HardwareCorrupted", PrometheusKpiType::Gauge,
         "The amount of memory, in kibibytes, with physical memory corruption problems, identified by the hardware and "
         "set aside by the kernel so it does not get used" },
-    { "proc_meminfo_AnonHugePages", prometheus::MetricType::Counter,
+    { "proc_meminfo_AnonHugePages", PrometheusKpiType::Gauge,
         "The total amount of memory, in kibibytes, used by huge pages that are not backed by files and are mapped into "
         "userspace page tables" },
-    { "proc_meminfo_CmaTotal", prometheus::MetricType::Counter,
+    { "proc_meminfo_CmaTotal", PrometheusKpiType::Gauge,
         "Total amount of Contiguous Memory Area reserved for current kernel" },
-    { "proc_meminfo_CmaFree", prometheus::MetricType::Counter,
+    { "proc_meminfo_CmaFree", PrometheusKpiType::Gauge,
         "Contiguous Memory Area that is free to use by current kernel" },
-    { "proc_meminfo_HugePages_Total", prometheus::MetricType::Counter, "The total number of hugepages for the system" },
-    { "proc_meminfo_HugePages_Free", prometheus::MetricType::Counter,
+    { "proc_meminfo_HugePages_Total", PrometheusKpiType::Gauge, "The total number of hugepages for the system" },
+    { "proc_meminfo_HugePages_Free", PrometheusKpiType::Gauge,
         "The total number of hugepages available for the system" },
-    { "proc_meminfo_HugePages_Rsvd", prometheus::MetricType::Counter,
+    { "proc_meminfo_HugePages_Rsvd", PrometheusKpiType::Gauge,
         "The number of unused huge pages reserved for hugetlbfs" },
-    { "proc_meminfo_HugePages_Surp", prometheus::MetricType::Counter, "The number of surplus huge pages" },
-    { "proc_meminfo_Hugepagesize", prometheus::MetricType::Counter, "The size for each hugepages unit in kibibytes" },
-    { "proc_meminfo_DirectMap4k", prometheus::MetricType::Counter,
+    { "proc_meminfo_HugePages_Surp", PrometheusKpiType::Gauge, "The number of surplus huge pages" },
+    { "proc_meminfo_Hugepagesize", PrometheusKpiType::Gauge, "The size for each hugepages unit in kibibytes" },
+    { "proc_meminfo_DirectMap4k", PrometheusKpiType::Gauge,
         "The amount of memory, in kibibytes, mapped into kernel address space with 4 kB page mappings" },
-    { "proc_meminfo_DirectMap2M", prometheus::MetricType::Counter,
+    { "proc_meminfo_DirectMap2M", PrometheusKpiType::Gauge,
         "The amount of memory, in kibibytes, mapped into kernel address space with 2 MB page mappings" },
-    { "proc_meminfo_DirectMap1G", prometheus::MetricType::Counter,
+    { "proc_meminfo_DirectMap1G", PrometheusKpiType::Gauge,
         "The amount of memory being mapped to hugepages 1GB in size" },
 };
 
 static const prometheus_kpi_descriptor g_prometheus_kpi_proc_vmstat[] = {
     // baremetal: proc_vmstat
-    { "proc_vmstat_allocstall", prometheus::MetricType::Counter, "proc_vmstat_allocstall" },
-    { "proc_vmstat_balloon_deflate", prometheus::MetricType::Counter, "proc_vmstat_balloon_deflate" },
-    { "proc_vmstat_balloon_inflate", prometheus::MetricType::Counter, "proc_vmstat_balloon_inflate" },
-    { "proc_vmstat_balloon_migrate", prometheus::MetricType::Counter, "proc_vmstat_balloon_migrate" },
-    { "proc_vmstat_compact_fail", prometheus::MetricType::Counter, "proc_vmstat_compact_fail" },
-    { "proc_vmstat_compact_free_scanned", prometheus::MetricType::Counter, "proc_vmstat_compact_free_scanned" },
-    { "proc_vmstat_compact_isolated", prometheus::MetricType::Counter, "proc_vmstat_compact_isolated" },
-    { "proc_vmstat_compact_migrate_scanned", prometheus::MetricType::Counter, "proc_vmstat_compact_migrate_scanned" },
-    { "proc_vmstat_compact_stall", prometheus::MetricType::Counter, "proc_vmstat_compact_stall" },
-    { "proc_vmstat_compact_success", prometheus::MetricType::Counter, "proc_vmstat_compact_success" },
-    { "proc_vmstat_drop_pagecache", prometheus::MetricType::Counter, "proc_vmstat_drop_pagecache" },
-    { "proc_vmstat_drop_slab", prometheus::MetricType::Counter, "proc_vmstat_drop_slab" },
-    { "proc_vmstat_htlb_buddy_alloc_fail", prometheus::MetricType::Counter, "proc_vmstat_htlb_buddy_alloc_fail" },
-    { "proc_vmstat_htlb_buddy_alloc_success", prometheus::MetricType::Counter, "proc_vmstat_htlb_buddy_alloc_success" },
-    { "proc_vmstat_kswapd_high_wmark_hit_quickly", prometheus::MetricType::Counter,
+    { "proc_vmstat_allocstall", PrometheusKpiType::Counter, "proc_vmstat_allocstall" },
+    { "proc_vmstat_balloon_deflate", PrometheusKpiType::Counter, "proc_vmstat_balloon_deflate" },
+    { "proc_vmstat_balloon_inflate", PrometheusKpiType::Counter, "proc_vmstat_balloon_inflate" },
+    { "proc_vmstat_balloon_migrate", PrometheusKpiType::Counter, "proc_vmstat_balloon_migrate" },
+    { "proc_vmstat_compact_fail", PrometheusKpiType::Counter, "proc_vmstat_compact_fail" },
+    { "proc_vmstat_compact_free_scanned", PrometheusKpiType::Counter, "proc_vmstat_compact_free_scanned" },
+    { "proc_vmstat_compact_isolated", PrometheusKpiType::Counter, "proc_vmstat_compact_isolated" },
+    { "proc_vmstat_compact_migrate_scanned", PrometheusKpiType::Counter, "proc_vmstat_compact_migrate_scanned" },
+    { "proc_vmstat_compact_stall", PrometheusKpiType::Counter, "proc_vmstat_compact_stall" },
+    { "proc_vmstat_compact_success", PrometheusKpiType::Counter, "proc_vmstat_compact_success" },
+    { "proc_vmstat_drop_pagecache", PrometheusKpiType::Counter, "proc_vmstat_drop_pagecache" },
+    { "proc_vmstat_drop_slab", PrometheusKpiType::Counter, "proc_vmstat_drop_slab" },
+    { "proc_vmstat_htlb_buddy_alloc_fail", PrometheusKpiType::Counter, "proc_vmstat_htlb_buddy_alloc_fail" },
+    { "proc_vmstat_htlb_buddy_alloc_success", PrometheusKpiType::Counter, "proc_vmstat_htlb_buddy_alloc_success" },
+    { "proc_vmstat_kswapd_high_wmark_hit_quickly", PrometheusKpiType::Counter,
         "proc_vmstat_kswapd_high_wmark_hit_quickly" },
-    { "proc_vmstat_kswapd_inodesteal", prometheus::MetricType::Counter, "proc_vmstat_kswapd_inodesteal" },
-    { "proc_vmstat_kswapd_low_wmark_hit_quickly", prometheus::MetricType::Counter,
+    { "proc_vmstat_kswapd_inodesteal", PrometheusKpiType::Counter, "proc_vmstat_kswapd_inodesteal" },
+    { "proc_vmstat_kswapd_low_wmark_hit_quickly", PrometheusKpiType::Counter,
         "proc_vmstat_kswapd_low_wmark_hit_quickly" },
-    { "proc_vmstat_nr_active_anon", prometheus::MetricType::Gauge, "proc_vmstat_nr_active_anon" },
-    { "proc_vmstat_nr_active_file", prometheus::MetricType::Gauge, "proc_vmstat_nr_active_file" },
-    { "proc_vmstat_nr_alloc_batch", prometheus::MetricType::Gauge, "proc_vmstat_nr_alloc_batch" },
-    { "proc_vmstat_nr_anon_pages", prometheus::MetricType::Gauge, "proc_vmstat_nr_anon_pages" },
-    { "proc_vmstat_nr_anon_transparent_hugepages", prometheus::MetricType::Counter,
+    { "proc_vmstat_nr_active_anon", PrometheusKpiType::Gauge, "proc_vmstat_nr_active_anon" },
+    { "proc_vmstat_nr_active_file", PrometheusKpiType::Gauge, "proc_vmstat_nr_active_file" },
+    { "proc_vmstat_nr_alloc_batch", PrometheusKpiType::Gauge, "proc_vmstat_nr_alloc_batch" },
+    { "proc_vmstat_nr_anon_pages", PrometheusKpiType::Gauge, "proc_vmstat_nr_anon_pages" },
+    { "proc_vmstat_nr_anon_transparent_hugepages", PrometheusKpiType::Gauge,
         "proc_vmstat_nr_anon_transparent_hugepages" },
-    { "proc_vmstat_nr_bounce", prometheus::MetricType::Counter, "proc_vmstat_nr_bounce" },
-    { "proc_vmstat_nr_dirtied", prometheus::MetricType::Counter, "proc_vmstat_nr_dirtied" },
-    { "proc_vmstat_nr_dirty", prometheus::MetricType::Gauge, "proc_vmstat_nr_dirty" },
-    { "proc_vmstat_nr_dirty_background_threshold", prometheus::MetricType::Gauge,
+    { "proc_vmstat_nr_bounce", PrometheusKpiType::Gauge, "proc_vmstat_nr_bounce" },
+    { "proc_vmstat_nr_dirtied", PrometheusKpiType::Counter, "proc_vmstat_nr_dirtied" },
+    { "proc_vmstat_nr_dirty", PrometheusKpiType::Gauge, "proc_vmstat_nr_dirty" },
+    { "proc_vmstat_nr_dirty_background_threshold", PrometheusKpiType::Gauge,
         "proc_vmstat_nr_dirty_background_threshold" },
-    { "proc_vmstat_nr_dirty_threshold", prometheus::MetricType::Gauge, "proc_vmstat_nr_dirty_threshold" },
-    { "proc_vmstat_nr_file_pages", prometheus::MetricType::Gauge, "proc_vmstat_nr_file_pages" },
-    { "proc_vmstat_nr_free_cma", prometheus::MetricType::Counter, "proc_vmstat_nr_free_cma" },
-    { "proc_vmstat_nr_free_pages", prometheus::MetricType::Gauge, "proc_vmstat_nr_free_pages" },
-    { "proc_vmstat_nr_inactive_anon", prometheus::MetricType::Gauge, "proc_vmstat_nr_inactive_anon" },
-    { "proc_vmstat_nr_inactive_file", prometheus::MetricType::Gauge, "proc_vmstat_nr_inactive_file" },
-    { "proc_vmstat_nr_isolated_anon", prometheus::MetricType::Counter, "proc_vmstat_nr_isolated_anon" },
-    { "proc_vmstat_nr_isolated_file", prometheus::MetricType::Counter, "proc_vmstat_nr_isolated_file" },
-    { "proc_vmstat_nr_kernel_stack", prometheus::MetricType::Gauge, "proc_vmstat_nr_kernel_stack" },
-    { "proc_vmstat_nr_mapped", prometheus::MetricType::Gauge, "proc_vmstat_nr_mapped" },
-    { "proc_vmstat_nr_mlock", prometheus::MetricType::Counter, "proc_vmstat_nr_mlock" },
-    { "proc_vmstat_nr_page_table_pages", prometheus::MetricType::Gauge, "proc_vmstat_nr_page_table_pages" },
-    { "proc_vmstat_nr_shmem", prometheus::MetricType::Gauge, "proc_vmstat_nr_shmem" },
-    { "proc_vmstat_nr_slab_reclaimable", prometheus::MetricType::Gauge, "proc_vmstat_nr_slab_reclaimable" },
-    { "proc_vmstat_nr_slab_unreclaimable", prometheus::MetricType::Gauge, "proc_vmstat_nr_slab_unreclaimable" },
-    { "proc_vmstat_nr_unevictable", prometheus::MetricType::Counter, "proc_vmstat_nr_unevictable" },
-    { "proc_vmstat_nr_unstable", prometheus::MetricType::Counter, "proc_vmstat_nr_unstable" },
-    { "proc_vmstat_nr_vmscan_immediate_reclaim", prometheus::MetricType::Counter,
+    { "proc_vmstat_nr_dirty_threshold", PrometheusKpiType::Gauge, "proc_vmstat_nr_dirty_threshold" },
+    { "proc_vmstat_nr_file_pages", PrometheusKpiType::Gauge, "proc_vmstat_nr_file_pages" },
+    { "proc_vmstat_nr_free_cma", PrometheusKpiType::Gauge, "proc_vmstat_nr_free_cma" },
+    { "proc_vmstat_nr_free_pages", PrometheusKpiType::Gauge, "proc_vmstat_nr_free_pages" },
+    { "proc_vmstat_nr_inactive_anon", PrometheusKpiType::Gauge, "proc_vmstat_nr_inactive_anon" },
+    { "proc_vmstat_nr_inactive_file", PrometheusKpiType::Gauge, "proc_vmstat_nr_inactive_file" },
+    { "proc_vmstat_nr_isolated_anon", PrometheusKpiType::Gauge, "proc_vmstat_nr_isolated_anon" },
+    { "proc_vmstat_nr_isolated_file", PrometheusKpiType::Gauge, "proc_vmstat_nr_isolated_file" },
+    { "proc_vmstat_nr_kernel_stack", PrometheusKpiType::Gauge, "proc_vmstat_nr_kernel_stack" },
+    { "proc_vmstat_nr_mapped", PrometheusKpiType::Gauge, "proc_vmstat_nr_mapped" },
+    { "proc_vmstat_nr_mlock", PrometheusKpiType::Gauge, "proc_vmstat_nr_mlock" },
+    { "proc_vmstat_nr_page_table_pages", PrometheusKpiType::Gauge, "proc_vmstat_nr_page_table_pages" },
+    { "proc_vmstat_nr_shmem", PrometheusKpiType::Gauge, "proc_vmstat_nr_shmem" },
+    { "proc_vmstat_nr_slab_reclaimable", PrometheusKpiType::Gauge, "proc_vmstat_nr_slab_reclaimable" },
+    { "proc_vmstat_nr_slab_unreclaimable", PrometheusKpiType::Gauge, "proc_vmstat_nr_slab_unreclaimable" },
+    { "proc_vmstat_nr_unevictable", PrometheusKpiType::Gauge, "proc_vmstat_nr_unevictable" },
+    { "proc_vmstat_nr_unstable", PrometheusKpiType::Gauge, "proc_vmstat_nr_unstable" },
+    { "proc_vmstat_nr_vmscan_immediate_reclaim", PrometheusKpiType::Counter,
         "proc_vmstat_nr_vmscan_immediate_reclaim" },
-    { "proc_vmstat_nr_vmscan_write", prometheus::MetricType::Counter, "proc_vmstat_nr_vmscan_write" },
-    { "proc_vmstat_nr_writeback", prometheus::MetricType::Gauge, "proc_vmstat_nr_writeback" },
-    { "proc_vmstat_nr_writeback_temp", prometheus::MetricType::Counter, "proc_vmstat_nr_writeback_temp" },
-    { "proc_vmstat_nr_written", prometheus::MetricType::Counter, "proc_vmstat_nr_written" },
-    { "proc_vmstat_numa_foreign", prometheus::MetricType::Counter, "proc_vmstat_numa_foreign" },
-    { "proc_vmstat_numa_hint_faults", prometheus::MetricType::Counter, "proc_vmstat_numa_hint_faults" },
-    { "proc_vmstat_numa_hint_faults_local", prometheus::MetricType::Counter, "" },
-    { "proc_vmstat_numa_hit", prometheus::MetricType::Counter, "proc_vmstat_numa_hit" },
-    { "proc_vmstat_numa_huge_pte_updates", prometheus::MetricType::Counter, "proc_vmstat_numa_huge_pte_updates" },
-    { "proc_vmstat_numa_interleave", prometheus::MetricType::Counter, "proc_vmstat_numa_interleave" },
-    { "proc_vmstat_numa_local", prometheus::MetricType::Counter, "proc_vmstat_numa_local" },
-    { "proc_vmstat_numa_miss", prometheus::MetricType::Counter, "proc_vmstat_numa_miss" },
-    { "proc_vmstat_numa_other", prometheus::MetricType::Counter, "proc_vmstat_numa_other" },
-    { "proc_vmstat_numa_pages_migrated", prometheus::MetricType::Counter, "proc_vmstat_numa_pages_migrated" },
-    { "proc_vmstat_numa_pte_updates", prometheus::MetricType::Counter, "proc_vmstat_numa_pte_updates" },
-    { "proc_vmstat_pageoutrun", prometheus::MetricType::Counter, "proc_vmstat_pageoutrun" },
-    { "proc_vmstat_pgactivate", prometheus::MetricType::Counter, "proc_vmstat_pgactivate" },
-    { "proc_vmstat_pgalloc_dma", prometheus::MetricType::Counter, "proc_vmstat_pgalloc_dma" },
-    { "proc_vmstat_pgalloc_dma32", prometheus::MetricType::Counter, "proc_vmstat_pgalloc_dma32" },
-    { "proc_vmstat_pgalloc_movable", prometheus::MetricType::Counter, "proc_vmstat_pgalloc_movable" },
-    { "proc_vmstat_pgalloc_normal", prometheus::MetricType::Counter, "proc_vmstat_pgalloc_normal" },
-    { "proc_vmstat_pgdeactivate", prometheus::MetricType::Counter, "proc_vmstat_pgdeactivate" },
-    { "proc_vmstat_pgfault", prometheus::MetricType::Counter, "proc_vmstat_pgfault" },
-    { "proc_vmstat_pgfree", prometheus::MetricType::Counter, "proc_vmstat_pgfree" },
-    { "proc_vmstat_pginodesteal", prometheus::MetricType::Counter, "proc_vmstat_pginodesteal" },
-    { "proc_vmstat_pglazyfreed", prometheus::MetricType::Counter, "proc_vmstat_pglazyfreed" },
-    { "proc_vmstat_pgmajfault", prometheus::MetricType::Counter, "proc_vmstat_pgmajfault" },
-    { "proc_vmstat_pgmigrate_fail", prometheus::MetricType::Counter, "proc_vmstat_pgmigrate_fail" },
-    { "proc_vmstat_pgmigrate_success", prometheus::MetricType::Counter, "proc_vmstat_pgmigrate_success" },
-    { "proc_vmstat_pgpgin", prometheus::MetricType::Counter, "proc_vmstat_pgpgin" },
-    { "proc_vmstat_pgpgout", prometheus::MetricType::Counter, "proc_vmstat_pgpgout" },
-    { "proc_vmstat_pgrefill_dma", prometheus::MetricType::Counter, "proc_vmstat_pgrefill_dma" },
-    { "proc_vmstat_pgrefill_dma32", prometheus::MetricType::Counter, "proc_vmstat_pgrefill_dma32" },
-    { "proc_vmstat_pgrefill_movable", prometheus::MetricType::Counter, "proc_vmstat_pgrefill_movable" },
-    { "proc_vmstat_pgrefill_normal", prometheus::MetricType::Counter, "proc_vmstat_pgrefill_normal" },
-    { "proc_vmstat_pgrotated", prometheus::MetricType::Counter, "proc_vmstat_pgrotated" },
-    { "proc_vmstat_pgscan_direct_dma", prometheus::MetricType::Counter, "proc_vmstat_pgscan_direct_dma" },
-    { "proc_vmstat_pgscan_direct_dma32", prometheus::MetricType::Counter, "proc_vmstat_pgscan_direct_dma32" },
-    { "proc_vmstat_pgscan_direct_movable", prometheus::MetricType::Counter, "proc_vmstat_pgscan_direct_movable" },
-    { "proc_vmstat_pgscan_direct_normal", prometheus::MetricType::Counter, "proc_vmstat_pgscan_direct_normal" },
-    { "proc_vmstat_pgscan_direct_throttle", prometheus::MetricType::Counter, "proc_vmstat_pgscan_direct_throttle" },
-    { "proc_vmstat_pgscan_kswapd_dma", prometheus::MetricType::Counter, "proc_vmstat_pgscan_kswapd_dma" },
-    { "proc_vmstat_pgscan_kswapd_dma32", prometheus::MetricType::Counter, "proc_vmstat_pgscan_kswapd_dma32" },
-    { "proc_vmstat_pgscan_kswapd_movable", prometheus::MetricType::Counter, "proc_vmstat_pgscan_kswapd_movable" },
-    { "proc_vmstat_pgscan_kswapd_normal", prometheus::MetricType::Counter, "proc_vmstat_pgscan_kswapd_normal" },
-    { "proc_vmstat_pgsteal_direct_dma", prometheus::MetricType::Counter, "proc_vmstat_pgsteal_direct_dma" },
-    { "proc_vmstat_pgsteal_direct_dma32", prometheus::MetricType::Counter, "proc_vmstat_pgsteal_direct_dma32" },
-    { "proc_vmstat_pgsteal_direct_movable", prometheus::MetricType::Counter, "proc_vmstat_pgsteal_direct_movable" },
-    { "proc_vmstat_pgsteal_direct_normal", prometheus::MetricType::Counter, "proc_vmstat_pgsteal_direct_normal" },
-    { "proc_vmstat_pgsteal_kswapd_dma", prometheus::MetricType::Counter, "proc_vmstat_pgsteal_kswapd_dma" },
-    { "proc_vmstat_pgsteal_kswapd_dma32", prometheus::MetricType::Counter, "proc_vmstat_pgsteal_kswapd_dma32" },
-    { "proc_vmstat_pgsteal_kswapd_movable", prometheus::MetricType::Counter, "proc_vmstat_pgsteal_kswapd_movable" },
-    { "proc_vmstat_pgsteal_kswapd_normal", prometheus::MetricType::Counter, "proc_vmstat_pgsteal_kswapd_normal" },
-    { "proc_vmstat_pswpin", prometheus::MetricType::Counter, "proc_vmstat_pswpin" },
-    { "proc_vmstat_pswpout", prometheus::MetricType::Counter, "proc_vmstat_pswpout" },
-    { "proc_vmstat_slabs_scanned", prometheus::MetricType::Counter, "proc_vmstat_slabs_scanned" },
-    { "proc_vmstat_swap_ra", prometheus::MetricType::Counter, "proc_vmstat_swap_ra" },
-    { "proc_vmstat_swap_ra_hit", prometheus::MetricType::Counter, "proc_vmstat_swap_ra_hit" },
-    { "proc_vmstat_thp_collapse_alloc", prometheus::MetricType::Counter, "proc_vmstat_thp_collapse_alloc" },
-    { "proc_vmstat_thp_collapse_alloc_failed", prometheus::MetricType::Counter,
-        "proc_vmstat_thp_collapse_alloc_failed" },
-    { "proc_vmstat_thp_fault_alloc", prometheus::MetricType::Counter, "proc_vmstat_thp_fault_alloc" },
-    { "proc_vmstat_thp_fault_fallback", prometheus::MetricType::Counter, "proc_vmstat_thp_fault_fallback" },
-    { "proc_vmstat_thp_split", prometheus::MetricType::Counter, "proc_vmstat_thp_split" },
-    { "proc_vmstat_thp_zero_page_alloc", prometheus::MetricType::Counter, "proc_vmstat_thp_zero_page_alloc" },
-    { "proc_vmstat_thp_zero_page_alloc_failed", prometheus::MetricType::Counter,
-        "proc_vmstat_thp_zero_page_alloc_failed" },
-    { "proc_vmstat_unevictable_pgs_cleared", prometheus::MetricType::Counter, "proc_vmstat_unevictable_pgs_cleared" },
-    { "proc_vmstat_unevictable_pgs_culled", prometheus::MetricType::Counter, "proc_vmstat_unevictable_pgs_culled" },
-    { "proc_vmstat_unevictable_pgs_mlocked", prometheus::MetricType::Counter, "proc_vmstat_unevictable_pgs_mlocked" },
-    { "proc_vmstat_unevictable_pgs_munlocked", prometheus::MetricType::Counter,
-        "proc_vmstat_unevictable_pgs_munlocked" },
-    { "proc_vmstat_unevictable_pgs_rescued", prometheus::MetricType::Counter, "proc_vmstat_unevictable_pgs_rescued" },
-    { "proc_vmstat_unevictable_pgs_scanned", prometheus::MetricType::Counter, "proc_vmstat_unevictable_pgs_scanned" },
-    { "proc_vmstat_unevictable_pgs_stranded", prometheus::MetricType::Counter, "proc_vmstat_unevictable_pgs_stranded" },
-    { "proc_vmstat_workingset_activate", prometheus::MetricType::Counter, "proc_vmstat_workingset_activate" },
-    { "proc_vmstat_workingset_nodereclaim", prometheus::MetricType::Counter, "proc_vmstat_workingset_nodereclaim" },
-    { "proc_vmstat_workingset_refault", prometheus::MetricType::Counter, "proc_vmstat_workingset_refault" },
-    { "proc_vmstat_zone_reclaim_failed", prometheus::MetricType::Counter, "proc_vmstat_zone_reclaim_failed" },
+    { "proc_vmstat_nr_vmscan_write", PrometheusKpiType::Counter, "proc_vmstat_nr_vmscan_write" },
+    { "proc_vmstat_nr_writeback", PrometheusKpiType::Gauge, "proc_vmstat_nr_writeback" },
+    { "proc_vmstat_nr_writeback_temp", PrometheusKpiType::Gauge, "proc_vmstat_nr_writeback_temp" },
+    { "proc_vmstat_nr_written", PrometheusKpiType::Counter, "proc_vmstat_nr_written" },
+    { "proc_vmstat_numa_foreign", PrometheusKpiType::Counter, "proc_vmstat_numa_foreign" },
+    { "proc_vmstat_numa_hint_faults", PrometheusKpiType::Counter, "proc_vmstat_numa_hint_faults" },
+    { "proc_vmstat_numa_hint_faults_local", PrometheusKpiType::Counter, "" },
+    { "proc_vmstat_numa_hit", PrometheusKpiType::Counter, "proc_vmstat_numa_hit" },
+    { "proc_vmstat_numa_huge_pte_updates", PrometheusKpiType::Counter, "proc_vmstat_numa_huge_pte_updates" },
+    { "proc_vmstat_numa_interleave", PrometheusKpiType::Counter, "proc_vmstat_numa_interleave" },
+    { "proc_vmstat_numa_local", PrometheusKpiType::Counter, "proc_vmstat_numa_local" },
+    { "proc_vmstat_numa_miss", PrometheusKpiType::Counter, "proc_vmstat_numa_miss" },
+    { "proc_vmstat_numa_other", PrometheusKpiType::Counter, "proc_vmstat_numa_other" },
+    { "proc_vmstat_numa_pages_migrated", PrometheusKpiType::Counter, "proc_vmstat_numa_pages_migrated" },
+    { "proc_vmstat_numa_pte_updates", PrometheusKpiType::Counter, "proc_vmstat_numa_pte_updates" },
+    { "proc_vmstat_pageoutrun", PrometheusKpiType::Counter, "proc_vmstat_pageoutrun" },
+    { "proc_vmstat_pgactivate", PrometheusKpiType::Counter, "proc_vmstat_pgactivate" },
+    { "proc_vmstat_pgalloc_dma", PrometheusKpiType::Counter, "proc_vmstat_pgalloc_dma" },
+    { "proc_vmstat_pgalloc_dma32", PrometheusKpiType::Counter, "proc_vmstat_pgalloc_dma32" },
+    { "proc_vmstat_pgalloc_movable", PrometheusKpiType::Counter, "proc_vmstat_pgalloc_movable" },
+    { "proc_vmstat_pgalloc_normal", PrometheusKpiType::Counter, "proc_vmstat_pgalloc_normal" },
+    { "proc_vmstat_pgdeactivate", PrometheusKpiType::Counter, "proc_vmstat_pgdeactivate" },
+    { "proc_vmstat_pgfault", PrometheusKpiType::Counter, "proc_vmstat_pgfault" },
+    { "proc_vmstat_pgfree", PrometheusKpiType::Counter, "proc_vmstat_pgfree" },
+    { "proc_vmstat_pginodesteal", PrometheusKpiType::Counter, "proc_vmstat_pginodesteal" },
+    { "proc_vmstat_pglazyfreed", PrometheusKpiType::Counter, "proc_vmstat_pglazyfreed" },
+    { "proc_vmstat_pgmajfault", PrometheusKpiType::Counter, "proc_vmstat_pgmajfault" },
+    { "proc_vmstat_pgmigrate_fail", PrometheusKpiType::Counter, "proc_vmstat_pgmigrate_fail" },
+    { "proc_vmstat_pgmigrate_success", PrometheusKpiType::Counter, "proc_vmstat_pgmigrate_success" },
+    { "proc_vmstat_pgpgin", PrometheusKpiType::Counter, "proc_vmstat_pgpgin" },
+    { "proc_vmstat_pgpgout", PrometheusKpiType::Counter, "proc_vmstat_pgpgout" },
+    { "proc_vmstat_pgrefill_dma", PrometheusKpiType::Counter, "proc_vmstat_pgrefill_dma" },
+    { "proc_vmstat_pgrefill_dma32", PrometheusKpiType::Counter, "proc_vmstat_pgrefill_dma32" },
+    { "proc_vmstat_pgrefill_movable", PrometheusKpiType::Counter, "proc_vmstat_pgrefill_movable" },
+    { "proc_vmstat_pgrefill_normal", PrometheusKpiType::Counter, "proc_vmstat_pgrefill_normal" },
+    { "proc_vmstat_pgrotated", PrometheusKpiType::Counter, "proc_vmstat_pgrotated" },
+    { "proc_vmstat_pgscan_direct_dma", PrometheusKpiType::Counter, "proc_vmstat_pgscan_direct_dma" },
+    { "proc_vmstat_pgscan_direct_dma32", PrometheusKpiType::Counter, "proc_vmstat_pgscan_direct_dma32" },
+    { "proc_vmstat_pgscan_direct_movable", PrometheusKpiType::Counter, "proc_vmstat_pgscan_direct_movable" },
+    { "proc_vmstat_pgscan_direct_normal", PrometheusKpiType::Counter, "proc_vmstat_pgscan_direct_normal" },
+    { "proc_vmstat_pgscan_direct_throttle", PrometheusKpiType::Counter, "proc_vmstat_pgscan_direct_throttle" },
+    { "proc_vmstat_pgscan_kswapd_dma", PrometheusKpiType::Counter, "proc_vmstat_pgscan_kswapd_dma" },
+    { "proc_vmstat_pgscan_kswapd_dma32", PrometheusKpiType::Counter, "proc_vmstat_pgscan_kswapd_dma32" },
+    { "proc_vmstat_pgscan_kswapd_movable", PrometheusKpiType::Counter, "proc_vmstat_pgscan_kswapd_movable" },
+    { "proc_vmstat_pgscan_kswapd_normal", PrometheusKpiType::Counter, "proc_vmstat_pgscan_kswapd_normal" },
+    { "proc_vmstat_pgsteal_direct_dma", PrometheusKpiType::Counter, "proc_vmstat_pgsteal_direct_dma" },
+    { "proc_vmstat_pgsteal_direct_dma32", PrometheusKpiType::Counter, "proc_vmstat_pgsteal_direct_dma32" },
+    { "proc_vmstat_pgsteal_direct_movable", PrometheusKpiType::Counter, "proc_vmstat_pgsteal_direct_movable" },
+    { "proc_vmstat_pgsteal_direct_normal", PrometheusKpiType::Counter, "proc_vmstat_pgsteal_direct_normal" },
+    { "proc_vmstat_pgsteal_kswapd_dma", PrometheusKpiType::Counter, "proc_vmstat_pgsteal_kswapd_dma" },
+    { "proc_vmstat_pgsteal_kswapd_dma32", PrometheusKpiType::Counter, "proc_vmstat_pgsteal_kswapd_dma32" },
+    { "proc_vmstat_pgsteal_kswapd_movable", PrometheusKpiType::Counter, "proc_vmstat_pgsteal_kswapd_movable" },
+    { "proc_vmstat_pgsteal_kswapd_normal", PrometheusKpiType::Counter, "proc_vmstat_pgsteal_kswapd_normal" },
+    { "proc_vmstat_pswpin", PrometheusKpiType::Counter, "proc_vmstat_pswpin" },
+    { "proc_vmstat_pswpout", PrometheusKpiType::Counter, "proc_vmstat_pswpout" },
+    { "proc_vmstat_slabs_scanned", PrometheusKpiType::Counter, "proc_vmstat_slabs_scanned" },
+    { "proc_vmstat_swap_ra", PrometheusKpiType::Counter, "proc_vmstat_swap_ra" },
+    { "proc_vmstat_swap_ra_hit", PrometheusKpiType::Counter, "proc_vmstat_swap_ra_hit" },
+    { "proc_vmstat_thp_collapse_alloc", PrometheusKpiType::Counter, "proc_vmstat_thp_collapse_alloc" },
+    { "proc_vmstat_thp_collapse_alloc_failed", PrometheusKpiType::Counter, "proc_vmstat_thp_collapse_alloc_failed" },
+    { "proc_vmstat_thp_fault_alloc", PrometheusKpiType::Counter, "proc_vmstat_thp_fault_alloc" },
+    { "proc_vmstat_thp_fault_fallback", PrometheusKpiType::Counter, "proc_vmstat_thp_fault_fallback" },
+    { "proc_vmstat_thp_split", PrometheusKpiType::Counter, "proc_vmstat_thp_split" },
+    { "proc_vmstat_thp_zero_page_alloc", PrometheusKpiType::Counter, "proc_vmstat_thp_zero_page_alloc" },
+    { "proc_vmstat_thp_zero_page_alloc_failed", PrometheusKpiType::Counter, "proc_vmstat_thp_zero_page_alloc_failed" },
+    { "proc_vmstat_unevictable_pgs_cleared", PrometheusKpiType::Counter, "proc_vmstat_unevictable_pgs_cleared" },
+    { "proc_vmstat_unevictable_pgs_culled", PrometheusKpiType::Counter, "proc_vmstat_unevictable_pgs_culled" },
+    { "proc_vmstat_unevictable_pgs_mlocked", PrometheusKpiType::Counter, "proc_vmstat_unevictable_pgs_mlocked" },
+    { "proc_vmstat_unevictable_pgs_munlocked", PrometheusKpiType::Counter, "proc_vmstat_unevictable_pgs_munlocked" },
+    { "proc_vmstat_unevictable_pgs_rescued", PrometheusKpiType::Counter, "proc_vmstat_unevictable_pgs_rescued" },
+    { "proc_vmstat_unevictable_pgs_scanned", PrometheusKpiType::Counter, "proc_vmstat_unevictable_pgs_scanned" },
+    { "proc_vmstat_unevictable_pgs_stranded", PrometheusKpiType::Counter, "proc_vmstat_unevictable_pgs_stranded" },
+    { "proc_vmstat_workingset_activate", PrometheusKpiType::Counter, "proc_vmstat_workingset_activate" },
+    { "proc_vmstat_workingset_nodereclaim", PrometheusKpiType::Counter, "proc_vmstat_workingset_nodereclaim" },
+    { "proc_vmstat_workingset_refault", PrometheusKpiType::Counter, "proc_vmstat_workingset_refault" },
+    { "proc_vmstat_zone_reclaim_failed", PrometheusKpiType::Counter, "proc_vmstat_zone_reclaim_failed" },
 };
-#endif
 
 typedef std::map<std::string /* interface name */, std::string /* address */> netdevices_map_t;
 
@@ -448,6 +440,13 @@ public:
     void sample_diskstats(double elapsed, OutputFields output_opts);
     void sample_filesystems();
 
+    // the deltas are computed against the values read by the previous sample; with --trigger-ring the samples
+    // being written compute them against the last written sample instead, skipping the held ones, by saving the
+    // previous values before the first held sample and restoring them before the next sample to write.
+    // Restoring without a saved state does nothing.
+    void save_delta_baselines();
+    void restore_delta_baselines();
+
     //------------------------------------------------------------------------------
     // Utilities shared with CMonitorCgroups
     //------------------------------------------------------------------------------
@@ -515,4 +514,14 @@ private:
 
     // loadavg
     FastFileReader m_loadavg;
+
+    // previous values saved by save_delta_baselines()
+    typedef struct {
+        long long cpu_stat_old_ctxt = 0;
+        long long cpu_stat_old_processes = 0;
+        std::vector<cpu_specs_t> cpu_stat_prev_values;
+        diskinfo_map_t previous_diskinfo;
+        netinfo_map_t previous_netinfo;
+    } delta_baselines_t;
+    std::unique_ptr<delta_baselines_t> m_saved_delta_baselines; // nullptr when nothing is saved
 };
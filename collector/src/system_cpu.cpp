@@ -181,7 +181,7 @@ void CMonitorSystem::sample_cpu_stat(double elapsed_sec, OutputFields output_opt
 
 #define DELTA_CPU_STAT(stat) ((double)(new_values[i].stat - m_cpu_stat_prev_values[i].stat) / elapsed_sec)
 
-            m_pOutput->psubsection_start(fmt::format("cpu{:d}", i).c_str());
+            m_pOutput->psubsection_start(fmt::format("cpu{:d}", i).c_str(), "cpu", fmt::format("{:d}", i).c_str());
             switch (output_opts) {
             case PF_NONE:
                 assert(0);
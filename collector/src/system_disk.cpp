@@ -130,7 +130,7 @@ void CMonitorSystem::sample_diskstats(double elapsed_sec, OutputFields output_op
             const diskinfo_t& previous = it_prev->second;
 
             if (output_opts != PF_NONE) {
-                m_pOutput->psubsection_start(current.dk_name);
+                m_pOutput->psubsection_start(current.dk_name, "disk", current.dk_name);
 
 #define DELTA_DISK_STAT(member) ((double)(current.member - previous.member) / elapsed_sec)
 
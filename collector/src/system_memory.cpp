@@ -102,7 +102,7 @@ void CMonitorSystem::sample_memory(const std::set<std::string>& charted_stats_fr
     numeric_parser_stats_t out_stats;
     read_meminfo_stats(m_meminfo, charted_stats_from_meminfo, m_pOutput, out_stats);
 
-    if (m_pCfg->m_nOutputFields == PF_ALL) {
+    if (m_pCfg->m_nOutputFields == PF_ALL && m_pOutput->is_section_wanted("proc_vmstat")) {
         key_value_map_t out;
         numeric_parser_stats_t out_stats;
         m_vmstat.read_numeric_stats(std::set<std::string>(), out, out_stats);
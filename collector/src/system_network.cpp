@@ -225,7 +225,7 @@ bool CMonitorSystem::output_net_dev_stats(CMonitorOutputFrontend* m_pOutput, dou
 
         // found previous values, statistics can now be generated:
         const netinfo_t& previous = it_prev->second;
-        m_pOutput->psubsection_start(name.c_str());
+        m_pOutput->psubsection_start(name.c_str(), "iface", name.c_str());
 
         switch (output_opts) {
         case PF_NONE:
@@ -0,0 +1,166 @@
+//------------------------------------------------------------------------------
+// Stub HTTP server used by unit tests of the remote sinks
+/*
+	Listens on an ephemeral port of the loopback interface and answers every
+	POST request with a configurable status code. Failures can be injected
+	to check the behaviour of the clients:
+	 - fail the next N requests with HTTP 500
+	 - close the connection after each response
+	 - never answer (to trigger client-side timeouts)
+*/
+//------------------------------------------------------------------------------
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+class StubHttpServer {
+public:
+    StubHttpServer()
+    {
+        m_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(m_listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0; // ephemeral port
+        socklen_t len = sizeof(addr);
+        if (bind(m_listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 && listen(m_listen_fd, 16) == 0
+            && getsockname(m_listen_fd, (struct sockaddr*)&addr, &len) == 0)
+            m_port = ntohs(addr.sin_port);
+
+        m_thread = std::thread(&StubHttpServer::run, this);
+    }
+    ~StubHttpServer()
+    {
+        m_stop = true;
+        m_thread.join();
+        close_client();
+        close(m_listen_fd);
+    }
+
+    unsigned int port() const { return m_port; }
+
+    std::vector<std::string> get_bodies()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_bodies;
+    }
+    std::string get_last_request_head()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_last_head;
+    }
+
+    // failure injection
+    std::atomic<int> m_status { 204 };
+    std::atomic<unsigned int> m_fail_next_requests { 0 }; // answered with HTTP 500
+    std::atomic<bool> m_close_after_response { false };
+    std::atomic<bool> m_never_answer { false };
+
+    // stats
+    std::atomic<unsigned int> m_num_connections { 0 };
+    std::atomic<unsigned int> m_num_requests { 0 };
+
+private:
+    void close_client()
+    {
+        if (m_client_fd != -1)
+            close(m_client_fd);
+        m_client_fd = -1;
+        m_rx.clear();
+    }
+
+    void run()
+    {
+        while (!m_stop) {
+            struct pollfd pfd[2] = { { m_listen_fd, POLLIN, 0 }, { m_client_fd, POLLIN, 0 } };
+            if (poll(pfd, m_client_fd != -1 ? 2 : 1, 20 /* msec */) <= 0)
+                continue;
+
+            if (pfd[0].revents & POLLIN) {
+                // serve one connection at a time: a new one replaces the old one
+                close_client();
+                m_client_fd = accept(m_listen_fd, nullptr, nullptr);
+                m_num_connections++;
+            } else if (m_client_fd != -1 && pfd[1].revents) {
+                char buf[4096];
+                ssize_t n = recv(m_client_fd, buf, sizeof(buf), 0);
+                if (n <= 0) {
+                    close_client();
+                    continue;
+                }
+                m_rx.append(buf, n);
+                while (m_client_fd != -1 && process_request())
+                    ;
+            }
+        }
+    }
+
+    // returns true if a complete request was found in the RX buffer
+    bool process_request()
+    {
+        size_t end_of_head = m_rx.find("\r\n\r\n");
+        if (end_of_head == std::string::npos)
+            return false;
+        std::string head = m_rx.substr(0, end_of_head + 4);
+
+        size_t content_length = 0;
+        size_t cl = head.find("Content-Length: ");
+        if (cl != std::string::npos)
+            content_length = strtoul(head.c_str() + cl + 16, nullptr, 10);
+        if (m_rx.size() < head.size() + content_length)
+            return false;
+
+        std::string body = m_rx.substr(head.size(), content_length);
+        m_rx.erase(0, head.size() + content_length);
+        m_num_requests++;
+        if (m_never_answer)
+            return true;
+
+        int status = m_status;
+        if (m_fail_next_requests > 0) {
+            m_fail_next_requests--;
+            status = 500;
+        } else {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_bodies.push_back(body);
+            m_last_head = head;
+        }
+
+        std::string error_body = status / 100 == 2 ? "" : "{\"error\":\"injected failure\"}";
+        std::string response = "HTTP/1.1 " + std::to_string(status) + " Stub\r\n";
+        if (status != 204)
+            response += "Content-Length: " + std::to_string(error_body.size()) + "\r\n";
+        if (m_close_after_response)
+            response += "Connection: close\r\n";
+        response += "\r\n" + error_body;
+        if (send(m_client_fd, response.data(), response.size(), MSG_NOSIGNAL) < 0 || m_close_after_response)
+            close_client();
+        return true;
+    }
+
+    int m_listen_fd = -1;
+    int m_client_fd = -1;
+    unsigned int m_port = 0;
+    std::string m_rx;
+    std::atomic<bool> m_stop { false };
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::vector<std::string> m_bodies; // bodies of successful requests
+    std::string m_last_head;
+};
@@ -7,7 +7,10 @@
 #include "../output_frontend.h"
 #include "../utils_files.h"
 #include "../utils_string.h"
+#include "stub_http_server.h"
+#include <dirent.h>
 #include <fstream>
+#include <functional>
 #include <gtest/gtest.h>
 #include <iostream>
 #include <sstream> //std::stringstream
@@ -88,7 +91,11 @@ void run_cmonitor_on_tarball_samples( // fn
     const std::string& test_name, const std::string& kernel_under_test, const std::string& cgroup_name,
     bool include_threads, unsigned int nsamples, uint64_t simulated_cmonitor_collector_pid,
     /* expected */
-    CGroupDetected expected_cgroup_ver = CG_VERSION1, uint64_t num_logged_errors = 0)
+    CGroupDetected expected_cgroup_ver = CG_VERSION1, uint64_t num_logged_errors = 0,
+    /* additional sinks */
+    std::function<void(CMonitorOutputFrontend&)> setup_output = nullptr,
+    /* additional config */
+    unsigned int sampling_threads = 1)
 {
     // reset number of logged errors to keep each gtest isolated
     CMonitorLogger::instance()->reset_num_errors();
@@ -98,10 +105,13 @@ void run_cmonitor_on_tarball_samples( // fn
     std::string expected_json_file = get_unit_test_abs_dir() + kernel_under_test + "/expected-" + test_name + ".json";
     CMonitorOutputFrontend actual_output(result_json_file);
     actual_output.enable_json_pretty_print();
+    if (setup_output)
+        setup_output(actual_output);
 
     CMonitorCollectorAppConfig cfg;
     cfg.m_strCGroupName = cgroup_name;
     cfg.m_nProcessScoreThreshold = 0;
+    cfg.m_nSamplingThreads = sampling_threads;
 
     CMonitorLogger::instance()->enable_debug();
     CMonitorLogger::instance()->init_error_output_file("stdout");
@@ -316,3 +326,351 @@ TEST(CGroups, fedora35_Linux_5_14_17_systemd_withthreads)
                 purposes */
         CG_VERSION2, 2 /* num_logged_errors: absence of cpu.max and cpuset.cpus */);
 }
+
+// the tasks are spread over several threads: the output must be identical
+TEST(CGroups, centos7_Linux_3_10_0_docker_withthreads_parallel_sampling)
+{
+    run_cmonitor_on_tarball_samples( // force newline
+        "withthreads", // force newline
+        "centos7-Linux-3.10.0-x86_64-docker", // force newline
+        "docker/d20c1d74e74b4ee40954136e18d33ea85d7333dda4dca0161806395c2d26913c", true /* with threads */,
+        4 /* nsamples */, 1232906 /* simulated_cmonitor_collector_pid */, CG_VERSION1, 0 /* num_logged_errors */,
+        nullptr, 4 /* sampling_threads */);
+}
+TEST(CGroups, fedora35_Linux_5_14_17_systemd_withthreads_parallel_sampling)
+{
+    run_cmonitor_on_tarball_samples( // force newline
+        "withthreads", // force newline
+        "fedora35-Linux-5.14.17-x86_64-systemd", // force newline
+        "self" /* cgroup name: ask to autodetect cgroup under monitor */, true /* with threads */, 4 /* nsamples */,
+        1003 /* simulated_cmonitor_collector_pid */, CG_VERSION2, 2 /* num_logged_errors */, nullptr,
+        3 /* sampling_threads */);
+}
+
+TEST(CGroups, restored_delta_baselines_skip_the_held_samples)
+{
+    // with --trigger-ring, a sample written after some held ones must be identical to the one obtained by
+    // not taking the held samples at all: its deltas cover the whole time since the last written sample
+    const std::string kernel_under_test = "centos7-Linux-3.10.0-x86_64-docker";
+    std::string current_sample_abs_dir = get_unit_test_abs_dir() + kernel_under_test + "/current-sample";
+    std::string result_prefix = get_unit_test_abs_dir() + kernel_under_test + "/result-";
+    CMonitorOutputFrontend output_skipped(result_prefix + "ring-skipped.json");
+    CMonitorOutputFrontend output_held(result_prefix + "ring-held.json");
+    CMonitorCollectorAppConfig cfg;
+    cfg.m_strCGroupName = "docker/d20c1d74e74b4ee40954136e18d33ea85d7333dda4dca0161806395c2d26913c";
+    cfg.m_nProcessScoreThreshold = 0;
+    std::set<std::string> allowedStats;
+
+    uint64_t prev_ts, curr_ts;
+    prepare_sample_dir(kernel_under_test, 1, prev_ts);
+    CMonitorCgroups skipped(&cfg, &output_skipped), held(&cfg, &output_held);
+    skipped.init(true, current_sample_abs_dir, current_sample_abs_dir, 1232906);
+    held.init(true, current_sample_abs_dir, current_sample_abs_dir, 1232906);
+
+    uint64_t last_written_ts = prev_ts;
+    for (unsigned int i = 1; i <= 4; i++) {
+        prepare_sample_dir(kernel_under_test, i, curr_ts);
+        if (i == 3)
+            held.save_delta_baselines(); // sample 3 is held and then discarded
+        else if (i == 4)
+            held.restore_delta_baselines();
+
+        std::vector<std::pair<CMonitorCgroups*, CMonitorOutputFrontend*>> collectors = { { &held, &output_held } };
+        if (i != 3)
+            collectors.push_back(std::make_pair(&skipped, &output_skipped));
+        for (const auto& collector : collectors) {
+            uint64_t since_ts = (collector.first == &held && i == 3) ? prev_ts : last_written_ts;
+            double elapsed_sec = (curr_ts - since_ts) * 1e-9;
+            collector.second->psample_start();
+            collector.first->sample_cpuacct(elapsed_sec);
+            collector.first->sample_memory(allowedStats, allowedStats);
+            collector.first->sample_process_list();
+            collector.first->sample_processes(elapsed_sec, cfg.m_nOutputFields);
+            collector.first->sample_network_interfaces(elapsed_sec, cfg.m_nOutputFields);
+            if (i == 3)
+                collector.second->hold_current_sample();
+            else
+                collector.second->push_current_sample();
+        }
+        if (i != 3)
+            last_written_ts = curr_ts;
+        prev_ts = curr_ts;
+    }
+    output_skipped.close();
+    output_held.close();
+
+    std::string skipped_json = get_file_string(result_prefix + "ring-skipped.json");
+    ASSERT_NE(skipped_json.find("\"pid_1232906\""), std::string::npos);
+    ASSERT_EQ(get_file_string(result_prefix + "ring-held.json"), skipped_json);
+}
+
+//------------------------------------------------------------------------------
+// unit tests on the cardinality caps of the per-task series
+//------------------------------------------------------------------------------
+
+// returns the InfluxDB lines of the given measurement, for each sample producing some
+static std::vector<std::vector<std::string>> get_influxdb_lines(StubHttpServer& server, const std::string& measurement)
+{
+    std::vector<std::vector<std::string>> ret;
+    for (const auto& body : server.get_bodies()) {
+        std::vector<std::string> lines;
+        for (const auto& line : split_string_in_array(body, '\n'))
+            if (line.compare(0, measurement.size() + 1, measurement + ",") == 0)
+                lines.push_back(line);
+        if (!lines.empty())
+            ret.push_back(lines);
+    }
+    return ret;
+}
+
+// returns the value of the given field of an InfluxDB line
+static double get_influxdb_field(const std::string& line, const std::string& field)
+{
+    size_t fields_start = line.find(' ');
+    size_t pos = line.find(" " + field + "=");
+    if (pos == std::string::npos)
+        pos = line.find("," + field + "=", fields_start);
+    if (pos == std::string::npos)
+        return -1;
+    return strtod(line.c_str() + pos + field.size() + 2, nullptr);
+}
+
+static void run_centos7_docker_withthreads_capped(StubHttpServer& server, const std::string& task_limit)
+{
+    // the expected JSON is the same of the uncapped test: local files always get all tasks
+    run_cmonitor_on_tarball_samples( // force newline
+        "withthreads", // force newline
+        "centos7-Linux-3.10.0-x86_64-docker", // force newline
+        "docker/d20c1d74e74b4ee40954136e18d33ea85d7333dda4dca0161806395c2d26913c", true /* with threads */,
+        4 /* nsamples */, 1232906 /* simulated_cmonitor_collector_pid */, CG_VERSION1, 0 /* num_logged_errors */,
+        [&server, &task_limit](CMonitorOutputFrontend& output) {
+            std::string errmsg;
+            ASSERT_TRUE(output.add_task_series_limit(task_limit, errmsg)) << errmsg;
+            remote_sender_config_t cfg;
+            cfg.batch_max_points = 1; // one POST per sample
+            output.init_influxdb_connection("127.0.0.1", server.port(), "test", cfg);
+        });
+}
+
+TEST(CGroups, task_series_capped_by_pid)
+{
+    // the 5 threads of Redis: the 2 busiest keep their series, the other 3 are summed
+    StubHttpServer server;
+    run_centos7_docker_withthreads_capped(server, "influxdb:2");
+
+    std::vector<std::vector<std::string>> samples = get_influxdb_lines(server, "cgroup_tasks_proc_info");
+    ASSERT_EQ(samples.size(), 3); // the first sample is just the bootstrap
+    for (const auto& lines : samples) {
+        ASSERT_EQ(lines.size(), 3);
+        unsigned int num_other = 0;
+        for (const auto& line : lines) {
+            if (line.find("other=true") != std::string::npos) {
+                ASSERT_NE(line.find(",other=true cmon_score="), std::string::npos) << line;
+                ASSERT_NE(line.find(",tasks=3 "), std::string::npos) << line;
+                num_other++;
+            } else
+                ASSERT_NE(line.find(",tgid=1232906,"), std::string::npos) << line;
+        }
+        ASSERT_EQ(num_other, 1);
+    }
+    for (const auto& lines : get_influxdb_lines(server, "cgroup_tasks_cpu"))
+        ASSERT_EQ(lines.size(), 3);
+
+    // the counters of the aggregated series never decrease:
+    std::vector<std::pair<std::string, std::string>> counters = { { "cgroup_tasks_cpu", "usr_total_secs" },
+        { "cgroup_tasks_cpu", "sys_total_secs" }, { "cgroup_tasks_io", "delayacct_blkio_secs" },
+        { "cgroup_tasks_io", "total_read" }, { "cgroup_tasks_io", "total_write" } };
+    for (const auto& counter : counters) {
+        double prev_value = 0;
+        for (const auto& lines : get_influxdb_lines(server, counter.first)) {
+            for (const auto& line : lines) {
+                if (line.find("other=true") == std::string::npos)
+                    continue;
+                double value = get_influxdb_field(line, counter.second);
+                ASSERT_GE(value, prev_value) << line;
+                prev_value = value;
+            }
+        }
+    }
+}
+
+TEST(CGroups, task_series_aggregated_by_tgid)
+{
+    StubHttpServer server;
+    run_centos7_docker_withthreads_capped(server, "influxdb:1:tgid");
+
+    // all threads are summed into the series of their process, named after its main thread:
+    std::vector<std::vector<std::string>> samples = get_influxdb_lines(server, "cgroup_tasks_memory");
+    ASSERT_EQ(samples.size(), 3);
+    for (const auto& lines : samples) {
+        ASSERT_EQ(lines.size(), 1);
+        ASSERT_NE(lines[0].find(",cmd=redis-server,tgid=1232906 "), std::string::npos) << lines[0];
+    }
+
+    // the memory of the process is counted once, not once per thread:
+    ASSERT_EQ(get_influxdb_field(samples[0][0], "rss_bytes"), 5283840) << samples[0][0];
+    ASSERT_EQ(get_influxdb_field(samples[0][0], "virtual_bytes"), 54079488) << samples[0][0];
+    for (const auto& lines : get_influxdb_lines(server, "cgroup_tasks_proc_info"))
+        ASSERT_NE(lines[0].find(",tasks=5 "), std::string::npos) << lines[0];
+
+    // invalid caps:
+    CMonitorOutputFrontend output;
+    std::string errmsg;
+    ASSERT_FALSE(output.add_task_series_limit("json:10", errmsg));
+    ASSERT_FALSE(output.add_task_series_limit("prometheus:0", errmsg));
+    ASSERT_FALSE(output.add_task_series_limit("prometheus:10:uid", errmsg));
+    ASSERT_TRUE(output.add_task_series_limit("prometheus:10:cmd", errmsg));
+}
+
+//------------------------------------------------------------------------------
+// unit tests on the selection of multiple cgroups
+//------------------------------------------------------------------------------
+
+TEST(CGroups, cgroup_name_patterns_are_expanded)
+{
+    std::string kernel_under_test = "centos7-Linux-3.10.0-x86_64-docker";
+    std::string current_sample_abs_dir = get_unit_test_abs_dir() + kernel_under_test + "/current-sample";
+    uint64_t ts;
+    prepare_sample_dir(kernel_under_test, 1, ts);
+
+    CMonitorCollectorAppConfig cfg;
+    CMonitorOutputFrontend output;
+    CMonitorCgroups t(&cfg, &output);
+    std::vector<std::string> names;
+
+    // patterns are matched against the cgroup hierarchy, plain names are kept as they are:
+    ASSERT_TRUE(t.expand_cgroup_names(
+        "docker/*, docker/d20c*,my/plain/name", names, current_sample_abs_dir, current_sample_abs_dir, 1232906));
+    ASSERT_EQ(names.size(), 2U);
+    ASSERT_EQ(names[0], "docker/d20c1d74e74b4ee40954136e18d33ea85d7333dda4dca0161806395c2d26913c");
+    ASSERT_EQ(names[1], "my/plain/name");
+
+    ASSERT_TRUE(t.expand_cgroup_names("kubepods/*", names, current_sample_abs_dir, current_sample_abs_dir, 1232906));
+    ASSERT_TRUE(names.empty());
+}
+
+static size_t count_dir_entries(const char* path)
+{
+    size_t n = 0;
+    DIR* dir = opendir(path);
+    if (dir == nullptr)
+        return 0;
+    while (readdir(dir) != nullptr)
+        n++;
+    closedir(dir);
+    return n;
+}
+
+TEST(CGroups, many_cgroups_have_a_bounded_cost)
+{
+    // what --cgroup-discovery does for each cgroup it monitors, using the same cgroup many times over:
+    const unsigned int num_cgroups = 32, num_threads = 4, max_fds_per_cgroup = 12;
+    std::string kernel_under_test = "centos7-Linux-3.10.0-x86_64-docker";
+    std::string current_sample_abs_dir = get_unit_test_abs_dir() + kernel_under_test + "/current-sample";
+    uint64_t ts;
+    prepare_sample_dir(kernel_under_test, 1, ts);
+
+    CMonitorWorkerPool pool;
+    ASSERT_TRUE(pool.init(num_threads));
+    size_t fds_before = count_dir_entries("/proc/self/fd");
+    size_t threads_before = count_dir_entries("/proc/self/task");
+
+    std::string prefix = "/tmp/cmonitor_unit_tests_" + std::to_string(getpid()) + "_cgroup";
+    std::vector<std::unique_ptr<CMonitorCollectorAppConfig>> cfgs;
+    std::vector<std::unique_ptr<CMonitorOutputFrontend>> outputs;
+    std::vector<std::unique_ptr<CMonitorCgroups>> cgroups;
+    for (unsigned int i = 0; i < num_cgroups; i++) {
+        cfgs.emplace_back(new CMonitorCollectorAppConfig());
+        cfgs.back()->m_strCGroupName = "docker/d20c1d74e74b4ee40954136e18d33ea85d7333dda4dca0161806395c2d26913c";
+        cfgs.back()->m_nSamplingThreads = num_threads;
+        outputs.emplace_back(new CMonitorOutputFrontend());
+        ASSERT_TRUE(outputs.back()->init_json_output_file(prefix + std::to_string(i)));
+        cgroups.emplace_back(new CMonitorCgroups(cfgs.back().get(), outputs.back().get(), &pool));
+        cgroups.back()->init(false /* include_threads */, current_sample_abs_dir, current_sample_abs_dir, 1232906);
+        ASSERT_EQ(cgroups.back()->get_detected_cgroup_version(), CG_VERSION1);
+    }
+    for (unsigned int n = 0; n < 2; n++) {
+        for (unsigned int i = 0; i < num_cgroups; i++) {
+            outputs[i]->psample_start();
+            cgroups[i]->sample_cpuacct(1.0);
+            cgroups[i]->sample_process_list();
+            cgroups[i]->sample_processes(1.0, PF_ALL);
+            outputs[i]->push_current_sample();
+        }
+    }
+
+    // the sampling threads are shared, the open files grow linearly:
+    ASSERT_EQ(count_dir_entries("/proc/self/task"), threads_before);
+    ASSERT_LE(count_dir_entries("/proc/self/fd"), fds_before + num_cgroups * max_fds_per_cgroup);
+
+    // failing to open the output of a cgroup is not fatal:
+    CMonitorOutputFrontend output;
+    ASSERT_FALSE(output.init_json_output_file("/not-existing-dir/cgroup"));
+
+    cgroups.clear();
+    outputs.clear();
+    for (unsigned int i = 0; i < num_cgroups; i++)
+        unlink((prefix + std::to_string(i) + ".json").c_str());
+}
+
+TEST(CGroups, recreated_cgroup_keeps_the_output_of_its_previous_instance)
+{
+    // what --cgroup-discovery does when a cgroup is removed and then created again with the same name:
+    std::string prefix = "/tmp/cmonitor_unit_tests_" + std::to_string(getpid()) + "_recreated";
+    std::vector<std::string> files;
+    for (unsigned int instance = 1; instance <= 3; instance++) {
+        std::string filename_prefix
+            = instance == 1 ? prefix : get_unused_filename_prefix(prefix, { ".json", ".cbor" });
+        files.push_back(filename_prefix + ".json");
+
+        CMonitorOutputFrontend output;
+        ASSERT_TRUE(output.init_json_output_file(filename_prefix));
+        output.pheader_start();
+        output.push_header();
+        output.psample_array_start();
+        output.psample_start();
+        output.psection_start("cgroup_memory_stats");
+        output.plong("instance", instance);
+        output.psection_end();
+        output.push_current_sample();
+        output.psample_array_end();
+        output.close();
+    }
+
+    ASSERT_EQ(files, std::vector<std::string>({ prefix + ".json", prefix + ".2.json", prefix + ".3.json" }));
+    for (unsigned int i = 0; i < files.size(); i++) {
+        std::string contents = get_file_string(files[i]);
+        ASSERT_NE(contents.find("\"instance\": " + std::to_string(i + 1)), std::string::npos) << contents;
+        unlink(files[i].c_str());
+    }
+}
+
+//------------------------------------------------------------------------------
+// unit tests on the lifecycle of the monitored cgroup
+//------------------------------------------------------------------------------
+
+TEST(CGroups, cgroup_v2_is_not_alive_once_empty)
+{
+    std::string kernel_under_test = "fedora35-Linux-5.14.17-x86_64-docker";
+    std::string current_sample_abs_dir = get_unit_test_abs_dir() + kernel_under_test + "/current-sample";
+    uint64_t ts;
+    prepare_sample_dir(kernel_under_test, 1, ts);
+
+    CMonitorCollectorAppConfig cfg;
+    cfg.m_strCGroupName = "system.slice/docker-3cfe7ca058f43dbb15a6cc68c472978a14c93fd7e263384dd0a1fa1517f6d7f0.scope";
+    CMonitorOutputFrontend output;
+    CMonitorCgroups t(&cfg, &output);
+    t.init(false /* include_threads */, current_sample_abs_dir, current_sample_abs_dir, 3834);
+    ASSERT_EQ(t.get_detected_cgroup_version(), CG_VERSION2);
+
+    std::string events_file = t.get_events_file();
+    ASSERT_EQ(events_file, current_sample_abs_dir + "/sys/fs/cgroup/" + cfg.m_strCGroupName + "/cgroup.events");
+    ASSERT_TRUE(t.cgroup_is_alive());
+
+    // the processes of the container exited, but the container runtime did not remove the cgroup yet:
+    std::string contents = get_file_string(events_file);
+    std::ofstream(events_file) << "populated 0\nfrozen 0\n";
+    ASSERT_TRUE(t.cgroup_still_exists());
+    ASSERT_FALSE(t.cgroup_is_alive());
+    std::ofstream(events_file) << contents;
+}
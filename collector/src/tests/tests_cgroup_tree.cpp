@@ -0,0 +1,171 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the incremental discovery of cgroups
+//------------------------------------------------------------------------------
+
+#include "../cgroup_tree.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+// inotify works the same way on plain directories and on cgroupfs: a temporary folder plays the hierarchy
+class TestHierarchy {
+public:
+    TestHierarchy(const char* suffix)
+    {
+        m_root = "/tmp/cmonitor_unit_tests_" + std::to_string(getpid()) + "_" + suffix;
+        ::mkdir(m_root.c_str(), 0755);
+    }
+    ~TestHierarchy()
+    {
+        std::string cmd = "rm -rf " + m_root;
+        if (system(cmd.c_str()) != 0)
+            fprintf(stderr, "Failed to remove %s\n", m_root.c_str());
+    }
+
+    const std::string& get_root() const { return m_root; }
+    void mkdir(const std::string& path) { ASSERT_EQ(::mkdir((m_root + "/" + path).c_str(), 0755), 0); }
+    void rmdir(const std::string& path) { ASSERT_EQ(::rmdir((m_root + "/" + path).c_str()), 0); }
+    void rename(const std::string& from, const std::string& to)
+    {
+        ASSERT_EQ(::rename((m_root + "/" + from).c_str(), (m_root + "/" + to).c_str()), 0);
+    }
+
+private:
+    std::string m_root;
+};
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(CgroupTree, initial_walk)
+{
+    TestHierarchy hierarchy("tree_walk");
+    hierarchy.mkdir("docker");
+    hierarchy.mkdir("docker/abc");
+    hierarchy.mkdir("docker/def");
+    hierarchy.mkdir("system.slice");
+    FILE* f = fopen((hierarchy.get_root() + "/docker/memory.stat").c_str(), "w"); // files are not cgroups
+    fclose(f);
+
+    CMonitorCgroupTree tree;
+    ASSERT_TRUE(tree.init(hierarchy.get_root() + "/"));
+    std::vector<std::string> expected = { "docker", "docker/abc", "docker/def", "system.slice" };
+    ASSERT_EQ(tree.get_cgroups(), expected);
+    ASSERT_TRUE(tree.is_watching_all());
+    ASSERT_TRUE(tree.has_children("docker"));
+    ASSERT_FALSE(tree.has_children("docker/abc"));
+    ASSERT_FALSE(tree.has_children("system.slice"));
+
+    std::vector<std::string> added, removed;
+    ASSERT_FALSE(tree.update(added, removed));
+    ASSERT_TRUE(added.empty());
+    ASSERT_TRUE(removed.empty());
+
+    ASSERT_FALSE(tree.init(hierarchy.get_root() + "/not-existing"));
+}
+
+TEST(CgroupTree, incremental_updates)
+{
+    TestHierarchy hierarchy("tree_updates");
+    hierarchy.mkdir("docker");
+
+    CMonitorCgroupTree tree;
+    ASSERT_TRUE(tree.init(hierarchy.get_root()));
+    ASSERT_EQ(tree.get_num_cgroups(), 1U);
+
+    // a whole subtree appearing at once is reported parents first:
+    std::vector<std::string> added, removed;
+    hierarchy.mkdir("docker/abc");
+    hierarchy.mkdir("docker/abc/child");
+    hierarchy.mkdir("kubepods");
+    ASSERT_TRUE(tree.update(added, removed));
+    std::vector<std::string> expected = { "docker/abc", "docker/abc/child", "kubepods" };
+    std::sort(added.begin(), added.end());
+    ASSERT_EQ(added, expected);
+    ASSERT_TRUE(removed.empty());
+
+    // cgroups created inside a cgroup discovered by an update are watched as well:
+    hierarchy.mkdir("kubepods/pod1");
+    ASSERT_TRUE(tree.update(added, removed));
+    ASSERT_EQ(added, std::vector<std::string>({ "kubepods/pod1" }));
+
+    hierarchy.rmdir("docker/abc/child");
+    hierarchy.rmdir("docker/abc");
+    ASSERT_TRUE(tree.update(added, removed));
+    ASSERT_TRUE(added.empty());
+    std::sort(removed.begin(), removed.end());
+    ASSERT_EQ(removed, std::vector<std::string>({ "docker/abc", "docker/abc/child" }));
+
+    // a renamed cgroup is reported as removed and added again, together with its children; its siblings
+    // sorting between it and its children are left alone:
+    hierarchy.mkdir("kubepods/pod1/container");
+    hierarchy.mkdir("kubepods/pod1-x");
+    hierarchy.mkdir("kubepods/pod1.slice");
+    ASSERT_TRUE(tree.update(added, removed));
+    hierarchy.rename("kubepods/pod1", "kubepods/pod2");
+    ASSERT_TRUE(tree.update(added, removed));
+    ASSERT_EQ(removed, std::vector<std::string>({ "kubepods/pod1", "kubepods/pod1/container" }));
+    ASSERT_EQ(added, std::vector<std::string>({ "kubepods/pod2", "kubepods/pod2/container" }));
+
+    expected = { "docker", "kubepods", "kubepods/pod1-x", "kubepods/pod1.slice", "kubepods/pod2",
+        "kubepods/pod2/container" };
+    ASSERT_EQ(tree.get_cgroups(), expected);
+    ASSERT_EQ(tree.get_stats().full_scans, 1U); // no rescan was needed
+    ASSERT_EQ(tree.get_stats().added, 9U);
+    ASSERT_EQ(tree.get_stats().removed, 4U);
+}
+
+TEST(CgroupTree, discovery_limit_with_churn)
+{
+    TestHierarchy hierarchy("tree_churn");
+    hierarchy.mkdir("docker");
+    for (const char* name : { "docker/e", "docker/b", "docker/d", "docker/a", "docker/c" })
+        hierarchy.mkdir(name);
+
+    CMonitorCgroupTree tree;
+    ASSERT_TRUE(tree.init(hierarchy.get_root()));
+
+    // without patterns only the leaves match, the first ones by path fill the slots:
+    std::set<std::string> monitored;
+    std::vector<std::string> selected;
+    ASSERT_FALSE(tree.select_cgroups_to_monitor(tree.get_cgroups(), {}, monitored, 3, selected));
+    ASSERT_EQ(selected, std::vector<std::string>({ "docker/a", "docker/b", "docker/c" }));
+    monitored.insert(selected.begin(), selected.end());
+
+    // a cgroup created while the limit is reached is refused as well:
+    std::vector<std::string> added, removed;
+    hierarchy.mkdir("docker/0");
+    ASSERT_TRUE(tree.update(added, removed));
+    ASSERT_FALSE(tree.select_cgroups_to_monitor(added, {}, monitored, 3, selected));
+    ASSERT_TRUE(selected.empty());
+
+    // the slot freed by a removal goes to the first of the refused cgroups, in a stable order:
+    hierarchy.rmdir("docker/b");
+    ASSERT_TRUE(tree.update(added, removed));
+    monitored.erase("docker/b");
+    ASSERT_FALSE(tree.select_cgroups_to_monitor(tree.get_cgroups(), {}, monitored, 3, selected));
+    ASSERT_EQ(selected, std::vector<std::string>({ "docker/0" }));
+    monitored.insert(selected.begin(), selected.end());
+
+    // once enough cgroups are gone all the refused ones get monitored:
+    hierarchy.rmdir("docker/a");
+    hierarchy.rmdir("docker/c");
+    ASSERT_TRUE(tree.update(added, removed));
+    monitored.erase("docker/a");
+    monitored.erase("docker/c");
+    ASSERT_TRUE(tree.select_cgroups_to_monitor(tree.get_cgroups(), {}, monitored, 3, selected));
+    ASSERT_EQ(selected, std::vector<std::string>({ "docker/d", "docker/e" }));
+    monitored.insert(selected.begin(), selected.end());
+    ASSERT_EQ(monitored, std::set<std::string>({ "docker/0", "docker/d", "docker/e" }));
+
+    // the patterns select non-leaf cgroups too:
+    ASSERT_TRUE(tree.select_cgroups_to_monitor(tree.get_cgroups(), { "docker" }, {}, 3, selected));
+    ASSERT_EQ(selected, std::vector<std::string>({ "docker" }));
+}
@@ -0,0 +1,87 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the budget on the CPU used by the collector
+//------------------------------------------------------------------------------
+
+#include "../cpu_budget.h"
+#include <gtest/gtest.h>
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(CpuBudget, usage_is_measured_over_windows)
+{
+    const uint64_t msec = 1000000; // in nsecs
+
+    CMonitorCpuBudget budget;
+    budget.init(1 /* perc */, 1000);
+    ASSERT_TRUE(budget.is_enabled());
+
+    // the first sample starts the window:
+    ASSERT_FALSE(budget.check(5000, 500 * msec));
+
+    // 10 secs with 50msecs of CPU: 0.5%
+    for (uint64_t t = 6000; t < 15000; t += 1000)
+        ASSERT_FALSE(budget.check(t, 500 * msec + (t - 5000) / 200 * msec));
+    ASSERT_FALSE(budget.check(15000, 550 * msec));
+    ASSERT_DOUBLE_EQ(budget.get_last_usage_perc(), 0.5);
+
+    // 10 secs with 200msecs of CPU: 2%
+    for (uint64_t t = 16000; t < 25000; t += 1000)
+        ASSERT_FALSE(budget.check(t, 550 * msec));
+    ASSERT_TRUE(budget.check(25000, 750 * msec));
+    ASSERT_DOUBLE_EQ(budget.get_last_usage_perc(), 2);
+
+    // with long sampling intervals the window spans at least 3 samples:
+    budget.init(1, 60000);
+    ASSERT_FALSE(budget.check(1000, 0));
+    ASSERT_FALSE(budget.check(61000, 60000 * msec));
+    ASSERT_FALSE(budget.check(121000, 60000 * msec));
+    ASSERT_TRUE(budget.check(181000, 60000 * msec));
+    ASSERT_NEAR(budget.get_last_usage_perc(), 33.3, 0.1);
+}
+
+TEST(CpuBudget, degradation_steps_are_taken_in_order)
+{
+    CMonitorCpuBudget budget;
+    budget.init(1, 1000);
+
+    // the task interval is doubled up to 8 times:
+    ASSERT_EQ(budget.degrade(true, 100, true), CPU_BUDGET_LENGTHEN_TASK_INTERVAL);
+    ASSERT_EQ(budget.degrade(true, 100, true), CPU_BUDGET_LENGTHEN_TASK_INTERVAL);
+    ASSERT_EQ(budget.degrade(true, 100, true), CPU_BUDGET_LENGTHEN_TASK_INTERVAL);
+    ASSERT_EQ(budget.get_task_interval_factor(), 8U);
+
+    // then the tasks are halved, down to the minimum:
+    ASSERT_EQ(budget.degrade(true, 100, true), CPU_BUDGET_CAP_TASKS);
+    ASSERT_EQ(budget.get_max_tasks(), 50U);
+    ASSERT_EQ(budget.degrade(true, 100, true), CPU_BUDGET_CAP_TASKS);
+    ASSERT_EQ(budget.get_max_tasks(), 25U);
+    ASSERT_EQ(budget.degrade(true, 100, true), CPU_BUDGET_CAP_TASKS);
+    ASSERT_EQ(budget.get_max_tasks(), (size_t)CPU_BUDGET_MIN_TASKS);
+
+    // then the deep fields are dropped and nothing else is left:
+    ASSERT_EQ(budget.degrade(true, 100, true), CPU_BUDGET_DISABLE_DEEP_FIELDS);
+    ASSERT_EQ(budget.degrade(true, 100, false), CPU_BUDGET_EXHAUSTED);
+    ASSERT_EQ(budget.degrade(true, 100, false), CPU_BUDGET_NONE); // reported only once
+    ASSERT_EQ(budget.get_level(), 7U);
+}
+
+TEST(CpuBudget, inapplicable_steps_are_skipped)
+{
+    // no cgroup task sampled: straight to the deep fields
+    CMonitorCpuBudget budget;
+    budget.init(1, 1000);
+    ASSERT_EQ(budget.degrade(false, 0, true), CPU_BUDGET_DISABLE_DEEP_FIELDS);
+    ASSERT_EQ(budget.degrade(false, 0, false), CPU_BUDGET_EXHAUSTED);
+
+    // the interval cannot be changed but there are many tasks
+    CMonitorCpuBudget budget2;
+    budget2.init(1, 1000);
+    ASSERT_EQ(budget2.degrade(false, 40, false), CPU_BUDGET_CAP_TASKS);
+    ASSERT_EQ(budget2.get_max_tasks(), 20U);
+    ASSERT_EQ(budget2.get_task_interval_factor(), 1U);
+
+    // the cap follows the number of tasks when they decrease
+    ASSERT_EQ(budget2.degrade(false, 10, false), CPU_BUDGET_EXHAUSTED);
+}
@@ -0,0 +1,92 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the persistent HTTP client
+//------------------------------------------------------------------------------
+
+#include "../http_client.h"
+#include "../utils_misc.h"
+#include "stub_http_server.h"
+#include <gtest/gtest.h>
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(HttpClient, keepalive_reuses_connection)
+{
+    StubHttpServer server;
+    CMonitorHttpClient client;
+    ASSERT_TRUE(client.init("127.0.0.1", server.port()));
+
+    for (unsigned int i = 0; i < 20; i++)
+        ASSERT_EQ(client.post("/write?db=test", "meas value=" + std::to_string(i)), 204);
+
+    ASSERT_TRUE(client.is_connected());
+    ASSERT_EQ(client.get_num_connects(), 1);
+    ASSERT_EQ(server.m_num_connections, 1);
+    ASSERT_EQ(server.get_bodies().size(), 20);
+    ASSERT_EQ(server.get_bodies().back(), "meas value=19");
+}
+
+TEST(HttpClient, reconnects_when_server_closes)
+{
+    StubHttpServer server;
+    server.m_close_after_response = true;
+
+    CMonitorHttpClient client;
+    ASSERT_TRUE(client.init("localhost", server.port()));
+    for (unsigned int i = 0; i < 5; i++)
+        ASSERT_EQ(client.post("/write?db=test", "meas value=1"), 204);
+    ASSERT_EQ(client.get_num_connects(), 5);
+
+    // now the server stops closing connections; also error responses keep the connection open:
+    server.m_close_after_response = false;
+    server.m_fail_next_requests = 1;
+    ASSERT_EQ(client.post("/write?db=test", "meas value=1"), 500);
+    ASSERT_EQ(client.get_last_response_body(), "{\"error\":\"injected failure\"}");
+    ASSERT_EQ(client.post("/write?db=test", "meas value=1"), 204);
+    ASSERT_EQ(client.get_num_connects(), 6);
+    ASSERT_EQ(client.get_num_failures(), 0);
+}
+
+TEST(HttpClient, unreachable_server_does_not_stall)
+{
+    unsigned int port;
+    {
+        StubHttpServer server; // just to find a free port
+        port = server.port();
+    }
+
+    CMonitorHttpClient client;
+    ASSERT_TRUE(client.init("127.0.0.1", port));
+    ASSERT_EQ(client.post("/write", "meas value=1"), HTTP_CLIENT_ERR_CONNECT);
+
+    // while the backoff is in progress no attempt is done at all:
+    uint64_t start = get_monotonic_msec();
+    for (unsigned int i = 0; i < 100; i++)
+        ASSERT_EQ(client.post("/write", "meas value=1"), HTTP_CLIENT_ERR_BACKOFF);
+    ASSERT_LT(get_monotonic_msec() - start, 100);
+    ASSERT_EQ(client.get_num_failures(), 1);
+}
+
+TEST(HttpClient, response_timeout)
+{
+    StubHttpServer server;
+    server.m_never_answer = true;
+
+    CMonitorHttpClient client;
+    client.set_timeouts(200, 200);
+    ASSERT_TRUE(client.init("127.0.0.1", server.port()));
+
+    uint64_t start = get_monotonic_msec();
+    ASSERT_EQ(client.post("/write", "meas value=1"), HTTP_CLIENT_ERR_RECV);
+    uint64_t elapsed = get_monotonic_msec() - start;
+    ASSERT_GE(elapsed, 190);
+    ASSERT_LT(elapsed, 1000);
+    ASSERT_FALSE(client.is_connected());
+
+    // once the server recovers and the backoff expires, data flows again:
+    server.m_never_answer = false;
+    usleep((HTTP_CLIENT_MIN_BACKOFF_MSEC + 50) * 1000);
+    ASSERT_EQ(client.post("/write", "meas value=1"), 204);
+    ASSERT_EQ(client.get_num_connects(), 2);
+}
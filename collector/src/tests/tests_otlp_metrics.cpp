@@ -0,0 +1,476 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the OTLP/HTTP metrics sink
+//------------------------------------------------------------------------------
+
+#include "../cgroups.h"
+#include "../otlp_metrics.h"
+#include "../output_frontend.h"
+#include "../system.h"
+#include "stub_http_server.h"
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+// OTLP receiver side: decodes the bodies received by the stub server
+//------------------------------------------------------------------------------
+
+typedef std::map<std::string, std::string> attributes_t;
+
+typedef struct {
+    std::string scope;
+    std::string scope_version;
+    std::string metric;
+    std::string description;
+    bool is_sum = false;
+    bool is_monotonic = false;
+    uint64_t temporality = 0;
+    attributes_t attributes;
+    uint64_t start_time = 0;
+    uint64_t time = 0;
+    bool is_int = false;
+    double dvalue = 0;
+    int64_t ivalue = 0;
+} decoded_point_t;
+
+typedef struct {
+    attributes_t resource;
+    std::vector<std::string> scopes; // in the order they were encoded
+    std::vector<decoded_point_t> points;
+} decoded_resource_metrics_t;
+
+static bool read_varint(const std::string& buf, size_t& pos, uint64_t& value)
+{
+    value = 0;
+    for (unsigned int shift = 0; pos < buf.size() && shift < 64; shift += 7) {
+        uint8_t b = buf[pos++];
+        value |= (uint64_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+// iterates over the fields of a protobuf message, invoking fn(field_number, value, payload)
+// where payload holds the bytes of LEN fields and value the VARINT/FIXED64 ones
+template <typename Fn> static bool for_each_field(const std::string& msg, Fn fn)
+{
+    size_t pos = 0;
+    while (pos < msg.size()) {
+        uint64_t key, value = 0;
+        if (!read_varint(msg, pos, key))
+            return false;
+        std::string payload;
+        switch (key & 7) {
+        case 0:
+            if (!read_varint(msg, pos, value))
+                return false;
+            break;
+        case 1:
+            if (pos + 8 > msg.size())
+                return false;
+            for (int i = 7; i >= 0; i--)
+                value = value << 8 | (uint8_t)msg[pos + i];
+            pos += 8;
+            break;
+        case 2:
+            if (!read_varint(msg, pos, value) || pos + value > msg.size())
+                return false;
+            payload = msg.substr(pos, value);
+            pos += value;
+            break;
+        default:
+            return false;
+        }
+        if (!fn(key >> 3, value, payload))
+            return false;
+    }
+    return true;
+}
+
+static bool decode_key_value(const std::string& msg, attributes_t& out)
+{
+    std::string key, value;
+    bool ok = for_each_field(msg, [&](uint64_t field, uint64_t, const std::string& payload) {
+        if (field == 1)
+            key = payload;
+        else if (field == 2)
+            return for_each_field(payload, [&value](uint64_t f, uint64_t, const std::string& str) {
+                if (f == 1) // AnyValue.string_value
+                    value = str;
+                return true;
+            });
+        return true;
+    });
+    out[key] = value;
+    return ok;
+}
+
+static bool decode_data_point(const std::string& msg, decoded_point_t& point)
+{
+    return for_each_field(msg, [&point](uint64_t field, uint64_t value, const std::string& payload) {
+        switch (field) {
+        case 7:
+            return decode_key_value(payload, point.attributes);
+        case 2:
+            point.start_time = value;
+            break;
+        case 3:
+            point.time = value;
+            break;
+        case 4:
+            memcpy(&point.dvalue, &value, sizeof(point.dvalue));
+            break;
+        case 6:
+            point.is_int = true;
+            point.ivalue = (int64_t)value;
+            break;
+        }
+        return true;
+    });
+}
+
+static bool decode_metric(const std::string& msg, decoded_point_t prototype, std::vector<decoded_point_t>& out)
+{
+    std::string data;
+    bool ok = for_each_field(msg, [&](uint64_t field, uint64_t, const std::string& payload) {
+        if (field == 1)
+            prototype.metric = payload;
+        else if (field == 2)
+            prototype.description = payload;
+        else if (field == 5 || field == 7) {
+            prototype.is_sum = field == 7;
+            data = payload;
+        }
+        return true;
+    });
+
+    // Gauge/Sum: the data points are decoded after the Sum properties
+    std::vector<std::string> data_points;
+    ok = ok && for_each_field(data, [&](uint64_t field, uint64_t value, const std::string& payload) {
+        if (field == 1)
+            data_points.push_back(payload);
+        else if (field == 2)
+            prototype.temporality = value;
+        else if (field == 3)
+            prototype.is_monotonic = value != 0;
+        return true;
+    });
+    for (const auto& data_point : data_points) {
+        decoded_point_t point = prototype;
+        ok = ok && decode_data_point(data_point, point);
+        out.push_back(point);
+    }
+    return ok;
+}
+
+static bool decode_export_request(const std::string& body, std::vector<decoded_resource_metrics_t>& out)
+{
+    return for_each_field(body, [&out](uint64_t field, uint64_t, const std::string& rm_msg) {
+        if (field != 1)
+            return false;
+        decoded_resource_metrics_t rm;
+        bool ok = for_each_field(rm_msg, [&rm](uint64_t field, uint64_t, const std::string& payload) {
+            if (field == 1) // Resource
+                return for_each_field(payload, [&rm](uint64_t, uint64_t, const std::string& kv) {
+                    return decode_key_value(kv, rm.resource);
+                });
+
+            // ScopeMetrics
+            decoded_point_t prototype;
+            return for_each_field(payload, [&](uint64_t f, uint64_t, const std::string& sub_msg) {
+                if (f == 1) {
+                    for_each_field(sub_msg, [&prototype](uint64_t f, uint64_t, const std::string& str) {
+                        (f == 1 ? prototype.scope : prototype.scope_version) = str;
+                        return true;
+                    });
+                    rm.scopes.push_back(prototype.scope);
+                    return true;
+                }
+                return decode_metric(sub_msg, prototype, rm.points);
+            });
+        });
+        out.push_back(rm);
+        return ok;
+    });
+}
+
+static std::vector<const decoded_point_t*> find_points(const decoded_resource_metrics_t& rm, const std::string& metric)
+{
+    std::vector<const decoded_point_t*> ret;
+    for (const auto& point : rm.points)
+        if (point.metric == metric)
+            ret.push_back(&point);
+    return ret;
+}
+
+static void produce_sample(CMonitorOutputFrontend& output, unsigned int n, unsigned int first_pid = 1)
+{
+    output.psample_start();
+    output.psection_start("proc_loadavg");
+    output.pdouble("load_avg_1min", 0.5 * n);
+    output.psection_end();
+    output.psection_start("cgroup_tasks");
+    for (unsigned int pid = first_pid; pid <= first_pid + 1; pid++) {
+        std::map<std::string, std::string> labels = { { "pid", std::to_string(pid) }, { "cmd", "task" } };
+        output.psubsection_start(("pid_" + std::to_string(pid)).c_str(), labels);
+        output.psubsubsection_start("proc_info", labels);
+        output.pstring("cmd", "task");
+        output.psubsubsection_end();
+        output.psubsubsection_start("cpu", labels);
+        output.pdouble("usr", 10.0 * pid + n);
+        output.psubsubsection_end();
+        output.psubsubsection_start("memory", labels);
+        output.plong("major_faults", 100 * pid + n);
+        output.psubsubsection_end();
+        output.psubsection_end();
+    }
+    output.psection_end();
+    output.push_current_sample();
+}
+
+static const prometheus_kpi_descriptor g_test_kpis[] = {
+    { "cgroup_tasks_usr", PrometheusKpiType::Gauge, "User CPU" },
+    { "cgroup_tasks_major_faults", PrometheusKpiType::Counter, "Major page faults" },
+};
+
+static void init_output(CMonitorOutputFrontend& output, const StubHttpServer& server, const remote_sender_config_t& cfg)
+{
+    output.init_otlp_connection("127.0.0.1", server.port(), OTLP_DEFAULT_PATH, { { "env", "ci" } }, cfg);
+    ASSERT_TRUE(output.wants_kpi_descriptors());
+    output.init_prometheus_kpis(g_test_kpis, sizeof(g_test_kpis) / sizeof(g_test_kpis[0]));
+
+    output.pheader_start();
+    output.psection_start("identity");
+    output.pstring("hostname", "myhost");
+    output.psection_end();
+    output.push_header();
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(OtlpMetrics, scopes_sums_and_gauges_are_decoded_by_receiver)
+{
+    StubHttpServer server;
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 1; // one POST per sample
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t before_nsec = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    CMonitorOutputFrontend output;
+    init_output(output, server, cfg);
+    produce_sample(output, 1);
+    produce_sample(output, 2);
+    output.close();
+
+    ASSERT_EQ(server.get_last_request_head().find("POST " OTLP_DEFAULT_PATH " HTTP/1.1\r\n"), 0);
+    ASSERT_NE(server.get_last_request_head().find(OTLP_HEADERS), std::string::npos);
+    std::vector<std::string> bodies = server.get_bodies();
+    ASSERT_EQ(bodies.size(), 2);
+
+    std::vector<decoded_resource_metrics_t> all;
+    ASSERT_TRUE(decode_export_request(bodies[0], all));
+    ASSERT_EQ(all.size(), 1);
+    const decoded_resource_metrics_t& rm = all[0];
+
+    // host-wide labels are resource attributes:
+    ASSERT_EQ(rm.resource.at("service.name"), "cmonitor");
+    ASSERT_EQ(rm.resource.at("host.name"), "myhost");
+    ASSERT_EQ(rm.resource.at("env"), "ci");
+
+    // one scope per section, one Metric per KPI, one data point per series; strings are not sent
+    ASSERT_EQ(rm.scopes, std::vector<std::string>({ "proc_loadavg", "cgroup_tasks" }));
+    ASSERT_EQ(rm.points.size(), 5);
+    for (const auto& point : rm.points) {
+        ASSERT_EQ(point.scope_version, VERSION_STRING);
+        ASSERT_GE(point.time, before_nsec);
+    }
+
+    // KPIs without a descriptor are gauges:
+    std::vector<const decoded_point_t*> load = find_points(rm, "proc_loadavg_load_avg_1min");
+    ASSERT_EQ(load.size(), 1);
+    ASSERT_EQ(load[0]->scope, "proc_loadavg");
+    ASSERT_FALSE(load[0]->is_sum);
+    ASSERT_FALSE(load[0]->is_int);
+    ASSERT_EQ(load[0]->dvalue, 0.5);
+    ASSERT_EQ(load[0]->start_time, 0);
+    ASSERT_TRUE(load[0]->attributes.empty());
+
+    std::vector<const decoded_point_t*> usr = find_points(rm, "cgroup_tasks_usr");
+    ASSERT_EQ(usr.size(), 2);
+    for (unsigned int i = 0; i < 2; i++) {
+        ASSERT_EQ(usr[i]->scope, "cgroup_tasks");
+        ASSERT_FALSE(usr[i]->is_sum);
+        ASSERT_EQ(usr[i]->description, "User CPU");
+        attributes_t expected = { { "cmd", "task" }, { "metric", "cpu" }, { "pid", std::to_string(i + 1) } };
+        ASSERT_EQ(usr[i]->attributes, expected);
+        ASSERT_EQ(usr[i]->dvalue, 10.0 * (i + 1) + 1);
+    }
+
+    // counters are monotonic cumulative sums of integers, starting when their series first appeared:
+    std::vector<const decoded_point_t*> faults = find_points(rm, "cgroup_tasks_major_faults");
+    ASSERT_EQ(faults.size(), 2);
+    for (unsigned int i = 0; i < 2; i++) {
+        ASSERT_TRUE(faults[i]->is_sum);
+        ASSERT_TRUE(faults[i]->is_monotonic);
+        ASSERT_EQ(faults[i]->temporality, 2);
+        ASSERT_TRUE(faults[i]->is_int);
+        ASSERT_EQ(faults[i]->ivalue, 100 * (i + 1) + 1);
+        ASSERT_EQ(faults[i]->attributes.at("metric"), "memory");
+        ASSERT_EQ(faults[i]->start_time, faults[i]->time);
+    }
+
+    // the second sample keeps the same start time for the counters:
+    all.clear();
+    ASSERT_TRUE(decode_export_request(bodies[1], all));
+    ASSERT_EQ(all.size(), 1);
+    faults = find_points(all[0], "cgroup_tasks_major_faults");
+    ASSERT_EQ(faults.size(), 2);
+    ASSERT_EQ(faults[0]->ivalue, 102);
+    ASSERT_EQ(faults[0]->start_time, find_points(rm, "cgroup_tasks_major_faults")[0]->start_time);
+    ASSERT_LT(faults[0]->start_time, faults[0]->time);
+}
+
+TEST(OtlpMetrics, recreated_series_restart_their_sums)
+{
+    StubHttpServer server;
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 1; // one POST per sample
+
+    // PID 1 exits after the first sample and is recycled by a new task in the third one:
+    CMonitorOutputFrontend output;
+    init_output(output, server, cfg);
+    produce_sample(output, 1, 1); // PIDs 1 and 2
+    usleep(1000);
+    produce_sample(output, 2, 2); // PIDs 2 and 3
+    usleep(1000);
+    produce_sample(output, 3, 1); // PIDs 1 and 2
+    output.close();
+
+    std::vector<std::string> bodies = server.get_bodies();
+    ASSERT_EQ(bodies.size(), 3);
+    std::vector<decoded_resource_metrics_t> all;
+    for (const auto& body : bodies)
+        ASSERT_TRUE(decode_export_request(body, all));
+    ASSERT_EQ(all.size(), 3);
+
+    std::vector<std::vector<const decoded_point_t*>> faults;
+    for (const auto& rm : all) {
+        faults.push_back(find_points(rm, "cgroup_tasks_major_faults"));
+        ASSERT_EQ(faults.back().size(), 2);
+    }
+
+    // PID 2 is present in all samples: its Sum never restarts
+    ASSERT_EQ(faults[0][1]->attributes.at("pid"), "2");
+    ASSERT_EQ(faults[1][0]->attributes.at("pid"), "2");
+    ASSERT_EQ(faults[2][1]->attributes.at("pid"), "2");
+    ASSERT_EQ(faults[1][0]->start_time, faults[0][1]->start_time);
+    ASSERT_EQ(faults[2][1]->start_time, faults[0][1]->start_time);
+
+    // the recycled PID 1 restarts from its reappearance, not from the first sample:
+    ASSERT_EQ(faults[2][0]->attributes.at("pid"), "1");
+    ASSERT_EQ(faults[2][0]->ivalue, 103);
+    ASSERT_GT(faults[2][0]->start_time, faults[0][0]->time);
+    ASSERT_EQ(faults[2][0]->start_time, faults[2][0]->time);
+}
+
+TEST(OtlpMetrics, only_cumulative_kpis_of_real_tables_are_sums)
+{
+    // the levels (e.g. the free swap or the RSS of a task) go up and down: a receiver would take each
+    // decrease of a monotonic Sum as a reset, so only the really cumulative KPIs are Sums
+    StubHttpServer server;
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 1; // one POST per sample
+
+    CMonitorOutputFrontend output;
+    output.init_otlp_connection("127.0.0.1", server.port(), OTLP_DEFAULT_PATH, {}, cfg);
+    output.init_prometheus_kpis(g_prometheus_kpi_proc_meminfo,
+        sizeof(g_prometheus_kpi_proc_meminfo) / sizeof(g_prometheus_kpi_proc_meminfo[0]));
+    output.init_prometheus_kpis(g_prometheus_kpi_cgroup_processes,
+        sizeof(g_prometheus_kpi_cgroup_processes) / sizeof(g_prometheus_kpi_cgroup_processes[0]));
+    output.pheader_start();
+    output.push_header();
+
+    output.psample_start();
+    output.psection_start("proc_meminfo");
+    output.plong("SwapFree", 1024);
+    output.plong("MemTotal", 4096);
+    output.psection_end();
+    output.psection_start("cgroup_tasks");
+    std::map<std::string, std::string> labels = { { "pid", "1" }, { "cmd", "task" } };
+    output.psubsection_start("pid_1", labels);
+    output.psubsubsection_start("cpu", labels);
+    output.pdouble("usr_total_secs", 1.5);
+    output.psubsubsection_end();
+    output.psubsubsection_start("memory", labels);
+    output.plong("resident_kb", 512);
+    output.plong("sched_policy", 0);
+    output.plong("rss_bytes", 524288);
+    output.psubsubsection_end();
+    output.psubsubsection_start("io", labels);
+    output.pdouble("delayacct_blkio_secs", 0.5);
+    output.plong("total_read", 100);
+    output.psubsubsection_end();
+    output.psubsection_end();
+    output.psection_end();
+    output.push_current_sample();
+    output.close();
+
+    std::vector<std::string> bodies = server.get_bodies();
+    ASSERT_EQ(bodies.size(), 1);
+    std::vector<decoded_resource_metrics_t> all;
+    ASSERT_TRUE(decode_export_request(bodies[0], all));
+    ASSERT_EQ(all.size(), 1);
+
+    for (const char* gauge : { "proc_meminfo_SwapFree", "proc_meminfo_MemTotal", "cgroup_tasks_resident_kb",
+             "cgroup_tasks_sched_policy", "cgroup_tasks_rss_bytes" }) {
+        std::vector<const decoded_point_t*> points = find_points(all[0], gauge);
+        ASSERT_EQ(points.size(), 1) << gauge;
+        ASSERT_FALSE(points[0]->is_sum) << gauge;
+        ASSERT_EQ(points[0]->start_time, 0) << gauge;
+    }
+    for (const char* sum : { "cgroup_tasks_usr_total_secs", "cgroup_tasks_delayacct_blkio_secs",
+             "cgroup_tasks_total_read" }) {
+        std::vector<const decoded_point_t*> points = find_points(all[0], sum);
+        ASSERT_EQ(points.size(), 1) << sum;
+        ASSERT_TRUE(points[0]->is_sum) << sum;
+        ASSERT_TRUE(points[0]->is_monotonic) << sum;
+    }
+
+    // no field of /proc/meminfo is cumulative:
+    for (const auto& kpi : g_prometheus_kpi_proc_meminfo)
+        ASSERT_EQ(kpi.kpi_type, PrometheusKpiType::Gauge) << kpi.kpi_name;
+}
+
+TEST(OtlpMetrics, samples_are_batched_and_filtered)
+{
+    StubHttpServer server;
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 1000;
+    cfg.batch_max_msec = 60000; // batches are closed only by close()
+
+    CMonitorOutputFrontend output;
+    std::string errmsg;
+    ASSERT_TRUE(output.add_output_filter("otlp:-proc_loadavg,-cgroup_tasks/usr", errmsg));
+    init_output(output, server, cfg);
+    for (unsigned int n = 1; n <= 3; n++)
+        produce_sample(output, n);
+    output.close();
+
+    // the batch is a single valid request made of the ResourceMetrics of all samples:
+    std::vector<std::string> bodies = server.get_bodies();
+    ASSERT_EQ(bodies.size(), 1);
+    std::vector<decoded_resource_metrics_t> all;
+    ASSERT_TRUE(decode_export_request(bodies[0], all));
+    ASSERT_EQ(all.size(), 3);
+    for (unsigned int n = 0; n < 3; n++) {
+        ASSERT_EQ(all[n].resource.at("host.name"), "myhost");
+        ASSERT_EQ(all[n].scopes, std::vector<std::string>({ "cgroup_tasks" }));
+        ASSERT_EQ(all[n].points.size(), 2);
+        ASSERT_EQ(find_points(all[n], "cgroup_tasks_major_faults").size(), 2);
+        ASSERT_EQ(find_points(all[n], "cgroup_tasks_major_faults")[1]->ivalue, 200 + n + 1);
+    }
+}
@@ -0,0 +1,532 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the output frontend encoders
+//------------------------------------------------------------------------------
+
+#include "../cgroups.h"
+#include "../logger.h"
+#include "../output_frontend.h"
+#include "../utils_files.h"
+#include "../utils_string.h"
+#include "stub_http_server.h"
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iostream>
+
+//------------------------------------------------------------------------------
+// GTest helpers (defined in tests_cgroup.cpp)
+//------------------------------------------------------------------------------
+
+std::string get_unit_test_abs_dir();
+std::string get_file_string(const std::string& file);
+void prepare_sample_dir(std::string kernel_test, unsigned int sampleIdx, uint64_t& sample_timestamp_nsec);
+
+// defined in tests_prometheus_server.cpp:
+std::string scrape(unsigned int port, const std::string& extra_headers, std::string* head_out);
+
+//------------------------------------------------------------------------------
+// Minimal CBOR decoder re-emitting the document as machine-friendly JSON
+// (i.e. with the same formatting used by CMonitorOutputFrontend when pretty-printing is off)
+//------------------------------------------------------------------------------
+
+class CborToJsonConverter {
+public:
+    CborToJsonConverter(const std::string& cbor)
+        : m_cbor(cbor)
+    {
+    }
+
+    bool convert(std::string& json)
+    {
+        // document is an indefinite map with "header" and "samples" keys:
+        if (read_byte() != CBOR_INDEFINITE_MAP_HEAD)
+            return false;
+
+        std::string key;
+        if (!read_text(key) || key != "header")
+            return false;
+        json += "{\n\"header\": {";
+        if (!convert_map_members(json))
+            return false;
+        json += "},\n";
+
+        if (!read_text(key) || key != "samples")
+            return false;
+        if (read_byte() != CBOR_INDEFINITE_ARRAY_HEAD)
+            return false;
+        json += "\"samples\": [\n";
+
+        for (unsigned int nsample = 0; peek_byte() != CBOR_BREAK; nsample++) {
+            if (nsample > 0)
+                json += ",\n";
+            json += "{";
+            if (!convert_map_members(json))
+                return false;
+            json += "}";
+        }
+        read_byte(); // end of samples array
+        json += "]\n}\n";
+
+        return read_byte() == CBOR_BREAK && m_pos == m_cbor.size();
+    }
+
+private:
+    int peek_byte() const { return m_pos < m_cbor.size() ? (uint8_t)m_cbor[m_pos] : -1; }
+    int read_byte() { return m_pos < m_cbor.size() ? (uint8_t)m_cbor[m_pos++] : -1; }
+
+    bool read_head(uint8_t& major_type, uint64_t& value)
+    {
+        int b = read_byte();
+        if (b < 0)
+            return false;
+        major_type = b >> 5;
+        uint8_t info = b & 0x1F;
+        if (info < 24) {
+            value = info;
+            return true;
+        }
+        if (info > 27)
+            return false;
+
+        unsigned int nbytes = 1 << (info - 24);
+        value = 0;
+        for (unsigned int i = 0; i < nbytes; i++) {
+            if ((b = read_byte()) < 0)
+                return false;
+            value = (value << 8) | (uint8_t)b;
+        }
+        return true;
+    }
+
+    bool read_text(std::string& out)
+    {
+        uint8_t mt;
+        uint64_t len;
+        if (!read_head(mt, len) || mt != CBOR_MAJOR_TYPE_TEXT_STRING || m_pos + len > m_cbor.size())
+            return false;
+        out = m_cbor.substr(m_pos, len);
+        m_pos += len;
+        return true;
+    }
+
+    bool convert_map_members(std::string& json)
+    {
+        uint8_t mt;
+        uint64_t nmembers;
+        if (!read_head(mt, nmembers) || mt != CBOR_MAJOR_TYPE_MAP)
+            return false;
+
+        std::string key, value;
+        for (uint64_t n = 0; n < nmembers; n++) {
+            if (!read_text(key))
+                return false;
+            json += "\"" + key + "\": ";
+
+            int b = peek_byte();
+            if (b < 0)
+                return false;
+            switch (b >> 5) {
+            case CBOR_MAJOR_TYPE_MAP:
+                json += "{";
+                if (!convert_map_members(json))
+                    return false;
+                json += "}";
+                break;
+            case CBOR_MAJOR_TYPE_TEXT_STRING:
+                if (!read_text(value))
+                    return false;
+                json += "\"" + value + "\"";
+                break;
+            case CBOR_MAJOR_TYPE_UNSIGNED_INT: {
+                uint64_t v = 0;
+                if (!read_head(mt, v))
+                    return false;
+                json += fmt::format("{}", v);
+            } break;
+            case CBOR_MAJOR_TYPE_NEGATIVE_INT: {
+                uint64_t v = 0;
+                if (!read_head(mt, v))
+                    return false;
+                json += fmt::format("{}", -1 - (int64_t)v);
+            } break;
+            case CBOR_MAJOR_TYPE_SIMPLE: {
+                uint64_t bits = 0;
+                if (b != CBOR_FLOAT64_HEAD || !read_head(mt, bits))
+                    return false;
+                double d;
+                memcpy(&d, &bits, sizeof(d));
+                json += fmt::format("{:.3f}", d);
+            } break;
+            default:
+                return false;
+            }
+
+            if (n < nmembers - 1)
+                json += ",";
+        }
+        return true;
+    }
+
+    const std::string& m_cbor;
+    size_t m_pos = 0;
+};
+
+//------------------------------------------------------------------------------
+// Round-trip CBOR vs JSON
+//------------------------------------------------------------------------------
+
+void run_cbor_json_roundtrip_on_tarball_samples( // fn
+    const std::string& kernel_under_test, const std::string& cgroup_name, unsigned int nsamples,
+    uint64_t simulated_cmonitor_collector_pid)
+{
+    std::string result_prefix = get_unit_test_abs_dir() + kernel_under_test + "/result-roundtrip";
+    std::string current_sample_abs_dir = get_unit_test_abs_dir() + kernel_under_test + "/current-sample";
+
+    {
+        // produce both encodings from the same frontend, i.e. from the very same sample trees:
+        CMonitorOutputFrontend actual_output(result_prefix);
+        actual_output.init_cbor_output_file(result_prefix);
+
+        CMonitorCollectorAppConfig cfg;
+        cfg.m_strCGroupName = cgroup_name;
+        cfg.m_nProcessScoreThreshold = 0;
+        cfg.m_nOutputFields = PF_ALL;
+
+        std::set<std::string> allowedStats;
+        uint64_t prev_ts;
+        prepare_sample_dir(kernel_under_test, 1, prev_ts);
+
+        CMonitorCgroups t(&cfg, &actual_output);
+        t.init(true /* include threads */, current_sample_abs_dir, current_sample_abs_dir,
+            simulated_cmonitor_collector_pid);
+
+        actual_output.pheader_start();
+        t.output_config();
+        actual_output.push_header();
+        actual_output.psample_array_start();
+        for (unsigned int i = 0; i < nsamples; i++) {
+            uint64_t curr_ts;
+            prepare_sample_dir(kernel_under_test, i + 1, curr_ts);
+            double elapsed_sec = (curr_ts - prev_ts) * (1e-9);
+
+            actual_output.psample_start();
+            t.sample_cpuacct(elapsed_sec);
+            t.sample_memory(allowedStats, allowedStats);
+            t.sample_process_list();
+            t.sample_processes(elapsed_sec, cfg.m_nOutputFields);
+            t.sample_network_interfaces(elapsed_sec, cfg.m_nOutputFields);
+            actual_output.push_current_sample();
+            prev_ts = curr_ts;
+        }
+        actual_output.psample_array_end();
+        actual_output.close();
+    }
+
+    std::string json_str = get_file_string(result_prefix + ".json");
+    std::string cbor_str = get_file_string(result_prefix + ".cbor");
+    ASSERT_FALSE(json_str.empty());
+    ASSERT_FALSE(cbor_str.empty());
+
+    // the binary encoding is expected to be noticeably more compact:
+    printf("JSON size: %zu bytes, CBOR size: %zu bytes\n", json_str.size(), cbor_str.size());
+    ASSERT_LT(cbor_str.size(), json_str.size());
+
+    std::string json_from_cbor;
+    CborToJsonConverter converter(cbor_str);
+    ASSERT_TRUE(converter.convert(json_from_cbor));
+    ASSERT_EQ(json_from_cbor, json_str);
+}
+
+TEST(OutputFrontend, cbor_roundtrip_centos7_Linux_3_10_0_docker)
+{
+    run_cbor_json_roundtrip_on_tarball_samples( // force newline
+        "centos7-Linux-3.10.0-x86_64-docker", // force newline
+        "docker/d20c1d74e74b4ee40954136e18d33ea85d7333dda4dca0161806395c2d26913c", 4 /* nsamples */,
+        1232906 /* simulated_cmonitor_collector_pid */);
+}
+
+TEST(OutputFrontend, cbor_roundtrip_fedora35_Linux_5_14_17_docker)
+{
+    run_cbor_json_roundtrip_on_tarball_samples( // force newline
+        "fedora35-Linux-5.14.17-x86_64-docker", // force newline
+        "system.slice/docker-3cfe7ca058f43dbb15a6cc68c472978a14c93fd7e263384dd0a1fa1517f6d7f0.scope/",
+        4 /* nsamples */, 3834 /* simulated_cmonitor_collector_pid */);
+}
+
+//------------------------------------------------------------------------------
+// Per-sink filters
+//------------------------------------------------------------------------------
+
+TEST(OutputFilters, rules_and_masks)
+{
+    CMonitorOutputFilters filters;
+    std::string errmsg;
+    ASSERT_TRUE(filters.empty());
+
+    // invalid rule sets:
+    ASSERT_FALSE(filters.add_rules("prometheus", errmsg));
+    ASSERT_FALSE(filters.add_rules("nosuchsink:+stat", errmsg));
+    ASSERT_FALSE(filters.add_rules("prometheus:stat", errmsg));
+    ASSERT_TRUE(filters.empty());
+
+    ASSERT_TRUE(filters.add_rules("prometheus:+cgroup_*,-cgroup_tasks", errmsg));
+    ASSERT_TRUE(filters.add_rules("influxdb:-cgroup_tasks,+cgroup_tasks/user,+cgroup_tasks/sys", errmsg));
+    ASSERT_TRUE(filters.add_rules("json:-stat/cpu*", errmsg));
+    ASSERT_FALSE(filters.empty());
+
+    sink_mask_t all_but_prometheus = SINK_MASK_ALL & ~SINK_MASK(SINK_PROMETHEUS);
+    ASSERT_EQ(filters.get_section_mask("stat"), all_but_prometheus);
+    ASSERT_EQ(filters.get_section_mask("cgroup_memory_stats"), SINK_MASK_ALL);
+    ASSERT_EQ(filters.get_section_mask("cgroup_tasks"), all_but_prometheus);
+
+    uint32_t stat_id = filters.intern_section("stat");
+    uint32_t tasks_id = filters.intern_section("cgroup_tasks");
+    ASSERT_EQ(filters.intern_section("stat"), stat_id);
+
+    for (int repeat = 0; repeat < 2; repeat++) { // second pass exercises the cached masks
+        ASSERT_EQ(filters.get_measurement_mask(stat_id, "cpu_total"), SINK_MASK(SINK_INFLUXDB) | SINK_MASK(SINK_OTLP));
+        ASSERT_EQ(filters.get_measurement_mask(stat_id, "ctxt"), all_but_prometheus);
+        ASSERT_EQ(filters.get_measurement_mask(tasks_id, "user"), all_but_prometheus);
+        ASSERT_EQ(
+            filters.get_measurement_mask(tasks_id, "cmd_line"), SINK_MASK(SINK_LOCAL_FILE) | SINK_MASK(SINK_OTLP));
+    }
+}
+
+TEST(OutputFilters, json_output_skips_filtered_kpis)
+{
+    std::string prefix = "/tmp/cmonitor_tests_output_filters";
+    {
+        CMonitorOutputFrontend output(prefix);
+        std::string errmsg;
+        ASSERT_TRUE(output.add_output_filter("json:-cgroup_tasks/cmd_line,-proc_loadavg", errmsg));
+        ASSERT_FALSE(output.is_section_wanted("proc_loadavg"));
+        ASSERT_TRUE(output.is_section_wanted("cgroup_tasks"));
+        ASSERT_FALSE(output.is_measurement_wanted("cgroup_tasks", "cmd_line")); // not even sampled
+        ASSERT_TRUE(output.is_measurement_wanted("cgroup_tasks", "cmd"));
+        ASSERT_FALSE(output.wants_labels()); // no remote sink
+
+        output.psample_array_start();
+        output.psample_start();
+        output.psection_start("cgroup_tasks");
+        output.psubsection_start("pid_1");
+        output.pstring("cmd", "init");
+        output.pstring("cmd_line", "/sbin/init --some-arg");
+        output.plong("pid", 1);
+        output.psubsection_end();
+        output.psection_end();
+        output.psection_start("proc_loadavg");
+        output.pdouble("load_avg_1min", 0.5);
+        output.psection_end();
+        output.push_current_sample();
+        output.psample_array_end();
+        output.close();
+    }
+
+    std::string json_str = get_file_string(prefix + ".json");
+    unlink((prefix + ".json").c_str());
+    ASSERT_NE(json_str.find("\"cmd\": \"init\",\"pid\": 1}"), std::string::npos);
+    ASSERT_EQ(json_str.find("cmd_line"), std::string::npos);
+    ASSERT_EQ(json_str.find("load_avg_1min"), std::string::npos);
+}
+
+//------------------------------------------------------------------------------
+// Prometheus series groups
+//------------------------------------------------------------------------------
+
+#ifdef PROMETHEUS_SUPPORT
+TEST(OutputFrontend, prometheus_series_groups_follow_their_labels)
+{
+    static const prometheus_kpi_descriptor kpis[] = {
+        { "tasks_usr", PrometheusKpiType::Gauge, "User CPU" },
+    };
+
+    CMonitorOutputFrontend output;
+    ASSERT_TRUE(output.init_prometheus_connection("127.0.0.1", 0, {}));
+    output.init_prometheus_kpis(kpis, sizeof(kpis) / sizeof(kpis[0]));
+    ASSERT_TRUE(output.wants_labels());
+
+    auto produce_sample = [&output](const char* cmd, double usr) {
+        std::map<std::string, std::string> labels = { { "pid", "1" }, { "cmd", cmd } };
+        output.psample_start();
+        output.psection_start("tasks");
+        output.psubsection_start("pid_1", labels);
+        output.psubsubsection_start("cpu", labels);
+        output.pdouble("usr", usr);
+        output.psubsubsection_end();
+        output.psubsection_end();
+        output.psection_end();
+        output.push_current_sample();
+    };
+
+    // same group and same labels: the series is just updated
+    produce_sample("a", 1);
+    produce_sample("a", 2);
+    std::string metrics = scrape(output.get_prometheus_port(), "", nullptr);
+    ASSERT_NE(metrics.find("tasks_usr{cmd=\"a\",metric=\"cpu\",pid=\"1\"} 2\n"), std::string::npos);
+    ASSERT_NE(metrics.find("cmonitor_prometheus_live_series 1\n"), std::string::npos);
+
+    // the PID got reused by another command: the series of the group is replaced
+    produce_sample("b", 3);
+    metrics = scrape(output.get_prometheus_port(), "", nullptr);
+    ASSERT_EQ(metrics.find("cmd=\"a\""), std::string::npos);
+    ASSERT_NE(metrics.find("tasks_usr{cmd=\"b\",metric=\"cpu\",pid=\"1\"} 3\n"), std::string::npos);
+    ASSERT_NE(metrics.find("cmonitor_prometheus_live_series 1\n"), std::string::npos);
+}
+#endif
+
+//------------------------------------------------------------------------------
+// InfluxDB line protocol
+//------------------------------------------------------------------------------
+
+static void produce_influxdb_sample(CMonitorOutputFrontend& output, const char* cmd)
+{
+    std::map<std::string, std::string> labels = { { "pid", "1" }, { "cmd", cmd } };
+
+    output.psample_start();
+    output.psection_start("proc_loadavg");
+    output.pdouble("load_avg_1min", 0.5);
+    output.psection_end();
+    output.psection_start("disks");
+    output.psubsection_start("sda", { { "disk", "sda" } });
+    output.plong("reads", 10);
+    output.psubsection_end();
+    output.psection_end();
+    output.psection_start("cgroup_tasks");
+    output.psubsection_start("pid_1", labels);
+    output.psubsubsection_start("proc_info");
+    output.pstring("state", "running \"R\"");
+    output.psubsubsection_end();
+    output.psubsubsection_start("cpu", labels);
+    output.pdouble("usr", 12.5);
+    output.psubsubsection_end();
+    output.psubsection_end();
+    output.psection_end();
+    output.push_current_sample();
+}
+
+TEST(OutputFrontend, influxdb_lines_carry_tags)
+{
+    StubHttpServer server;
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 1; // one POST per sample
+
+    CMonitorOutputFrontend output;
+    output.init_influxdb_connection("127.0.0.1", server.port(), "test", cfg);
+
+    output.pheader_start();
+    output.psection_start("identity");
+    output.pstring("hostname", "my host");
+    output.psection_end();
+    output.push_header();
+
+    produce_influxdb_sample(output, "init");
+    produce_influxdb_sample(output, "sh"); // same PID, new command: the series prefix must be regenerated
+    output.close();
+
+    std::vector<std::string> bodies = server.get_bodies();
+    ASSERT_EQ(bodies.size(), 2);
+    std::vector<std::string> lines = split_string_in_array(bodies[0], '\n');
+    ASSERT_EQ(lines.size(), 4) << bodies[0];
+
+    // tags are sorted by key and escaped; the field set follows the cached prefix:
+    ASSERT_EQ(lines[0].find("proc_loadavg,hostname=my\\ host load_avg_1min=0.500 "), 0);
+    ASSERT_EQ(lines[1].find("disks,disk=sda,hostname=my\\ host reads=10 "), 0);
+    ASSERT_EQ(lines[2].find("cgroup_tasks_proc_info,cmd=init,hostname=my\\ host,pid=1 state=\"running \\\"R\\\"\" "), 0);
+    ASSERT_EQ(lines[3].find("cgroup_tasks_cpu,cmd=init,hostname=my\\ host,pid=1 usr=12.500 "), 0);
+    ASSERT_NE(bodies[1].find("cgroup_tasks_cpu,cmd=sh,hostname=my\\ host,pid=1 usr=12.500 "), std::string::npos);
+}
+
+TEST(OutputFrontend, influxdb_timestamp_precision)
+{
+    StubHttpServer server;
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 1;
+
+    CMonitorOutputFrontend output;
+    ASSERT_FALSE(output.set_influxdb_precision("h"));
+    ASSERT_TRUE(output.set_influxdb_precision("s"));
+    output.init_influxdb_connection("127.0.0.1", server.port(), "test", cfg);
+
+    // time() may lag behind CLOCK_REALTIME by one tick: use the same clock of the collector
+    struct timespec before, after;
+    clock_gettime(CLOCK_REALTIME, &before);
+    produce_influxdb_sample(output, "init");
+    clock_gettime(CLOCK_REALTIME, &after);
+    output.close();
+
+    ASSERT_EQ(server.get_last_request_head().find("POST /write?db=test&precision=s HTTP/1.1\r\n"), 0);
+    std::vector<std::string> bodies = server.get_bodies();
+    ASSERT_EQ(bodies.size(), 1);
+    for (const auto& line : split_string_in_array(bodies[0], '\n')) {
+        if (line.empty())
+            continue;
+        uint64_t ts = strtoull(line.substr(line.rfind(' ') + 1).c_str(), nullptr, 10);
+        ASSERT_GE(ts, (uint64_t)before.tv_sec);
+        ASSERT_LE(ts, (uint64_t)after.tv_sec);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Held samples
+//------------------------------------------------------------------------------
+
+static void produce_indexed_sample(CMonitorOutputFrontend& output, long index, long throttled)
+{
+    output.psample_start();
+    output.psection_start("timestamp");
+    output.plong("sample_index", index);
+    output.psection_end();
+    output.psection_start("cgroup_cpuacct_stats");
+    output.psubsection_start("throttling");
+    output.plong("nr_throttled", throttled);
+    output.psubsection_end();
+    output.psection_end();
+}
+
+TEST(OutputFrontend, held_samples_are_written_oldest_first)
+{
+    std::string prefix = "/tmp/cmonitor_tests_held_samples";
+    {
+        CMonitorOutputFrontend output(prefix);
+        output.enable_kpi_lookup();
+        output.init_sample_ring(2);
+
+        output.pheader_start();
+        output.psection_start("cgroup_config");
+        output.plong("memory_limit_bytes", 1024);
+        output.psection_end();
+        output.push_header();
+
+        output.psample_array_start();
+        produce_indexed_sample(output, 0, 0);
+        output.push_current_sample();
+        for (long i = 1; i <= 3; i++) {
+            produce_indexed_sample(output, i, 0);
+            output.hold_current_sample();
+        }
+        ASSERT_EQ(output.get_num_held_samples(), 2U); // sample 1 has been dropped
+
+        produce_indexed_sample(output, 4, 7);
+        double value;
+        ASSERT_TRUE(output.get_kpi_value("cgroup_cpuacct_stats", "throttling", "nr_throttled", value));
+        ASSERT_EQ(value, 7);
+        ASSERT_TRUE(output.get_kpi_value("cgroup_config", "", "memory_limit_bytes", value)); // from the header
+        ASSERT_EQ(value, 1024);
+        ASSERT_FALSE(output.get_kpi_value("cgroup_cpuacct_stats", "", "nr_throttled", value));
+
+        ASSERT_EQ(output.push_held_samples(), 2U);
+        output.push_current_sample();
+        output.psample_array_end();
+        output.close();
+    }
+
+    std::string json_str = get_file_string(prefix + ".json");
+    unlink((prefix + ".json").c_str());
+    ASSERT_EQ(json_str.find("\"sample_index\": 1"), std::string::npos);
+    size_t pos0 = json_str.find("\"sample_index\": 0"), pos2 = json_str.find("\"sample_index\": 2"),
+           pos3 = json_str.find("\"sample_index\": 3"), pos4 = json_str.find("\"sample_index\": 4");
+    ASSERT_NE(pos0, std::string::npos);
+    ASSERT_LT(pos0, pos2);
+    ASSERT_LT(pos2, pos3);
+    ASSERT_LT(pos3, pos4);
+    ASSERT_NE(pos4, std::string::npos);
+}
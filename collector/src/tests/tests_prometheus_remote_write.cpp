@@ -0,0 +1,290 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the Prometheus remote-write sink
+//------------------------------------------------------------------------------
+
+#include "../output_frontend.h"
+#include "../prometheus_remote_write.h"
+#include "../remote_sender.h"
+#include "../snappy_codec.h"
+#include "stub_http_server.h"
+#include <gtest/gtest.h>
+
+//------------------------------------------------------------------------------
+// Remote-write receiver side: decodes the bodies received by the stub server
+//------------------------------------------------------------------------------
+
+typedef struct {
+    std::vector<std::pair<std::string, std::string>> labels; // in the order they were encoded
+    double value = 0;
+    int64_t timestamp = 0;
+} decoded_series_t;
+
+static bool read_varint(const std::string& buf, size_t& pos, uint64_t& value)
+{
+    value = 0;
+    for (unsigned int shift = 0; pos < buf.size() && shift < 64; shift += 7) {
+        uint8_t b = buf[pos++];
+        value |= (uint64_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+// iterates over the fields of a protobuf message, invoking fn(field_number, wire_type, payload)
+// where payload holds the bytes of LEN fields or the raw 8 bytes of FIXED64 fields
+template <typename Fn> static bool for_each_field(const std::string& msg, Fn fn)
+{
+    size_t pos = 0;
+    while (pos < msg.size()) {
+        uint64_t key, value;
+        if (!read_varint(msg, pos, key))
+            return false;
+        std::string payload;
+        switch (key & 7) {
+        case 0:
+            if (!read_varint(msg, pos, value))
+                return false;
+            break;
+        case 1:
+            if (pos + 8 > msg.size())
+                return false;
+            payload = msg.substr(pos, 8);
+            pos += 8;
+            value = 0;
+            for (int i = 7; i >= 0; i--)
+                value = value << 8 | (uint8_t)payload[i];
+            break;
+        case 2:
+            if (!read_varint(msg, pos, value) || pos + value > msg.size())
+                return false;
+            payload = msg.substr(pos, value);
+            pos += value;
+            break;
+        default:
+            return false;
+        }
+        if (!fn(key >> 3, key & 7, value, payload))
+            return false;
+    }
+    return true;
+}
+
+static bool decode_write_request(const std::string& body, std::vector<decoded_series_t>& out)
+{
+    std::string msg;
+    if (!snappy_uncompress(body.data(), body.size(), msg))
+        return false;
+
+    return for_each_field(msg, [&out](uint64_t field, uint64_t, uint64_t, const std::string& ts_msg) {
+        if (field != 1)
+            return false;
+        decoded_series_t series;
+        bool ok = for_each_field(ts_msg, [&series](uint64_t field, uint64_t, uint64_t, const std::string& sub_msg) {
+            if (field == 1) {
+                std::pair<std::string, std::string> label;
+                series.labels.push_back(label);
+                return for_each_field(sub_msg, [&series](uint64_t f, uint64_t, uint64_t, const std::string& str) {
+                    (f == 1 ? series.labels.back().first : series.labels.back().second) = str;
+                    return true;
+                });
+            }
+            return for_each_field(sub_msg, [&series](uint64_t f, uint64_t, uint64_t value, const std::string&) {
+                if (f == 1)
+                    memcpy(&series.value, &value, sizeof(series.value));
+                else
+                    series.timestamp = (int64_t)value;
+                return true;
+            });
+        });
+        out.push_back(series);
+        return ok;
+    });
+}
+
+static std::string get_label(const decoded_series_t& series, const std::string& name)
+{
+    for (const auto& label : series.labels)
+        if (label.first == name)
+            return label.second;
+    return "";
+}
+
+static const decoded_series_t* find_series(
+    const std::vector<decoded_series_t>& all, const std::string& name, const std::string& metric = "")
+{
+    for (const auto& series : all)
+        if (get_label(series, "__name__") == name && get_label(series, "metric") == metric)
+            return &series;
+    return nullptr;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(SnappyCodec, known_encoding_and_roundtrip)
+{
+    // a literal followed by an overlapping copy with 1-byte offset, as in the format description
+    std::string out;
+    snappy_compress("abcdabcdabcd", 12, out);
+    ASSERT_EQ(out, std::string("\x0c\x0c"
+                               "abcd\x11\x04",
+                       8));
+
+    std::string text;
+    for (unsigned int i = 0; i < 20000; i++)
+        text += "cgroup_tasks_cpu_usr{cmd=\"bash\",pid=\"" + std::to_string(i % 300) + "\"} 0.5\n";
+    std::string binary;
+    for (unsigned int i = 0; i < 100000; i++)
+        binary.push_back((char)(rand() & 0xff));
+
+    for (const std::string& input : { std::string(), std::string("x"), text, binary, text + binary + text }) {
+        std::string compressed, decompressed;
+        snappy_compress(input.data(), input.size(), compressed);
+        ASSERT_TRUE(snappy_uncompress(compressed.data(), compressed.size(), decompressed));
+        ASSERT_EQ(decompressed, input);
+    }
+    snappy_compress(text.data(), text.size(), out);
+    ASSERT_LT(out.size(), text.size() / 4);
+
+    // corrupted inputs are refused:
+    ASSERT_FALSE(snappy_uncompress(out.data(), out.size() / 2, text));
+    ASSERT_FALSE(snappy_uncompress("\x05\x01\x00", 3, text)); // copy before any literal
+}
+
+TEST(PrometheusRemoteWrite, series_are_decoded_by_receiver)
+{
+    static const prometheus_kpi_descriptor kpis[] = {
+        { "proc_loadavg_load_avg_1min", PrometheusKpiType::Gauge, "Load average" },
+        { "disks_reads", PrometheusKpiType::Counter, "Disk reads" },
+        { "cgroup_tasks_usr", PrometheusKpiType::Gauge, "User CPU" },
+    };
+
+    StubHttpServer server;
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 1; // one POST per sample
+
+    CMonitorOutputFrontend output;
+    output.init_prometheus_remote_write_connection("127.0.0.1", server.port(), "/api/v1/push",
+        { { "env", "ci" }, { "Zone", "eu" }, { "9team-name", "core" } }, cfg);
+    ASSERT_TRUE(output.wants_kpi_descriptors());
+    output.init_prometheus_kpis(kpis, sizeof(kpis) / sizeof(kpis[0]));
+
+    output.pheader_start();
+    output.psection_start("identity");
+    output.pstring("hostname", "myhost");
+    output.psection_end();
+    output.push_header();
+
+    int64_t before_msec = (int64_t)time(NULL) * 1000;
+    for (unsigned int n = 1; n <= 2; n++) {
+        std::map<std::string, std::string> labels = { { "pid", "1" }, { "cmd", n == 1 ? "init" : "sh" } };
+        output.psample_start();
+        output.psection_start("proc_loadavg");
+        output.pdouble("load_avg_1min", 0.5 * n);
+        output.pdouble("load_avg_5min", 0.25); // not in the KPI table: not exposed in pull mode either
+        output.psection_end();
+        output.psection_start("disks");
+        output.psubsection_start("sda");
+        output.plong("reads", 10 * n);
+        output.psubsection_end();
+        output.psection_end();
+        output.psection_start("cgroup_tasks");
+        output.psubsection_start("pid_1", labels);
+        output.psubsubsection_start("proc_info", labels);
+        output.pstring("cmd", "init");
+        output.psubsubsection_end();
+        output.psubsubsection_start("cpu", labels);
+        output.pdouble("usr", 12.5);
+        output.psubsubsection_end();
+        output.psubsection_end();
+        output.psection_end();
+        output.push_current_sample();
+    }
+    output.close();
+
+    ASSERT_EQ(server.get_last_request_head().find("POST /api/v1/push HTTP/1.1\r\n"), 0);
+    ASSERT_NE(server.get_last_request_head().find(PROMETHEUS_REMOTE_WRITE_HEADERS), std::string::npos);
+    std::vector<std::string> bodies = server.get_bodies();
+    ASSERT_EQ(bodies.size(), 2);
+
+    std::vector<decoded_series_t> series;
+    ASSERT_TRUE(decode_write_request(bodies[0], series));
+    ASSERT_EQ(series.size(), 3); // strings are not sent
+    for (const auto& s : series) {
+        // all labels sorted by name, including __name__, and with valid names:
+        for (size_t i = 1; i < s.labels.size(); i++)
+            ASSERT_LT(s.labels[i - 1].first, s.labels[i].first);
+        ASSERT_EQ(s.labels[0].first, "Zone");
+        ASSERT_EQ(s.labels[1].first, "__name__");
+        ASSERT_EQ(get_label(s, "_team_name"), "core");
+        ASSERT_EQ(get_label(s, "job"), "cmonitor");
+        ASSERT_EQ(get_label(s, "instance"), "myhost");
+        ASSERT_EQ(get_label(s, "env"), "ci");
+        ASSERT_GE(s.timestamp, before_msec);
+        ASSERT_LE(s.timestamp, (int64_t)time(NULL) * 1000 + 1000);
+    }
+
+    // same names and labels of the series exposed in pull mode:
+    const decoded_series_t* load = find_series(series, "proc_loadavg_load_avg_1min");
+    ASSERT_NE(load, nullptr);
+    ASSERT_EQ(load->value, 0.5);
+    const decoded_series_t* reads = find_series(series, "disks_reads", "sda");
+    ASSERT_NE(reads, nullptr);
+    ASSERT_EQ(reads->value, 10);
+    const decoded_series_t* usr = find_series(series, "cgroup_tasks_usr", "cpu");
+    ASSERT_NE(usr, nullptr);
+    ASSERT_EQ(get_label(*usr, "pid"), "1");
+    ASSERT_EQ(get_label(*usr, "cmd"), "init");
+
+    // same PID, new command: the labels must be encoded again
+    series.clear();
+    ASSERT_TRUE(decode_write_request(bodies[1], series));
+    usr = find_series(series, "cgroup_tasks_usr", "cpu");
+    ASSERT_NE(usr, nullptr);
+    ASSERT_EQ(get_label(*usr, "cmd"), "sh");
+    ASSERT_EQ(find_series(series, "disks_reads", "sda")->value, 20);
+}
+
+TEST(PrometheusRemoteWrite, batches_are_retried_in_order)
+{
+    StubHttpServer server;
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 10;
+    cfg.queue_max_batches = 4;
+    cfg.snappy = true;
+
+    CMonitorRemoteSender sender;
+    ASSERT_TRUE(sender.init("127.0.0.1", server.port(), PROMETHEUS_REMOTE_WRITE_DEFAULT_PATH,
+        PROMETHEUS_REMOTE_WRITE_HEADERS, cfg));
+
+    // the receiver is overloaded: 6 batches are produced but only 4 fit the queue
+    server.m_fail_next_requests = 1000;
+    std::string labels;
+    remote_write_append_label(labels, "job", "cmonitor");
+    for (unsigned int i = 0; i < 60; i++) {
+        std::string ts;
+        remote_write_append_timeseries(ts, "metric", "", labels, i, 1000 + i);
+        sender.enqueue(ts, 1);
+        sender.flush();
+    }
+    ASSERT_EQ(sender.get_stats().dropped, 20);
+
+    server.m_fail_next_requests = 0;
+    sender.flush();
+    ASSERT_EQ(sender.get_pending_points(), 0);
+    ASSERT_EQ(sender.get_stats().sent, 40);
+    ASSERT_GT(sender.get_stats().retried, 0);
+
+    // the newest samples survived, in order, each batch being a valid WriteRequest:
+    std::vector<decoded_series_t> series;
+    for (const auto& body : server.get_bodies())
+        ASSERT_TRUE(decode_write_request(body, series));
+    ASSERT_EQ(series.size(), 40);
+    for (unsigned int i = 0; i < 40; i++) {
+        ASSERT_EQ(series[i].value, 20 + i);
+        ASSERT_EQ(series[i].timestamp, 1020 + i);
+        ASSERT_EQ(get_label(series[i], "__name__"), "metric");
+    }
+}
@@ -0,0 +1,321 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the built-in Prometheus exposition
+//------------------------------------------------------------------------------
+
+#include "../output_frontend.h"
+#include "../prometheus_server.h"
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <zlib.h>
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+static int connect_to(unsigned int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// reads one HTTP response from the given socket; returns its status code, or -1 on error/timeout
+static int read_response(int fd, std::string& rx, std::string& head, std::string& body, bool head_request = false)
+{
+    while (true) {
+        size_t end_of_head = rx.find("\r\n\r\n");
+        if (end_of_head != std::string::npos) {
+            head = rx.substr(0, end_of_head + 4);
+            size_t content_length = 0;
+            size_t cl = head.find("Content-Length: ");
+            if (cl != std::string::npos && !head_request)
+                content_length = strtoul(head.c_str() + cl + 16, nullptr, 10);
+            if (rx.size() >= head.size() + content_length) {
+                body = rx.substr(head.size(), content_length);
+                rx.erase(0, head.size() + content_length);
+                return atoi(head.c_str() + 9);
+            }
+        }
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 1000 /* msec */) <= 0)
+            return -1;
+        char buf[4096];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+            return -1;
+        rx.append(buf, n);
+    }
+}
+
+std::string scrape(unsigned int port, const std::string& extra_headers = "", std::string* head_out = nullptr)
+{
+    int fd = connect_to(port);
+    std::string req = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n" + extra_headers + "\r\n", rx, head, body;
+    if (fd == -1 || send(fd, req.data(), req.size(), 0) < 0 || read_response(fd, rx, head, body) != 200)
+        body = "";
+    close(fd);
+    if (head_out)
+        *head_out = head;
+    return body;
+}
+
+static void publish(CMonitorPrometheusServer& server, const std::string& text)
+{
+    server.get_back_buffer() = text;
+    server.swap_buffers();
+}
+
+static std::string gunzip(const std::string& data)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    inflateInit2(&zs, 15 + 16);
+    zs.next_in = (Bytef*)data.data();
+    zs.avail_in = data.size();
+
+    std::string out;
+    char buf[4096];
+    int ret;
+    do {
+        zs.next_out = (Bytef*)buf;
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (ret == Z_OK);
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END ? out : "";
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(PrometheusServer, keepalive_and_pipelining)
+{
+    CMonitorPrometheusServer server;
+    ASSERT_TRUE(server.init("127.0.0.1", 0));
+    ASSERT_NE(server.get_port(), 0);
+    publish(server, "# TYPE a gauge\na 1\n");
+
+    // three pipelined requests, sent in a single write:
+    int fd = connect_to(server.get_port());
+    ASSERT_NE(fd, -1);
+    std::string reqs = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                       "GET /other HTTP/1.1\r\nHost: localhost\r\n\r\n"
+                       "HEAD /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ASSERT_EQ(send(fd, reqs.data(), reqs.size(), 0), (ssize_t)reqs.size());
+
+    std::string rx, head, body;
+    ASSERT_EQ(read_response(fd, rx, head, body), 200);
+    ASSERT_NE(head.find("Content-Type: " PROMETHEUS_TEXT_FORMAT_CONTENT_TYPE "\r\n"), std::string::npos);
+    ASSERT_EQ(body, "# TYPE a gauge\na 1\n");
+    ASSERT_EQ(read_response(fd, rx, head, body), 404);
+    ASSERT_EQ(read_response(fd, rx, head, body, true), 200);
+    ASSERT_NE(head.find("Content-Length: 19\r\n"), std::string::npos); // HEAD has no body
+    ASSERT_TRUE(rx.empty());
+
+    // a new payload is served on the same connection:
+    publish(server, "# TYPE a gauge\na 2\n");
+    std::string req = "GET /metrics HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    ASSERT_EQ(send(fd, req.data(), req.size(), 0), (ssize_t)req.size());
+    ASSERT_EQ(read_response(fd, rx, head, body), 200);
+    ASSERT_EQ(body, "# TYPE a gauge\na 2\n");
+    ASSERT_NE(head.find("Connection: close\r\n"), std::string::npos);
+    close(fd);
+
+    prometheus_server_stats_t stats = server.get_stats();
+    ASSERT_EQ(stats.connections, 1);
+    ASSERT_EQ(stats.scrapes, 3);
+    ASSERT_EQ(stats.errors, 1);
+}
+
+TEST(PrometheusServer, large_payload)
+{
+    CMonitorPrometheusServer server;
+    ASSERT_TRUE(server.init("127.0.0.1", 0));
+
+    // much larger than the socket buffers: needs several EPOLLOUT rounds
+    std::string payload;
+    for (unsigned int i = 0; i < 200000; i++)
+        payload += "metric{pid=\"" + std::to_string(i) + "\"} " + std::to_string(i) + "\n";
+    publish(server, payload);
+    ASSERT_EQ(scrape(server.get_port()), payload);
+}
+
+TEST(PrometheusServer, gzip_and_double_buffering)
+{
+    CMonitorPrometheusServer server;
+    ASSERT_TRUE(server.init("127.0.0.1", 0, true /* gzip */));
+
+    std::string payload;
+    for (unsigned int i = 0; i < 50000; i++)
+        payload += "metric{pid=\"" + std::to_string(i) + "\"} " + std::to_string(i) + "\n";
+    publish(server, payload);
+    prometheus_server_stats_t stats = server.get_stats();
+    ASSERT_EQ(stats.payload_bytes, payload.size());
+    ASSERT_GT(stats.payload_gzip_bytes, 0);
+    ASSERT_LT(stats.payload_gzip_bytes, payload.size() / 2);
+
+    // scrapers not asking for gzip, or refusing it, get the plain text:
+    std::string head;
+    ASSERT_EQ(scrape(server.get_port(), "", &head), payload);
+    ASSERT_EQ(head.find("Content-Encoding"), std::string::npos);
+    ASSERT_EQ(scrape(server.get_port(), "Accept-Encoding: identity, gzip;q=0\r\n", &head), payload);
+    ASSERT_EQ(head.find("Content-Encoding"), std::string::npos);
+
+    std::string body = scrape(server.get_port(), "accept-encoding: deflate, gzip\r\n", &head);
+    ASSERT_NE(head.find("Content-Encoding: gzip\r\n"), std::string::npos);
+    ASSERT_EQ(body.size(), stats.payload_gzip_bytes);
+    ASSERT_EQ(gunzip(body), payload);
+
+    // with no scrape in progress the two buffers get recycled forever:
+    for (unsigned int i = 0; i < 10; i++)
+        publish(server, payload + "sample " + std::to_string(i) + "\n");
+    ASSERT_EQ(gunzip(scrape(server.get_port(), "Accept-Encoding: gzip\r\n")), payload + "sample 9\n");
+    stats = server.get_stats();
+    ASSERT_EQ(stats.payload_allocations, 2);
+    ASSERT_EQ(stats.scrapes, 4);
+    ASSERT_EQ(stats.gzip_scrapes, 2);
+}
+
+TEST(PrometheusServer, slow_scraper_keeps_its_snapshot)
+{
+    CMonitorPrometheusServer server;
+    ASSERT_TRUE(server.init("127.0.0.1", 0));
+
+    std::string payload;
+    for (unsigned int i = 0; i < 1000000; i++)
+        payload += "metric{pid=\"" + std::to_string(i) + "\"} " + std::to_string(i) + "\n";
+    publish(server, payload);
+
+    // much larger than the socket buffers: a scraper which does not read its socket keeps a reference to the
+    // snapshot it started to receive...
+    int fd = connect_to(server.get_port());
+    ASSERT_NE(fd, -1);
+    std::string req = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ASSERT_EQ(send(fd, req.data(), req.size(), 0), (ssize_t)req.size());
+
+    // the first bytes of the response are sent only after the server took its reference to the snapshot:
+    // wait for them without consuming them
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    ASSERT_EQ(poll(&pfd, 1, 5000), 1);
+    char c;
+    ASSERT_EQ(recv(fd, &c, 1, MSG_PEEK), 1);
+
+    // ...so the sampling loop must not overwrite it, while other scrapers get the new payloads:
+    for (unsigned int i = 0; i < 5; i++)
+        publish(server, "new " + std::to_string(i) + "\n");
+    ASSERT_EQ(scrape(server.get_port()), "new 4\n");
+    ASSERT_EQ(server.get_stats().payload_allocations, 3);
+
+    std::string rx, head, body;
+    ASSERT_EQ(read_response(fd, rx, head, body), 200);
+    ASSERT_EQ(body, payload);
+    close(fd);
+}
+
+#ifdef PROMETHEUS_SUPPORT
+TEST(OutputFrontend, prometheus_stale_series_are_removed)
+{
+    static const prometheus_kpi_descriptor kpis[] = {
+        { "tasks_usr", PrometheusKpiType::Gauge, "User CPU" },
+        { "tasks_major_faults", PrometheusKpiType::Counter, "Major page faults" },
+    };
+
+    CMonitorOutputFrontend output;
+    ASSERT_TRUE(output.init_prometheus_connection("127.0.0.1", 0, { { "host", "test\"host" } }));
+    output.init_prometheus_kpis(kpis, sizeof(kpis) / sizeof(kpis[0]));
+
+    auto produce_sample = [&output](const std::vector<unsigned int>& pids, unsigned int n) {
+        output.psample_start();
+        output.psection_start("tasks");
+        for (unsigned int pid : pids) {
+            std::map<std::string, std::string> labels = { { "pid", std::to_string(pid) }, { "cmd", "cmd" } };
+            output.psubsection_start(("pid_" + std::to_string(pid)).c_str(), labels);
+            output.psubsubsection_start("cpu", labels);
+            output.pdouble("usr", 0.5 * n);
+            output.plong("major_faults", n);
+            output.psubsubsection_end();
+            output.psubsection_end();
+        }
+        output.psection_end();
+        output.push_current_sample();
+    };
+
+    produce_sample({ 1, 2 }, 1);
+    std::string metrics = scrape(output.get_prometheus_port());
+    ASSERT_NE(metrics.find("# HELP tasks_usr User CPU\n# TYPE tasks_usr gauge\n"), std::string::npos);
+    ASSERT_NE(metrics.find("tasks_usr{cmd=\"cmd\",host=\"test\\\"host\",metric=\"cpu\",pid=\"1\"} 0.5\n"),
+        std::string::npos);
+    ASSERT_NE(metrics.find("# TYPE tasks_major_faults counter\n"), std::string::npos);
+    ASSERT_NE(metrics.find("tasks_major_faults{cmd=\"cmd\",host=\"test\\\"host\",metric=\"cpu\",pid=\"2\"} 1\n"),
+        std::string::npos);
+    ASSERT_NE(metrics.find("cmonitor_prometheus_live_series{host=\"test\\\"host\"} 4\n"), std::string::npos);
+
+    // PID 1 exits: its series survive a few samples, then get removed
+    for (unsigned int n = 2; n < 2 + PROMETHEUS_STALE_SERIES_SAMPLES; n++)
+        produce_sample({ 2 }, n);
+    metrics = scrape(output.get_prometheus_port());
+    ASSERT_EQ(metrics.find("pid=\"1\""), std::string::npos);
+    ASSERT_NE(metrics.find("tasks_major_faults{cmd=\"cmd\",host=\"test\\\"host\",metric=\"cpu\",pid=\"2\"} 6\n"),
+        std::string::npos);
+    ASSERT_NE(metrics.find("cmonitor_prometheus_live_series{host=\"test\\\"host\"} 2\n"), std::string::npos);
+}
+
+TEST(OutputFrontend, prometheus_series_shared_by_subsections)
+{
+    static const prometheus_kpi_descriptor kpis[] = {
+        { "tasks_rss", PrometheusKpiType::Gauge, "RSS" },
+    };
+
+    CMonitorOutputFrontend output;
+    ASSERT_TRUE(output.init_prometheus_connection("127.0.0.1", 0, {}));
+    output.init_prometheus_kpis(kpis, sizeof(kpis) / sizeof(kpis[0]));
+
+    // two subsections rendering the same labels get the same series: the last value written wins
+    auto produce_sample = [&output](const std::vector<std::string>& subsections, unsigned int n) {
+        output.psample_start();
+        output.psection_start("tasks");
+        for (const auto& name : subsections) {
+            std::map<std::string, std::string> labels = { { "cmd", "other" } };
+            output.psubsection_start(name.c_str(), labels);
+            output.psubsubsection_start("memory", labels);
+            output.plong("rss", n);
+            output.psubsubsection_end();
+            output.psubsection_end();
+        }
+        output.psection_end();
+        output.push_current_sample();
+    };
+
+    produce_sample({ "cmd_other", "other" }, 1);
+    std::string metrics = scrape(output.get_prometheus_port());
+    ASSERT_NE(metrics.find("tasks_rss{cmd=\"other\",metric=\"memory\"} 1\n"), std::string::npos) << metrics;
+
+    // the series outlives the subsection going stale, as long as the other one still uses it:
+    for (unsigned int n = 2; n < 2 + PROMETHEUS_STALE_SERIES_SAMPLES; n++)
+        produce_sample({ "cmd_other" }, n);
+    metrics = scrape(output.get_prometheus_port());
+    ASSERT_NE(metrics.find("tasks_rss{cmd=\"other\",metric=\"memory\"} "
+                           + std::to_string(1 + PROMETHEUS_STALE_SERIES_SAMPLES) + "\n"),
+        std::string::npos)
+        << metrics;
+
+    // and it is removed together with its last subsection:
+    for (unsigned int n = 0; n < PROMETHEUS_STALE_SERIES_SAMPLES; n++)
+        produce_sample({}, n);
+    metrics = scrape(output.get_prometheus_port());
+    ASSERT_EQ(metrics.find("cmd=\"other\""), std::string::npos) << metrics;
+}
+#endif
@@ -0,0 +1,281 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the batching/queueing/spooling remote sender
+//------------------------------------------------------------------------------
+
+#include "../remote_sender.h"
+#include "../remote_worker.h"
+#include "../utils_misc.h"
+#include "stub_http_server.h"
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#define TEST_SPOOL_DIR "/tmp/cmonitor_tests_spool"
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+static void cleanup_spool_dir()
+{
+    int ret = system("rm -rf " TEST_SPOOL_DIR);
+    (void)ret;
+}
+
+static std::string gunzip(const std::string& data)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    inflateInit2(&zs, 15 + 16);
+    zs.next_in = (Bytef*)data.data();
+    zs.avail_in = data.size();
+
+    std::string out;
+    char buf[4096];
+    int ret;
+    do {
+        zs.next_out = (Bytef*)buf;
+        zs.avail_out = sizeof(buf);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    } while (ret == Z_OK);
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END ? out : "";
+}
+
+static std::string make_point(unsigned int n) { return "meas value=" + std::to_string(n) + "i\n"; }
+
+// enqueues points [first, first+count) one by one, as if each one was a new sample
+static void enqueue_points(CMonitorRemoteSender& sender, unsigned int first, unsigned int count)
+{
+    for (unsigned int i = first; i < first + count; i++) {
+        sender.enqueue(make_point(i), 1);
+        sender.flush();
+    }
+}
+
+// checks that the server received exactly the points [0, count), in order
+static void check_received_points(StubHttpServer& server, unsigned int count)
+{
+    std::string all;
+    for (const auto& body : server.get_bodies())
+        all += body;
+
+    std::string expected;
+    for (unsigned int i = 0; i < count; i++)
+        expected += make_point(i);
+    ASSERT_EQ(all, expected);
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(RemoteSender, batching_by_points_and_time)
+{
+    StubHttpServer server;
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 10;
+    cfg.batch_max_msec = 100000;
+
+    CMonitorRemoteSender sender;
+    ASSERT_TRUE(sender.init("127.0.0.1", server.port(), "/write?db=test", "", cfg));
+
+    enqueue_points(sender, 0, 25);
+    ASSERT_EQ(server.get_bodies().size(), 2);
+    ASSERT_EQ(sender.get_pending_points(), 5);
+
+    // the last partial batch gets sent once it becomes old enough:
+    cfg.batch_max_msec = 50;
+    CMonitorRemoteSender sender2;
+    ASSERT_TRUE(sender2.init("127.0.0.1", server.port(), "/write?db=test", "", cfg));
+    sender2.enqueue(make_point(100), 1);
+    sender2.flush();
+    ASSERT_EQ(sender2.get_pending_points(), 1);
+    usleep(60 * 1000);
+    sender2.flush();
+    ASSERT_EQ(sender2.get_pending_points(), 0);
+    ASSERT_EQ(server.get_bodies().size(), 3);
+
+    sender.close();
+    ASSERT_EQ(server.get_bodies().size(), 4);
+    ASSERT_EQ(sender.get_stats().queued, 25);
+    ASSERT_EQ(sender.get_stats().sent, 25);
+    ASSERT_EQ(sender.get_stats().dropped, 0);
+    ASSERT_EQ(sender.get_stats().retried, 0);
+}
+
+TEST(RemoteSender, failures_spill_to_spool_and_replay_in_order)
+{
+    cleanup_spool_dir();
+
+    StubHttpServer server;
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 5;
+    cfg.queue_max_batches = 3;
+    cfg.spool_dir = TEST_SPOOL_DIR;
+
+    CMonitorRemoteSender sender;
+    ASSERT_TRUE(sender.init("127.0.0.1", server.port(), "/write?db=test", "", cfg));
+
+    // 20 batches while the server fails: only 3 fit the queue, the others must be spooled
+    server.m_fail_next_requests = 1000;
+    enqueue_points(sender, 0, 100);
+    ASSERT_TRUE(server.get_bodies().empty());
+    ASSERT_EQ(sender.get_pending_points(), 100);
+    ASSERT_EQ(sender.get_stats().spooled, 85);
+    ASSERT_EQ(sender.get_stats().dropped, 0);
+
+    // the server recovers: everything must be replayed in order
+    server.m_fail_next_requests = 0;
+    for (unsigned int i = 0; i < 5 && sender.get_pending_points() > 0; i++)
+        sender.flush();
+    ASSERT_EQ(sender.get_pending_points(), 0);
+    check_received_points(server, 100);
+
+    const remote_sender_stats_t& stats = sender.get_stats();
+    ASSERT_EQ(stats.queued, 100);
+    ASSERT_EQ(stats.sent, 100);
+    ASSERT_EQ(stats.dropped, 0);
+    ASSERT_GT(stats.retried, 0);
+
+    cleanup_spool_dir();
+}
+
+TEST(RemoteSender, full_queue_without_spool_drops_oldest)
+{
+    StubHttpServer server;
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 5;
+    cfg.queue_max_batches = 2;
+
+    CMonitorRemoteSender sender;
+    ASSERT_TRUE(sender.init("127.0.0.1", server.port(), "/write?db=test", "", cfg));
+
+    server.m_fail_next_requests = 1000;
+    enqueue_points(sender, 0, 50);
+    ASSERT_EQ(sender.get_stats().dropped, 40);
+
+    server.m_fail_next_requests = 0;
+    sender.flush();
+    ASSERT_EQ(sender.get_stats().sent, 10);
+
+    // only the newest 2 batches survived:
+    std::vector<std::string> bodies = server.get_bodies();
+    ASSERT_EQ(bodies.size(), 2);
+    ASSERT_EQ(bodies[0].substr(0, make_point(40).size()), make_point(40));
+}
+
+TEST(RemoteSender, spool_survives_restart)
+{
+    cleanup_spool_dir();
+
+    unsigned int port;
+    {
+        StubHttpServer server; // just to find a free port
+        port = server.port();
+    }
+
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 4;
+    cfg.queue_max_batches = 1;
+    cfg.spool_dir = TEST_SPOOL_DIR;
+    {
+        // server unreachable: at close() the whole queue ends up in the spool
+        CMonitorRemoteSender sender;
+        ASSERT_TRUE(sender.init("127.0.0.1", port, "/write?db=test", "", cfg));
+        enqueue_points(sender, 0, 30);
+        sender.close();
+        ASSERT_EQ(sender.get_stats().dropped, 0);
+    }
+
+    StubHttpServer server;
+    {
+        CMonitorRemoteSender sender;
+        ASSERT_TRUE(sender.init("127.0.0.1", server.port(), "/write?db=test", "", cfg));
+        ASSERT_EQ(sender.get_pending_points(), 30);
+        for (unsigned int i = 0; i < 5 && sender.get_pending_points() > 0; i++)
+            sender.flush();
+        ASSERT_EQ(sender.get_pending_points(), 0);
+    }
+    check_received_points(server, 30);
+
+    cleanup_spool_dir();
+}
+
+TEST(RemoteSender, gzip_batches)
+{
+    cleanup_spool_dir();
+
+    StubHttpServer server;
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 50;
+    cfg.queue_max_batches = 1;
+    cfg.spool_dir = TEST_SPOOL_DIR;
+    cfg.gzip = true;
+
+    CMonitorRemoteSender sender;
+    ASSERT_TRUE(sender.init("127.0.0.1", server.port(), "/write?db=test", "", cfg));
+
+    // some batches go through the spool, which must keep them compressed:
+    server.m_fail_next_requests = 1000;
+    enqueue_points(sender, 0, 150);
+    ASSERT_GT(sender.get_stats().spooled, 0);
+    server.m_fail_next_requests = 0;
+    enqueue_points(sender, 150, 50);
+    ASSERT_EQ(sender.get_pending_points(), 0);
+
+    const remote_sender_stats_t& stats = sender.get_stats();
+    ASSERT_EQ(stats.batch_uncompressed_bytes, 50 * make_point(150).size()); // all points of last batch have 3 digits
+    ASSERT_GT(stats.batch_compressed_bytes, 0);
+    ASSERT_LT(stats.batch_compressed_bytes, stats.batch_uncompressed_bytes / 2);
+    ASSERT_NE(server.get_last_request_head().find("Content-Encoding: gzip\r\n"), std::string::npos);
+
+    std::string all;
+    for (const auto& body : server.get_bodies())
+        all += gunzip(body);
+    std::string expected;
+    for (unsigned int i = 0; i < 200; i++)
+        expected += make_point(i);
+    ASSERT_EQ(all, expected);
+
+    cleanup_spool_dir();
+}
+
+TEST(RemoteWorker, slow_endpoint_does_not_delay_the_others)
+{
+    StubHttpServer primary, secondary;
+    secondary.m_never_answer = true;
+
+    remote_sender_config_t cfg;
+    cfg.batch_max_points = 1;
+    CMonitorRemoteWorker primary_worker, secondary_worker;
+    ASSERT_TRUE(primary_worker.init("127.0.0.1", primary.port(), "/write?db=test", "", cfg));
+    ASSERT_TRUE(secondary_worker.init("127.0.0.1", secondary.port(), "/write?db=archive", "", cfg));
+
+    // each payload is encoded once and shared by both endpoints:
+    uint64_t start = get_monotonic_msec();
+    for (unsigned int i = 0; i < 20; i++) {
+        remote_payload_t payload = std::make_shared<const std::string>(make_point(i));
+        primary_worker.submit(payload, 1);
+        secondary_worker.submit(payload, 1);
+    }
+    ASSERT_LT(get_monotonic_msec() - start, 50);
+
+    // the primary gets everything while the secondary is still stuck waiting for its first answer:
+    for (unsigned int i = 0; i < 100 && primary_worker.get_pending_points() > 0; i++)
+        usleep(10 * 1000);
+    ASSERT_EQ(primary_worker.get_pending_points(), 0);
+    ASSERT_LT(get_monotonic_msec() - start, HTTP_CLIENT_DEFAULT_IO_TIMEOUT_MSEC);
+    check_received_points(primary, 20);
+    ASSERT_EQ(primary_worker.get_stats().sent, 20);
+    ASSERT_EQ(secondary_worker.get_stats().sent, 0);
+
+    primary_worker.close();
+
+    // once the secondary recovers, it gets its whole backlog:
+    secondary.m_never_answer = false;
+    secondary_worker.close();
+    check_received_points(secondary, 20);
+    ASSERT_EQ(secondary_worker.get_stats().sent, 20);
+    ASSERT_EQ(secondary_worker.get_stats().dropped, 0);
+}
@@ -0,0 +1,200 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the scheduling of the sampling loop
+//------------------------------------------------------------------------------
+
+#include "../sampling_scheduler.h"
+#include "../utils_misc.h"
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <signal.h>
+#include <thread>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+static void busy_wait_msec(uint64_t msec)
+{
+    uint64_t end = get_monotonic_msec() + msec;
+    while (get_monotonic_msec() < end)
+        ;
+}
+
+static void ignore_signal(int) { }
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(SamplingScheduler, sampling_time_does_not_cause_drift)
+{
+    const unsigned int num_samples = 20, interval_msec = 20;
+
+    CMonitorSamplingScheduler scheduler;
+    scheduler.init(interval_msec);
+    uint64_t start = get_monotonic_msec();
+    scheduler.start(interval_msec);
+    for (unsigned int n = 0; n < num_samples; n++) {
+        ASSERT_TRUE(scheduler.wait_next_deadline());
+        busy_wait_msec(8); // the sampling
+    }
+    uint64_t last_wakeup = get_monotonic_msec() - 8;
+
+    // sleeping the interval after each sample would take 20*(20+8)msecs: deadlines are instead 20msecs apart
+    ASSERT_GE(last_wakeup - start, num_samples * interval_msec - 1); // msec truncation
+    ASSERT_LT(last_wakeup - start, num_samples * interval_msec + 8);
+
+    const sampling_scheduler_stats_t& stats = scheduler.get_stats();
+    ASSERT_EQ(stats.deadlines, num_samples);
+    ASSERT_EQ(stats.overruns, 0U);
+    ASSERT_EQ(stats.skipped, 0U);
+    ASSERT_LE(stats.last_jitter_usec, stats.max_jitter_usec);
+    ASSERT_LE(stats.total_jitter_usec, num_samples * stats.max_jitter_usec);
+}
+
+TEST(SamplingScheduler, missed_deadlines_are_skipped)
+{
+    CMonitorSamplingScheduler scheduler;
+    scheduler.init(10, MISSED_DEADLINE_SKIP);
+    uint64_t start = get_monotonic_msec();
+    scheduler.start(10);
+
+    ASSERT_EQ(scheduler.wait_next_deadline(), 1U); // t=10
+    busy_wait_msec(25); // a slow sample: deadlines at t=20 and t=30 are missed
+
+    ASSERT_EQ(scheduler.wait_next_deadline(), 2U); // returns immediately, at t=35
+    ASSERT_EQ(scheduler.get_stats().overruns, 1U);
+    ASSERT_EQ(scheduler.get_stats().skipped, 1U); // the one at t=30
+
+    // back on the original grid of deadlines:
+    ASSERT_EQ(scheduler.wait_next_deadline(), 1U);
+    uint64_t elapsed = get_monotonic_msec() - start;
+    ASSERT_GE(elapsed, 40U);
+    ASSERT_LT(elapsed, 45U);
+}
+
+TEST(SamplingScheduler, missed_deadlines_are_caught_up)
+{
+    CMonitorSamplingScheduler scheduler;
+    scheduler.init(10, MISSED_DEADLINE_CATCH_UP);
+    uint64_t start = get_monotonic_msec();
+    scheduler.start(10);
+
+    ASSERT_TRUE(scheduler.wait_next_deadline()); // t=10
+    busy_wait_msec(25); // a slow sample: deadlines at t=20 and t=30 are missed
+
+    // both the missed samples are taken immediately:
+    ASSERT_TRUE(scheduler.wait_next_deadline());
+    ASSERT_TRUE(scheduler.wait_next_deadline());
+    ASSERT_LT(get_monotonic_msec() - start, 40U);
+    ASSERT_EQ(scheduler.get_stats().overruns, 2U);
+    ASSERT_EQ(scheduler.get_stats().skipped, 0U);
+
+    ASSERT_TRUE(scheduler.wait_next_deadline());
+    ASSERT_GE(get_monotonic_msec() - start, 40U);
+}
+
+TEST(SamplingScheduler, wakeup_fd_ends_the_sleep_early)
+{
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+
+    CMonitorSamplingScheduler scheduler;
+    scheduler.init(200);
+    uint64_t start = get_monotonic_msec();
+    scheduler.start(200);
+    std::thread writer([&fds]() {
+        usleep(20000);
+        ASSERT_EQ(write(fds[1], "x", 1), 1);
+    });
+
+    bool woken_up;
+    ASSERT_EQ(scheduler.wait_next_deadline(fds[0], &woken_up), 0U);
+    writer.join();
+    ASSERT_TRUE(woken_up);
+    ASSERT_LT(get_monotonic_msec() - start, 150U);
+    ASSERT_EQ(scheduler.get_stats().wakeups, 1U);
+    ASSERT_EQ(scheduler.get_stats().deadlines, 0U);
+
+    // the deadline did not move:
+    char c;
+    ASSERT_EQ(read(fds[0], &c, 1), 1);
+    ASSERT_EQ(scheduler.wait_next_deadline(fds[0], &woken_up), 1U);
+    ASSERT_FALSE(woken_up);
+    ASSERT_GE(get_monotonic_msec() - start, 199U);
+    ASSERT_EQ(scheduler.get_stats().deadlines, 1U);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(SamplingScheduler, interrupted_waits_are_not_deadlines)
+{
+    // no SA_RESTART: the signal interrupts the sleep
+    struct sigaction sa = {}, old_sa;
+    sa.sa_handler = ignore_signal;
+    ASSERT_EQ(sigaction(SIGUSR1, &sa, &old_sa), 0);
+
+    CMonitorSamplingScheduler scheduler;
+    scheduler.init(100);
+    scheduler.start(100);
+
+    pthread_t waiter = pthread_self();
+    std::thread signaler([waiter]() {
+        usleep(20000);
+        pthread_kill(waiter, SIGUSR1);
+    });
+    ASSERT_EQ(scheduler.wait_next_deadline(), 0U);
+    signaler.join();
+    ASSERT_EQ(scheduler.get_stats().deadlines, 0U);
+
+    // the same deadline is waited for again:
+    ASSERT_EQ(scheduler.wait_next_deadline(), 1U);
+    ASSERT_EQ(scheduler.get_stats().deadlines, 1U);
+    ASSERT_EQ(sigaction(SIGUSR1, &old_sa, nullptr), 0);
+}
+
+TEST(SamplingScheduler, families_due_at_each_tick)
+{
+    const unsigned int cpu = 1, memory = 2, disk = 4, processes = 8, load = 16;
+
+    CMonitorSamplingPlan plan;
+    plan.init(cpu | memory | disk | processes | load, 60000,
+        { { cpu, 100 }, { memory, 1000 }, { disk, 10000 }, { processes, 5000 }, { 32, 10 } });
+    ASSERT_TRUE(plan.is_multi_rate());
+    ASSERT_EQ(plan.get_tick_msec(), 100U); // family 32 is not collected: its interval is ignored
+
+    ASSERT_EQ(plan.get_due_families(0), cpu | memory | disk | processes | load);
+    ASSERT_EQ(plan.get_due_families(1), cpu);
+    ASSERT_EQ(plan.get_due_families(10), cpu | memory);
+    ASSERT_EQ(plan.get_due_families(50), cpu | memory | processes);
+    ASSERT_EQ(plan.get_due_families(100), cpu | memory | disk | processes);
+    ASSERT_EQ(plan.get_due_families(600), cpu | memory | disk | processes | load); // default interval
+
+    // intervals not multiple of each other: at some ticks nothing is due
+    plan.init(cpu | disk, 60000, { { cpu, 200 }, { disk, 300 } });
+    ASSERT_EQ(plan.get_tick_msec(), 100U);
+    ASSERT_EQ(plan.get_due_families(1), 0U);
+    ASSERT_EQ(plan.get_due_families(2), cpu);
+    ASSERT_EQ(plan.get_due_families(3), disk);
+    ASSERT_EQ(plan.get_due_families(6), cpu | disk);
+
+    // after skipping some ticks, the families due at any of them are sampled:
+    ASSERT_EQ(plan.get_due_families(1, 1), 0U);
+    ASSERT_EQ(plan.get_due_families(1, 2), cpu);
+    ASSERT_EQ(plan.get_due_families(4, 5), cpu);
+    ASSERT_EQ(plan.get_due_families(7, 9), cpu | disk);
+
+    // a tick shorter than the minimum is refused, leaving the plan unchanged:
+    ASSERT_FALSE(plan.init(cpu | disk, 60000, { { cpu, 1000 }, { disk, 1001 } }, 10));
+    ASSERT_EQ(plan.get_tick_msec(), 100U);
+    ASSERT_TRUE(plan.init(cpu | disk, 60000, { { cpu, 1000 }, { disk, 1010 } }, 10));
+    ASSERT_EQ(plan.get_tick_msec(), 10U);
+
+    // without per-family intervals everything is sampled at each tick
+    plan.init(cpu | disk, 2000, {});
+    ASSERT_FALSE(plan.is_multi_rate());
+    ASSERT_EQ(plan.get_tick_msec(), 2000U);
+    ASSERT_EQ(plan.get_due_families(7), cpu | disk);
+}
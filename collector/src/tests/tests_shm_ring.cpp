@@ -0,0 +1,175 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the shared-memory ring sink
+//------------------------------------------------------------------------------
+
+#include "../output_frontend.h"
+#include "../shm_ring.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+static std::string get_test_ring_name(const char* suffix)
+{
+    return "/cmonitor_unit_tests_" + std::to_string(getpid()) + "_" + suffix;
+}
+
+// the payload of the N-th sample: variable length, contents depending on N, so that torn reads are detected
+static std::string get_expected_payload(uint64_t n)
+{
+    std::string ret(16 + (n * 7919) % 4000, (char)('a' + n % 26));
+    std::string tag = std::to_string(n);
+    ret.replace(0, tag.size(), tag);
+    ret.replace(ret.size() - tag.size(), tag.size(), tag);
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(ShmRing, concurrent_reader_never_sees_torn_samples)
+{
+    const uint64_t num_samples = 200000;
+    std::string name = get_test_ring_name("concurrent");
+
+    CMonitorShmRingWriter writer;
+    ASSERT_TRUE(writer.init(name, 8, 4096));
+
+    CMonitorShmRingReader reader;
+    ASSERT_TRUE(reader.open(name));
+    ASSERT_EQ(reader.get_num_slots(), 8U);
+    ASSERT_EQ(reader.get_write_index(), 0U);
+
+    std::atomic<bool> done(false);
+    uint64_t num_ok = 0, num_overwritten = 0, num_latest = 0, num_corrupted = 0;
+    std::thread reader_thread([&]() {
+        shm_ring_record_t record;
+        uint64_t next = 0;
+        while (!done.load() || next < reader.get_write_index()) {
+            // sequential consumer, skipping ahead whenever the writer lapped it:
+            switch (reader.read(next, record)) {
+            case SHM_RING_READ_OK:
+                if (record.index != next || record.payload != get_expected_payload(next))
+                    num_corrupted++;
+                num_ok++;
+                next++;
+                break;
+            case SHM_RING_READ_OVERWRITTEN:
+                num_overwritten++;
+                next = reader.get_write_index() - 1;
+                break;
+            case SHM_RING_READ_NOT_YET:
+                break;
+            }
+
+            // "latest value" consumer:
+            if (reader.read_latest(record)) {
+                if (record.payload != get_expected_payload(record.index))
+                    num_corrupted++;
+                num_latest++;
+            }
+        }
+    });
+
+    for (uint64_t n = 0; n < num_samples; n++) {
+        std::string payload = get_expected_payload(n);
+        writer.publish(payload.data(), payload.size());
+    }
+    done = true;
+    reader_thread.join();
+
+    printf("Reader: %lu samples read in sequence, %lu times lapped by the writer, %lu latest samples read\n", num_ok,
+        num_overwritten, num_latest);
+    ASSERT_EQ(num_corrupted, 0U);
+    ASSERT_GT(num_ok, 0U);
+    ASSERT_GT(num_latest, 0U);
+    ASSERT_EQ(reader.get_write_index(), num_samples);
+    ASSERT_EQ(writer.get_stats().published, num_samples);
+    ASSERT_EQ(writer.get_stats().oversized, 0U);
+
+    // the last num_slots samples are still readable once the writer is idle:
+    shm_ring_record_t record;
+    for (uint64_t n = num_samples - 8; n < num_samples; n++) {
+        ASSERT_EQ(reader.read(n, record), SHM_RING_READ_OK);
+        ASSERT_EQ(record.payload, get_expected_payload(n));
+    }
+    ASSERT_EQ(reader.read(num_samples - 9, record), SHM_RING_READ_OVERWRITTEN);
+    ASSERT_EQ(reader.read(num_samples, record), SHM_RING_READ_NOT_YET);
+
+    ASSERT_FALSE(reader.is_writer_closed());
+    writer.close();
+    ASSERT_TRUE(reader.is_writer_closed()); // the mapping of the reader stays valid
+
+    CMonitorShmRingReader late_reader;
+    ASSERT_FALSE(late_reader.open(name)); // the shared memory was removed
+}
+
+TEST(ShmRing, oversized_samples_are_flagged)
+{
+    std::string name = get_test_ring_name("oversized");
+
+    CMonitorShmRingWriter writer;
+    ASSERT_TRUE(writer.init(name, 4, 100));
+    ASSERT_GE(writer.get_max_payload(), 100U);
+
+    std::string small(50, 's'), big(writer.get_max_payload() + 1, 'b');
+    writer.publish(small.data(), small.size());
+    writer.publish(big.data(), big.size());
+
+    CMonitorShmRingReader reader;
+    ASSERT_TRUE(reader.open(name));
+
+    shm_ring_record_t record;
+    ASSERT_FALSE(reader.read_header(record)); // no header was published
+    ASSERT_EQ(reader.read(0, record), SHM_RING_READ_OK);
+    ASSERT_EQ(record.flags, 0U);
+    ASSERT_EQ(record.payload, small);
+    ASSERT_EQ(reader.read(1, record), SHM_RING_READ_OK);
+    ASSERT_EQ(record.flags, (uint32_t)SHM_RING_FLAG_OVERSIZED);
+    ASSERT_TRUE(record.payload.empty());
+    ASSERT_EQ(writer.get_stats().oversized, 1U);
+}
+
+TEST(ShmRing, output_frontend_publishes_cbor_samples)
+{
+    std::string name = get_test_ring_name("frontend");
+
+    CMonitorOutputFrontend output;
+    ASSERT_TRUE(output.init_shm_ring(name, 4, 4096));
+
+    output.pheader_start();
+    output.psection_start("identity");
+    output.pstring("hostname", "myhost");
+    output.psection_end();
+    output.push_header();
+
+    for (unsigned int n = 0; n < 6; n++) {
+        output.psample_start();
+        output.psection_start("proc_loadavg");
+        output.pdouble("load_avg_1min", 0.5 * n);
+        output.psection_end();
+        output.push_current_sample();
+    }
+
+    CMonitorShmRingReader reader;
+    ASSERT_TRUE(reader.open(name));
+    ASSERT_EQ(reader.get_write_index(), 6U);
+
+    // header and samples are standalone CBOR maps, without the framing of the CBOR files:
+    shm_ring_record_t record;
+    ASSERT_TRUE(reader.read_header(record));
+    ASSERT_EQ((uint8_t)record.payload[0], (CBOR_MAJOR_TYPE_MAP << 5) | 1); // map with 1 section
+    ASSERT_NE(record.payload.find("myhost"), std::string::npos);
+
+    ASSERT_TRUE(reader.read_latest(record));
+    ASSERT_EQ(record.index, 5U);
+    ASSERT_NE(record.payload.find("load_avg_1min"), std::string::npos);
+    ASSERT_EQ(reader.read(1, record), SHM_RING_READ_OVERWRITTEN);
+
+    output.close();
+    ASSERT_TRUE(reader.is_writer_closed());
+}
@@ -0,0 +1,205 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the Unix domain socket streaming sink
+//------------------------------------------------------------------------------
+
+#include "../output_frontend.h"
+#include "../stream_server.h"
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+static std::string get_test_socket_path(const char* suffix)
+{
+    return "/tmp/cmonitor_unit_tests_" + std::to_string(getpid()) + "_" + suffix + ".sock";
+}
+
+static int subscribe(const CMonitorStreamServer& server, const std::string& path, int rcvbuf = 0)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (rcvbuf)
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unsigned int before = server.get_num_subscribers();
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    // wait for the server thread to register the subscriber, so that it does not miss the next frames
+    for (unsigned int i = 0; i < 1000 && server.get_num_subscribers() == before; i++)
+        usleep(1000);
+    return fd;
+}
+
+// reads lines until the given number of lines is received, or the connection is closed, or nothing comes for 1sec
+static std::vector<std::string> read_lines(int fd, size_t num_lines, std::string& rx)
+{
+    std::vector<std::string> ret;
+    while (true) {
+        size_t eol;
+        while (ret.size() < num_lines && (eol = rx.find('\n')) != std::string::npos) {
+            ret.push_back(rx.substr(0, eol));
+            rx.erase(0, eol + 1);
+        }
+        if (ret.size() == num_lines)
+            return ret;
+
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, 1000 /* msec */) <= 0)
+            return ret;
+        char buf[65536];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+            return ret;
+        rx.append(buf, n);
+    }
+}
+
+static std::string get_frame(unsigned int n, size_t size)
+{
+    std::string ret = std::to_string(n) + ":";
+    ret.resize(size - 1, 'x');
+    return ret + "\n";
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(StreamServer, ndjson_header_and_samples)
+{
+    std::string path = get_test_socket_path("ndjson");
+
+    CMonitorOutputFrontend output;
+    ASSERT_TRUE(output.init_stream_socket(path));
+
+    // the server of the frontend is not reachable from here: just give it time to register the subscriber
+    int early = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    ASSERT_EQ(connect(early, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    usleep(100000);
+
+    output.pheader_start();
+    output.psection_start("identity");
+    output.pstring("hostname", "my\"host");
+    output.plong("cpus", 4);
+    output.psection_end();
+    output.push_header();
+
+    for (unsigned int n = 0; n < 3; n++) {
+        output.psample_start();
+        output.psection_start("proc_loadavg");
+        output.pdouble("load_avg_1min", 0.5 * n);
+        output.psection_end();
+        output.push_current_sample();
+    }
+
+    std::string rx;
+    std::vector<std::string> lines = read_lines(early, 4, rx);
+    ASSERT_EQ(lines.size(), 4U);
+    ASSERT_EQ(lines[0], "{\"header\":{\"identity\":{\"hostname\":\"my*host\",\"cpus\":4}}}");
+    ASSERT_NE(lines[3].find("\"proc_loadavg\":{\"load_avg_1min\":1.0"), std::string::npos);
+    ASSERT_EQ(lines[3].back(), '}');
+
+    // subscribers connecting later start from the header, then get the new samples only
+    std::string rx_late;
+    int late = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(late, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    lines = read_lines(late, 1, rx_late);
+    ASSERT_EQ(lines.size(), 1U);
+    ASSERT_EQ(lines[0].find("{\"header\":"), 0U);
+
+    output.psample_start();
+    output.psection_start("proc_loadavg");
+    output.pdouble("load_avg_1min", 9);
+    output.psection_end();
+    output.push_current_sample();
+    lines = read_lines(late, 1, rx_late);
+    ASSERT_EQ(lines.size(), 1U);
+    ASSERT_NE(lines[0].find("\"load_avg_1min\":9"), std::string::npos);
+    lines = read_lines(early, 1, rx);
+    ASSERT_EQ(lines.size(), 1U);
+    ASSERT_NE(lines[0].find("\"load_avg_1min\":9"), std::string::npos);
+
+    output.close();
+    ASSERT_NE(access(path.c_str(), F_OK), 0); // the socket file is removed at exit
+    close(early);
+    close(late);
+}
+
+TEST(StreamServer, slow_subscriber_gets_a_downsampled_stream)
+{
+    const unsigned int num_frames = 300;
+    std::string path = get_test_socket_path("skip");
+
+    CMonitorStreamServer server;
+    ASSERT_TRUE(server.init(path, 4, STREAM_POLICY_SKIP));
+    int slow = subscribe(server, path, 4096);
+    ASSERT_NE(slow, -1);
+
+    server.publish_header(get_frame(0, 100));
+    for (unsigned int n = 1; n <= num_frames; n++)
+        server.publish(get_frame(n, 65536)); // never blocks, although nobody is reading
+    usleep(100000);
+    ASSERT_EQ(server.get_num_subscribers(), 1U);
+    ASSERT_GT(server.get_stats().skipped, 0U);
+
+    // whatever was received must be complete frames, in order, starting from the header and ending with the last one
+    std::string rx;
+    std::vector<std::string> lines = read_lines(slow, num_frames + 1, rx);
+    ASSERT_GE(lines.size(), 2U);
+    ASSERT_LT(lines.size(), num_frames + 1);
+    ASSERT_EQ(lines[0], get_frame(0, 100).substr(0, 99));
+    unsigned int prev = 0;
+    for (size_t i = 1; i < lines.size(); i++) {
+        unsigned int n = atoi(lines[i].c_str());
+        ASSERT_GT(n, prev);
+        ASSERT_EQ(lines[i] + "\n", get_frame(n, 65536));
+        prev = n;
+    }
+    ASSERT_EQ(prev, num_frames);
+    ASSERT_TRUE(rx.empty());
+
+    stream_server_stats_t stats = server.get_stats();
+    ASSERT_EQ(stats.frames, num_frames);
+    ASSERT_EQ(stats.skipped, num_frames - (lines.size() - 1));
+    ASSERT_EQ(stats.disconnected, 0U);
+    close(slow);
+}
+
+TEST(StreamServer, slow_subscriber_is_disconnected)
+{
+    std::string path = get_test_socket_path("disconnect");
+
+    CMonitorStreamServer server;
+    ASSERT_TRUE(server.init(path, 4, STREAM_POLICY_DISCONNECT));
+    int slow = subscribe(server, path, 4096);
+    ASSERT_NE(slow, -1);
+
+    for (unsigned int n = 1; n <= 100 && server.get_num_subscribers() > 0; n++)
+        server.publish(get_frame(n, 65536));
+    for (unsigned int i = 0; i < 1000 && server.get_num_subscribers() > 0; i++)
+        usleep(1000);
+    ASSERT_EQ(server.get_num_subscribers(), 0U);
+    ASSERT_EQ(server.get_stats().disconnected, 1U);
+
+    // the frames queued at the time of the disconnection are lost, but all those received are intact and in order
+    std::string rx;
+    std::vector<std::string> lines = read_lines(slow, 100, rx);
+    ASSERT_LT(lines.size(), 100U);
+    for (size_t i = 0; i < lines.size(); i++)
+        ASSERT_EQ(lines[i] + "\n", get_frame(i + 1, 65536));
+    close(slow);
+}
@@ -0,0 +1,95 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the trigger rules
+//------------------------------------------------------------------------------
+
+#include "../triggers.h"
+#include <gtest/gtest.h>
+#include <map>
+
+//------------------------------------------------------------------------------
+// Helpers
+//------------------------------------------------------------------------------
+
+static CMonitorTriggers::kpi_lookup_t make_lookup(const std::map<std::string, double>& kpis)
+{
+    return [kpis](const trigger_kpi_t& kpi, double& valueOUT) -> bool {
+        std::string path = kpi.section + "/" + (kpi.subsection.empty() ? "" : kpi.subsection + "/") + kpi.measurement;
+        auto it = kpis.find(path);
+        if (it == kpis.end())
+            return false;
+        valueOUT = it->second;
+        return true;
+    };
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(Triggers, rules_are_parsed)
+{
+    CMonitorTriggers triggers;
+    std::string errmsg;
+    ASSERT_FALSE(triggers.add_rule("cgroup_memory_stats/stat.current", errmsg));
+    ASSERT_FALSE(triggers.add_rule("nr_throttled>0", errmsg));
+    ASSERT_FALSE(triggers.add_rule("a/b/c/d>0", errmsg));
+    ASSERT_FALSE(triggers.add_rule("cgroup_memory_stats/stat.current>lots", errmsg));
+    ASSERT_FALSE(triggers.add_rule("cgroup_memory_stats/stat.current>90%limit", errmsg));
+    ASSERT_TRUE(triggers.empty());
+
+    ASSERT_TRUE(triggers.add_rule("cgroup_cpuacct_stats/throttling/nr_throttled > 0", errmsg)) << errmsg;
+    ASSERT_TRUE(triggers.add_rule("proc_loadavg/load_avg_1min<=0.5", errmsg)) << errmsg;
+    ASSERT_TRUE(
+        triggers.add_rule("cgroup_memory_stats/stat.current>=90%cgroup_config/memory_limit_bytes", errmsg))
+        << errmsg;
+    ASSERT_FALSE(triggers.empty());
+}
+
+TEST(Triggers, rules_fire_on_thresholds)
+{
+    CMonitorTriggers triggers;
+    std::string errmsg;
+    ASSERT_TRUE(triggers.add_rule("cgroup_cpuacct_stats/throttling/nr_throttled>0", errmsg));
+    ASSERT_TRUE(triggers.add_rule("cgroup_memory_stats/stat.current>=90%cgroup_config/memory_limit_bytes", errmsg));
+
+    // missing KPIs never fire:
+    ASSERT_EQ(triggers.evaluate(make_lookup({})), nullptr);
+
+    const trigger_rule_t* rule
+        = triggers.evaluate(make_lookup({ { "cgroup_cpuacct_stats/throttling/nr_throttled", 3 } }));
+    ASSERT_NE(rule, nullptr);
+    ASSERT_EQ(rule->text, "cgroup_cpuacct_stats/throttling/nr_throttled>0");
+    ASSERT_EQ(triggers.evaluate(make_lookup({ { "cgroup_cpuacct_stats/throttling/nr_throttled", 0 } })), nullptr);
+
+    // percentages of another KPI:
+    std::map<std::string, double> kpis
+        = { { "cgroup_memory_stats/stat.current", 899 }, { "cgroup_config/memory_limit_bytes", 1000 } };
+    ASSERT_EQ(triggers.evaluate(make_lookup(kpis)), nullptr);
+    kpis["cgroup_memory_stats/stat.current"] = 900;
+    rule = triggers.evaluate(make_lookup(kpis));
+    ASSERT_NE(rule, nullptr);
+    ASSERT_EQ(rule->kpi.measurement, "stat.current");
+
+    // a limit of -1 means no limit:
+    kpis["cgroup_config/memory_limit_bytes"] = -1;
+    ASSERT_EQ(triggers.evaluate(make_lookup(kpis)), nullptr);
+}
+
+TEST(Triggers, bursts_last_the_configured_duration)
+{
+    CMonitorTriggers triggers;
+    triggers.set_burst(50, 1000);
+    ASSERT_FALSE(triggers.is_bursting());
+    ASSERT_EQ(triggers.update(10000, false), TRIGGER_NONE);
+
+    ASSERT_EQ(triggers.update(11000, true), TRIGGER_BURST_STARTED);
+    ASSERT_TRUE(triggers.is_bursting());
+    ASSERT_EQ(triggers.update(11500, false), TRIGGER_NONE);
+
+    // firing again moves the end of the burst:
+    ASSERT_EQ(triggers.update(11900, true), TRIGGER_BURST_EXTENDED);
+    ASSERT_EQ(triggers.update(12500, false), TRIGGER_NONE);
+    ASSERT_EQ(triggers.update(12900, false), TRIGGER_BURST_ENDED);
+    ASSERT_FALSE(triggers.is_bursting());
+    ASSERT_EQ(triggers.update(13000, false), TRIGGER_NONE);
+}
@@ -0,0 +1,172 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the InfluxDB UDP transport
+//------------------------------------------------------------------------------
+
+#include "../output_frontend.h"
+#include "../udp_sender.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <netinet/in.h>
+#include <poll.h>
+#include <thread>
+
+//------------------------------------------------------------------------------
+// Local UDP receiver
+//------------------------------------------------------------------------------
+
+class UdpReceiver {
+public:
+    UdpReceiver()
+    {
+        m_fd = socket(AF_INET, SOCK_DGRAM, 0);
+        int rcvbuf = 8 * 1024 * 1024;
+        setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(m_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0
+            && getsockname(m_fd, (struct sockaddr*)&addr, &len) == 0)
+            m_port = ntohs(addr.sin_port);
+
+        m_thread = std::thread(&UdpReceiver::run, this);
+    }
+    ~UdpReceiver()
+    {
+        m_stop = true;
+        m_thread.join();
+        close(m_fd);
+    }
+
+    unsigned int port() const { return m_port; }
+    std::vector<std::string> get_datagrams()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_datagrams;
+    }
+
+private:
+    void run()
+    {
+        char buf[65536];
+        while (!m_stop) {
+            struct pollfd pfd = { m_fd, POLLIN, 0 };
+            if (poll(&pfd, 1, 20 /* msec */) <= 0)
+                continue;
+            ssize_t n = recv(m_fd, buf, sizeof(buf), 0);
+            if (n > 0) {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_datagrams.push_back(std::string(buf, n));
+            }
+        }
+    }
+
+    int m_fd = -1;
+    unsigned int m_port = 0;
+    std::atomic<bool> m_stop { false };
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::vector<std::string> m_datagrams;
+};
+
+static unsigned int count_lines(const std::string& str) { return std::count(str.begin(), str.end(), '\n'); }
+
+static void wait_for_datagrams(UdpReceiver& receiver, uint64_t expected)
+{
+    for (unsigned int i = 0; i < 100 && receiver.get_datagrams().size() < expected; i++)
+        usleep(10 * 1000);
+}
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(UdpSender, records_are_never_split)
+{
+    UdpReceiver receiver;
+    CMonitorUdpSender sender;
+    ASSERT_TRUE(sender.init("127.0.0.1", receiver.port(), 100 /* max payload */));
+
+    std::string records;
+    for (unsigned int i = 0; i < 50; i++)
+        records += "meas,tag=" + std::string(i % 40, 'x') + " value=" + std::to_string(i) + "i\n";
+    std::string oversized = "meas,tag=" + std::string(200, 'y') + " value=1i\n";
+
+    unsigned int ndatagrams = sender.send(records + oversized);
+    ASSERT_GT(ndatagrams, 1);
+    wait_for_datagrams(receiver, ndatagrams);
+
+    std::vector<std::string> datagrams = receiver.get_datagrams();
+    ASSERT_EQ(datagrams.size(), ndatagrams);
+    std::string all;
+    for (const auto& d : datagrams) {
+        ASSERT_LE(d.size(), 100);
+        ASSERT_EQ(d.back(), '\n');
+        all += d;
+    }
+
+    // all records arrived, in order; only the one larger than the payload size was dropped:
+    ASSERT_EQ(all, records);
+    ASSERT_EQ(sender.get_stats().sent, 50);
+    ASSERT_EQ(sender.get_stats().dropped, 1);
+    ASSERT_EQ(sender.get_stats().datagrams, ndatagrams);
+}
+
+TEST(UdpSender, no_loss_at_100_samples_per_sec)
+{
+    const unsigned int num_samples = 100, num_disks = 16;
+
+    UdpReceiver receiver;
+    uint64_t points_sent = 0;
+    {
+        CMonitorOutputFrontend output;
+        output.init_influxdb_udp_connection("127.0.0.1", receiver.port(), UDP_SENDER_DEFAULT_PAYLOAD_SIZE);
+        for (unsigned int n = 0; n < num_samples; n++) {
+            output.psample_start();
+            output.psection_start("proc_loadavg");
+            output.pdouble("load_avg_1min", 0.01 * n);
+            output.pdouble("load_avg_5min", 0.02 * n);
+            output.pdouble("load_avg_15min", 0.03 * n);
+            output.psection_end();
+            output.psection_start("disks");
+            for (unsigned int d = 0; d < num_disks; d++) {
+                output.psubsection_start(("sd" + std::to_string(d)).c_str());
+                output.plong("reads", n * d);
+                output.plong("writes", n * d * 2);
+                output.plong("read_bytes", n * d * 4096);
+                output.plong("write_bytes", n * d * 8192);
+                output.psubsection_end();
+            }
+            output.psection_end();
+            output.pstats();
+            output.push_current_sample();
+
+            usleep(10 * 1000); // 100 samples/sec
+        }
+
+        // a last sample carrying only the final self-stats:
+        output.psample_start();
+        output.pstats();
+        output.push_current_sample();
+        output.close();
+    }
+
+    // count what has been received:
+    wait_for_datagrams(receiver, 1);
+    usleep(100 * 1000);
+    std::vector<std::string> datagrams = receiver.get_datagrams();
+    for (const auto& d : datagrams) {
+        ASSERT_LE(d.size(), UDP_SENDER_DEFAULT_PAYLOAD_SIZE);
+        points_sent += count_lines(d);
+    }
+
+    // the last datagram carries the final self-stats, which must report no drop:
+    std::string last = datagrams.back();
+    ASSERT_NE(last.find("influxdb_udp_points_dropped=0 "), std::string::npos);
+    // every sample produced one line for each section/subsection:
+    ASSERT_EQ(points_sent, num_samples * (1 + num_disks + 1) + 1);
+}
@@ -3,6 +3,7 @@
 //------------------------------------------------------------------------------
 
 #include "../utils_misc.h"
+#include "../utils_string.h"
 #include <gtest/gtest.h>
 #include <iostream>
 #include <sstream> //std::stringstream
@@ -32,3 +33,19 @@ TEST(Utils, format_timestamp)
         ASSERT_EQ(testArray[i].expected_output, utcTime);
     }
 }
+
+TEST(Utils, string2duration_msec)
+{
+    uint64_t msec;
+    ASSERT_TRUE(string2duration_msec("100ms", msec));
+    ASSERT_EQ(msec, 100U);
+    ASSERT_TRUE(string2duration_msec("10s", msec));
+    ASSERT_EQ(msec, 10000U);
+    ASSERT_TRUE(string2duration_msec("0.5", msec));
+    ASSERT_EQ(msec, 500U);
+    ASSERT_TRUE(string2duration_msec("2m", msec));
+    ASSERT_EQ(msec, 120000U);
+    ASSERT_FALSE(string2duration_msec("ms", msec));
+    ASSERT_FALSE(string2duration_msec("10h", msec));
+    ASSERT_FALSE(string2duration_msec("-1s", msec));
+}
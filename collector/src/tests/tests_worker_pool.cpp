@@ -0,0 +1,90 @@
+//------------------------------------------------------------------------------
+// GTest unit tests for the pool of sampling threads
+//------------------------------------------------------------------------------
+
+#include "../utils_misc.h"
+#include "../worker_pool.h"
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+TEST(WorkerPool, each_item_is_processed_once)
+{
+    const unsigned int num_workers = 4;
+
+    CMonitorWorkerPool pool;
+    ASSERT_TRUE(pool.init(num_workers));
+    ASSERT_EQ(pool.get_num_workers(), num_workers);
+
+    // the pool is reused across runs, with any number of items:
+    for (size_t num_items : { 0, 1, 5, 1000, 7, 10000 }) {
+        std::vector<unsigned int> processed(num_items, 0);
+        std::vector<std::vector<size_t>> per_worker(num_workers); // the "arenas"
+        pool.run(num_items, [&](unsigned int worker, size_t first, size_t last) {
+            ASSERT_LT(worker, num_workers);
+            ASSERT_LE(last - first, (size_t)WORKER_POOL_CHUNK_SIZE);
+            for (size_t i = first; i < last; i++) {
+                processed[i]++;
+                per_worker[worker].push_back(i);
+            }
+        });
+
+        size_t total = 0;
+        for (const auto& items : per_worker)
+            total += items.size();
+        ASSERT_EQ(total, num_items);
+        for (size_t i = 0; i < num_items; i++)
+            ASSERT_EQ(processed[i], 1U) << "item " << i << " of " << num_items;
+    }
+    ASSERT_EQ(pool.get_stats().runs, 6U);
+}
+
+TEST(WorkerPool, idle_workers_steal_from_slow_ones)
+{
+    const unsigned int num_workers = 4, num_items = 400;
+
+    CMonitorWorkerPool pool;
+    ASSERT_TRUE(pool.init(num_workers));
+
+    // all the expensive items are in the first shard:
+    uint64_t start = get_monotonic_msec();
+    std::vector<unsigned int> processed(num_items, 0);
+    pool.run(num_items, [&](unsigned int worker, size_t first, size_t last) {
+        for (size_t i = first; i < last; i++) {
+            if (i < num_items / num_workers)
+                usleep(1000);
+            processed[i]++;
+        }
+    });
+    uint64_t elapsed = get_monotonic_msec() - start;
+
+    for (size_t i = 0; i < num_items; i++)
+        ASSERT_EQ(processed[i], 1U);
+    ASSERT_GT(pool.get_stats().stolen_chunks, 0U);
+    const uint64_t chunks_per_shard = (num_items / num_workers + WORKER_POOL_CHUNK_SIZE - 1) / WORKER_POOL_CHUNK_SIZE;
+    ASSERT_EQ(pool.get_stats().chunks, num_workers * chunks_per_shard);
+
+    // without stealing the first worker alone would take 100 msecs
+    printf("Elapsed %lu msecs with %lu chunks stolen\n", elapsed, pool.get_stats().stolen_chunks);
+    ASSERT_LT(elapsed, 80U);
+}
+
+TEST(WorkerPool, single_worker_runs_inline)
+{
+    CMonitorWorkerPool pool;
+    ASSERT_FALSE(pool.init(0));
+    ASSERT_FALSE(pool.init(WORKER_POOL_MAX_THREADS + 1));
+    ASSERT_TRUE(pool.init(1));
+
+    std::thread::id caller = std::this_thread::get_id();
+    size_t num_processed = 0;
+    pool.run(100, [&](unsigned int worker, size_t first, size_t last) {
+        ASSERT_EQ(worker, 0U);
+        ASSERT_EQ(std::this_thread::get_id(), caller);
+        num_processed += last - first;
+    });
+    ASSERT_EQ(num_processed, 100U);
+}
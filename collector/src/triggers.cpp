@@ -0,0 +1,135 @@
+/*
+ * triggers.cpp -- trigger rules switching the sampling to a burst rate
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "triggers.h"
+#include "utils_string.h"
+
+// ----------------------------------------------------------------------------------
+// CMonitorTriggers
+// ----------------------------------------------------------------------------------
+
+bool CMonitorTriggers::parse_kpi(const std::string& str, trigger_kpi_t& kpiOUT)
+{
+    std::vector<std::string> tokens = split_string_in_array(str, '/');
+    for (const auto& token : tokens)
+        if (token.empty())
+            return false;
+
+    switch (tokens.size()) {
+    case 2:
+        kpiOUT.section = tokens[0];
+        kpiOUT.subsection.clear();
+        kpiOUT.measurement = tokens[1];
+        return true;
+    case 3:
+        kpiOUT.section = tokens[0];
+        kpiOUT.subsection = tokens[1];
+        kpiOUT.measurement = tokens[2];
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool CMonitorTriggers::add_rule(const std::string& rule, std::string& errmsg)
+{
+    trigger_rule_t r;
+    r.text = rule;
+
+    size_t op_pos = rule.find_first_of("<>");
+    if (op_pos == std::string::npos) {
+        errmsg = "missing comparison operator: expected one of >, >=, <, <=";
+        return false;
+    }
+    bool or_equal = op_pos + 1 < rule.size() && rule[op_pos + 1] == '=';
+    if (rule[op_pos] == '>')
+        r.op = or_equal ? TRIGGER_OP_GREATER_EQUAL : TRIGGER_OP_GREATER;
+    else
+        r.op = or_equal ? TRIGGER_OP_LESS_EQUAL : TRIGGER_OP_LESS;
+
+    std::string kpi = trim_string(rule.substr(0, op_pos));
+    std::string threshold = trim_string(rule.substr(op_pos + (or_equal ? 2 : 1)));
+    if (!parse_kpi(kpi, r.kpi)) {
+        errmsg = "invalid KPI '" + kpi + "': expected SECTION[/SUBSECTION]/MEASUREMENT";
+        return false;
+    }
+
+    std::string number = threshold, ref_kpi;
+    r.has_ref_kpi = split_string_on_first_separator(threshold, '%', number, ref_kpi);
+    if (!string2double(trim_string(number).c_str(), r.threshold)) {
+        errmsg = "invalid threshold '" + threshold
+            + "': expected a number or PERCENTAGE%SECTION[/SUBSECTION]/MEASUREMENT";
+        return false;
+    }
+    if (r.has_ref_kpi && !parse_kpi(trim_string(ref_kpi), r.ref_kpi)) {
+        errmsg = "invalid reference KPI '" + ref_kpi + "': expected SECTION[/SUBSECTION]/MEASUREMENT";
+        return false;
+    }
+
+    m_rules.push_back(r);
+    return true;
+}
+
+const trigger_rule_t* CMonitorTriggers::evaluate(const kpi_lookup_t& lookup) const
+{
+    for (const auto& r : m_rules) {
+        double value, threshold = r.threshold;
+        if (!lookup(r.kpi, value))
+            continue;
+        if (r.has_ref_kpi) {
+            double ref_value;
+            if (!lookup(r.ref_kpi, ref_value) || ref_value <= 0)
+                continue; // e.g. a memory limit reported as -1 since there is no limit
+            threshold = ref_value * r.threshold / 100;
+        }
+
+        bool fired = false;
+        switch (r.op) {
+        case TRIGGER_OP_GREATER:
+            fired = value > threshold;
+            break;
+        case TRIGGER_OP_GREATER_EQUAL:
+            fired = value >= threshold;
+            break;
+        case TRIGGER_OP_LESS:
+            fired = value < threshold;
+            break;
+        case TRIGGER_OP_LESS_EQUAL:
+            fired = value <= threshold;
+            break;
+        }
+        if (fired)
+            return &r;
+    }
+    return nullptr;
+}
+
+TriggerTransition CMonitorTriggers::update(uint64_t now_msec, bool fired)
+{
+    if (fired) {
+        bool was_bursting = is_bursting();
+        m_burst_end_msec = now_msec + m_burst_duration_msec;
+        return was_bursting ? TRIGGER_BURST_EXTENDED : TRIGGER_BURST_STARTED;
+    }
+    if (is_bursting() && now_msec >= m_burst_end_msec) {
+        m_burst_end_msec = 0;
+        return TRIGGER_BURST_ENDED;
+    }
+    return TRIGGER_NONE;
+}
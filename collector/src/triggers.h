@@ -0,0 +1,118 @@
+/*
+ * triggers.h -- trigger rules switching the sampling to a burst rate
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define TRIGGER_DEFAULT_BURST_INTERVAL_MSEC (100)
+#define TRIGGER_DEFAULT_BURST_DURATION_MSEC (10000)
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+enum TriggerOperator {
+    TRIGGER_OP_GREATER,
+    TRIGGER_OP_GREATER_EQUAL,
+    TRIGGER_OP_LESS,
+    TRIGGER_OP_LESS_EQUAL,
+};
+
+// a KPI is identified by its position in the sample: SECTION[/SUBSECTION]/MEASUREMENT
+typedef struct {
+    std::string section;
+    std::string subsection; // empty for measurements placed directly in the section
+    std::string measurement;
+} trigger_kpi_t;
+
+typedef struct {
+    std::string text; // the rule as provided by the user
+    trigger_kpi_t kpi;
+    TriggerOperator op = TRIGGER_OP_GREATER;
+    double threshold = 0; // a percentage of ref_kpi when has_ref_kpi is set
+    bool has_ref_kpi = false;
+    trigger_kpi_t ref_kpi;
+} trigger_rule_t;
+
+enum TriggerTransition {
+    TRIGGER_NONE, // nothing changed
+    TRIGGER_BURST_STARTED,
+    TRIGGER_BURST_EXTENDED, // a rule fired again during the burst: the burst now ends later
+    TRIGGER_BURST_ENDED,
+};
+
+//------------------------------------------------------------------------------
+// CMonitorTriggers
+//
+// Rules evaluated on each sample, e.g.
+//     cgroup_cpuacct_stats/throttling/nr_throttled>0
+//     cgroup_memory_stats/stat.current>90%cgroup_config/memory_limit_bytes
+// The threshold of a rule is either a number or a percentage of another KPI, which is looked up in the sample
+// and then in the header (this is where limits like the cgroup memory limit are reported).
+// When a rule fires the collector samples at the burst interval for the burst duration; a rule firing again
+// during the burst extends it.
+//------------------------------------------------------------------------------
+
+class CMonitorTriggers {
+public:
+    // returns false if the KPI is not present in the sample or is not numeric
+    typedef std::function<bool(const trigger_kpi_t& kpi, double& valueOUT)> kpi_lookup_t;
+
+    CMonitorTriggers() { }
+
+    bool add_rule(const std::string& rule, std::string& errmsg);
+    bool empty() const { return m_rules.empty(); }
+
+    void set_burst(uint64_t interval_msec, uint64_t duration_msec)
+    {
+        m_burst_interval_msec = interval_msec;
+        m_burst_duration_msec = duration_msec;
+    }
+    uint64_t get_burst_interval_msec() const { return m_burst_interval_msec; }
+    uint64_t get_burst_duration_msec() const { return m_burst_duration_msec; }
+
+    // returns the first rule firing on the KPIs provided by the lookup function, or nullptr.
+    // Rules whose KPIs are missing do not fire.
+    const trigger_rule_t* evaluate(const kpi_lookup_t& lookup) const;
+
+    // advances the burst state after each sample, given whether a rule fired on it
+    TriggerTransition update(uint64_t now_msec, bool fired);
+    bool is_bursting() const { return m_burst_end_msec != 0; }
+
+private:
+    static bool parse_kpi(const std::string& str, trigger_kpi_t& kpiOUT);
+
+private:
+    std::vector<trigger_rule_t> m_rules;
+    uint64_t m_burst_interval_msec = TRIGGER_DEFAULT_BURST_INTERVAL_MSEC;
+    uint64_t m_burst_duration_msec = TRIGGER_DEFAULT_BURST_DURATION_MSEC;
+    uint64_t m_burst_end_msec = 0; // 0 when not bursting
+};
@@ -0,0 +1,143 @@
+/*
+ * udp_sender.cpp -- fire-and-forget UDP transport for InfluxDB line protocol
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "udp_sender.h"
+#include "logger.h"
+#include <algorithm>
+#include <errno.h>
+#include <netdb.h>
+#include <string.h>
+#include <unistd.h>
+
+// ----------------------------------------------------------------------------------
+// CMonitorUdpSender
+// ----------------------------------------------------------------------------------
+
+bool CMonitorUdpSender::init(const std::string& hostname, unsigned int port, unsigned int max_payload)
+{
+    m_max_payload = std::min(std::max(max_payload, 1U), (unsigned int)UDP_SENDER_MAX_PAYLOAD_SIZE);
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    struct addrinfo* res = nullptr;
+    int ret = getaddrinfo(hostname.c_str(), std::to_string(port).c_str(), &hints, &res);
+    if (ret != 0 || res == nullptr) {
+        CMonitorLogger::instance()->LogError(
+            "Lookup of IP address for hostname %s failed: %s\n", hostname.c_str(), gai_strerror(ret));
+        return false;
+    }
+
+    // a connected UDP socket avoids the route/address lookup that sendto() does for every datagram
+    m_fd = socket(res->ai_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_fd == -1 || connect(m_fd, res->ai_addr, res->ai_addrlen) != 0) {
+        CMonitorLogger::instance()->LogError(
+            "Failed to create UDP socket towards %s:%u: %s\n", hostname.c_str(), port, strerror(errno));
+        freeaddrinfo(res);
+        close();
+        return false;
+    }
+    freeaddrinfo(res);
+    return true;
+}
+
+void CMonitorUdpSender::close()
+{
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+unsigned int CMonitorUdpSender::send(const std::string& records)
+{
+    if (m_fd == -1)
+        return 0;
+
+    // split the buffer in datagrams, at record boundaries only:
+    m_iovecs.clear();
+    m_points_per_datagram.clear();
+    const char* base = records.data();
+    size_t datagram_start = 0, datagram_len = 0;
+    unsigned int datagram_points = 0;
+    for (size_t pos = 0; pos < records.size();) {
+        const char* eol = (const char*)memchr(base + pos, '\n', records.size() - pos);
+        size_t record_len = eol ? (size_t)(eol - (base + pos)) + 1 : records.size() - pos;
+
+        if (datagram_len > 0 && datagram_len + record_len > m_max_payload) {
+            m_iovecs.push_back({ (void*)(base + datagram_start), datagram_len });
+            m_points_per_datagram.push_back(datagram_points);
+            datagram_len = 0;
+            datagram_points = 0;
+        }
+        if (datagram_len == 0)
+            datagram_start = pos;
+
+        if (record_len > m_max_payload) {
+            // this record alone does not fit a datagram: drop it rather than truncating it
+            CMonitorLogger::instance()->LogDebug(
+                "Dropping line-protocol record of %zu bytes: larger than the UDP payload size", record_len);
+            m_stats.dropped++;
+        } else {
+            datagram_len += record_len;
+            datagram_points++;
+        }
+        pos += record_len;
+    }
+    if (datagram_len > 0) {
+        m_iovecs.push_back({ (void*)(base + datagram_start), datagram_len });
+        m_points_per_datagram.push_back(datagram_points);
+    }
+
+    // now send them all with as few syscalls as possible:
+    m_msgs.resize(m_iovecs.size());
+    for (size_t i = 0; i < m_iovecs.size(); i++) {
+        memset(&m_msgs[i], 0, sizeof(m_msgs[i]));
+        m_msgs[i].msg_hdr.msg_iov = &m_iovecs[i];
+        m_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    unsigned int nsent = 0;
+    bool refused_once = false;
+    while (nsent < m_msgs.size()) {
+        int ret = sendmmsg(m_fd, &m_msgs[nsent], m_msgs.size() - nsent, 0);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == ECONNREFUSED && !refused_once) {
+                // ICMP port unreachable received for some previous datagram: reporting it cleared the error
+                refused_once = true;
+                continue;
+            }
+            // e.g. EAGAIN when the socket buffer is full: fire-and-forget means dropping
+            for (size_t i = nsent; i < m_msgs.size(); i++)
+                m_stats.dropped += m_points_per_datagram[i];
+            break;
+        }
+        for (int i = 0; i < ret; i++) {
+            m_stats.sent += m_points_per_datagram[nsent + i];
+            m_stats.bytes += m_iovecs[nsent + i].iov_len;
+        }
+        m_stats.datagrams += ret;
+        nsent += ret;
+    }
+    return nsent;
+}
@@ -0,0 +1,82 @@
+/*
+ * udp_sender.h -- fire-and-forget UDP transport for InfluxDB line protocol
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+// 1500 bytes Ethernet MTU minus IPv4 and UDP headers, to avoid IP fragmentation:
+#define UDP_SENDER_DEFAULT_PAYLOAD_SIZE (1472)
+#define UDP_SENDER_DEFAULT_PAYLOAD_SIZE_STR "1472"
+#define UDP_SENDER_MAX_PAYLOAD_SIZE (65507)
+
+typedef struct {
+    uint64_t datagrams = 0; // datagrams handed to the kernel
+    uint64_t sent = 0; // points handed to the kernel
+    uint64_t dropped = 0; // points that could not be sent (oversized or socket errors)
+    uint64_t bytes = 0; // payload bytes handed to the kernel
+} udp_sender_stats_t;
+
+//------------------------------------------------------------------------------
+// CMonitorUdpSender
+//
+// Sends newline-terminated line-protocol records over a single, long-lived and connected
+// UDP socket. Consecutive records are packed into datagrams as large as the configured
+// payload size, but a record is never split across two datagrams: InfluxDB parses every
+// datagram independently. Since the records are contiguous in the input buffer, each
+// datagram simply points into it and all of them are sent with a single sendmmsg().
+//------------------------------------------------------------------------------
+
+class CMonitorUdpSender {
+public:
+    CMonitorUdpSender() { }
+    ~CMonitorUdpSender() { close(); }
+
+    bool init(
+        const std::string& hostname, unsigned int port, unsigned int max_payload = UDP_SENDER_DEFAULT_PAYLOAD_SIZE);
+    void close();
+
+    // sends the given records, which must be newline-terminated; returns the number of datagrams sent
+    unsigned int send(const std::string& records);
+
+    const udp_sender_stats_t& get_stats() const { return m_stats; }
+    unsigned int get_max_payload() const { return m_max_payload; }
+
+private:
+    int m_fd = -1;
+    unsigned int m_max_payload = UDP_SENDER_DEFAULT_PAYLOAD_SIZE;
+
+    // reused across calls
+    std::vector<struct iovec> m_iovecs;
+    std::vector<struct mmsghdr> m_msgs;
+    std::vector<unsigned int> m_points_per_datagram;
+
+    udp_sender_stats_t m_stats;
+};
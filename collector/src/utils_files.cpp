@@ -43,6 +43,19 @@ bool file_or_dir_exists(const char* filename)
         return false;
 }
 
+std::string get_unused_filename_prefix(
+    const std::string& prefix, const std::vector<std::string>& extensions, unsigned int first_instance)
+{
+    for (unsigned int n = first_instance;; n++) {
+        std::string candidate = prefix + "." + std::to_string(n);
+        bool used = false;
+        for (const auto& extension : extensions)
+            used = used || file_or_dir_exists((candidate + extension).c_str());
+        if (!used)
+            return candidate;
+    }
+}
+
 bool read_integer(std::string filePath, uint64_t& value)
 {
     FILE* stream = fopen(filePath.c_str(), "r");
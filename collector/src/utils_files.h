@@ -39,6 +39,11 @@ class CMonitorOutputFrontend;
 //       during slow, configuration & initialization code paths if possible
 //------------------------------------------------------------------------------
 bool file_or_dir_exists(const char* filename);
+
+// returns "<prefix>.N" with the lowest N >= first_instance such that no "<prefix>.N<extension>" file exists,
+// for any of the given extensions; used to avoid overwriting the output files of a previous instance
+std::string get_unused_filename_prefix(
+    const std::string& prefix, const std::vector<std::string>& extensions, unsigned int first_instance = 2);
 bool search_integer(std::string filePath, uint64_t valueToSearch);
 bool read_integer(std::string filePath, uint64_t& value);
 bool read_cgroupv2_integer_or_max(std::string filePath, uint64_t& value);
@@ -90,3 +90,11 @@ bool get_timestamp(double* ts_for_delta_computation, std::string& utcTime)
     format_timestamp(now_ts, utcTime);
     return true;
 }
+
+uint64_t get_monotonic_msec()
+{
+    struct timespec tv;
+    if (clock_gettime(CLOCK_MONOTONIC, &tv) != 0)
+        return 0;
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_nsec / 1000000;
+}
@@ -36,6 +36,7 @@
 //------------------------------------------------------------------------------
 void format_timestamp(const std::chrono::time_point<std::chrono::system_clock>& now_ts, std::string& utcTime);
 bool get_timestamp(double* ts_for_delta_computation, std::string& utcTime);
+uint64_t get_monotonic_msec();
 
 //------------------------------------------------------------------------------
 // Hostname utilities
@@ -173,6 +173,27 @@ template std::string stl_container2string(const std::set<uint64_t>& par, const s
 template std::string stl_container2string(const std::vector<int>& par, const std::string& delim);
 template std::string stl_container2string(const std::set<std::string>& par, const std::string& delim);
 
+bool string2duration_msec(const std::string& s, uint64_t& result)
+{
+    std::string number = s;
+    double msec_per_unit = 1000; // seconds are the default unit, like for --sampling-interval
+    if (s.size() > 2 && s.compare(s.size() - 2, 2, "ms") == 0) {
+        number = s.substr(0, s.size() - 2);
+        msec_per_unit = 1;
+    } else if (s.size() > 1 && s.back() == 's') {
+        number = s.substr(0, s.size() - 1);
+    } else if (s.size() > 1 && s.back() == 'm') {
+        number = s.substr(0, s.size() - 1);
+        msec_per_unit = 60000;
+    }
+
+    double value;
+    if (!string2double(number.c_str(), value) || value < 0)
+        return false;
+    result = (uint64_t)(value * msec_per_unit + 0.5);
+    return true;
+}
+
 std::vector<std::string> split_string_in_array(const std::string& str, char splitter)
 {
     std::vector<std::string> tokens;
@@ -40,6 +40,7 @@ std::string trim_string(const std::string& s);
 void strip_spaces(char* s);
 bool string2int(const char* s, uint64_t& result);
 bool string2double(const char* s, double& result);
+bool string2duration_msec(const std::string& s, uint64_t& result); // e.g. "100ms", "10s", "2m" or "0.5" (seconds)
 template <typename T> std::string stl_container2string(const T& par, const std::string& delim);
 std::vector<std::string> split_string_in_array(const std::string& str, char splitter);
 bool split_string_on_first_separator(const std::string& str, char separator, std::string& before, std::string& after);
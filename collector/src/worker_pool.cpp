@@ -0,0 +1,151 @@
+/*
+ * worker_pool.cpp -- pool of threads sharing the sampling work of a single sample
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "worker_pool.h"
+#include <algorithm>
+
+// ----------------------------------------------------------------------------------
+// CMonitorWorkerPool
+// ----------------------------------------------------------------------------------
+
+bool CMonitorWorkerPool::init(unsigned int num_workers)
+{
+    close();
+    if (num_workers == 0 || num_workers > WORKER_POOL_MAX_THREADS)
+        return false;
+
+    m_num_workers = num_workers;
+    m_shards.reset(new shard_t[num_workers]);
+    for (unsigned int i = 0; i < num_workers; i++) {
+        m_shards[i].next = 0;
+        m_shards[i].last = 0;
+    }
+
+    m_stop = false;
+    m_run_generation = 0; // threads starting late still join the first run
+    for (unsigned int i = 1; i < num_workers; i++)
+        m_threads.push_back(std::thread(&CMonitorWorkerPool::thread_main, this, i));
+    return true;
+}
+
+void CMonitorWorkerPool::close()
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stop = true;
+    }
+    m_start_cond.notify_all();
+    for (auto& t : m_threads)
+        t.join();
+    m_threads.clear();
+    m_num_workers = 1;
+}
+
+void CMonitorWorkerPool::run(size_t num_items, const worker_pool_fn_t& fn)
+{
+    m_stats.runs++;
+    if (m_threads.empty() || num_items == 0) {
+        if (num_items) {
+            fn(0, 0, num_items);
+            m_stats.chunks++;
+        }
+        return;
+    }
+
+    // shards of (almost) equal size:
+    size_t first = 0;
+    for (unsigned int i = 0; i < m_num_workers; i++) {
+        size_t size = num_items / m_num_workers + (i < num_items % m_num_workers ? 1 : 0);
+        m_shards[i].next = first;
+        m_shards[i].last = first + size;
+        m_shards[i].chunks = 0;
+        m_shards[i].stolen_chunks = 0;
+        first += size;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_fn = &fn;
+        m_num_running = m_num_workers - 1;
+        m_run_generation++;
+    }
+    m_start_cond.notify_all();
+
+    work(0);
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done_cond.wait(lock, [this]() -> bool { return m_num_running == 0; });
+        m_fn = nullptr;
+    }
+
+    for (unsigned int i = 0; i < m_num_workers; i++) {
+        m_stats.chunks += m_shards[i].chunks;
+        m_stats.stolen_chunks += m_shards[i].stolen_chunks;
+    }
+}
+
+// ----------------------------------------------------------------------------------
+// CMonitorWorkerPool - worker threads
+// ----------------------------------------------------------------------------------
+
+void CMonitorWorkerPool::work(unsigned int worker)
+{
+    const worker_pool_fn_t& fn = *m_fn;
+    shard_t& mine = m_shards[worker];
+
+    // start from our own shard, then visit the others in a different order for each worker:
+    for (unsigned int n = 0; n < m_num_workers; n++) {
+        unsigned int victim = (worker + n) % m_num_workers;
+        shard_t& shard = m_shards[victim];
+        while (true) {
+            size_t first = shard.next.fetch_add(WORKER_POOL_CHUNK_SIZE, std::memory_order_relaxed);
+            if (first >= shard.last)
+                break;
+            fn(worker, first, std::min(first + WORKER_POOL_CHUNK_SIZE, shard.last));
+            mine.chunks.fetch_add(1, std::memory_order_relaxed);
+            if (victim != worker)
+                mine.stolen_chunks.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void CMonitorWorkerPool::thread_main(unsigned int worker)
+{
+    uint64_t last_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start_cond.wait(lock, [&]() -> bool { return m_stop || m_run_generation != last_generation; });
+            if (m_stop)
+                return;
+            last_generation = m_run_generation;
+        }
+
+        work(worker);
+
+        bool last_one;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            last_one = --m_num_running == 0;
+        }
+        if (last_one)
+            m_done_cond.notify_one();
+    }
+}
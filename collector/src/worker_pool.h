@@ -0,0 +1,108 @@
+/*
+ * worker_pool.h -- pool of threads sharing the sampling work of a single sample
+ * Developer: Francesco Montorsi.
+ * (C) Copyright 2022 Francesco Montorsi
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+//------------------------------------------------------------------------------
+// Includes
+//------------------------------------------------------------------------------
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
+
+#define WORKER_POOL_MAX_THREADS (64)
+#define WORKER_POOL_MAX_THREADS_STR "64"
+#define WORKER_POOL_CHUNK_SIZE (8) // items taken at once by a worker: small enough to balance tasks of uneven cost
+
+//------------------------------------------------------------------------------
+// Types
+//------------------------------------------------------------------------------
+
+// processes the items [first, last) on behalf of the given worker, 0 <= worker < get_num_workers()
+typedef std::function<void(unsigned int worker, size_t first, size_t last)> worker_pool_fn_t;
+
+typedef struct {
+    uint64_t runs = 0; // calls to run()
+    uint64_t chunks = 0; // chunks processed, including the stolen ones
+    uint64_t stolen_chunks = 0; // chunks processed by a worker other than the owner of their shard
+} worker_pool_stats_t;
+
+//------------------------------------------------------------------------------
+// CMonitorWorkerPool
+//
+// Spreads the processing of a list of independent items, e.g. the tasks of a cgroup, over a set of
+// threads. The calling thread is worker 0; the pool adds num_workers-1 threads, parked between runs.
+// Each run splits the items in one contiguous shard per worker; workers consume their own shard in chunks
+// and, once done, steal chunks from the shards of the others, so that a worker slowed down by expensive
+// items does not delay the whole run. Shards are claimed with atomic counters only: the callback is expected
+// to write into per-worker storage and the caller to merge it once run() returns.
+//------------------------------------------------------------------------------
+
+class CMonitorWorkerPool {
+public:
+    CMonitorWorkerPool() { }
+    ~CMonitorWorkerPool() { close(); }
+
+    // num_workers includes the calling thread: 1 means that run() just invokes the callback inline
+    bool init(unsigned int num_workers);
+    void close();
+
+    // returns once all the items have been processed
+    void run(size_t num_items, const worker_pool_fn_t& fn);
+
+    unsigned int get_num_workers() const { return m_num_workers; }
+    const worker_pool_stats_t& get_stats() const { return m_stats; }
+
+private:
+    // each shard has its own cache line, so that workers do not contend on their counters
+    struct alignas(64) shard_t {
+        std::atomic<size_t> next;
+        size_t last;
+        std::atomic<uint64_t> chunks; // processed by its worker, from any shard
+        std::atomic<uint64_t> stolen_chunks;
+    };
+
+    void thread_main(unsigned int worker);
+    void work(unsigned int worker);
+
+    unsigned int m_num_workers = 1;
+    std::vector<std::thread> m_threads;
+    std::unique_ptr<shard_t[]> m_shards;
+
+    // state of the current run, protected by m_mutex
+    std::mutex m_mutex;
+    std::condition_variable m_start_cond;
+    std::condition_variable m_done_cond;
+    const worker_pool_fn_t* m_fn = nullptr;
+    uint64_t m_run_generation = 0;
+    unsigned int m_num_running = 0; // threads of the pool still working on the current run
+    bool m_stop = false;
+
+    worker_pool_stats_t m_stats;
+};